@@ -2,5 +2,5 @@
 mkdir -p build
 cd build
 cmake -S ../ -B .
-make && make shaders && ./KnoxicEngine
+make && ./KnoxicEngine
 cd ..
\ No newline at end of file
@@ -0,0 +1,32 @@
+# Writes every SPIR-V binary in SPIRV_DIR to OUTPUT as constexpr uint32_t arrays, along with the
+# EMBEDDED_SHADERS table declared in src/graphics/vulkan/knoxic_vk_embedded_shaders.hpp.
+# Run by the shaders target: cmake -DSPIRV_DIR=<dir> -DOUTPUT=<file> -P embed_spirv.cmake
+
+file(GLOB SPIRV_FILES "${SPIRV_DIR}/*.spv")
+list(SORT SPIRV_FILES)
+if(NOT SPIRV_FILES)
+    message(FATAL_ERROR "no SPIR-V binaries found in ${SPIRV_DIR}")
+endif()
+
+set(ARRAYS "")
+set(TABLE "")
+foreach(SPIRV ${SPIRV_FILES})
+    get_filename_component(FILE_NAME ${SPIRV} NAME)
+    string(MAKE_C_IDENTIFIER ${FILE_NAME} IDENTIFIER)
+
+    # SPIR-V is a stream of little-endian words, four hex bytes are reversed into one literal
+    file(READ ${SPIRV} HEX_CONTENT HEX)
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])"
+        "0x\\4\\3\\2\\1, " WORDS "${HEX_CONTENT}")
+
+    string(APPEND ARRAYS "    static constexpr uint32_t ${IDENTIFIER}[] = {${WORDS}};\n")
+    string(APPEND TABLE "        {\"shaders/${FILE_NAME}\", ${IDENTIFIER}, sizeof(${IDENTIFIER})},\n")
+endforeach()
+
+set(CONTENT "// Generated by cmake/embed_spirv.cmake, do not edit\n\n")
+string(APPEND CONTENT "#include \"graphics/vulkan/knoxic_vk_embedded_shaders.hpp\"\n\n")
+string(APPEND CONTENT "namespace knoxic {\n\n${ARRAYS}\n")
+string(APPEND CONTENT "    const KnoxicEmbeddedShader EMBEDDED_SHADERS[] = {\n${TABLE}    };\n")
+string(APPEND CONTENT "    const size_t EMBEDDED_SHADER_COUNT = sizeof(EMBEDDED_SHADERS) / sizeof(EMBEDDED_SHADERS[0]);\n}\n")
+
+file(WRITE ${OUTPUT} "${CONTENT}")
\ No newline at end of file
@@ -1,21 +0,0 @@
-#version 450
-
-layout(location = 0) out vec2 fragTexCoord;
-
-void main() {
-    // Generate a fullscreen triangle
-    vec2 positions[3] = vec2[](
-        vec2(-1.0, -1.0),
-        vec2(3.0, -1.0),
-        vec2(-1.0, 3.0)
-    );
-    
-    vec2 texCoords[3] = vec2[](
-        vec2(0.0, 0.0),
-        vec2(2.0, 0.0),
-        vec2(0.0, 2.0)
-    );
-    
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragTexCoord = texCoords[gl_VertexIndex];
-}
\ No newline at end of file
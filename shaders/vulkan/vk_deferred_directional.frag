@@ -0,0 +1,168 @@
+#version 450
+
+// Ambient and directional lights for every lit pixel, added onto the HDR color
+layout(location = 0) in vec2 fragTexCoord;
+layout(location = 0) out vec4 outColor;
+
+struct PointLight {
+    vec4 position; // w is range
+    vec4 color; // w is intensity
+};
+
+struct SpotLight {
+    vec4 position; // w is range
+    vec4 direction; // ignore w
+    vec4 color; // w is intensity
+    float innerCutoff; // cos of inner angle
+    float outerCutoff; // cos of outer angle
+    float padding1;
+    float padding2;
+};
+
+struct DirectionalLight {
+    vec4 direction; // ignore w
+    vec4 color; // w is intensity
+};
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projection;
+    mat4 view;
+    mat4 inverseView;
+    vec4 ambientLightColor; // w is intensity
+    int numLights;
+    int numSpotLights;
+    int numDirectionalLights;
+    int padding;
+    uvec4 clusterGrid; // tiles x, tiles y, depth slices, max lights per cluster
+    vec4 clusterDepth; // near, far, slice scale, slice bias
+    vec4 clusterScreen; // width, height, 1 / width, 1 / height
+} ubo;
+
+layout(std430, set = 0, binding = 3) readonly buffer PointLightBuffer {
+    PointLight lights[];
+} pointLightBuffer;
+
+layout(std430, set = 0, binding = 4) readonly buffer SpotLightBuffer {
+    SpotLight lights[];
+} spotLightBuffer;
+
+layout(std430, set = 0, binding = 5) readonly buffer DirectionalLightBuffer {
+    DirectionalLight lights[];
+} directionalLightBuffer;
+
+struct ShadowView {
+    mat4 viewProjection;
+    vec4 atlasRect; // uv offset xy, uv scale zw, zero scale until first rendered
+    vec4 params; // x is the far view depth of a cascade
+};
+
+layout(std430, set = 0, binding = 6) readonly buffer ShadowViewBuffer {
+    ShadowView views[];
+} shadowViewBuffer;
+
+// First shadow view of every light: point lights, then spot lights, then directional lights. -1 for none
+layout(std430, set = 0, binding = 7) readonly buffer LightShadowBuffer {
+    int firstViews[];
+} lightShadowBuffer;
+
+layout(set = 0, binding = 8) uniform sampler2DShadow shadowAtlas;
+
+// Matches ShadowSystem::CASCADE_COUNT
+const int SHADOW_CASCADE_COUNT = 3;
+
+// G-buffer, read from the previous subpass
+layout(input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput gbufferAlbedo;
+layout(input_attachment_index = 1, set = 1, binding = 1) uniform subpassInput gbufferNormal;
+layout(input_attachment_index = 2, set = 1, binding = 2) uniform subpassInput gbufferMaterial; // roughness, metallic, ao, lit
+layout(input_attachment_index = 3, set = 1, binding = 3) uniform subpassInput gbufferDepth;
+
+// World position from the depth buffer and the projection (+z forward)
+vec3 reconstructWorldPosition(float depth) {
+    vec2 ndc = gl_FragCoord.xy * ubo.clusterScreen.zw * 2.0 - 1.0;
+    float viewZ = ubo.projection[3][2] / (depth - ubo.projection[2][2]);
+    vec3 viewPosition = vec3(ndc.x * viewZ / ubo.projection[0][0], ndc.y * viewZ / ubo.projection[1][1], viewZ);
+    return (ubo.inverseView * vec4(viewPosition, 1.0)).xyz;
+}
+
+// 2x2 bilinear compare PCF in one atlas tile, 1 is fully lit
+float sampleShadow(int viewIndex, vec3 positionWorld) {
+    ShadowView view = shadowViewBuffer.views[viewIndex];
+    if (view.atlasRect.z == 0.0) {
+        return 1.0;
+    }
+
+    vec4 clip = view.viewProjection * vec4(positionWorld, 1.0);
+    vec3 ndc = clip.xyz / clip.w;
+    if (ndc.z <= 0.0 || ndc.z >= 1.0 || abs(ndc.x) >= 1.0 || abs(ndc.y) >= 1.0) {
+        return 1.0;
+    }
+
+    // Keep the filter footprint inside the tile
+    vec2 texel = 1.0 / vec2(textureSize(shadowAtlas, 0));
+    vec2 uv = view.atlasRect.xy + (ndc.xy * 0.5 + 0.5) * view.atlasRect.zw;
+    uv = clamp(uv, view.atlasRect.xy + texel, view.atlasRect.xy + view.atlasRect.zw - texel);
+
+    float shadow = 0.0;
+    shadow += texture(shadowAtlas, vec3(uv + vec2(-0.5, -0.5) * texel, ndc.z));
+    shadow += texture(shadowAtlas, vec3(uv + vec2(0.5, -0.5) * texel, ndc.z));
+    shadow += texture(shadowAtlas, vec3(uv + vec2(-0.5, 0.5) * texel, ndc.z));
+    shadow += texture(shadowAtlas, vec3(uv + vec2(0.5, 0.5) * texel, ndc.z));
+    return shadow * 0.25;
+}
+
+// Picks the first cascade that reaches the fragment's view depth
+float directionalShadow(int lightIndex, vec3 positionWorld) {
+    int firstView = lightShadowBuffer.firstViews[ubo.numLights + ubo.numSpotLights + lightIndex];
+    if (firstView < 0) {
+        return 1.0;
+    }
+
+    float viewDepth = (ubo.view * vec4(positionWorld, 1.0)).z;
+    for (int cascade = 0; cascade < SHADOW_CASCADE_COUNT; cascade++) {
+        if (viewDepth <= shadowViewBuffer.views[firstView + cascade].params.x) {
+            return sampleShadow(firstView + cascade, positionWorld);
+        }
+    }
+    return 1.0;
+}
+
+// Diffuse and specular of one light, same model as vk_lighting.frag
+void addLight(vec3 radiance, vec3 directionToLight, vec3 normal, vec3 viewDirection,
+              vec3 albedo, float roughness, float metallic, inout vec3 diffuse, inout vec3 specular) {
+    float cosAngleIncidence = max(dot(normal, directionToLight), 0);
+    diffuse += radiance * cosAngleIncidence;
+
+    vec3 halfAngle = normalize(directionToLight + viewDirection);
+    float blinnTerm = clamp(dot(normal, halfAngle), 0, 1);
+    float shininess = mix(128.0, 8.0, roughness);
+    blinnTerm = pow(blinnTerm, shininess);
+
+    vec3 specularColor = mix(vec3(0.04), albedo, metallic);
+    specular += radiance * blinnTerm * specularColor;
+}
+
+void main() {
+    vec4 material = subpassLoad(gbufferMaterial);
+    float depth = subpassLoad(gbufferDepth).r;
+    if (material.a == 0.0 || depth >= 1.0) {
+        discard;
+    }
+
+    vec3 albedo = subpassLoad(gbufferAlbedo).rgb;
+    vec3 normal = normalize(subpassLoad(gbufferNormal).xyz);
+    vec3 positionWorld = reconstructWorldPosition(depth);
+
+    vec3 cameraPosWorld = ubo.inverseView[3].xyz;
+    vec3 viewDirection = normalize(cameraPosWorld - positionWorld);
+
+    vec3 diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w * material.b;
+    vec3 specularLight = vec3(0.0);
+
+    for (int i = 0; i < ubo.numDirectionalLights; i++) {
+        DirectionalLight light = directionalLightBuffer.lights[i];
+        addLight(light.color.xyz * light.color.w * directionalShadow(i, positionWorld), normalize(-light.direction.xyz), normal, viewDirection,
+                 albedo, material.r, material.g, diffuseLight, specularLight);
+    }
+
+    outColor = vec4(diffuseLight * albedo + specularLight, 0.0);
+}
\ No newline at end of file
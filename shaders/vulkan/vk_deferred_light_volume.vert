@@ -0,0 +1,65 @@
+#version 450
+
+// One instance per light, a cube of half size = range around it.
+// Only back faces are drawn with a greater-or-equal depth test, so pixels whose surface lies
+// in front of the far side of the volume are shaded, including when the camera is inside it.
+layout(constant_id = 0) const bool SPOT_LIGHT = false;
+
+layout(location = 0) flat out uint lightIndex;
+
+struct PointLight {
+    vec4 position; // w is range
+    vec4 color; // w is intensity
+};
+
+struct SpotLight {
+    vec4 position; // w is range
+    vec4 direction; // ignore w
+    vec4 color; // w is intensity
+    float innerCutoff; // cos of inner angle
+    float outerCutoff; // cos of outer angle
+    float padding1;
+    float padding2;
+};
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projection;
+    mat4 view;
+    mat4 inverseView;
+    vec4 ambientLightColor; // w is intensity
+    int numLights;
+    int numSpotLights;
+    int numDirectionalLights;
+    int padding;
+    uvec4 clusterGrid; // tiles x, tiles y, depth slices, max lights per cluster
+    vec4 clusterDepth; // near, far, slice scale, slice bias
+    vec4 clusterScreen; // width, height, 1 / width, 1 / height
+} ubo;
+
+layout(std430, set = 0, binding = 3) readonly buffer PointLightBuffer {
+    PointLight lights[];
+} pointLightBuffer;
+
+layout(std430, set = 0, binding = 4) readonly buffer SpotLightBuffer {
+    SpotLight lights[];
+} spotLightBuffer;
+
+// Corner bits are x, y, z. Faces wind outward
+const uint CUBE_INDICES[36] = uint[](
+    0, 2, 1, 1, 2, 3, // -z
+    4, 5, 6, 5, 7, 6, // +z
+    0, 4, 2, 2, 4, 6, // -x
+    1, 3, 5, 3, 7, 5, // +x
+    0, 1, 4, 1, 5, 4, // -y
+    2, 6, 3, 3, 6, 7  // +y
+);
+
+void main() {
+    uint corner = CUBE_INDICES[gl_VertexIndex];
+    vec3 offset = vec3(corner & 1u, (corner >> 1) & 1u, (corner >> 2) & 1u) * 2.0 - 1.0;
+
+    vec4 light = SPOT_LIGHT ? spotLightBuffer.lights[gl_InstanceIndex].position : pointLightBuffer.lights[gl_InstanceIndex].position;
+    lightIndex = gl_InstanceIndex;
+
+    gl_Position = ubo.projection * ubo.view * vec4(light.xyz + offset * light.w, 1.0);
+}
\ No newline at end of file
@@ -2,49 +2,23 @@
 
 layout(location = 0) in vec2 fragOffset;
 layout(location = 1) in vec3 fragDirection;
+layout(location = 2) in vec3 fragColor;
 layout(location = 0) out vec4 outColor;
 
-struct PointLight {
-    vec4 position; // ignore w
-    vec4 color; // w is intensity
-};
-
-struct SpotLight {
-    vec4 position; // ignore w
-    vec4 direction; // ignore w
-    vec4 color; // w is intensity
-    float innerCutoff; // cos of inner angle
-    float outerCutoff; // cos of outer angle
-    float padding1;
-    float padding2;
-};
-
-struct DirectionalLight {
-    vec4 direction; // ignore w
-    vec4 color; // w is intensity
-};
-
 layout(set = 0, binding = 0) uniform GlobalUbo {
     mat4 projection;
     mat4 view;
     mat4 inverseView;
     vec4 ambientLightColor; // w is intensity
-    PointLight pointLights[1000];
     int numLights;
     int numSpotLights;
     int numDirectionalLights;
     int padding;
-    SpotLight spotLights[1000];
-    DirectionalLight directionalLights[1000];
+    uvec4 clusterGrid; // tiles x, tiles y, depth slices, max lights per cluster
+    vec4 clusterDepth; // near, far, slice scale, slice bias
+    vec4 clusterScreen; // width, height, 1 / width, 1 / height
 } ubo;
 
-layout(push_constant) uniform Push {
-    vec4 position; // position for visualization
-    vec4 direction; // ignore w
-    vec4 color; // w is intesntiy
-    float radius;
-} push;
-
 const float M_PI = 3.1415926538;
 
 void main() {
@@ -95,7 +69,7 @@ void main() {
     float alpha = max(centerCircle, sunRays);
     
     // Use very low brightness to avoid bloom
-    vec3 finalColor = push.color.xyz * (centerCircle * 0.25 + sunRays * 0.3);
+    vec3 finalColor = fragColor * (centerCircle * 0.25 + sunRays * 0.3);
     outColor = vec4(finalColor, alpha);
 }
 
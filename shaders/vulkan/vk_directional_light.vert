@@ -9,60 +9,48 @@ const vec2 OFFSETS[6] = vec2[](
     vec2(1.0, 1.0)
 );
 
+// Per-instance billboard
+layout(location = 0) in vec4 instancePosition; // w is billboard radius
+layout(location = 1) in uint instanceLightIndex;
+
 layout(location = 0) out vec2 fragOffset;
 layout(location = 1) out vec3 fragDirection;
-
-struct PointLight {
-    vec4 position; // ignore w
-    vec4 color; // w is intensity
-};
-
-struct SpotLight {
-    vec4 position; // ignore w
-    vec4 direction; // ignore w
-    vec4 color; // w is intensity
-    float innerCutoff; // cos of inner angle
-    float outerCutoff; // cos of outer angle
-    float padding1;
-    float padding2;
-};
-
-struct DirectionalLight {
-    vec4 direction; // ignore w
-    vec4 color; // w is intensity
-};
+layout(location = 2) out vec3 fragColor;
 
 layout(set = 0, binding = 0) uniform GlobalUbo {
     mat4 projection;
     mat4 view;
     mat4 inverseView;
     vec4 ambientLightColor; // w is intensity
-    PointLight pointLights[1000];
     int numLights;
     int numSpotLights;
     int numDirectionalLights;
     int padding;
-    SpotLight spotLights[1000];
-    DirectionalLight directionalLights[1000];
+    uvec4 clusterGrid; // tiles x, tiles y, depth slices, max lights per cluster
+    vec4 clusterDepth; // near, far, slice scale, slice bias
+    vec4 clusterScreen; // width, height, 1 / width, 1 / height
 } ubo;
 
-layout(push_constant) uniform Push {
-    vec4 position; // position for visualization
+struct DirectionalLight {
     vec4 direction; // ignore w
-    vec4 color; // w is intesntiy
-    float radius;
-} push;
+    vec4 color; // w is intensity
+};
+
+layout(std430, set = 0, binding = 5) readonly buffer DirectionalLightBuffer {
+    DirectionalLight lights[];
+} directionalLightBuffer;
 
 void main() {
     fragOffset = OFFSETS[gl_VertexIndex];
-    fragDirection = push.direction.xyz;
+    fragDirection = directionalLightBuffer.lights[instanceLightIndex].direction.xyz;
+    fragColor = directionalLightBuffer.lights[instanceLightIndex].color.xyz;
     
     vec3 cameraRightWorld = {ubo.view[0][0], ubo.view[1][0], ubo.view[2][0]};
     vec3 cameraUpWorld = {ubo.view[0][1], ubo.view[1][1], ubo.view[2][1]};
 
-    vec3 positionWorld = push.position.xyz
-        + push.radius * fragOffset.x * cameraRightWorld
-        + push.radius * fragOffset.y * cameraUpWorld;
+    vec3 positionWorld = instancePosition.xyz
+        + instancePosition.w * fragOffset.x * cameraRightWorld
+        + instancePosition.w * fragOffset.y * cameraUpWorld;
 
     gl_Position = ubo.projection * ubo.view * vec4(positionWorld, 1.0);
 }
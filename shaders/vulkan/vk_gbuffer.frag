@@ -0,0 +1,115 @@
+#version 450
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragPosWorld;
+layout(location = 2) in vec3 fragNormalWorld;
+layout(location = 3) in vec2 fragUv;
+layout(location = 4) in vec4 fragClipPosition;
+layout(location = 5) in vec4 fragPreviousClipPosition;
+
+// HDR color receives emission and unlit surfaces directly, lighting is added in the next subpass
+layout(location = 0) out vec4 outEmission;
+layout(location = 1) out vec4 outAlbedo;
+layout(location = 2) out vec4 outNormal; // world space
+layout(location = 3) out vec4 outMaterial; // roughness, metallic, ao, lit
+layout(location = 4) out vec2 outVelocity;
+
+// Material textures
+layout(set = 1, binding = 0) uniform sampler2D albedoTexture;
+layout(set = 1, binding = 1) uniform sampler2D normalTexture;
+layout(set = 1, binding = 2) uniform sampler2D roughnessTexture;
+layout(set = 1, binding = 3) uniform sampler2D metallicTexture;
+
+layout(push_constant) uniform Push {
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    vec3 albedo;
+    float metallic;
+    float roughness;
+    float ao;
+    vec2 textureOffset;
+    vec2 textureScale;
+    vec3 emissionColor;
+    float emissionStrength;
+} push;
+
+// Material permutation, constant_id matches the MaterialFeatureBits bit index
+layout(constant_id = 0) const bool HAS_ALBEDO_MAP = false;
+layout(constant_id = 1) const bool HAS_NORMAL_MAP = false;
+layout(constant_id = 2) const bool HAS_ROUGHNESS_MAP = false;
+layout(constant_id = 3) const bool HAS_METALLIC_MAP = false;
+layout(constant_id = 4) const bool EMISSIVE_ONLY = false;
+layout(constant_id = 5) const bool UNLIT = false;
+
+// Calculate tangent-bitangent-normal matrix for normal mapping
+mat3 calculateTBN(vec3 normal, vec3 pos, vec2 uv) {
+    vec3 dp1 = dFdx(pos);
+    vec3 dp2 = dFdy(pos);
+    vec2 duv1 = dFdx(uv);
+    vec2 duv2 = dFdy(uv);
+    
+    vec3 dp2perp = cross(dp2, normal);
+    vec3 dp1perp = cross(normal, dp1);
+    vec3 tangent = dp2perp * duv1.x + dp1perp * duv2.x;
+    vec3 bitangent = dp2perp * duv1.y + dp1perp * duv2.y;
+    
+    float invmax = inversesqrt(max(dot(tangent, tangent), dot(bitangent, bitangent)));
+    return mat3(tangent * invmax, bitangent * invmax, normal);
+}
+
+// Screen space motion since the previous frame, in uv units
+vec2 velocity() {
+    return (fragClipPosition.xy / fragClipPosition.w - fragPreviousClipPosition.xy / fragPreviousClipPosition.w) * 0.5;
+}
+
+void main() {
+    outVelocity = velocity();
+
+    vec3 emission = push.emissionColor * push.emissionStrength;
+    if (EMISSIVE_ONLY) {
+        outEmission = vec4(emission, 1.0);
+        outAlbedo = vec4(0.0);
+        outNormal = vec4(0.0);
+        outMaterial = vec4(0.0);
+        return;
+    }
+
+    // Sample albedo texture and combine with material color
+    vec3 materialColor = push.albedo;
+    if (HAS_ALBEDO_MAP) {
+        materialColor *= texture(albedoTexture, fragUv).rgb;
+    }
+
+    if (UNLIT) {
+        outEmission = vec4(materialColor + emission, 1.0);
+        outAlbedo = vec4(0.0);
+        outNormal = vec4(0.0);
+        outMaterial = vec4(0.0);
+        return;
+    }
+
+    float roughness = push.roughness;
+    if (HAS_ROUGHNESS_MAP) {
+        roughness *= texture(roughnessTexture, fragUv).r;
+    }
+
+    float metallic = push.metallic;
+    if (HAS_METALLIC_MAP) {
+        metallic *= texture(metallicTexture, fragUv).r;
+    }
+
+    vec3 N = normalize(fragNormalWorld);
+    vec3 surfaceNormal = N;
+
+    // Normal mapping only in permutations that have a normal map
+    if (HAS_NORMAL_MAP) {
+        vec3 normalMap = normalize(texture(normalTexture, fragUv).rgb * 2.0 - 1.0);
+        mat3 TBN = calculateTBN(N, fragPosWorld, fragUv);
+        surfaceNormal = normalize(TBN * normalMap);
+    }
+
+    outEmission = vec4(emission, 1.0);
+    outAlbedo = vec4(materialColor, 1.0);
+    outNormal = vec4(surfaceNormal, 0.0);
+    outMaterial = vec4(roughness, metallic, push.ao, 1.0);
+}
\ No newline at end of file
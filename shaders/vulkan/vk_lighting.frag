@@ -4,16 +4,19 @@ layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec3 fragPosWorld;
 layout(location = 2) in vec3 fragNormalWorld;
 layout(location = 3) in vec2 fragUv;
+layout(location = 4) in vec4 fragClipPosition;
+layout(location = 5) in vec4 fragPreviousClipPosition;
 
 layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec2 outVelocity;
 
 struct PointLight {
-    vec4 position; // ignore w
+    vec4 position; // w is range
     vec4 color; // w is intensity
 };
 
 struct SpotLight {
-    vec4 position; // ignore w
+    vec4 position; // w is range
     vec4 direction; // ignore w
     vec4 color; // w is intensity
     float innerCutoff; // cos of inner angle
@@ -32,15 +35,58 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
     mat4 view;
     mat4 inverseView;
     vec4 ambientLightColor; // w is intensity
-    PointLight pointLights[1000];
     int numLights;
     int numSpotLights;
     int numDirectionalLights;
     int padding;
-    SpotLight spotLights[1000];
-    DirectionalLight directionalLights[1000];
+    uvec4 clusterGrid; // tiles x, tiles y, depth slices, max lights per cluster
+    vec4 clusterDepth; // near, far, slice scale, slice bias
+    vec4 clusterScreen; // width, height, 1 / width, 1 / height
 } ubo;
 
+// Per cluster point and spot light counts, written by vk_light_cull.comp
+layout(std430, set = 0, binding = 1) readonly buffer LightGrid {
+    uvec2 counts[];
+} lightGrid;
+
+// Point indices followed by spot indices, clusterGrid.w slots per cluster
+layout(std430, set = 0, binding = 2) readonly buffer LightIndexList {
+    uint indices[];
+} lightIndexList;
+
+// Light storage, sized to the lights in the scene
+layout(std430, set = 0, binding = 3) readonly buffer PointLightBuffer {
+    PointLight lights[];
+} pointLightBuffer;
+
+layout(std430, set = 0, binding = 4) readonly buffer SpotLightBuffer {
+    SpotLight lights[];
+} spotLightBuffer;
+
+layout(std430, set = 0, binding = 5) readonly buffer DirectionalLightBuffer {
+    DirectionalLight lights[];
+} directionalLightBuffer;
+
+struct ShadowView {
+    mat4 viewProjection;
+    vec4 atlasRect; // uv offset xy, uv scale zw, zero scale until first rendered
+    vec4 params; // x is the far view depth of a cascade
+};
+
+layout(std430, set = 0, binding = 6) readonly buffer ShadowViewBuffer {
+    ShadowView views[];
+} shadowViewBuffer;
+
+// First shadow view of every light: point lights, then spot lights, then directional lights. -1 for none
+layout(std430, set = 0, binding = 7) readonly buffer LightShadowBuffer {
+    int firstViews[];
+} lightShadowBuffer;
+
+layout(set = 0, binding = 8) uniform sampler2DShadow shadowAtlas;
+
+// Matches ShadowSystem::CASCADE_COUNT
+const int SHADOW_CASCADE_COUNT = 3;
+
 // Material textures
 layout(set = 1, binding = 0) uniform sampler2D albedoTexture;
 layout(set = 1, binding = 1) uniform sampler2D normalTexture;
@@ -60,6 +106,14 @@ layout(push_constant) uniform Push {
     float emissionStrength;
 } push;
 
+// Material permutation, constant_id matches the MaterialFeatureBits bit index
+layout(constant_id = 0) const bool HAS_ALBEDO_MAP = false;
+layout(constant_id = 1) const bool HAS_NORMAL_MAP = false;
+layout(constant_id = 2) const bool HAS_ROUGHNESS_MAP = false;
+layout(constant_id = 3) const bool HAS_METALLIC_MAP = false;
+layout(constant_id = 4) const bool EMISSIVE_ONLY = false;
+layout(constant_id = 5) const bool UNLIT = false;
+
 // Calculate tangent-bitangent-normal matrix for normal mapping
 mat3 calculateTBN(vec3 normal, vec3 pos, vec2 uv) {
     vec3 dp1 = dFdx(pos);
@@ -76,19 +130,133 @@ mat3 calculateTBN(vec3 normal, vec3 pos, vec2 uv) {
     return mat3(tangent * invmax, bitangent * invmax, normal);
 }
 
+// Inverse square falloff windowed to reach zero at the light range
+float rangeAttenuation(float distanceSquared, float range) {
+    float ratio = distanceSquared / (range * range);
+    float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+    return (window * window) / max(distanceSquared, 0.0001);
+}
+
+// Cluster containing this fragment
+// 2x2 bilinear compare PCF in one atlas tile, 1 is fully lit
+float sampleShadow(int viewIndex, vec3 positionWorld) {
+    ShadowView view = shadowViewBuffer.views[viewIndex];
+    if (view.atlasRect.z == 0.0) {
+        return 1.0;
+    }
+
+    vec4 clip = view.viewProjection * vec4(positionWorld, 1.0);
+    vec3 ndc = clip.xyz / clip.w;
+    if (ndc.z <= 0.0 || ndc.z >= 1.0 || abs(ndc.x) >= 1.0 || abs(ndc.y) >= 1.0) {
+        return 1.0;
+    }
+
+    // Keep the filter footprint inside the tile
+    vec2 texel = 1.0 / vec2(textureSize(shadowAtlas, 0));
+    vec2 uv = view.atlasRect.xy + (ndc.xy * 0.5 + 0.5) * view.atlasRect.zw;
+    uv = clamp(uv, view.atlasRect.xy + texel, view.atlasRect.xy + view.atlasRect.zw - texel);
+
+    float shadow = 0.0;
+    shadow += texture(shadowAtlas, vec3(uv + vec2(-0.5, -0.5) * texel, ndc.z));
+    shadow += texture(shadowAtlas, vec3(uv + vec2(0.5, -0.5) * texel, ndc.z));
+    shadow += texture(shadowAtlas, vec3(uv + vec2(-0.5, 0.5) * texel, ndc.z));
+    shadow += texture(shadowAtlas, vec3(uv + vec2(0.5, 0.5) * texel, ndc.z));
+    return shadow * 0.25;
+}
+
+// Cube faces are stored +x, -x, +y, -y, +z, -z
+float pointShadow(int lightIndex, vec3 positionWorld, vec3 lightPosition) {
+    int firstView = lightShadowBuffer.firstViews[lightIndex];
+    if (firstView < 0) {
+        return 1.0;
+    }
+
+    vec3 fromLight = positionWorld - lightPosition;
+    vec3 absolute = abs(fromLight);
+    int face;
+    if (absolute.x >= absolute.y && absolute.x >= absolute.z) {
+        face = fromLight.x > 0.0 ? 0 : 1;
+    } else if (absolute.y >= absolute.z) {
+        face = fromLight.y > 0.0 ? 2 : 3;
+    } else {
+        face = fromLight.z > 0.0 ? 4 : 5;
+    }
+    return sampleShadow(firstView + face, positionWorld);
+}
+
+float spotShadow(int lightIndex, vec3 positionWorld) {
+    int firstView = lightShadowBuffer.firstViews[ubo.numLights + lightIndex];
+    return firstView < 0 ? 1.0 : sampleShadow(firstView, positionWorld);
+}
+
+// Picks the first cascade that reaches the fragment's view depth
+float directionalShadow(int lightIndex, vec3 positionWorld) {
+    int firstView = lightShadowBuffer.firstViews[ubo.numLights + ubo.numSpotLights + lightIndex];
+    if (firstView < 0) {
+        return 1.0;
+    }
+
+    float viewDepth = (ubo.view * vec4(positionWorld, 1.0)).z;
+    for (int cascade = 0; cascade < SHADOW_CASCADE_COUNT; cascade++) {
+        if (viewDepth <= shadowViewBuffer.views[firstView + cascade].params.x) {
+            return sampleShadow(firstView + cascade, positionWorld);
+        }
+    }
+    return 1.0;
+}
+
+uint clusterIndex(vec3 posWorld) {
+    float viewDepth = (ubo.view * vec4(posWorld, 1.0)).z;
+    uint slice = uint(max(log(max(viewDepth, ubo.clusterDepth.x)) * ubo.clusterDepth.z + ubo.clusterDepth.w, 0.0));
+    slice = min(slice, ubo.clusterGrid.z - 1);
+
+    uvec2 tile = uvec2(gl_FragCoord.xy * ubo.clusterScreen.zw * vec2(ubo.clusterGrid.xy));
+    tile = min(tile, ubo.clusterGrid.xy - 1);
+
+    return tile.x + tile.y * ubo.clusterGrid.x + slice * ubo.clusterGrid.x * ubo.clusterGrid.y;
+}
+
+// Screen space motion since the previous frame, in uv units
+vec2 velocity() {
+    return (fragClipPosition.xy / fragClipPosition.w - fragPreviousClipPosition.xy / fragPreviousClipPosition.w) * 0.5;
+}
+
 void main() {
+    outVelocity = velocity();
+
+    vec3 emission = push.emissionColor * push.emissionStrength;
+    if (EMISSIVE_ONLY) {
+        outColor = vec4(emission, 1.0);
+        return;
+    }
+
     // Sample albedo texture and combine with material color
-    vec3 materialColor = push.albedo * texture(albedoTexture, fragUv).rgb;
-    
-    // Sample normal map
-    vec3 normalMap = texture(normalTexture, fragUv).rgb;
+    vec3 materialColor = push.albedo;
+    if (HAS_ALBEDO_MAP) {
+        materialColor *= texture(albedoTexture, fragUv).rgb;
+    }
+
+    if (UNLIT) {
+        outColor = vec4(materialColor + emission, 1.0);
+        return;
+    }
+
+    float roughness = push.roughness;
+    if (HAS_ROUGHNESS_MAP) {
+        roughness *= texture(roughnessTexture, fragUv).r;
+    }
+
+    float metallic = push.metallic;
+    if (HAS_METALLIC_MAP) {
+        metallic *= texture(metallicTexture, fragUv).r;
+    }
+
     vec3 N = normalize(fragNormalWorld);
     vec3 surfaceNormal = N;
 
-    // Use normal map if not a plain white texture
-    vec3 whiteTexel = vec3(1.0, 1.0, 1.0);
-    if (length(normalMap - whiteTexel) > 0.01) {
-        normalMap = normalize(normalMap * 2.0 - 1.0);
+    // Normal mapping only in permutations that have a normal map
+    if (HAS_NORMAL_MAP) {
+        vec3 normalMap = normalize(texture(normalTexture, fragUv).rgb * 2.0 - 1.0);
         mat3 TBN = calculateTBN(N, fragPosWorld, fragUv);
         surfaceNormal = normalize(TBN * normalMap);
     }
@@ -100,11 +268,18 @@ void main() {
     vec3 cameraPosWorld = ubo.inverseView[3].xyz;
     vec3 viewDirection = normalize(cameraPosWorld - fragPosWorld);
 
+    // Only the lights binned into this fragment's cluster
+    uint cluster = clusterIndex(fragPosWorld);
+    uvec2 lightCounts = lightGrid.counts[cluster];
+    uint lightOffset = cluster * ubo.clusterGrid.w;
+
     // Point lights
-    for (int i = 0; i < ubo.numLights; i++) {
-        PointLight light = ubo.pointLights[i];
+    for (uint i = 0; i < lightCounts.x; i++) {
+        uint lightIndex = lightIndexList.indices[lightOffset + i];
+        PointLight light = pointLightBuffer.lights[lightIndex];
         vec3 directionToLight = light.position.xyz - fragPosWorld;
-        float attenuation = 1.0 / dot(directionToLight, directionToLight);
+        float attenuation = rangeAttenuation(dot(directionToLight, directionToLight), light.position.w);
+        attenuation *= pointShadow(int(lightIndex), fragPosWorld, light.position.xyz);
         directionToLight = normalize(directionToLight);
 
         float cosAngleIncidence = max(dot(surfaceNormal, directionToLight), 0);
@@ -115,19 +290,20 @@ void main() {
         // Specular
         vec3 halfAngle = normalize(directionToLight + viewDirection);
         float blinnTerm = clamp(dot(surfaceNormal, halfAngle), 0, 1);
-        float shininess = mix(128.0, 8.0, push.roughness);
+        float shininess = mix(128.0, 8.0, roughness);
         blinnTerm = pow(blinnTerm, shininess);
 
-        vec3 specularColor = mix(vec3(0.04), materialColor, push.metallic);
+        vec3 specularColor = mix(vec3(0.04), materialColor, metallic);
         specularLight += intensity * blinnTerm * specularColor;
     }
 
     // Spot lights
-    for (int i = 0; i < ubo.numSpotLights; i++) {
-        SpotLight light = ubo.spotLights[i];
+    for (uint i = 0; i < lightCounts.y; i++) {
+        uint lightIndex = lightIndexList.indices[lightOffset + lightCounts.x + i];
+        SpotLight light = spotLightBuffer.lights[lightIndex];
         vec3 directionToLight = light.position.xyz - fragPosWorld;
-        float distance = length(directionToLight);
-        float attenuation = 1.0 / (distance * distance);
+        float attenuation = rangeAttenuation(dot(directionToLight, directionToLight), light.position.w);
+        attenuation *= spotShadow(int(lightIndex), fragPosWorld);
         directionToLight = normalize(directionToLight);
 
         // Calculate spotlight cone
@@ -143,37 +319,35 @@ void main() {
         // Specular
         vec3 halfAngle = normalize(directionToLight + viewDirection);
         float blinnTerm = clamp(dot(surfaceNormal, halfAngle), 0, 1);
-        float shininess = mix(128.0, 8.0, push.roughness);
+        float shininess = mix(128.0, 8.0, roughness);
         blinnTerm = pow(blinnTerm, shininess);
 
-        vec3 specularColor = mix(vec3(0.04), materialColor, push.metallic);
+        vec3 specularColor = mix(vec3(0.04), materialColor, metallic);
         specularLight += intensity * blinnTerm * specularColor;
     }
 
     // Directional lights
     for (int i = 0; i < ubo.numDirectionalLights; i++) {
-        DirectionalLight light = ubo.directionalLights[i];
+        DirectionalLight light = directionalLightBuffer.lights[i];
         vec3 directionToLight = normalize(-light.direction.xyz);
 
         float cosAngleIncidence = max(dot(surfaceNormal, directionToLight), 0);
-        vec3 intensity = light.color.xyz * light.color.w;
+        vec3 intensity = light.color.xyz * light.color.w * directionalShadow(i, fragPosWorld);
 
         diffuseLight += intensity * cosAngleIncidence;
 
         // Specular
         vec3 halfAngle = normalize(directionToLight + viewDirection);
         float blinnTerm = clamp(dot(surfaceNormal, halfAngle), 0, 1);
-        float shininess = mix(128.0, 8.0, push.roughness);
+        float shininess = mix(128.0, 8.0, roughness);
         blinnTerm = pow(blinnTerm, shininess);
 
-        vec3 specularColor = mix(vec3(0.04), materialColor, push.metallic);
+        vec3 specularColor = mix(vec3(0.04), materialColor, metallic);
         specularLight += intensity * blinnTerm * specularColor;
     }
 
     // Combine lighting
     vec3 lighting = diffuseLight * materialColor + specularLight;
-    
-    vec3 emission = push.emissionColor * push.emissionStrength;
 
     vec3 finalColor = lighting + emission;
     outColor = vec4(finalColor, 1.0);
@@ -9,21 +9,30 @@ layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 fragPosWorld;
 layout(location = 2) out vec3 fragNormalWorld;
 layout(location = 3) out vec2 fragUv;
-
-struct PointLight {
-    vec4 position; // ignore w
-    vec4 color; // w is intensity
-};
+layout(location = 4) out vec4 fragClipPosition; // Unjittered
+layout(location = 5) out vec4 fragPreviousClipPosition;
 
 layout(set = 0, binding = 0) uniform GlobalUbo {
     mat4 projection;
     mat4 view;
     mat4 inverseView;
-    vec4 ambientLightColor;
-    PointLight pointLights[1000];
+    vec4 ambientLightColor; // w is intensity
     int numLights;
+    int numSpotLights;
+    int numDirectionalLights;
+    int padding;
+    uvec4 clusterGrid; // tiles x, tiles y, depth slices, max lights per cluster
+    vec4 clusterDepth; // near, far, slice scale, slice bias
+    vec4 clusterScreen; // width, height, 1 / width, 1 / height
+    mat4 viewProjection; // Without jitter
+    mat4 previousViewProjection;
 } ubo;
 
+// Model matrices of the previous frame by entity, for motion vectors
+layout(std430, set = 0, binding = 9) readonly buffer PreviousModelBuffer {
+    mat4 previousModels[];
+} previousModelBuffer;
+
 layout(push_constant) uniform Push {
     mat4 modelMatrix;
     mat4 normalMatrix;
@@ -35,12 +44,16 @@ layout(push_constant) uniform Push {
     vec2 textureScale;
     vec3 emissionColor;
     float emissionStrength;
+    uint entityIndex;
 } push;
 
 void main() {
     vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
     gl_Position = ubo.projection * ubo.view * positionWorld;
 
+    fragClipPosition = ubo.viewProjection * positionWorld;
+    fragPreviousClipPosition = ubo.previousViewProjection * previousModelBuffer.previousModels[push.entityIndex] * vec4(position, 1.0);
+
     fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
     fragPosWorld = positionWorld.xyz;
     fragColor = color;
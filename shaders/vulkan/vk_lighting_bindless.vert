@@ -0,0 +1,70 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec2 uv;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPosWorld;
+layout(location = 2) out vec3 fragNormalWorld;
+layout(location = 3) out vec2 fragUv;
+layout(location = 4) out vec4 fragClipPosition; // Unjittered
+layout(location = 5) out vec4 fragPreviousClipPosition;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projection;
+    mat4 view;
+    mat4 inverseView;
+    vec4 ambientLightColor; // w is intensity
+    int numLights;
+    int numSpotLights;
+    int numDirectionalLights;
+    int padding;
+    uvec4 clusterGrid; // tiles x, tiles y, depth slices, max lights per cluster
+    vec4 clusterDepth; // near, far, slice scale, slice bias
+    vec4 clusterScreen; // width, height, 1 / width, 1 / height
+    mat4 viewProjection; // Without jitter
+    mat4 previousViewProjection;
+} ubo;
+
+// Model matrices of the previous frame by entity, for motion vectors
+layout(std430, set = 0, binding = 9) readonly buffer PreviousModelBuffer {
+    mat4 previousModels[];
+} previousModelBuffer;
+
+struct Material {
+    vec4 albedoMetallic;
+    vec4 roughnessAoEmission; // roughness, ao, emission strength
+    vec4 emissionColor;
+    vec4 uvTransform; // offset, scale
+    uvec4 textureIndices; // albedo, normal, roughness, metallic
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer MaterialBuffer {
+    Material materials[];
+} materialBuffer;
+
+layout(push_constant) uniform Push {
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    vec3 color;
+    uint materialIndex;
+    uint entityIndex;
+} push;
+
+void main() {
+    vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
+    gl_Position = ubo.projection * ubo.view * positionWorld;
+
+    fragClipPosition = ubo.viewProjection * positionWorld;
+    fragPreviousClipPosition = ubo.previousViewProjection * previousModelBuffer.previousModels[push.entityIndex] * vec4(position, 1.0);
+
+    fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
+    fragPosWorld = positionWorld.xyz;
+    fragColor = color;
+    
+    // Apply texture scaling and offset
+    vec4 uvTransform = materialBuffer.materials[push.materialIndex].uvTransform;
+    fragUv = uv * uvTransform.zw + uvTransform.xy;
+}
\ No newline at end of file
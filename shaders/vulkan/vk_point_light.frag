@@ -1,28 +1,23 @@
 #version 450
 
 layout(location = 0) in vec2 fragOffset;
+layout(location = 1) in vec3 fragColor;
 layout(location = 0) out vec4 outColor;
 
-struct PointLight {
-    vec4 position; // ignore w
-    vec4 color; // w is intensity
-};
-
 layout(set = 0, binding = 0) uniform GlobalUbo {
     mat4 projection;
     mat4 view;
     mat4 inverseView;
     vec4 ambientLightColor; // w is intensity
-    PointLight pointLights[1000];
     int numLights;
+    int numSpotLights;
+    int numDirectionalLights;
+    int padding;
+    uvec4 clusterGrid; // tiles x, tiles y, depth slices, max lights per cluster
+    vec4 clusterDepth; // near, far, slice scale, slice bias
+    vec4 clusterScreen; // width, height, 1 / width, 1 / height
 } ubo;
 
-layout(push_constant) uniform Push {
-    vec4 position; // ignore w
-    vec4 color; // w is intesntiy
-    float radius;
-} push;
-
 const float M_PI = 3.1415926538;
 void main() {
     // Discard any pixels outside the radius
@@ -34,16 +29,16 @@ void main() {
     // Temporary? looks cool
     float cosDis = 0.5 * (cos(dis * M_PI * 1.5) + 1.0);
     // Clamp to avoid bloom - keep brightness well below threshold
-    vec3 finalColor = push.color.xyz * cosDis;
+    vec3 finalColor = fragColor * cosDis;
     // Clamp each channel and also clamp overall brightness to 0.4 max
     finalColor = min(finalColor, vec3(0.4));
     outColor = vec4(finalColor, cosDis);
 
     // Without the white center
     // float cosDis = 0.5 * (cos(dis * M_PI) + 1.0);
-    // outColor = vec4(push.color.xyz, cosDis);
+    // outColor = vec4(fragColor, cosDis);
 
     // With the white center (default)
     // float cosDis = 0.5 * (cos(dis * M_PI) + 1.0);
-    // outColor = vec4(push.color.xyz + cosDis, cosDis);
+    // outColor = vec4(fragColor + cosDis, cosDis);
 }
\ No newline at end of file
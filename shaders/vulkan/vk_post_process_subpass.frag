@@ -0,0 +1,45 @@
+#version 450
+
+// Composite as the last subpass of the HDR pass, reads the scene straight from tile memory (bloom off)
+layout(location = 0) in vec2 fragTexCoord;
+layout(location = 0) out vec4 outColor;
+
+layout(input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput sceneColor;
+layout(set = 0, binding = 1) uniform sampler3D gradingLut;
+
+layout(push_constant) uniform Push {
+    float bloomIntensity;
+    float exposure;
+    int bloomEnabled;
+} push;
+
+// ACES Filmic Tone Mapping
+vec3 ACESFilm(vec3 x) {
+    float a = 2.51;
+    float b = 0.03;
+    float c = 2.43;
+    float d = 0.59;
+    float e = 0.14;
+    return clamp((x * (a * x + b)) / (x * (c * x + d) + e), 0.0, 1.0);
+}
+
+// Contrast, vibrance, saturation and gamma, baked into the LUT. Texel centers sit at the cube's corners
+vec3 applyGrading(vec3 color) {
+    float size = float(textureSize(gradingLut, 0).x);
+    return texture(gradingLut, color * ((size - 1.0) / size) + 0.5 / size).rgb;
+}
+
+void main() {
+    vec3 hdrColor = subpassLoad(sceneColor).rgb;
+    
+    // Apply exposure
+    vec3 color = hdrColor * push.exposure;
+    
+    // Apply ACES tone mapping
+    color = ACESFilm(color);
+    
+    // Apply color grading
+    color = applyGrading(color);
+    
+    outColor = vec4(color, 1.0);
+}
\ No newline at end of file
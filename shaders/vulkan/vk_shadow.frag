@@ -0,0 +1,5 @@
+#version 450
+
+// Depth only, the atlas has no color attachment
+void main() {
+}
\ No newline at end of file
@@ -8,11 +8,21 @@
 #include "../input/keybord_movement_controller.hpp"
 #include "../input/mouse_movement_controller.hpp"
 #include "../core/vulkan/knoxic_vk_buffer.hpp"
+#include "../core/vulkan/knoxic_vk_frame_allocator.hpp"
+#include "../core/vulkan/knoxic_vk_upload_context.hpp"
 #include "../systems/vulkan/knoxic_vk_render_system.hpp"
 #include "../systems/vulkan/knoxic_vk_point_light_system.hpp"
 #include "../systems/vulkan/knoxic_vk_spot_light_system.hpp"
 #include "../systems/vulkan/knoxic_vk_directional_light_system.hpp"
 #include "../systems/vulkan/knoxic_vk_material_system.hpp"
+#include "../systems/vulkan/knoxic_vk_occlusion_culling_system.hpp"
+#include "../systems/vulkan/knoxic_vk_light_cluster_system.hpp"
+#include "../systems/vulkan/knoxic_vk_light_buffer_system.hpp"
+#include "../systems/vulkan/knoxic_vk_deferred_lighting_system.hpp"
+#include "../systems/vulkan/knoxic_vk_shadow_system.hpp"
+#include "../systems/vulkan/knoxic_vk_dynamic_resolution_system.hpp"
+#include "../systems/vulkan/knoxic_vk_temporal_aa_system.hpp"
+#include "../systems/knoxic_software_occlusion_system.hpp"
 #include "../systems/knoxic_editor_system.hpp"
 #include "../core/ecs/coordinator_instance.hpp"
 #include "../core/ecs/components.hpp"
@@ -28,16 +38,22 @@
 #include <imgui/backends/imgui_impl_glfw.h>
 #include <imgui/backends/imgui_impl_vulkan.h>
 
+#include <algorithm>
 #include <cassert>
 #include <memory>
 #include <chrono>
+#include <cstring>
+#include <iostream>
 
 namespace knoxic {
 
-    App::App() {
+    App::App(RenderPath renderPath, bool lowLatency) : renderPath{renderPath}, lowLatency{lowLatency} {
         globalPool = KnoxicDescriptorPool::Builder(knoxicDevice)
-            .setMaxSets(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT)
+            .setMaxSets(KnoxicSwapChain::framesInFlight())
+            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, KnoxicSwapChain::framesInFlight())
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 * KnoxicSwapChain::framesInFlight())
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 3 * KnoxicSwapChain::framesInFlight())
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, KnoxicSwapChain::framesInFlight())
             .build();
 
         materialPool = KnoxicDescriptorPool::Builder(knoxicDevice)
@@ -83,7 +99,8 @@ namespace knoxic {
 
         // Create post-processing system
         VkExtent2D extent = knoxicRenderer.getSwapChainExtent();
-        postProcessSystem = std::make_unique<PostProcessSystem>(knoxicDevice, extent);
+        postProcessSystem = std::make_unique<PostProcessSystem>(knoxicDevice, renderGraph, pipelineManager, extent,
+            knoxicRenderer.getSwapChainImageFormat(), knoxicRenderer.getSwapChainRenderPass(), renderPath);
 
         // Initialize ECS and register components/systems
         gCoordinator.Init();
@@ -95,6 +112,7 @@ namespace knoxic {
         gCoordinator.RegisterComponent<SpotLightComponent>();
         gCoordinator.RegisterComponent<DirectionalLightComponent>();
         gCoordinator.RegisterComponent<PostProcessingComponent>();
+        gCoordinator.RegisterComponent<OccluderComponent>();
 
         renderableSystem = gCoordinator.RegisterSystem<RenderableSystem>(); {
             Signature signature;
@@ -124,6 +142,14 @@ namespace knoxic {
             gCoordinator.SetSystemSignature<DirectionalLightECSSystem>(signature);
         }
 
+        occluderSystem = gCoordinator.RegisterSystem<OccluderECSSystem>(); {
+            Signature signature;
+            signature.set(gCoordinator.GetComponentType<TransformComponent>());
+            signature.set(gCoordinator.GetComponentType<ModelComponent>());
+            signature.set(gCoordinator.GetComponentType<OccluderComponent>());
+            gCoordinator.SetSystemSignature<OccluderECSSystem>(signature);
+        }
+
         loadGameObjects(); 
     }
 
@@ -155,32 +181,61 @@ namespace knoxic {
     }
 
     void App::run() {
-        std::vector<std::unique_ptr<KnoxicBuffer>> uboBuffers(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT);
-        for (int i = 0; i < uboBuffers.size(); i++) {
-            uboBuffers[i] = std::make_unique<KnoxicBuffer>(
-                knoxicDevice,
-                sizeof(GlobalUbo),
-                1,
-                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-            );
-
-            uboBuffers[i]->map();
-        }
+        // Transient per-frame data: the global UBO, light arrays and gizmo instances
+        KnoxicFrameAllocator frameAllocator{knoxicDevice};
 
         auto globalSetLayout = KnoxicDescriptorSetLayout::Builder(knoxicDevice)
-            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // Cluster light grid
+            .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // Cluster light indices
+            .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT) // Point lights
+            .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT) // Spot lights
+            .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS) // Directional lights
+            .addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // Shadow views
+            .addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // First shadow view per light
+            .addBinding(8, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // Shadow atlas
+            .addBinding(9, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT) // Previous model matrices
             .build();
 
+        // Bins lights into view clusters, its buffers live in the global set
+        LightClusterSystem lightClusterSystem{knoxicDevice, globalSetLayout->getDescriptorSetLayout()};
+        LightBufferSystem lightBufferSystem{frameAllocator};
+        SceneLights sceneLights{};
+
+        // Cached shadow atlas, only stale tiles are re-rendered each frame
+        ShadowSystem shadowSystem{knoxicDevice, renderableSystem, pointLightSystem, spotLightSystem, directionalLightSystem};
+
+        // Jitter, motion vectors and the temporal resolve, renders the scene at a fraction of the output
+        TemporalAASystem temporalAASystem{knoxicDevice, *postProcessSystem, renderableSystem};
+        temporalAASystem.setEnabled(true);
+
         // Create material system and its descriptor set layout
         MaterialSystem materialSystem{knoxicDevice};
         auto materialSetLayout = materialSystem.createMaterialSetLayout();
 
-        std::vector<VkDescriptorSet> globalDescriptorSets(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT);
+        std::vector<VkDescriptorSet> globalDescriptorSets(KnoxicSwapChain::framesInFlight());
         for (int i = 0; i < globalDescriptorSets.size(); i++) {
-            auto bufferInfo = uboBuffers[i]->descriptorInfo();
+            auto bufferInfo = frameAllocator.descriptorInfo(sizeof(GlobalUbo));
+            auto lightGridInfo = lightClusterSystem.getLightGridInfo(i);
+            auto lightIndexInfo = lightClusterSystem.getLightIndexInfo(i);
+            auto pointLightInfo = lightBufferSystem.getPointLightInfo(i);
+            auto spotLightInfo = lightBufferSystem.getSpotLightInfo(i);
+            auto directionalLightInfo = lightBufferSystem.getDirectionalLightInfo(i);
+            auto shadowViewInfo = shadowSystem.getShadowViewInfo(i);
+            auto lightShadowInfo = shadowSystem.getLightShadowInfo(i);
+            auto shadowAtlasInfo = shadowSystem.getAtlasImageInfo();
+            auto previousModelInfo = temporalAASystem.getPreviousModelInfo(i);
             KnoxicDescriptorWriter(*globalSetLayout, *globalPool)
                 .writeBuffer(0, &bufferInfo)
+                .writeBuffer(1, &lightGridInfo)
+                .writeBuffer(2, &lightIndexInfo)
+                .writeBuffer(3, &pointLightInfo)
+                .writeBuffer(4, &spotLightInfo)
+                .writeBuffer(5, &directionalLightInfo)
+                .writeBuffer(6, &shadowViewInfo)
+                .writeBuffer(7, &lightShadowInfo)
+                .writeImage(8, &shadowAtlasInfo)
+                .writeBuffer(9, &previousModelInfo)
                 .build(globalDescriptorSets[i]);
         }
 
@@ -192,11 +247,11 @@ namespace knoxic {
         init_info.Device = knoxicDevice.device();
         init_info.QueueFamily = knoxicDevice.findPhysicalQueueFamilies().graphicsFamily;
         init_info.Queue = knoxicDevice.graphicsQueue();
-        init_info.PipelineCache = VK_NULL_HANDLE;
+        init_info.PipelineCache = knoxicDevice.pipelineCache().getCache();
         init_info.DescriptorPool = imguiPool->getPool();
         init_info.DescriptorPoolSize = 0; // Using external pool
-        init_info.MinImageCount = KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT;
-        init_info.ImageCount = KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT;
+        init_info.MinImageCount = KnoxicSwapChain::framesInFlight();
+        init_info.ImageCount = KnoxicSwapChain::framesInFlight();
         init_info.UseDynamicRendering = false;
         init_info.Allocator = nullptr;
         init_info.CheckVkResultFn = nullptr;
@@ -205,17 +260,30 @@ namespace knoxic {
         init_info.PipelineInfoMain.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
         ImGui_ImplVulkan_Init(&init_info);
 
+        // Deferred draws the scene into the G-buffer subpass, lights and gizmos stay in HDR passes
+        bool deferred = renderPath == RenderPath::Deferred;
         RenderSystem renderSystem {
             knoxicDevice,
-            postProcessSystem->getHDRRenderPass(),
+            pipelineManager,
+            deferred ? postProcessSystem->getGBufferRenderPass() : postProcessSystem->getHDRRenderPass(),
             globalSetLayout->getDescriptorSetLayout(),
             materialSetLayout->getDescriptorSetLayout(),
-            renderableSystem
+            materialSystem,
+            renderableSystem,
+            renderPath
         };
+
+        if (!deferred) {
+            renderSystem.setCompositeRenderPass(postProcessSystem->getHDRCompositeRenderPass());
+        }
+
+        SoftwareOcclusionSystem softwareOcclusionSystem{renderableSystem, occluderSystem};
+        renderSystem.setSoftwareOcclusion(&softwareOcclusionSystem);
         
         PointLightSystem pointLightVkSystem {
             knoxicDevice,
             postProcessSystem->getHDRRenderPass(),
+            postProcessSystem->getHDRCompositeRenderPass(),
             globalSetLayout->getDescriptorSetLayout(),
             pointLightSystem
         };
@@ -223,6 +291,7 @@ namespace knoxic {
         SpotLightSystem spotLightVkSystem {
             knoxicDevice,
             postProcessSystem->getHDRRenderPass(),
+            postProcessSystem->getHDRCompositeRenderPass(),
             globalSetLayout->getDescriptorSetLayout(),
             spotLightSystem
         };
@@ -230,10 +299,29 @@ namespace knoxic {
         DirectionalLightSystem directionalLightVkSystem {
             knoxicDevice,
             postProcessSystem->getHDRRenderPass(),
+            postProcessSystem->getHDRCompositeRenderPass(),
             globalSetLayout->getDescriptorSetLayout(),
             directionalLightSystem
         };
         
+        OcclusionCullingSystem occlusionCullingSystem {
+            knoxicDevice,
+            *postProcessSystem,
+            renderableSystem
+        };
+
+        DynamicResolutionSystem dynamicResolutionSystem{renderGraph.hasTimings()};
+        dynamicResolutionSystem.setEnabled(true);
+
+        std::unique_ptr<DeferredLightingSystem> deferredLightingSystem;
+        if (deferred) {
+            deferredLightingSystem = std::make_unique<DeferredLightingSystem>(
+                knoxicDevice,
+                *postProcessSystem,
+                globalSetLayout->getDescriptorSetLayout()
+            );
+        }
+        
         KnoxicCamera camera{};
 
         // Create camera ECS entity
@@ -269,13 +357,361 @@ namespace knoxic {
             directionalLightSystem
         );
 
+        // Begins one of the HDR or G-buffer passes over the rendered part of the target
+        auto beginTargetPass = [&](FrameInfo &frameInfo, VkRenderPass renderPass, VkFramebuffer framebuffer, bool clear) {
+            // G-buffer targets clear to zero, which the lighting subpass treats as unlit. Velocity is the last attachment
+            std::array<VkClearValue, 3 + PostProcessSystem::GBUFFER_COUNT> clearValues{};
+            clearValues[0].color = {{0.01f, 0.01f, 0.01f, 1.0f}};
+            clearValues[1].depthStencil = {1.0f, 0};
+            uint32_t clearValueCount = deferred ? static_cast<uint32_t>(clearValues.size()) : 3;
+            float noVelocity = PostProcessSystem::NO_VELOCITY;
+            clearValues[clearValueCount - 1].color = {{noVelocity, noVelocity, 0.0f, 0.0f}};
+
+            VkExtent2D extent = postProcessSystem->getRenderExtent();
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = renderPass;
+            renderPassInfo.framebuffer = framebuffer;
+            renderPassInfo.renderArea.offset = {0, 0};
+            renderPassInfo.renderArea.extent = extent;
+            if (clear) {
+                renderPassInfo.clearValueCount = clearValueCount;
+                renderPassInfo.pClearValues = clearValues.data();
+            }
+            vkCmdBeginRenderPass(frameInfo.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+            VkViewport viewport{};
+            viewport.x = 0.0f;
+            viewport.y = 0.0f;
+            viewport.width = static_cast<float>(extent.width);
+            viewport.height = static_cast<float>(extent.height);
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+            VkRect2D scissor{{0, 0}, extent};
+            vkCmdSetViewport(frameInfo.commandBuffer, 0, 1, &viewport);
+            vkCmdSetScissor(frameInfo.commandBuffer, 0, 1, &scissor);
+        };
+
+        auto renderEarlyPhase = [&](FrameInfo &frameInfo) {
+            if (occlusionCullingSystem.isEnabled()) {
+                renderSystem.renderGameObjectsIndirect(frameInfo,
+                    occlusionCullingSystem.getDrawCommandBuffer(frameInfo.frameIndex), OcclusionCullingSystem::EARLY_PHASE);
+            } else {
+                renderSystem.renderGameObjects(frameInfo);
+            }
+        };
+
+        auto renderLatePhase = [&](FrameInfo &frameInfo, bool compositePass) {
+            if (occlusionCullingSystem.isEnabled()) {
+                renderSystem.renderGameObjectsIndirect(frameInfo,
+                    occlusionCullingSystem.getDrawCommandBuffer(frameInfo.frameIndex), OcclusionCullingSystem::LATE_PHASE, compositePass);
+            }
+        };
+
+        auto renderLightGizmos = [&](FrameInfo &frameInfo, bool compositePass) {
+            auto &pointGizmos = lightBufferSystem.getPointGizmos();
+            auto &spotGizmos = lightBufferSystem.getSpotGizmos();
+            auto &directionalGizmos = lightBufferSystem.getDirectionalGizmos();
+            pointLightVkSystem.render(frameInfo, pointGizmos.buffer, pointGizmos.offset,
+                static_cast<uint32_t>(sceneLights.pointGizmos.size()), compositePass);
+            spotLightVkSystem.render(frameInfo, spotGizmos.buffer, spotGizmos.offset,
+                static_cast<uint32_t>(sceneLights.spotGizmos.size()), compositePass);
+            directionalLightVkSystem.render(frameInfo, directionalGizmos.buffer, directionalGizmos.offset,
+                static_cast<uint32_t>(sceneLights.directionalGizmos.size()), compositePass);
+        };
+
+        // Draws the UI over the composited swap chain image and closes the pass
+        auto renderUI = [&](FrameInfo &frameInfo) {
+            ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), frameInfo.commandBuffer);
+            knoxicRenderer.endSwapChainRenderPass(frameInfo.commandBuffer);
+        };
+
+        // Without bloom nothing samples the HDR color, the composite folds into the HDR pass as a subpass.
+        // Reading it as an input attachment can't upscale or resolve though, so not with dynamic resolution or TAA
+        auto wantsMergedComposite = [&]() {
+            return !gCoordinator.GetComponent<PostProcessingComponent>(cameraEntity).bloomEnabled &&
+                !dynamicResolutionSystem.isEnabled() && !temporalAASystem.isEnabled();
+        };
+
+        auto getSwapChainImageViews = [&]() {
+            std::vector<VkImageView> swapChainImageViews(knoxicRenderer.getSwapChainImageCount());
+            for (size_t i = 0; i < swapChainImageViews.size(); i++) {
+                swapChainImageViews[i] = knoxicRenderer.getSwapChainImageView(static_cast<int>(i));
+            }
+            return swapChainImageViews;
+        };
+
+        // Light culling, the Hi-Z build and bloom move to a compute-only queue where the device has one
+        bool asyncCompute = knoxicDevice.hasAsyncCompute();
+
+        // Declares the frame's passes over the post-processing targets, compiled once per target size
+        auto buildRenderGraph = [&]() {
+            renderGraph.reset();
+            renderGraph.setAsyncComputeEnabled(asyncCompute);
+
+            bool mergedComposite = wantsMergedComposite();
+            postProcessSystem->setMergedComposite(mergedComposite);
+            postProcessSystem->declareResources();
+
+            RenderGraphImage hdrColor = postProcessSystem->getHDRColorResource();
+            RenderGraphImage hdrDepth = postProcessSystem->getHDRDepthResource();
+            RenderGraphImage velocity = postProcessSystem->getVelocityResource();
+            bool temporalResolve = temporalAASystem.isEnabled();
+
+            // Written by compute passes and read by the scene passes, declared so the graph can order them across queues
+            RenderGraphBuffer lightClusters = renderGraph.importBuffer("light_clusters");
+            RenderGraphBuffer drawCommands = renderGraph.importBuffer("draw_commands");
+
+            // Bin point and spot lights into clusters for the forward lighting pass. Nothing before it in the frame,
+            // so on the async compute queue it runs alongside the shadow maps
+            if (!deferred) {
+                renderGraph.addPass("light_cull")
+                    .write(lightClusters, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+                    .asyncCompute()
+                    .execute([&](FrameInfo &frameInfo) { lightClusterSystem.cullLights(frameInfo); });
+            }
+
+            // The shadow atlas keeps its own barriers, tiles persist across frames
+            renderGraph.addPass("shadows")
+                .sideEffect()
+                .execute([&](FrameInfo &frameInfo) { shadowSystem.render(frameInfo); });
+
+            // Rebakes the grading LUT when its settings changed, both composites sample it
+            renderGraph.addPass("color_grading")
+                .sideEffect()
+                .execute([&](FrameInfo &frameInfo) {
+                    auto& postProcSettings = gCoordinator.GetComponent<PostProcessingComponent>(cameraEntity);
+                    postProcessSystem->updateGradingLUT(frameInfo.commandBuffer, postProcSettings);
+                });
+
+            // Occlusion culling phase 1: objects visible last frame
+            renderGraph.addPass("occlusion_early")
+                .write(drawCommands, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+                .sideEffect()
+                .execute([&](FrameInfo &frameInfo) {
+                    if (occlusionCullingSystem.isEnabled()) {
+                        occlusionCullingSystem.prepare(frameInfo);
+                        occlusionCullingSystem.cullEarly(frameInfo);
+                    }
+                });
+
+            // Render scene to HDR buffer (or the G-buffer when deferred)
+            if (deferred) {
+                auto gbufferPass = renderGraph.addPass("gbuffer");
+                gbufferPass
+                    .write(hdrColor, RenderGraphAccess::ColorAttachment)
+                    .write(hdrDepth, RenderGraphAccess::DepthAttachment)
+                    .write(velocity, RenderGraphAccess::ColorAttachment)
+                    .read(drawCommands, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+                for (int target = 0; target < PostProcessSystem::GBUFFER_COUNT; target++) {
+                    gbufferPass.write(postProcessSystem->getGBufferResource(target), RenderGraphAccess::ColorAttachment);
+                }
+                gbufferPass.execute([&](FrameInfo &frameInfo) {
+                    beginTargetPass(frameInfo, postProcessSystem->getGBufferRenderPass(),
+                        postProcessSystem->getGBufferFramebuffer(frameInfo.frameIndex), true);
+                    renderEarlyPhase(frameInfo);
+                    vkCmdNextSubpass(frameInfo.commandBuffer, VK_SUBPASS_CONTENTS_INLINE); // Lighting waits for the late phase
+                    vkCmdEndRenderPass(frameInfo.commandBuffer);
+                });
+            } else {
+                renderGraph.addPass("scene")
+                    .write(hdrColor, RenderGraphAccess::ColorAttachment)
+                    .write(hdrDepth, RenderGraphAccess::DepthAttachment)
+                    .write(velocity, RenderGraphAccess::ColorAttachment)
+                    .read(drawCommands, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT)
+                    .read(lightClusters, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+                    .execute([&](FrameInfo &frameInfo) {
+                        beginTargetPass(frameInfo, postProcessSystem->getHDRRenderPass(),
+                            postProcessSystem->getHDRFramebuffer(frameInfo.frameIndex), true);
+                        renderEarlyPhase(frameInfo);
+                        vkCmdEndRenderPass(frameInfo.commandBuffer);
+                    });
+            }
+
+            // Occlusion culling phase 2: test everything against the Hi-Z of phase 1
+            renderGraph.addPass("occlusion_late")
+                .read(hdrDepth, RenderGraphAccess::SampledCompute)
+                .write(drawCommands, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+                .sideEffect()
+                .asyncCompute()
+                .execute([&](FrameInfo &frameInfo) {
+                    if (occlusionCullingSystem.isEnabled()) {
+                        occlusionCullingSystem.buildDepthPyramid(frameInfo);
+                        occlusionCullingSystem.cullLate(frameInfo);
+                    }
+                });
+
+            // Deferred: newly visible objects into the G-buffer, then light it into the HDR color
+            if (deferred) {
+                auto lightingPass = renderGraph.addPass("gbuffer_late");
+                lightingPass
+                    .read(hdrColor, RenderGraphAccess::ColorAttachment)
+                    .write(hdrColor, RenderGraphAccess::ColorAttachment)
+                    .read(hdrDepth, RenderGraphAccess::DepthAttachment)
+                    .write(hdrDepth, RenderGraphAccess::DepthAttachment)
+                    .read(velocity, RenderGraphAccess::ColorAttachment)
+                    .write(velocity, RenderGraphAccess::ColorAttachment)
+                    .read(drawCommands, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+                for (int target = 0; target < PostProcessSystem::GBUFFER_COUNT; target++) {
+                    lightingPass
+                        .read(postProcessSystem->getGBufferResource(target), RenderGraphAccess::ColorAttachment)
+                        .write(postProcessSystem->getGBufferResource(target), RenderGraphAccess::ColorAttachment);
+                }
+                lightingPass.execute([&](FrameInfo &frameInfo) {
+                    beginTargetPass(frameInfo, postProcessSystem->getGBufferResumeRenderPass(),
+                        postProcessSystem->getGBufferFramebuffer(frameInfo.frameIndex), false);
+                    renderLatePhase(frameInfo, false);
+                    vkCmdNextSubpass(frameInfo.commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+                    deferredLightingSystem->render(frameInfo,
+                        static_cast<uint32_t>(sceneLights.pointLights.size()),
+                        static_cast<uint32_t>(sceneLights.spotLights.size()));
+                    vkCmdEndRenderPass(frameInfo.commandBuffer);
+                });
+            }
+
+            if (mergedComposite) {
+                // Resume the HDR pass for newly visible objects and light billboards, then composite straight from tile memory
+                auto compositeScenePass = renderGraph.addPass("scene_composite");
+                compositeScenePass
+                    .read(hdrColor, RenderGraphAccess::ColorAttachment)
+                    .write(hdrColor, RenderGraphAccess::ColorAttachment)
+                    .read(hdrDepth, RenderGraphAccess::DepthAttachment)
+                    .write(hdrDepth, RenderGraphAccess::DepthAttachment)
+                    .read(velocity, RenderGraphAccess::ColorAttachment)
+                    .write(velocity, RenderGraphAccess::ColorAttachment)
+                    .read(drawCommands, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+                if (!deferred) {
+                    compositeScenePass.read(lightClusters, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+                }
+                compositeScenePass
+                    .sideEffect()
+                    .execute([&](FrameInfo &frameInfo) {
+                        beginTargetPass(frameInfo, postProcessSystem->getHDRCompositeRenderPass(),
+                            postProcessSystem->getCompositeFramebuffer(frameInfo.frameIndex, knoxicRenderer.getImageIndex()), false);
+                        if (!deferred) {
+                            renderLatePhase(frameInfo, true);
+                        }
+                        renderLightGizmos(frameInfo, true);
+
+                        vkCmdNextSubpass(frameInfo.commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+                        auto& postProcSettings = gCoordinator.GetComponent<PostProcessingComponent>(cameraEntity);
+                        postProcessSystem->renderMergedComposite(frameInfo.commandBuffer, frameInfo.frameIndex, postProcSettings);
+                        vkCmdEndRenderPass(frameInfo.commandBuffer);
+
+                        knoxicRenderer.resumeSwapChainRenderPass(frameInfo.commandBuffer);
+                        renderUI(frameInfo);
+                    });
+            } else {
+                // Resume the HDR pass for newly visible objects and light billboards
+                auto lateScenePass = renderGraph.addPass("scene_late");
+                lateScenePass
+                    .read(hdrColor, RenderGraphAccess::ColorAttachment)
+                    .write(hdrColor, RenderGraphAccess::ColorAttachment)
+                    .read(hdrDepth, RenderGraphAccess::DepthAttachment)
+                    .write(hdrDepth, RenderGraphAccess::DepthAttachment)
+                    .read(velocity, RenderGraphAccess::ColorAttachment)
+                    .write(velocity, RenderGraphAccess::ColorAttachment)
+                    .read(drawCommands, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+                if (!deferred) {
+                    lateScenePass.read(lightClusters, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+                }
+                lateScenePass.execute([&](FrameInfo &frameInfo) {
+                    beginTargetPass(frameInfo, postProcessSystem->getHDRResumeRenderPass(),
+                        postProcessSystem->getHDRFramebuffer(frameInfo.frameIndex), false);
+                    if (!deferred) {
+                        renderLatePhase(frameInfo, false);
+                    }
+                    renderLightGizmos(frameInfo, false);
+                    vkCmdEndRenderPass(frameInfo.commandBuffer);
+                });
+
+                // Reconstruct the output resolution from this frame's samples and the history, bloom and the
+                // composite read the resolved color. The history images keep their own barriers
+                if (temporalResolve) {
+                    renderGraph.addPass("temporal_resolve")
+                        .read(hdrColor, RenderGraphAccess::SampledCompute)
+                        .read(velocity, RenderGraphAccess::SampledCompute)
+                        .sideEffect()
+                        .execute([&](FrameInfo &frameInfo) { temporalAASystem.resolve(frameInfo); });
+                }
+
+                // Apply post-processing
+                RenderGraphImage bloomChain = postProcessSystem->getBloomResource();
+                auto bloomPass = renderGraph.addPass("bloom");
+                if (!temporalResolve) {
+                    bloomPass.read(hdrColor, RenderGraphAccess::SampledCompute);
+                }
+                bloomPass
+                    .write(bloomChain, RenderGraphAccess::StorageCompute)
+                    .asyncCompute()
+                    .execute([&](FrameInfo &frameInfo) {
+                        auto& postProcSettings = gCoordinator.GetComponent<PostProcessingComponent>(cameraEntity);
+                        postProcessSystem->renderPostProcess(frameInfo.commandBuffer, frameInfo.frameIndex, postProcSettings);
+                    });
+
+                // Render final composite and the UI to the swapchain
+                auto compositePass = renderGraph.addPass("composite");
+                if (!temporalResolve) {
+                    compositePass.read(hdrColor, RenderGraphAccess::SampledFragment);
+                }
+                compositePass
+                    .read(bloomChain, RenderGraphAccess::SampledFragment)
+                    .sideEffect()
+                    .execute([&](FrameInfo &frameInfo) {
+                        auto& postProcSettings = gCoordinator.GetComponent<PostProcessingComponent>(cameraEntity);
+                        knoxicRenderer.beginSwapChainRenderPass(frameInfo.commandBuffer);
+                        postProcessSystem->renderFinalComposite(
+                            frameInfo.commandBuffer,
+                            frameInfo.frameIndex,
+                            postProcSettings
+                        );
+                        renderUI(frameInfo);
+                    });
+            }
+
+            renderGraph.compile();
+
+            temporalAASystem.recreate();
+            postProcessSystem->setResolvedColorViews(temporalAASystem.getResolvedViews());
+
+            postProcessSystem->createTargets(getSwapChainImageViews());
+            occlusionCullingSystem.recreate();
+            if (deferredLightingSystem) {
+                deferredLightingSystem->recreate();
+            }
+        };
+        buildRenderGraph();
+
         auto currentTime = std::chrono::high_resolution_clock::now();
-        VkExtent2D previousExtent = knoxicRenderer.getSwapChainExtent();
+        uint32_t swapChainGeneration = knoxicRenderer.getSwapChainGeneration();
 
         cameraControllerMouse.init(knoxicWindow.getGLFWwindow());
 
+        // The scene is loaded, its last uploads finish before the first frame and their staging memory is released
+        knoxicDevice.uploadContext().flush();
+
+        auto &pipelineCache = knoxicDevice.pipelineCache();
+        std::cout << "startup: " << std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - startupBegin).count() << " ms, "
+            << pipelineCache.getCreationCount() << " pipelines in " << pipelineCache.getCreationTime() << " ms ("
+            << (pipelineCache.isWarm() ? "warm" : "cold") << " pipeline cache)" << std::endl;
+        bool startupPipelinesPending = true;
+        float inputLatency = 0.0f; // Input sampled to frame submitted, smoothed over frames
+
         while(!knoxicWindow.shouldClose()) {
+            // Wait for the GPU (and the display) first, so the input sampled next is as fresh as possible when the
+            // frame is recorded. Otherwise acquire blocks on the frame's fence after input was already read
+            if (lowLatency) {
+                knoxicRenderer.waitForFrameSlot();
+            }
             glfwPollEvents();
+            auto inputTime = std::chrono::high_resolution_clock::now();
+
+            // The startup pipelines shared their shader modules, none are kept around once they're all compiled
+            if (startupPipelinesPending && pipelineManager.getPendingCount() == 0) {
+                knoxicDevice.shaderModules().setKeepUnused(false);
+                startupPipelinesPending = false;
+            }
 
             auto newTime = std::chrono::high_resolution_clock::now();
             float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
@@ -291,18 +727,41 @@ namespace knoxic {
             }
             camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
 
-            float aspect = knoxicRenderer.getAspectRatio();
-            camera.setPerspectiveProjection(glm::radians(75.0f), aspect, 0.01f, 100.0f);
-            
             if (auto commandBuffer = knoxicRenderer.beginFrame()) {
-                // Check if window was resized and recreate post-processing resources
-                VkExtent2D currentExtent = knoxicRenderer.getSwapChainExtent();
-                if (currentExtent.width != previousExtent.width || currentExtent.height != previousExtent.height) {
-                    postProcessSystem->recreate(currentExtent);
-                    previousExtent = currentExtent;
+                postProcessSystem->releaseRetired();
+
+                // Rebuild the targets when the choice between the merged and the separate composite changed, TAA was
+                // toggled or a new swap chain outgrew them. Otherwise a resize only moves the output inside the same
+                // targets, and the merged composite (which writes the swap chain images) re-points its framebuffers
+                bool rebuildTargets = wantsMergedComposite() != postProcessSystem->isMergedComposite() ||
+                    temporalAASystem.isEnabled() != postProcessSystem->hasTemporalResolve() ||
+                    asyncCompute != renderGraph.isAsyncComputeEnabled();
+                if (knoxicRenderer.getSwapChainGeneration() != swapChainGeneration) {
+                    rebuildTargets |= postProcessSystem->resize(knoxicRenderer.getSwapChainExtent());
+                    if (!rebuildTargets) {
+                        postProcessSystem->setSwapChainImageViews(getSwapChainImageViews());
+                    }
+                    swapChainGeneration = knoxicRenderer.getSwapChainGeneration();
+                }
+                if (rebuildTargets) {
+                    postProcessSystem->recreate();
+                    buildRenderGraph();
                 }
 
+                // Pick the render resolution from the GPU time this frame slot took last time, only the viewport changes.
+                // TAA lowers the base resolution first, the resolve reconstructs the full output
                 int frameIndex = knoxicRenderer.getFrameIndex();
+                frameAllocator.beginFrame(frameIndex);
+                renderGraph.updateTimings(frameIndex);
+                dynamicResolutionSystem.update(renderGraph.getTimings().frame);
+                VkExtent2D baseExtent = temporalAASystem.getRenderExtent(postProcessSystem->getExtent());
+                postProcessSystem->setRenderExtent(dynamicResolutionSystem.getRenderExtent(baseExtent));
+
+                // Jittered by a sub-pixel offset of the render resolution while TAA is on
+                float aspect = knoxicRenderer.getAspectRatio();
+                glm::vec2 jitter = temporalAASystem.nextJitter(postProcessSystem->getRenderExtent());
+                camera.setPerspectiveProjection(glm::radians(75.0f), aspect, 0.01f, 100.0f, jitter);
+
                 FrameInfo frameInfo {
                     frameIndex,
                     frameTime,
@@ -314,65 +773,50 @@ namespace knoxic {
                 // Update materials
                 materialSystem.updateMaterials(frameInfo, *materialSetLayout, *materialPool, renderableSystem);
 
+                // Test renderables against the CPU occluders before any draw is recorded
+                softwareOcclusionSystem.update(camera);
+
                 // Update
                 GlobalUbo ubo{};
                 ubo.projection = camera.getProjection();
                 ubo.view = camera.getView();
                 ubo.inverseView = camera.getInverseView();
-                pointLightVkSystem.update(frameInfo, ubo);
-                spotLightVkSystem.update(frameInfo, ubo);
-                directionalLightVkSystem.update(frameInfo, ubo);
-                uboBuffers[frameIndex]->writeToBuffer(&ubo);
-                uboBuffers[frameIndex]->flush();
-
-                // Render scene to HDR buffer
-                VkRenderPassBeginInfo hdrRenderPassInfo{};
-                hdrRenderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-                hdrRenderPassInfo.renderPass = postProcessSystem->getHDRRenderPass();
-                hdrRenderPassInfo.framebuffer = postProcessSystem->getHDRFramebuffer(frameIndex);
-                hdrRenderPassInfo.renderArea.offset = {0, 0};
-                hdrRenderPassInfo.renderArea.extent = knoxicRenderer.getSwapChainExtent();
-
-                std::array<VkClearValue, 2> clearValues{};
-                clearValues[0].color = {{0.01f, 0.01f, 0.01f, 1.0f}};
-                clearValues[1].depthStencil = {1.0f, 0};
-                hdrRenderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-                hdrRenderPassInfo.pClearValues = clearValues.data();
-
-                vkCmdBeginRenderPass(commandBuffer, &hdrRenderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-                
-                // Set viewport and scissor for HDR rendering
-                VkViewport viewport{};
-                viewport.x = 0.0f;
-                viewport.y = 0.0f;
-                viewport.width = static_cast<float>(knoxicRenderer.getSwapChainExtent().width);
-                viewport.height = static_cast<float>(knoxicRenderer.getSwapChainExtent().height);
-                viewport.minDepth = 0.0f;
-                viewport.maxDepth = 1.0f;
-                VkRect2D scissor{{0, 0}, knoxicRenderer.getSwapChainExtent()};
-                vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-                vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-                
-                renderSystem.renderGameObjects(frameInfo);
-                pointLightVkSystem.render(frameInfo);
-                spotLightVkSystem.render(frameInfo);
-                directionalLightVkSystem.render(frameInfo);
-                vkCmdEndRenderPass(commandBuffer);
-
-                // Apply post-processing
-                auto& postProcSettings = gCoordinator.GetComponent<PostProcessingComponent>(cameraEntity);
-                postProcessSystem->renderPostProcess(commandBuffer, frameIndex, postProcSettings);
-
-                // Render final composite to swapchain
-                knoxicRenderer.beginSwapChainRenderPass(commandBuffer);
-                postProcessSystem->renderFinalComposite(
-                    commandBuffer,
-                    knoxicRenderer.getSwapChainRenderPass(),
-                    frameIndex,
-                    postProcSettings
-                );
+                temporalAASystem.update(frameInfo, ubo);
+                pointLightVkSystem.update(frameInfo, ubo, sceneLights);
+                spotLightVkSystem.update(frameInfo, ubo, sceneLights);
+                directionalLightVkSystem.update(frameInfo, ubo, sceneLights);
+                lightClusterSystem.update(ubo, postProcessSystem->getRenderExtent());
+                KnoxicTransientAllocation uboSlice = frameAllocator.allocateUniform(sizeof(GlobalUbo));
+                std::memcpy(uboSlice.mapped, &ubo, sizeof(GlobalUbo));
+
+                // Only widen the global set's light ranges when they had to grow
+                if (lightBufferSystem.upload(frameIndex, sceneLights, camera.getPosition())) {
+                    auto pointLightInfo = lightBufferSystem.getPointLightInfo(frameIndex);
+                    auto spotLightInfo = lightBufferSystem.getSpotLightInfo(frameIndex);
+                    auto directionalLightInfo = lightBufferSystem.getDirectionalLightInfo(frameIndex);
+                    KnoxicDescriptorWriter(*globalSetLayout, *globalPool)
+                        .writeBuffer(3, &pointLightInfo)
+                        .writeBuffer(4, &spotLightInfo)
+                        .writeBuffer(5, &directionalLightInfo)
+                        .overwrite(globalDescriptorSets[frameIndex]);
+                }
+                frameInfo.globalDynamicOffsets = {
+                    uboSlice.dynamicOffset(),
+                    lightBufferSystem.getPointLightOffset(),
+                    lightBufferSystem.getSpotLightOffset(),
+                    lightBufferSystem.getDirectionalLightOffset()
+                };
 
-                // Render ImGui
+                // Shadow views for this frame, stale atlas tiles re-rendered within the budget
+                if (shadowSystem.update(frameInfo, sceneLights)) {
+                    auto shadowViewInfo = shadowSystem.getShadowViewInfo(frameIndex);
+                    auto lightShadowInfo = shadowSystem.getLightShadowInfo(frameIndex);
+                    KnoxicDescriptorWriter(*globalSetLayout, *globalPool)
+                        .writeBuffer(6, &shadowViewInfo)
+                        .writeBuffer(7, &lightShadowInfo)
+                        .overwrite(globalDescriptorSets[frameIndex]);
+                }
+                // Build the UI first, the composite pass draws it
                 ImGui_ImplVulkan_NewFrame();
                 ImGui_ImplGlfw_NewFrame();
                 ImGui::NewFrame();
@@ -442,16 +886,70 @@ namespace knoxic {
 
                     ImGui::Text("Press F10 to enter Editor Mode");
                     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+                    if (dynamicResolutionSystem.isSupported()) {
+                        bool dynamicResolution = dynamicResolutionSystem.isEnabled();
+                        if (ImGui::Checkbox("Dynamic resolution", &dynamicResolution)) {
+                            dynamicResolutionSystem.setEnabled(dynamicResolution);
+                        }
+                        VkExtent2D renderExtent = postProcessSystem->getRenderExtent();
+                        ImGui::Text("GPU %.2f ms, rendering %ux%u (%.0f%%)", renderGraph.getTimings().frame,
+                            renderExtent.width, renderExtent.height, dynamicResolutionSystem.getRenderScale() * 100.0f);
+                    }
+                    if (knoxicDevice.hasAsyncCompute()) {
+                        ImGui::Checkbox("Async compute", &asyncCompute); // Applied with the next rebuild
+
+                        // Idle is the graphics queue waiting on compute (or between batches), the rest of the
+                        // compute time overlapped graphics work
+                        const RenderGraphTimings &timings = renderGraph.getTimings();
+                        ImGui::Text("Graphics %.2f ms (%.2f ms idle), compute %.2f ms, %u batches", timings.graphics,
+                            std::max(timings.frame - timings.graphics, 0.0f), timings.compute, renderGraph.getSubmitCount());
+                    }
+                    ImGui::Checkbox("Low latency", &lowLatency);
+                    ImGui::Text("Input to submit %.2f ms%s", inputLatency,
+                        lowLatency && knoxicRenderer.supportsPresentPacing() ? ", paced by present wait" : "");
+                    // Render graph targets keep their own memory for aliasing and aren't counted here
+                    KnoxicAllocatorStats memoryStats = knoxicDevice.allocator().getStats();
+                    ImGui::Text("GPU memory %.1f of %.1f MiB, %u allocations in %u blocks",
+                        memoryStats.used / (1024.0 * 1024.0), memoryStats.reserved / (1024.0 * 1024.0),
+                        memoryStats.allocationCount, memoryStats.memoryCount);
+                    if (uint32_t pendingPipelines = pipelineManager.getPendingCount()) {
+                        ImGui::Text("Compiling %u pipelines", pendingPipelines);
+                    }
+                    bool temporalAA = temporalAASystem.isEnabled();
+                    if (ImGui::Checkbox("Temporal AA", &temporalAA)) {
+                        temporalAASystem.setEnabled(temporalAA); // Applied with the next rebuild
+                    }
 
                     ImGui::End();
                 }
 
                 ImGui::Render();
-                ImDrawData* draw_data = ImGui::GetDrawData();
-                ImGui_ImplVulkan_RenderDrawData(draw_data, commandBuffer);
 
-                knoxicRenderer.endSwapChainRenderPass(commandBuffer);
-                knoxicRenderer.endFrame();
+                // Late latch: mouse look that came in while the frame was prepared turns the camera once more and only
+                // the view dependent UBO fields are rewritten. Culling and shadow fitting keep the earlier view, the
+                // few milliseconds of rotation stay within their margins. Movement isn't latched, it scales by frame time
+                if (lowLatency && !editorSystem->isEditorMode()) {
+                    glfwPollEvents();
+                    inputTime = std::chrono::high_resolution_clock::now();
+                    cameraControllerMouse.updateLook(knoxicWindow.getGLFWwindow(), frameTime, viewerObject);
+                    camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
+                    ubo.view = camera.getView();
+                    ubo.inverseView = camera.getInverseView();
+                    temporalAASystem.updateView(camera, ubo);
+                    std::memcpy(uboSlice.mapped, &ubo, sizeof(GlobalUbo));
+                }
+                frameAllocator.flush();
+
+                // Record every pass of the frame, batches ahead of the frame's command buffer are submitted here
+                renderGraph.execute(frameInfo);
+                // Textures the editor loaded while recording go out ahead of the frame that samples them
+                knoxicDevice.uploadContext().submit();
+
+                knoxicRenderer.endFrame(renderGraph.getFrameWaitSemaphores(), renderGraph.getFrameWaitStages());
+
+                float latency = std::chrono::duration<float, std::milli>(
+                    std::chrono::high_resolution_clock::now() - inputTime).count();
+                inputLatency = inputLatency == 0.0f ? latency : glm::mix(inputLatency, latency, 0.1f);
             }
         }
 
@@ -545,6 +1043,7 @@ namespace knoxic {
             floorMat.setMetallic(0.7f);
             floorMat.setRoughness(0.3f);
             gCoordinator.AddComponent(floor, floorMat);
+            gCoordinator.AddComponent(floor, OccluderComponent{});
 
             // Create point lights
             {
@@ -602,6 +1101,7 @@ namespace knoxic {
             floor2Mat.setRoughness(0.5f);
             floor2Mat.setMetallic(0.0f);
             gCoordinator.AddComponent(floor2, floor2Mat);
+            gCoordinator.AddComponent(floor2, OccluderComponent{});
 
             // Creates a point light entity
             Entity pointLight1 = gCoordinator.CreateEntity();
@@ -643,6 +1143,7 @@ namespace knoxic {
             floor3Mat.setRoughness(0.5f);
             floor3Mat.setMetallic(0.3f);
             gCoordinator.AddComponent(floor3, floor3Mat);
+            gCoordinator.AddComponent(floor3, OccluderComponent{});
 
             // Creates the wall entity
             knoxicModel = KnoxicModel::createModelFromFile(knoxicDevice, "res/models/quad.obj");
@@ -659,6 +1160,7 @@ namespace knoxic {
             wallMat.setRoughness(0.002f);
             wallMat.setMetallic(3.0f);
             gCoordinator.AddComponent(wall, wallMat);
+            gCoordinator.AddComponent(wall, OccluderComponent{});
 
             // Creates the wall2 entity
             knoxicModel = KnoxicModel::createModelFromFile(knoxicDevice, "res/models/quad.obj");
@@ -675,6 +1177,7 @@ namespace knoxic {
             wall2Mat.setRoughness(0.002f);
             wall2Mat.setMetallic(3.0f);
             gCoordinator.AddComponent(wall2, wall2Mat);
+            gCoordinator.AddComponent(wall2, OccluderComponent{});
 
             // Creates a point light entity
             Entity pointLight2 = gCoordinator.CreateEntity();
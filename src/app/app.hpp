@@ -3,11 +3,15 @@
 #include "../core/knoxic_window.hpp"
 #include "../core/vulkan/knoxic_vk_device.hpp"
 #include "../graphics/vulkan/knoxic_vk_renderer.hpp"
+#include "../graphics/vulkan/knoxic_vk_render_graph.hpp"
+#include "../graphics/vulkan/knoxic_vk_pipeline_manager.hpp"
 #include "../core/vulkan/knoxic_vk_descriptors.hpp"
 #include "../core/ecs/ecs_systems.hpp"
+#include "../graphics/knoxic_frame_info.hpp"
 #include "../systems/vulkan/knoxic_vk_post_process_system.hpp"
 #include "../systems/knoxic_editor_system.hpp"
 
+#include <chrono>
 #include <memory>
 
 namespace knoxic {
@@ -17,7 +21,7 @@ namespace knoxic {
         static constexpr int WIDTH = 1152;
         static constexpr int HEIGHT = 758;
 
-        App();
+        explicit App(RenderPath renderPath = RenderPath::Forward, bool lowLatency = false);
         ~App();
 
         App(const App &) = delete;
@@ -29,11 +33,20 @@ namespace knoxic {
         void loadGameObjects();
         void loadScene();
 
+        // Taken before the window and the device are created, startup is measured up to the first frame
+        std::chrono::high_resolution_clock::time_point startupBegin = std::chrono::high_resolution_clock::now();
+
         Entity cameraEntity;
+        RenderPath renderPath;
+        bool lowLatency; // Input waits for the GPU instead of aging while the frame waits, and the camera is latched late
 
         KnoxicWindow knoxicWindow{WIDTH, HEIGHT, "Knoxic"};
         KnoxicDevice knoxicDevice{knoxicWindow};
         KnoxicRenderer knoxicRenderer{knoxicWindow, knoxicDevice};
+        KnoxicRenderGraph renderGraph{knoxicDevice};
+
+        // Compiles the pipelines of the systems below on worker threads
+        KnoxicPipelineManager pipelineManager{};
 
         // Order of declarations matters
         std::unique_ptr<KnoxicDescriptorPool> globalPool{};
@@ -46,6 +59,7 @@ namespace knoxic {
         std::shared_ptr<PointLightECSSystem> pointLightSystem;
         std::shared_ptr<SpotLightECSSystem> spotLightSystem;
         std::shared_ptr<DirectionalLightECSSystem> directionalLightSystem;
+        std::shared_ptr<OccluderECSSystem> occluderSystem;
 
         // Editor system
         std::unique_ptr<KnoxicEditorSystem> editorSystem;
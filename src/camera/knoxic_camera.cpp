@@ -13,9 +13,10 @@ namespace knoxic {
         projectionMatrix[3][0] = -(right + left) / (right - left);
         projectionMatrix[3][1] = -(bottom + top) / (bottom - top);
         projectionMatrix[3][2] = -near / (far - near);
+        unjitteredProjectionMatrix = projectionMatrix;
     }
     
-    void KnoxicCamera::setPerspectiveProjection(float fovy, float aspect, float near, float far) {
+    void KnoxicCamera::setPerspectiveProjection(float fovy, float aspect, float near, float far, glm::vec2 jitter) {
         assert(glm::abs(aspect - std::numeric_limits<float>::epsilon()) > 0.0f);
         const float tanHalfFovy = tan(fovy / 2.0f);
         projectionMatrix = glm::mat4{0.0f};
@@ -24,6 +25,11 @@ namespace knoxic {
         projectionMatrix[2][2] = far / (far - near);
         projectionMatrix[2][3] = 1.0f;
         projectionMatrix[3][2] = -(far * near) / (far - near);
+        unjitteredProjectionMatrix = projectionMatrix;
+
+        // Clip w is the view depth, so this shifts every projected point by the same NDC offset
+        projectionMatrix[2][0] = jitter.x;
+        projectionMatrix[2][1] = jitter.y;
     }
 
     void KnoxicCamera::setViewDirection(glm::vec3 position, glm::vec3 direction, glm::vec3 up) {
@@ -9,19 +9,22 @@ namespace knoxic {
     class KnoxicCamera {
     public:
         void setOrthographicProjection(float left, float right, float top, float bottom, float near, float far);
-        void setPerspectiveProjection(float fovy, float aspect, float near, float far);
+        // jitter offsets the image in NDC units, for temporal anti-aliasing
+        void setPerspectiveProjection(float fovy, float aspect, float near, float far, glm::vec2 jitter = glm::vec2{0.0f});
 
         void setViewDirection(glm::vec3 position, glm::vec3 direction, glm::vec3 up = glm::vec3{0.0f, -1.0f, 0.0f});
         void setViewTarget(glm::vec3 position, glm::vec3 target, glm::vec3 up = glm::vec3{0.0f, -1.0f, 0.0f});
         void setViewYXZ(glm::vec3 position, glm::vec3 rotation);
 
         const glm::mat4 &getProjection() const { return projectionMatrix; }
+        const glm::mat4 &getUnjitteredProjection() const { return unjitteredProjectionMatrix; }
         const glm::mat4 &getView() const { return viewMatrix; }
         const glm::mat4 &getInverseView() const { return inverseViewMatrix; }
         const glm::vec3 getPosition() const { return glm::vec3(inverseViewMatrix[3]); }
 
     private:
         glm::mat4 projectionMatrix{1.0f};
+        glm::mat4 unjitteredProjectionMatrix{1.0f};
         glm::mat4 viewMatrix{1.0f};
         glm::mat4 inverseViewMatrix{1.0f};
     };
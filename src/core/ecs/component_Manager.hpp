@@ -42,6 +42,16 @@ public:
         return GetComponentArray<T>()->GetData(entity);
     }
 
+    template <typename T>
+    void MarkChanged(Entity entity) {
+        GetComponentArray<T>()->MarkChanged(entity);
+    }
+
+    template <typename T>
+    std::uint32_t GetVersion(Entity entity) {
+        return GetComponentArray<T>()->GetVersion(entity);
+    }
+
     void EntityDestroyed(Entity entity) {
         for (auto const& pair : mComponentArrays) {
             auto const& component = pair.second;
@@ -22,6 +22,7 @@ public:
         mEntityToIndexMap[entity] = newIndex;
         mIndexToEntityMap[newIndex] = entity;
         mComponentArray[newIndex] = component;
+        ++mVersions[entity];
         ++mSize;
     }
 
@@ -39,6 +40,7 @@ public:
         mEntityToIndexMap.erase(entity);
         mIndexToEntityMap.erase(indexOfLastElement);
 
+        ++mVersions[entity];
         --mSize;
     }
 
@@ -47,6 +49,15 @@ public:
         return mComponentArray[mEntityToIndexMap[entity]];
     }
 
+    // Writes through GetData are not seen, whoever modifies a component bumps its version
+    void MarkChanged(Entity entity) {
+        ++mVersions[entity];
+    }
+
+    std::uint32_t GetVersion(Entity entity) const {
+        return mVersions[entity];
+    }
+
     void EntityDestroyed(Entity entity) override {
         if (mEntityToIndexMap.find(entity) != mEntityToIndexMap.end()) {
             RemoveData(entity);
@@ -57,5 +68,6 @@ private:
     std::array<T, MAX_ENTITIES> mComponentArray{};
     std::unordered_map<Entity, size_t> mEntityToIndexMap{};
     std::unordered_map<size_t, Entity> mIndexToEntityMap{};
+    std::array<std::uint32_t, MAX_ENTITIES> mVersions{}; // Bumped on add, remove and MarkChanged
     size_t mSize{};
 };
\ No newline at end of file
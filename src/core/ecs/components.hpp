@@ -29,6 +29,7 @@ namespace knoxic {
     // Tag/data for point lights
     struct PointLightComponent {
         float lightIntensity = 1.0f;
+        float range = 0.0f; // 0 derives the range from intensity
     };
 
     // Tag/data for spot lights
@@ -36,6 +37,7 @@ namespace knoxic {
         float lightIntensity = 1.0f;
         float innerCutoff = 12.5f; // in degrees
         float outerCutoff = 17.5f; // in degrees
+        float range = 0.0f; // 0 derives the range from intensity
     };
 
     // Tag/data for directional lights
@@ -48,12 +50,17 @@ namespace knoxic {
         std::shared_ptr<KnoxicModel> model{};
     };
 
+    // Marks large static geometry (walls, floors) drawn into the software occlusion buffer
+    struct OccluderComponent {
+        bool enabled = true;
+    };
+
     struct PostProcessingComponent {
         // Bloom
         bool bloomEnabled{true};
         float bloomThreshold{1.0f};   // HDR threshold
         float bloomIntensity{0.7f};
-        int bloomIterations{5};       // blur passes
+        int bloomIterations{5};       // mip chain levels
 
         // Tonemapping / exposure / gamma
         float exposure{1.0f};
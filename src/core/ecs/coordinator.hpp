@@ -59,6 +59,17 @@ public:
         return mComponentManager->GetComponent<T>(entity);
     }
 
+    // Change tracking: systems that cache derived data compare versions between frames
+    template <typename T>
+    void MarkComponentChanged(Entity entity) {
+        mComponentManager->MarkChanged<T>(entity);
+    }
+
+    template <typename T>
+    std::uint32_t GetComponentVersion(Entity entity) {
+        return mComponentManager->GetVersion<T>(entity);
+    }
+
     template <typename T>
     bool HasComponent(Entity entity) {
         auto signature = mEntityManager->GetSignature(entity);
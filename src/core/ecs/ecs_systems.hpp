@@ -6,4 +6,5 @@
 struct RenderableSystem : public System {};
 struct PointLightECSSystem : public System {};
 struct SpotLightECSSystem : public System {};
-struct DirectionalLightECSSystem : public System {};
\ No newline at end of file
+struct DirectionalLightECSSystem : public System {};
+struct OccluderECSSystem : public System {};
\ No newline at end of file
@@ -0,0 +1,306 @@
+#include "knoxic_vk_allocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+
+namespace knoxic {
+
+    static constexpr uint32_t DEDICATED_POOL = ~0u;
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+    static constexpr VkDeviceSize SMALL_HEAP_SIZE = 1024ull * 1024 * 1024;
+
+    struct KnoxicMemoryBlock {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        char *mapped = nullptr;
+        uint32_t memoryType = 0;
+        uint32_t pool = DEDICATED_POOL;
+        bool linear = false;
+        uint32_t allocationCount = 0;
+
+        // Pooled: free ranges by offset for merging, and by size for the best fit
+        std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+        std::multimap<VkDeviceSize, VkDeviceSize> freeBySize;
+
+        // Linear: end of the last allocation
+        VkDeviceSize top = 0;
+    };
+
+    static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    static void eraseBySize(KnoxicMemoryBlock &block, VkDeviceSize offset, VkDeviceSize size) {
+        auto range = block.freeBySize.equal_range(size);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == offset) {
+                block.freeBySize.erase(it);
+                return;
+            }
+        }
+    }
+
+    static void insertFreeRange(KnoxicMemoryBlock &block, VkDeviceSize offset, VkDeviceSize size) {
+        auto next = block.freeRanges.lower_bound(offset);
+        if (next != block.freeRanges.end() && offset + size == next->first) {
+            size += next->second;
+            eraseBySize(block, next->first, next->second);
+            next = block.freeRanges.erase(next);
+        }
+        if (next != block.freeRanges.begin()) {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset) {
+                offset = previous->first;
+                size += previous->second;
+                eraseBySize(block, previous->first, previous->second);
+                block.freeRanges.erase(previous);
+            }
+        }
+
+        block.freeRanges[offset] = size;
+        block.freeBySize.insert({size, offset});
+    }
+
+    KnoxicAllocator::KnoxicAllocator(VkPhysicalDevice physicalDevice, VkDevice device) : device{device} {
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        bufferImageGranularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+        nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+
+        // Small heaps (host visible device memory, integrated GPUs) get an eighth of their size per block
+        pools.resize(memoryProperties.memoryTypeCount * 4);
+        blockSizes.resize(memoryProperties.memoryTypeCount);
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size;
+            blockSizes[i] = heapSize <= SMALL_HEAP_SIZE ? heapSize / 8 : DEFAULT_BLOCK_SIZE;
+        }
+    }
+
+    KnoxicAllocator::~KnoxicAllocator() {
+        for (auto &pool : pools) {
+            for (auto &block : pool.blocks) {
+                vkFreeMemory(device, block->memory, nullptr);
+            }
+        }
+        for (auto &block : dedicatedBlocks) {
+            vkFreeMemory(device, block->memory, nullptr);
+        }
+    }
+
+    KnoxicAllocator::Pool &KnoxicAllocator::getPool(uint32_t memoryType, bool linearResource, bool linearStrategy) {
+        bool separateImages = bufferImageGranularity > 1 && !linearResource;
+        return pools[memoryType * 4 + (linearStrategy ? 2 : 0) + (separateImages ? 1 : 0)];
+    }
+
+    KnoxicMemoryBlock *KnoxicAllocator::createBlock(uint32_t memoryType, VkDeviceSize size, Pool *pool, bool linear) {
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryType;
+
+        auto block = std::make_unique<KnoxicMemoryBlock>();
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate device memory!");
+        }
+
+        if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            void *mapped = nullptr;
+            if (vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+                vkFreeMemory(device, block->memory, nullptr);
+                throw std::runtime_error("failed to map device memory!");
+            }
+            block->mapped = static_cast<char *>(mapped);
+        }
+
+        block->size = size;
+        block->memoryType = memoryType;
+        block->linear = linear;
+        if (!linear) {
+            insertFreeRange(*block, 0, size);
+        }
+
+        stats.reserved += size;
+        stats.memoryCount++;
+
+        KnoxicMemoryBlock *result = block.get();
+        if (pool != nullptr) {
+            block->pool = static_cast<uint32_t>(pool - pools.data());
+            pool->blocks.push_back(std::move(block));
+        } else {
+            dedicatedBlocks.push_back(std::move(block));
+        }
+        return result;
+    }
+
+    void KnoxicAllocator::destroyBlock(KnoxicMemoryBlock *block) {
+        stats.reserved -= block->size;
+        stats.memoryCount--;
+        vkFreeMemory(device, block->memory, nullptr);
+
+        auto &owner = block->pool == DEDICATED_POOL ? dedicatedBlocks : pools[block->pool].blocks;
+        owner.erase(std::find_if(owner.begin(), owner.end(), [&](const auto &other) { return other.get() == block; }));
+    }
+
+    bool KnoxicAllocator::allocateFromBlock(KnoxicMemoryBlock &block, VkDeviceSize size, VkDeviceSize alignment,
+        KnoxicAllocation &allocation) {
+        VkDeviceSize offset = 0;
+        if (block.linear) {
+            offset = alignUp(block.top, alignment);
+            if (offset + size > block.size) {
+                return false;
+            }
+            block.top = offset + size;
+        } else {
+            // Smallest free range that still fits once aligned
+            auto range = block.freeBySize.lower_bound(size);
+            for (; range != block.freeBySize.end(); ++range) {
+                offset = alignUp(range->second, alignment);
+                if (offset + size <= range->second + range->first) {
+                    break;
+                }
+            }
+            if (range == block.freeBySize.end()) {
+                return false;
+            }
+
+            VkDeviceSize rangeOffset = range->second;
+            VkDeviceSize rangeEnd = range->second + range->first;
+            block.freeRanges.erase(rangeOffset);
+            block.freeBySize.erase(range);
+            if (offset > rangeOffset) {
+                insertFreeRange(block, rangeOffset, offset - rangeOffset);
+            }
+            if (rangeEnd > offset + size) {
+                insertFreeRange(block, offset + size, rangeEnd - offset - size);
+            }
+        }
+
+        block.allocationCount++;
+        allocation.memory = block.memory;
+        allocation.offset = offset;
+        allocation.size = size;
+        allocation.mapped = block.mapped != nullptr ? block.mapped + offset : nullptr;
+        allocation.block = &block;
+        return true;
+    }
+
+    KnoxicAllocation KnoxicAllocator::allocate(const VkMemoryRequirements &requirements, uint32_t memoryType,
+        bool linearResource, KnoxicAllocationStrategy strategy) {
+        std::lock_guard<std::mutex> lock{mutex};
+
+        VkDeviceSize size = requirements.size;
+        VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+        VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[memoryType].propertyFlags;
+        if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+            alignment = std::max(alignment, nonCoherentAtomSize);
+            size = alignUp(size, nonCoherentAtomSize);
+        }
+
+        // Anything above half a block would leave most of one unusable
+        KnoxicAllocation allocation{};
+        if (strategy == KnoxicAllocationStrategy::Dedicated || size > blockSizes[memoryType] / 2) {
+            KnoxicMemoryBlock *block = createBlock(memoryType, size, nullptr, false);
+            allocateFromBlock(*block, size, alignment, allocation);
+        } else {
+            bool linearStrategy = strategy == KnoxicAllocationStrategy::Linear;
+            Pool &pool = getPool(memoryType, linearResource, linearStrategy);
+
+            bool allocated = false;
+            for (size_t i = 0; i < pool.blocks.size() && !allocated; i++) {
+                allocated = allocateFromBlock(*pool.blocks[i], size, alignment, allocation);
+            }
+            if (!allocated) {
+                KnoxicMemoryBlock *block = createBlock(memoryType, blockSizes[memoryType], &pool, linearStrategy);
+                allocateFromBlock(*block, size, alignment, allocation);
+            }
+        }
+
+        stats.used += allocation.size;
+        stats.allocationCount++;
+        return allocation;
+    }
+
+    void KnoxicAllocator::free(KnoxicAllocation &allocation) {
+        if (allocation.block == nullptr) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock{mutex};
+
+        KnoxicMemoryBlock *block = allocation.block;
+        stats.used -= allocation.size;
+        stats.allocationCount--;
+        block->allocationCount--;
+
+        if (block->pool == DEDICATED_POOL) {
+            destroyBlock(block);
+        } else {
+            if (!block->linear) {
+                insertFreeRange(*block, allocation.offset, allocation.size);
+            } else if (block->allocationCount == 0) {
+                block->top = 0;
+            }
+
+            // One empty block stays per pool, loading and unloading a scene doesn't reallocate it every time
+            if (block->allocationCount == 0) {
+                const auto &blocks = pools[block->pool].blocks;
+                bool otherEmpty = std::any_of(blocks.begin(), blocks.end(), [&](const auto &other) {
+                    return other.get() != block && other->allocationCount == 0;
+                });
+                if (otherEmpty) {
+                    destroyBlock(block);
+                }
+            }
+        }
+
+        allocation = KnoxicAllocation{};
+    }
+
+    VkMappedMemoryRange KnoxicAllocator::mappedRange(const KnoxicAllocation &allocation, VkDeviceSize size, VkDeviceSize offset) const {
+        assert(offset <= allocation.size && "Range starts past the end of the allocation");
+        if (size == VK_WHOLE_SIZE) {
+            size = allocation.size - offset;
+        }
+
+        // Non-coherent allocations are atom aligned and padded, so rounding outwards stays inside them
+        VkDeviceSize begin = (allocation.offset + offset) & ~(nonCoherentAtomSize - 1);
+        VkDeviceSize end = alignUp(allocation.offset + offset + size, nonCoherentAtomSize);
+
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = allocation.memory;
+        range.offset = begin;
+        range.size = end - begin;
+        return range;
+    }
+
+    VkResult KnoxicAllocator::flush(const KnoxicAllocation &allocation, VkDeviceSize size, VkDeviceSize offset) {
+        VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[allocation.block->memoryType].propertyFlags;
+        if (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) {
+            return VK_SUCCESS;
+        }
+
+        VkMappedMemoryRange range = mappedRange(allocation, size, offset);
+        return vkFlushMappedMemoryRanges(device, 1, &range);
+    }
+
+    VkResult KnoxicAllocator::invalidate(const KnoxicAllocation &allocation, VkDeviceSize size, VkDeviceSize offset) {
+        VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[allocation.block->memoryType].propertyFlags;
+        if (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) {
+            return VK_SUCCESS;
+        }
+
+        VkMappedMemoryRange range = mappedRange(allocation, size, offset);
+        return vkInvalidateMappedMemoryRanges(device, 1, &range);
+    }
+
+    KnoxicAllocatorStats KnoxicAllocator::getStats() {
+        std::lock_guard<std::mutex> lock{mutex};
+        return stats;
+    }
+}
\ No newline at end of file
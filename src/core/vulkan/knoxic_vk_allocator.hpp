@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace knoxic {
+
+    struct KnoxicMemoryBlock;
+
+    enum class KnoxicAllocationStrategy {
+        Pooled,    // Best fit from a shared block of the memory type, freed ranges merge with their neighbours
+        Linear,    // Bump allocated, a block starts over once everything in it is freed. Staging and other short-lived data
+        Dedicated  // Its own VkDeviceMemory, for render targets and anything too large for a block
+    };
+
+    struct KnoxicAllocation {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        void *mapped = nullptr; // Host visible memory stays mapped, this is the start of the allocation
+        KnoxicMemoryBlock *block = nullptr;
+    };
+
+    struct KnoxicAllocatorStats {
+        VkDeviceSize reserved = 0; // In VkDeviceMemory objects
+        VkDeviceSize used = 0;
+        uint32_t memoryCount = 0;
+        uint32_t allocationCount = 0;
+    };
+
+    // Sub-allocates device memory so resources don't each cost one of the maxMemoryAllocationCount allocations.
+    // Every memory type gets its own pools of blocks, sized from its heap. Where bufferImageGranularity is above 1,
+    // buffers and linear images never share a block with optimal tiled images, so neighbours can't alias pages.
+    // Host visible blocks are mapped once, non-coherent allocations are padded to nonCoherentAtomSize so flushing
+    // one never touches another
+    class KnoxicAllocator {
+    public:
+        KnoxicAllocator(VkPhysicalDevice physicalDevice, VkDevice device);
+        ~KnoxicAllocator();
+
+        KnoxicAllocator(const KnoxicAllocator &) = delete;
+        KnoxicAllocator &operator=(const KnoxicAllocator &) = delete;
+
+        // Linear resources are buffers and linear tiled images. Large requests fall back to dedicated memory
+        KnoxicAllocation allocate(const VkMemoryRequirements &requirements, uint32_t memoryType,
+            bool linearResource, KnoxicAllocationStrategy strategy);
+        void free(KnoxicAllocation &allocation);
+
+        // Ranges relative to the allocation, VK_WHOLE_SIZE runs to its end
+        VkResult flush(const KnoxicAllocation &allocation, VkDeviceSize size, VkDeviceSize offset);
+        VkResult invalidate(const KnoxicAllocation &allocation, VkDeviceSize size, VkDeviceSize offset);
+
+        KnoxicAllocatorStats getStats();
+
+    private:
+        struct Pool {
+            std::vector<std::unique_ptr<KnoxicMemoryBlock>> blocks;
+        };
+
+        Pool &getPool(uint32_t memoryType, bool linearResource, bool linearStrategy);
+        KnoxicMemoryBlock *createBlock(uint32_t memoryType, VkDeviceSize size, Pool *pool, bool linear);
+        void destroyBlock(KnoxicMemoryBlock *block);
+        bool allocateFromBlock(KnoxicMemoryBlock &block, VkDeviceSize size, VkDeviceSize alignment, KnoxicAllocation &allocation);
+        VkMappedMemoryRange mappedRange(const KnoxicAllocation &allocation, VkDeviceSize size, VkDeviceSize offset) const;
+
+        VkDevice device;
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        VkDeviceSize bufferImageGranularity = 1;
+        VkDeviceSize nonCoherentAtomSize = 1;
+
+        // Per memory type: pooled and linear, each for linear and optimal resources
+        std::vector<Pool> pools;
+        std::vector<VkDeviceSize> blockSizes;
+        std::vector<std::unique_ptr<KnoxicMemoryBlock>> dedicatedBlocks;
+
+        KnoxicAllocatorStats stats;
+        std::mutex mutex;
+    };
+}
\ No newline at end of file
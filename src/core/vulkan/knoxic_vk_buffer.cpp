@@ -13,29 +13,31 @@ namespace knoxic {
     }
 
     KnoxicBuffer::KnoxicBuffer(KnoxicDevice &device, VkDeviceSize instanceSize, uint32_t instanceCount,
-    VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags,  VkDeviceSize minOffsetAlignment) : knoxicDevice{device},
+    VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags,  VkDeviceSize minOffsetAlignment,
+    KnoxicAllocationStrategy strategy) : knoxicDevice{device},
     instanceSize{instanceSize}, instanceCount{instanceCount}, usageFlags{usageFlags}, memoryPropertyFlags{memoryPropertyFlags} {
         alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
         bufferSize = alignmentSize * instanceCount;
-        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, allocation, strategy);
     }
 
     KnoxicBuffer::~KnoxicBuffer() {
         unmap();
         vkDestroyBuffer(knoxicDevice.device(), buffer, nullptr);
-        vkFreeMemory(knoxicDevice.device(), memory, nullptr);
+        knoxicDevice.freeMemory(allocation);
     }
 
     VkResult KnoxicBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
-        assert(buffer && memory && "Called map on buffer before create");
-        return vkMapMemory(knoxicDevice.device(), memory, offset, size, 0, &mapped);
+        assert(buffer && allocation.memory && "Called map on buffer before create");
+        if (allocation.mapped == nullptr) {
+            return VK_ERROR_MEMORY_MAP_FAILED;
+        }
+        mapped = static_cast<char *>(allocation.mapped) + offset;
+        return VK_SUCCESS;
     }
 
     void KnoxicBuffer::unmap() {
-        if (mapped) {
-            vkUnmapMemory(knoxicDevice.device(), memory);
-            mapped = nullptr;
-        }
+        mapped = nullptr;
     }
 
     void KnoxicBuffer::writeToBuffer(void *data, VkDeviceSize size, VkDeviceSize offset) {
@@ -51,21 +53,11 @@ namespace knoxic {
     }
 
     VkResult KnoxicBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkFlushMappedMemoryRanges(knoxicDevice.device(), 1, &mappedRange);
+        return knoxicDevice.allocator().flush(allocation, size, offset);
     }
 
     VkResult KnoxicBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkInvalidateMappedMemoryRanges(knoxicDevice.device(), 1, &mappedRange);
+        return knoxicDevice.allocator().invalidate(allocation, size, offset);
     }
 
     VkDescriptorBufferInfo KnoxicBuffer::descriptorInfo(VkDeviceSize size, VkDeviceSize offset) {
@@ -7,12 +7,14 @@ namespace knoxic {
     class KnoxicBuffer {
     public:
         KnoxicBuffer(KnoxicDevice &device, VkDeviceSize instanceSize, uint32_t instanceCount, 
-            VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize minOffsetAlignment = 1);
+            VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize minOffsetAlignment = 1,
+            KnoxicAllocationStrategy strategy = KnoxicAllocationStrategy::Pooled);
         ~KnoxicBuffer();
         
         KnoxicBuffer(const KnoxicBuffer&) = delete;
         KnoxicBuffer& operator=(const KnoxicBuffer&) = delete;
         
+        // Host visible memory is mapped for its whole lifetime, this only hands out the pointer
         VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
         void unmap();
         
@@ -41,7 +43,7 @@ namespace knoxic {
         KnoxicDevice &knoxicDevice;
         void *mapped = nullptr;
         VkBuffer buffer = VK_NULL_HANDLE;
-        VkDeviceMemory memory = VK_NULL_HANDLE;
+        KnoxicAllocation allocation{};
         
         VkDeviceSize bufferSize;
         uint32_t instanceCount;
@@ -18,23 +18,51 @@ namespace knoxic {
         return *this;
     }
 
+    KnoxicDescriptorSetLayout::Builder &KnoxicDescriptorSetLayout::Builder::setBindingFlags(
+    uint32_t binding, VkDescriptorBindingFlagsEXT flags) {
+        assert(bindings.count(binding) == 1 && "Binding flags set for an unknown binding");
+        bindingFlags[binding] = flags;
+        return *this;
+    }
+
+    KnoxicDescriptorSetLayout::Builder &KnoxicDescriptorSetLayout::Builder::setLayoutFlags(VkDescriptorSetLayoutCreateFlags flags) {
+        layoutFlags = flags;
+        return *this;
+    }
+
     std::unique_ptr<KnoxicDescriptorSetLayout> KnoxicDescriptorSetLayout::Builder::build() const {
-        return std::make_unique<KnoxicDescriptorSetLayout>(knoxicDevice, bindings);
+        return std::make_unique<KnoxicDescriptorSetLayout>(knoxicDevice, bindings, bindingFlags, layoutFlags);
     }
 
     // -- Descriptor set layout --
     KnoxicDescriptorSetLayout::KnoxicDescriptorSetLayout(KnoxicDevice &knoxicDevice,
-    std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings) : knoxicDevice{knoxicDevice}, bindings{bindings} {
+    std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+    const std::unordered_map<uint32_t, VkDescriptorBindingFlagsEXT> &bindingFlags,
+    VkDescriptorSetLayoutCreateFlags layoutFlags) : knoxicDevice{knoxicDevice}, bindings{bindings} {
         std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+        std::vector<VkDescriptorBindingFlagsEXT> setLayoutBindingFlags{};
         for (auto keyValue : bindings) {
             setLayoutBindings.push_back(keyValue.second);
+
+            auto flags = bindingFlags.find(keyValue.first);
+            setLayoutBindingFlags.push_back(flags != bindingFlags.end() ? flags->second : 0);
         }
 
         VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
         descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        descriptorSetLayoutInfo.flags = layoutFlags;
         descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
         descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
 
+        // Only chained when used, so plain layouts don't need descriptor indexing
+        VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{};
+        if (!bindingFlags.empty()) {
+            bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+            bindingFlagsInfo.bindingCount = static_cast<uint32_t>(setLayoutBindingFlags.size());
+            bindingFlagsInfo.pBindingFlags = setLayoutBindingFlags.data();
+            descriptorSetLayoutInfo.pNext = &bindingFlagsInfo;
+        }
+
         if (vkCreateDescriptorSetLayout(
                 knoxicDevice.device(),
                 &descriptorSetLayoutInfo,
@@ -156,6 +184,25 @@ namespace knoxic {
         return *this;
     }
 
+    KnoxicDescriptorWriter &KnoxicDescriptorWriter::writeImageArrayElement(uint32_t binding, uint32_t arrayElement, VkDescriptorImageInfo *imageInfo) {
+        assert(setLayout.bindings.count(binding) == 1 && "Layout does not contain specified binding");
+
+        auto &bindingDescription = setLayout.bindings[binding];
+
+        assert(arrayElement < bindingDescription.descriptorCount && "Array element out of range for binding");
+
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.descriptorType = bindingDescription.descriptorType;
+        write.dstBinding = binding;
+        write.dstArrayElement = arrayElement;
+        write.pImageInfo = imageInfo;
+        write.descriptorCount = 1;
+
+        writes.push_back(write);
+        return *this;
+    }
+
     bool KnoxicDescriptorWriter::build(VkDescriptorSet &set) {
         bool success = pool.allocateDescriptor(setLayout.getDescriptorSetLayout(), set);
         if (!success) {
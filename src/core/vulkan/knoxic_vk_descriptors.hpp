@@ -15,14 +15,19 @@ namespace knoxic {
             Builder(KnoxicDevice &knoxicDevice) : knoxicDevice{knoxicDevice} {}
 
             Builder &addBinding(uint32_t binding, VkDescriptorType descriptorType, VkShaderStageFlags stageFlags, uint32_t count = 1);
+            Builder &setBindingFlags(uint32_t binding, VkDescriptorBindingFlagsEXT flags);
+            Builder &setLayoutFlags(VkDescriptorSetLayoutCreateFlags flags);
             std::unique_ptr<KnoxicDescriptorSetLayout> build() const;
 
         private:
             KnoxicDevice &knoxicDevice;
             std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+            std::unordered_map<uint32_t, VkDescriptorBindingFlagsEXT> bindingFlags{};
+            VkDescriptorSetLayoutCreateFlags layoutFlags = 0;
         };
 
-        KnoxicDescriptorSetLayout(KnoxicDevice &knoxicDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+        KnoxicDescriptorSetLayout(KnoxicDevice &knoxicDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+            const std::unordered_map<uint32_t, VkDescriptorBindingFlagsEXT> &bindingFlags = {}, VkDescriptorSetLayoutCreateFlags layoutFlags = 0);
         ~KnoxicDescriptorSetLayout();
 
         KnoxicDescriptorSetLayout(const KnoxicDescriptorSetLayout &) = delete;
@@ -85,6 +90,9 @@ namespace knoxic {
         KnoxicDescriptorWriter &writeBuffer(uint32_t binding, VkDescriptorBufferInfo *bufferInfo);
         KnoxicDescriptorWriter &writeImage(uint32_t binding, VkDescriptorImageInfo *imageInfo);
 
+        // Writes one element of an arrayed binding
+        KnoxicDescriptorWriter &writeImageArrayElement(uint32_t binding, uint32_t arrayElement, VkDescriptorImageInfo *imageInfo);
+
         bool build(VkDescriptorSet &set);
         void overwrite(VkDescriptorSet &set);
 
@@ -1,4 +1,5 @@
 #include "knoxic_vk_device.hpp"
+#include "knoxic_vk_upload_context.hpp"
 
 #include <cstring>
 #include <iostream>
@@ -48,11 +49,22 @@ namespace knoxic {
         createSurface();
         pickPhysicalDevice();
         createLogicalDevice();
+        allocator_ = std::make_unique<KnoxicAllocator>(physicalDevice, device_);
+        pipelineCache_ = std::make_unique<KnoxicPipelineCache>(device_, properties);
+        shaderModules_ = std::make_unique<KnoxicShaderModuleCache>(device_);
         createCommandPool();
+        uploadContext_ = std::make_unique<KnoxicUploadContext>(*this);
     }
 
     KnoxicDevice::~KnoxicDevice() {
+        uploadContext_.reset();
         vkDestroyCommandPool(device_, commandPool, nullptr);
+        if (computeCommandPool != VK_NULL_HANDLE) {
+            vkDestroyCommandPool(device_, computeCommandPool, nullptr);
+        }
+        shaderModules_.reset();
+        pipelineCache_.reset();
+        allocator_.reset();
         vkDestroyDevice(device_, nullptr);
 
         if (enableValidationLayers) {
@@ -88,6 +100,12 @@ namespace knoxic {
         #ifdef __APPLE__
             extensions.push_back("VK_KHR_portability_enumeration"); // required for macOS
         #endif
+
+        // Needed to query descriptor indexing features on a 1.0 instance
+        physicalDeviceProperties2Enabled = isInstanceExtensionAvailable(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+        if (physicalDeviceProperties2Enabled) {
+            extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+        }
         createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
         createInfo.ppEnabledExtensionNames = extensions.data();
 
@@ -133,6 +151,64 @@ namespace knoxic {
 
         vkGetPhysicalDeviceProperties(physicalDevice, &properties);
         std::cout << "physical device: " << properties.deviceName << std::endl;
+
+        queryDescriptorIndexingSupport();
+        queryPresentWaitSupport();
+    }
+
+    void KnoxicDevice::queryDescriptorIndexingSupport() {
+        descriptorIndexingSupported = false;
+        if (!physicalDeviceProperties2Enabled) return;
+        if (!isDeviceExtensionAvailable(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) ||
+            !isDeviceExtensionAvailable(physicalDevice, VK_KHR_MAINTENANCE3_EXTENSION_NAME)) {
+            return;
+        }
+
+        auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+        if (getFeatures2 == nullptr) return;
+
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+        indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+        VkPhysicalDeviceFeatures2KHR features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+        features2.pNext = &indexingFeatures;
+        getFeatures2(physicalDevice, &features2);
+
+        descriptorIndexingSupported =
+            indexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+            indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+            indexingFeatures.descriptorBindingPartiallyBound;
+
+        std::cout << "descriptor indexing: " << (descriptorIndexingSupported ? "supported" : "unsupported") << std::endl;
+    }
+
+    void KnoxicDevice::queryPresentWaitSupport() {
+        presentWaitSupported = false;
+        if (!physicalDeviceProperties2Enabled) return;
+        if (!isDeviceExtensionAvailable(physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME) ||
+            !isDeviceExtensionAvailable(physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+            return;
+        }
+
+        auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+        if (getFeatures2 == nullptr) return;
+
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        presentIdFeatures.pNext = &presentWaitFeatures;
+
+        VkPhysicalDeviceFeatures2KHR features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+        features2.pNext = &presentIdFeatures;
+        getFeatures2(physicalDevice, &features2);
+
+        presentWaitSupported = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+
+        std::cout << "present wait: " << (presentWaitSupported ? "supported" : "unsupported") << std::endl;
     }
 
     void KnoxicDevice::createLogicalDevice() {
@@ -140,6 +216,12 @@ namespace knoxic {
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
         std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+        if (indices.computeFamilyHasValue) {
+            uniqueQueueFamilies.insert(indices.computeFamily);
+        }
+        if (indices.transferFamilyHasValue) {
+            uniqueQueueFamilies.insert(indices.transferFamily);
+        }
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -160,9 +242,43 @@ namespace knoxic {
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+        std::vector<const char *> enabledExtensions = deviceExtensions;
+
+        // Optional feature structs, chained in front of each other
+        void *featureChain = nullptr;
+
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+        indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        if (descriptorIndexingSupported) {
+            enabledExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+            enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+            indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+            indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+            indexingFeatures.pNext = featureChain;
+            featureChain = &indexingFeatures;
+        }
+
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        if (presentWaitSupported) {
+            enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+            presentIdFeatures.presentId = VK_TRUE;
+            presentWaitFeatures.presentWait = VK_TRUE;
+            presentWaitFeatures.pNext = featureChain;
+            presentIdFeatures.pNext = &presentWaitFeatures;
+            featureChain = &presentIdFeatures;
+        }
+        createInfo.pNext = featureChain;
+
         createInfo.pEnabledFeatures = &deviceFeatures;
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
         if (enableValidationLayers) {
             createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -177,6 +293,31 @@ namespace knoxic {
 
         vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
         vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+
+        if (presentWaitSupported) {
+            waitForPresentKHR = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(device_, "vkWaitForPresentKHR");
+            presentWaitSupported = waitForPresentKHR != nullptr;
+        }
+
+        graphicsQueueFamily = indices.graphicsFamily;
+        if (indices.computeFamilyHasValue) {
+            computeQueueFamily = indices.computeFamily;
+            vkGetDeviceQueue(device_, indices.computeFamily, 0, &computeQueue_);
+        }
+        if (indices.transferFamilyHasValue) {
+            transferQueueFamily = indices.transferFamily;
+            vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+        }
+        sharedQueueFamilies[0] = graphicsQueueFamily;
+        sharedQueueFamilies[1] = computeQueueFamily;
+
+        bufferQueueFamilies = {graphicsQueueFamily};
+        if (hasAsyncCompute()) {
+            bufferQueueFamilies.push_back(computeQueueFamily);
+        }
+        if (hasTransferQueue()) {
+            bufferQueueFamilies.push_back(transferQueueFamily);
+        }
     }
 
     void KnoxicDevice::createCommandPool() {
@@ -190,6 +331,13 @@ namespace knoxic {
         if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
             throw std::runtime_error("failed to create command pool!");
         }
+
+        if (hasAsyncCompute()) {
+            poolInfo.queueFamilyIndex = computeQueueFamily;
+            if (vkCreateCommandPool(device_, &poolInfo, nullptr, &computeCommandPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create compute command pool!");
+            }
+        }
     }
 
     void KnoxicDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
@@ -312,6 +460,34 @@ namespace knoxic {
         return requiredExtensions.empty();
     }
 
+    bool KnoxicDevice::isInstanceExtensionAvailable(const char *extensionName) {
+        uint32_t extensionCount = 0;
+        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> extensions(extensionCount);
+        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+
+        for (const auto &extension : extensions) {
+            if (strcmp(extension.extensionName, extensionName) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool KnoxicDevice::isDeviceExtensionAvailable(VkPhysicalDevice device, const char *extensionName) {
+        uint32_t extensionCount = 0;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> extensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+
+        for (const auto &extension : extensions) {
+            if (strcmp(extension.extensionName, extensionName) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     QueueFamilyIndices KnoxicDevice::findQueueFamilies(VkPhysicalDevice device) {
         QueueFamilyIndices indices;
 
@@ -340,6 +516,28 @@ namespace knoxic {
             i++;
         }
 
+        // Separate from the graphics family, so its work can run alongside graphics work
+        for (uint32_t family = 0; family < queueFamilyCount; family++) {
+            const auto &queueFamily = queueFamilies[family];
+            if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) &&
+                !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+                indices.computeFamily = family;
+                indices.computeFamilyHasValue = true;
+                break;
+            }
+        }
+
+        // A DMA engine, uploads there don't take time from the graphics queue
+        for (uint32_t family = 0; family < queueFamilyCount; family++) {
+            const auto &queueFamily = queueFamilies[family];
+            if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+                !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+                indices.transferFamily = family;
+                indices.transferFamilyHasValue = true;
+                break;
+            }
+        }
+
     return indices;
     }
 
@@ -399,17 +597,37 @@ namespace knoxic {
         throw std::runtime_error("failed to find suitable memory type!");
     }
 
+    uint32_t KnoxicDevice::findTransientMemoryType(uint32_t typeFilter) {
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) &&
+                (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+                return i;
+            }
+        }
+
+        return findMemoryType(typeFilter, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+
     void KnoxicDevice::createBuffer(
         VkDeviceSize size,
         VkBufferUsageFlags usage,
         VkMemoryPropertyFlags properties,
         VkBuffer &buffer,
-        VkDeviceMemory &bufferMemory) {
+        KnoxicAllocation &bufferAllocation,
+        KnoxicAllocationStrategy strategy) {
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size;
         bufferInfo.usage = usage;
         bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (bufferQueueFamilies.size() > 1) {
+            // Buffers have no compression to lose, sharing them saves ownership transfers around async compute and uploads
+            bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(bufferQueueFamilies.size());
+            bufferInfo.pQueueFamilyIndices = bufferQueueFamilies.data();
+        }
 
         if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
             throw std::runtime_error("failed to create vertex buffer!");
@@ -418,16 +636,12 @@ namespace knoxic {
         VkMemoryRequirements memRequirements;
         vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+        uint32_t memoryType = findMemoryType(memRequirements.memoryTypeBits, properties);
+        bufferAllocation = allocator_->allocate(memRequirements, memoryType, true, strategy);
 
-        if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate vertex buffer memory!");
+        if (vkBindBufferMemory(device_, buffer, bufferAllocation.memory, bufferAllocation.offset) != VK_SUCCESS) {
+            throw std::runtime_error("failed to bind buffer memory!");
         }
-
-        vkBindBufferMemory(device_, buffer, bufferMemory, 0);
     }
 
     VkCommandBuffer KnoxicDevice::beginSingleTimeCommands() {
@@ -462,50 +676,21 @@ namespace knoxic {
         vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
     }
 
-    void KnoxicDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-        VkBufferCopy copyRegion{};
-        copyRegion.srcOffset = 0;
-        copyRegion.dstOffset = 0;
-        copyRegion.size = size;
-        vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-        endSingleTimeCommands(commandBuffer);
-    }
-
-    void KnoxicDevice::copyBufferToImage(
-        VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount) {
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-        VkBufferImageCopy region{};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = layerCount;
-
-        region.imageOffset = {0, 0, 0};
-        region.imageExtent = {width, height, 1};
-
-        vkCmdCopyBufferToImage(
-            commandBuffer,
-            buffer,
-            image,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            1,
-            &region);
-        endSingleTimeCommands(commandBuffer);
+    void KnoxicDevice::shareWithComputeQueue(VkImageCreateInfo &imageInfo) const {
+        if (!hasAsyncCompute()) {
+            return;
+        }
+        imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        imageInfo.queueFamilyIndexCount = 2;
+        imageInfo.pQueueFamilyIndices = sharedQueueFamilies;
     }
 
     void KnoxicDevice::createImageWithInfo(
         const VkImageCreateInfo &imageInfo,
         VkMemoryPropertyFlags properties,
         VkImage &image,
-        VkDeviceMemory &imageMemory) {
+        KnoxicAllocation &imageAllocation,
+        KnoxicAllocationStrategy strategy) {
         if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
             throw std::runtime_error("failed to create image!");
         }
@@ -513,67 +698,21 @@ namespace knoxic {
         VkMemoryRequirements memRequirements;
         vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-        if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate image memory!");
+        uint32_t memoryType;
+        if (imageInfo.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) {
+            memoryType = findTransientMemoryType(memRequirements.memoryTypeBits);
+            strategy = KnoxicAllocationStrategy::Dedicated;
+        } else {
+            memoryType = findMemoryType(memRequirements.memoryTypeBits, properties);
         }
+        imageAllocation = allocator_->allocate(memRequirements, memoryType,
+            imageInfo.tiling == VK_IMAGE_TILING_LINEAR, strategy);
 
-        if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+        if (vkBindImageMemory(device_, image, imageAllocation.memory, imageAllocation.offset) != VK_SUCCESS) {
             throw std::runtime_error("failed to bind image memory!");
         }
     }
 
-    void KnoxicDevice::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-        VkImageMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.oldLayout = oldLayout;
-        barrier.newLayout = newLayout;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.image = image;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = 1;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-
-        VkPipelineStageFlags sourceStage;
-        VkPipelineStageFlags destinationStage;
-
-        if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        } else {
-            throw std::invalid_argument("Unsupported layout transition!");
-        }
-
-        vkCmdPipelineBarrier(
-            commandBuffer,
-            sourceStage, destinationStage,
-            0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier
-        );
-
-        endSingleTimeCommands(commandBuffer);
-    }
-
     std::vector<const char*> KnoxicDevice::getRequiredDeviceExtensions() {
         std::vector<const char*> extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
         
@@ -1,7 +1,11 @@
 #pragma once
 
 #include "../knoxic_window.hpp"
+#include "knoxic_vk_allocator.hpp"
+#include "knoxic_vk_pipeline_cache.hpp"
+#include "knoxic_vk_shader_module_cache.hpp"
 
+#include <memory>
 #include <vector>
 
 namespace knoxic {
@@ -15,11 +19,17 @@ namespace knoxic {
     struct QueueFamilyIndices {
         uint32_t graphicsFamily;
         uint32_t presentFamily;
+        uint32_t computeFamily; // Compute without graphics, optional
+        uint32_t transferFamily; // Transfer only, optional
         bool graphicsFamilyHasValue = false;
         bool presentFamilyHasValue = false;
+        bool computeFamilyHasValue = false;
+        bool transferFamilyHasValue = false;
         bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
     };
 
+    class KnoxicUploadContext;
+
     class KnoxicDevice {
     public:
         #ifdef NDEBUG
@@ -42,10 +52,42 @@ namespace knoxic {
         VkSurfaceKHR surface() { return surface_; }
         VkQueue graphicsQueue() { return graphicsQueue_; }
         VkQueue presentQueue() { return presentQueue_; }
+        VkQueue computeQueue() { return computeQueue_; }
+        VkQueue transferQueue() { return transferQueue_; }
         VkPhysicalDevice getPhysicalDevice() { return physicalDevice; }
+        KnoxicAllocator &allocator() { return *allocator_; }
+        KnoxicPipelineCache &pipelineCache() { return *pipelineCache_; }
+        KnoxicShaderModuleCache &shaderModules() { return *shaderModules_; }
+
+        // A compute-only queue family next to the graphics one, work submitted there can overlap graphics work
+        bool hasAsyncCompute() const { return computeQueue_ != VK_NULL_HANDLE; }
+        VkCommandPool getComputeCommandPool() { return computeCommandPool; }
+        uint32_t getGraphicsQueueFamily() const { return graphicsQueueFamily; }
+        uint32_t getComputeQueueFamily() const { return computeQueueFamily; }
+
+        // A transfer-only queue family, the upload context copies there when the device has one
+        bool hasTransferQueue() const { return transferQueue_ != VK_NULL_HANDLE; }
+        uint32_t getTransferQueueFamily() const { return transferQueueFamily; }
+        KnoxicUploadContext &uploadContext() { return *uploadContext_; }
+
+        // Concurrent sharing between the graphics and compute families while both are in use. For resources the
+        // render graph doesn't transfer between the queues itself
+        void shareWithComputeQueue(VkImageCreateInfo &imageInfo) const;
+
+        // Partially bound, update-after-bind sampled image arrays (bindless materials)
+        bool supportsDescriptorIndexing() const { return descriptorIndexingSupported; }
+
+        // VK_KHR_present_id and VK_KHR_present_wait, the swap chain tags its presents and can wait for them on screen
+        bool supportsPresentWait() const { return presentWaitSupported; }
+        VkResult waitForPresent(VkSwapchainKHR swapChain, uint64_t presentId, uint64_t timeout) {
+            return waitForPresentKHR(device_, swapChain, presentId, timeout);
+        }
 
         SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
         uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+        // Lazily allocated memory where the GPU has it (tile-based), device local otherwise
+        uint32_t findTransientMemoryType(uint32_t typeFilter);
         QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
         VkFormat findSupportedFormat(const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
@@ -55,21 +97,23 @@ namespace knoxic {
             VkBufferUsageFlags usage,
             VkMemoryPropertyFlags properties,
             VkBuffer &buffer,
-            VkDeviceMemory &bufferMemory
+            KnoxicAllocation &bufferAllocation,
+            KnoxicAllocationStrategy strategy = KnoxicAllocationStrategy::Pooled
         );
         VkCommandBuffer beginSingleTimeCommands();
         void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-        void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-        void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount = 1);
 
+        // Transient attachments always get dedicated memory
         void createImageWithInfo(
             const VkImageCreateInfo &imageInfo,
             VkMemoryPropertyFlags properties,
             VkImage &image,
-            VkDeviceMemory &imageMemory
+            KnoxicAllocation &imageAllocation,
+            KnoxicAllocationStrategy strategy = KnoxicAllocationStrategy::Pooled
         );
 
-        void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
+        // After the buffer or image bound to it is destroyed
+        void freeMemory(KnoxicAllocation &allocation) { allocator_->free(allocation); }
 
         VkPhysicalDeviceProperties properties;
 
@@ -90,17 +134,38 @@ namespace knoxic {
         void hasGflwRequiredInstanceExtensions();
         bool checkDeviceExtensionSupport(VkPhysicalDevice device);
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
+        bool isInstanceExtensionAvailable(const char *extensionName);
+        bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char *extensionName);
+        void queryDescriptorIndexingSupport();
+        void queryPresentWaitSupport();
 
         VkInstance instance;
         VkDebugUtilsMessengerEXT debugMessenger;
         VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
         KnoxicWindow &window;
         VkCommandPool commandPool;
+        VkCommandPool computeCommandPool = VK_NULL_HANDLE;
+        std::unique_ptr<KnoxicAllocator> allocator_;
+        std::unique_ptr<KnoxicPipelineCache> pipelineCache_;
+        std::unique_ptr<KnoxicShaderModuleCache> shaderModules_;
 
         VkDevice device_;
         VkSurfaceKHR surface_;
         VkQueue graphicsQueue_;
         VkQueue presentQueue_;
+        VkQueue computeQueue_ = VK_NULL_HANDLE;
+        VkQueue transferQueue_ = VK_NULL_HANDLE;
+        uint32_t graphicsQueueFamily = 0;
+        uint32_t computeQueueFamily = 0;
+        uint32_t transferQueueFamily = 0;
+        uint32_t sharedQueueFamilies[2]{};
+        std::vector<uint32_t> bufferQueueFamilies; // Every family buffers are used on
+        std::unique_ptr<KnoxicUploadContext> uploadContext_;
+
+        bool physicalDeviceProperties2Enabled = false;
+        bool descriptorIndexingSupported = false;
+        bool presentWaitSupported = false;
+        PFN_vkWaitForPresentKHR waitForPresentKHR = nullptr;
 
         const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
         #ifdef __APPLE__
@@ -0,0 +1,74 @@
+#include "knoxic_vk_frame_allocator.hpp"
+#include "knoxic_vk_swap_chain.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace knoxic {
+
+    static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    KnoxicFrameAllocator::KnoxicFrameAllocator(KnoxicDevice &device, VkDeviceSize frameCapacity) : knoxicDevice{device} {
+        const VkPhysicalDeviceLimits &limits = device.properties.limits;
+        uniformAlignment = std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 1);
+        storageAlignment = std::max<VkDeviceSize>(limits.minStorageBufferOffsetAlignment, 1);
+
+        // Every region starts aligned for any kind of slice
+        this->frameCapacity = alignUp(frameCapacity, std::max(uniformAlignment, storageAlignment));
+
+        buffer = std::make_unique<KnoxicBuffer>(
+            knoxicDevice,
+            this->frameCapacity,
+            static_cast<uint32_t>(KnoxicSwapChain::framesInFlight()),
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+            1,
+            KnoxicAllocationStrategy::Dedicated
+        );
+        buffer->map();
+    }
+
+    void KnoxicFrameAllocator::beginFrame(int frameIndex) {
+        assert(frameIndex >= 0 && frameIndex < KnoxicSwapChain::framesInFlight() && "Frame index out of range");
+        frameBegin = frameCapacity * frameIndex;
+        head = frameBegin;
+        flushed = frameBegin;
+    }
+
+    void KnoxicFrameAllocator::flush() {
+        if (head > flushed) {
+            buffer->flush(head - flushed, flushed);
+            flushed = head;
+        }
+    }
+
+    KnoxicTransientAllocation KnoxicFrameAllocator::allocateUniform(VkDeviceSize size) {
+        return allocate(size, uniformAlignment);
+    }
+
+    KnoxicTransientAllocation KnoxicFrameAllocator::allocateStorage(VkDeviceSize size) {
+        return allocate(size, storageAlignment);
+    }
+
+    KnoxicTransientAllocation KnoxicFrameAllocator::allocateVertex(VkDeviceSize size) {
+        return allocate(size, 16);
+    }
+
+    KnoxicTransientAllocation KnoxicFrameAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+        VkDeviceSize offset = alignUp(head, alignment);
+        if (offset + size > frameBegin + frameCapacity) {
+            throw std::runtime_error("frame allocator is out of space, raise its frame capacity!");
+        }
+        head = offset + size;
+
+        KnoxicTransientAllocation allocation{};
+        allocation.buffer = buffer->getBuffer();
+        allocation.offset = offset;
+        allocation.size = size;
+        allocation.mapped = static_cast<char *>(buffer->getMappedMemory()) + offset;
+        return allocation;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "knoxic_vk_buffer.hpp"
+
+#include <memory>
+
+namespace knoxic {
+
+    // A slice handed out by the frame allocator, valid until its frame slot comes around again
+    struct KnoxicTransientAllocation {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0; // From the start of the buffer, also the dynamic offset of descriptors over it
+        VkDeviceSize size = 0;
+        void *mapped = nullptr;
+
+        uint32_t dynamicOffset() const { return static_cast<uint32_t>(offset); }
+    };
+
+    // Linear allocator for data written once a frame: uniforms, storage arrays, instance data.
+    // One persistently mapped buffer holds a region per frame in flight, and a region starts over when its frame
+    // begins again, after the renderer waited on that frame's fence. Descriptors point at the whole buffer as
+    // UNIFORM_BUFFER_DYNAMIC or STORAGE_BUFFER_DYNAMIC and select their slice with the dynamic offset at bind time
+    class KnoxicFrameAllocator {
+    public:
+        static constexpr VkDeviceSize FRAME_CAPACITY = 4ull * 1024 * 1024;
+
+        explicit KnoxicFrameAllocator(KnoxicDevice &device, VkDeviceSize frameCapacity = FRAME_CAPACITY);
+
+        KnoxicFrameAllocator(const KnoxicFrameAllocator &) = delete;
+        KnoxicFrameAllocator &operator=(const KnoxicFrameAllocator &) = delete;
+
+        void beginFrame(int frameIndex);
+
+        // Makes everything allocated this frame visible to the GPU, before the frame's work is submitted
+        void flush();
+
+        KnoxicTransientAllocation allocateUniform(VkDeviceSize size);
+        KnoxicTransientAllocation allocateStorage(VkDeviceSize size);
+        KnoxicTransientAllocation allocateVertex(VkDeviceSize size);
+
+        // For dynamic descriptors, the range is the size of every slice bound through them
+        VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range) { return buffer->descriptorInfo(range, 0); }
+
+        VkDeviceSize getFrameCapacity() const { return frameCapacity; }
+        VkDeviceSize getFrameUsage() const { return head - frameBegin; }
+
+    private:
+        KnoxicTransientAllocation allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+        KnoxicDevice &knoxicDevice;
+        std::unique_ptr<KnoxicBuffer> buffer;
+        VkDeviceSize frameCapacity;
+        VkDeviceSize uniformAlignment;
+        VkDeviceSize storageAlignment;
+
+        VkDeviceSize frameBegin = 0;
+        VkDeviceSize head = 0;
+        VkDeviceSize flushed = 0; // Start of what flush() hasn't covered yet
+    };
+}
\ No newline at end of file
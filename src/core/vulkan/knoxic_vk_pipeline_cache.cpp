@@ -0,0 +1,181 @@
+#include "knoxic_vk_pipeline_cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace knoxic {
+
+    static constexpr uint32_t CACHE_FILE_MAGIC = 0x4350584b; // "KXPC"
+
+    // Written in front of the driver's data
+    struct KnoxicPipelineCacheFileHeader {
+        uint32_t magic;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+        uint64_t dataHash;
+    };
+
+    // The header the driver puts at the start of its data (VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+    struct KnoxicPipelineCacheDataHeader {
+        uint32_t headerLength;
+        uint32_t headerVersion;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    };
+
+    // FNV-1a, catches truncated and corrupted files that would otherwise reach the driver
+    static uint64_t hashData(const char *data, size_t size) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (size_t i = 0; i < size; i++) {
+            hash ^= static_cast<uint8_t>(data[i]);
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    KnoxicPipelineCache::KnoxicPipelineCache(VkDevice device, const VkPhysicalDeviceProperties &properties)
+        : device{device}, properties{properties} {
+        std::ostringstream name;
+        name << "pipeline_cache_" << std::hex << properties.vendorID << "_" << properties.deviceID << ".bin";
+        path = name.str();
+
+        std::string file = loadFile(path);
+        warm = validate(file);
+
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        if (warm) {
+            cacheInfo.initialDataSize = file.size() - sizeof(KnoxicPipelineCacheFileHeader);
+            cacheInfo.pInitialData = file.data() + sizeof(KnoxicPipelineCacheFileHeader);
+        }
+
+        if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache) != VK_SUCCESS) {
+            // The driver can still refuse data it once wrote, start over without it
+            cacheInfo.initialDataSize = 0;
+            cacheInfo.pInitialData = nullptr;
+            warm = false;
+            if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create pipeline cache!");
+            }
+        }
+
+        std::cout << "pipeline cache: " << (warm ? "warm, " : "cold, ") << path << std::endl;
+    }
+
+    KnoxicPipelineCache::~KnoxicPipelineCache() {
+        try {
+            save();
+        } catch (const std::exception &e) {
+            std::cerr << "failed to save pipeline cache: " << e.what() << std::endl;
+        }
+        vkDestroyPipelineCache(device, cache, nullptr);
+    }
+
+    std::string KnoxicPipelineCache::loadFile(const std::string &filePath) {
+        std::ifstream file{filePath, std::ios::ate | std::ios::binary};
+        if (!file.is_open()) {
+            return {};
+        }
+
+        std::string contents(static_cast<size_t>(file.tellg()), '\0');
+        file.seekg(0);
+        file.read(&contents[0], contents.size());
+        return file ? contents : std::string{};
+    }
+
+    bool KnoxicPipelineCache::validate(const std::string &file) const {
+        if (file.size() < sizeof(KnoxicPipelineCacheFileHeader) + sizeof(KnoxicPipelineCacheDataHeader)) {
+            return false;
+        }
+
+        KnoxicPipelineCacheFileHeader fileHeader;
+        std::memcpy(&fileHeader, file.data(), sizeof(fileHeader));
+        const char *data = file.data() + sizeof(fileHeader);
+        size_t dataSize = file.size() - sizeof(fileHeader);
+
+        if (fileHeader.magic != CACHE_FILE_MAGIC ||
+            fileHeader.vendorID != properties.vendorID ||
+            fileHeader.deviceID != properties.deviceID ||
+            fileHeader.driverVersion != properties.driverVersion ||
+            std::memcmp(fileHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0 ||
+            fileHeader.dataSize != dataSize ||
+            fileHeader.dataHash != hashData(data, dataSize)) {
+            return false;
+        }
+
+        KnoxicPipelineCacheDataHeader dataHeader;
+        std::memcpy(&dataHeader, data, sizeof(dataHeader));
+        return dataHeader.headerLength >= sizeof(dataHeader) &&
+            dataHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+            dataHeader.vendorID == properties.vendorID &&
+            dataHeader.deviceID == properties.deviceID &&
+            std::memcmp(dataHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    void KnoxicPipelineCache::recordCreation(double milliseconds) {
+        std::lock_guard<std::mutex> lock{statsMutex};
+        creationTime += milliseconds;
+        creationCount++;
+    }
+
+    double KnoxicPipelineCache::getCreationTime() {
+        std::lock_guard<std::mutex> lock{statsMutex};
+        return creationTime;
+    }
+
+    uint32_t KnoxicPipelineCache::getCreationCount() {
+        std::lock_guard<std::mutex> lock{statsMutex};
+        return creationCount;
+    }
+
+    void KnoxicPipelineCache::save() {
+        size_t dataSize = 0;
+        if (vkGetPipelineCacheData(device, cache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+            return;
+        }
+
+        std::vector<char> data(sizeof(KnoxicPipelineCacheFileHeader) + dataSize);
+        char *cacheData = data.data() + sizeof(KnoxicPipelineCacheFileHeader);
+        if (vkGetPipelineCacheData(device, cache, &dataSize, cacheData) != VK_SUCCESS) {
+            throw std::runtime_error("failed to get pipeline cache data!");
+        }
+        data.resize(sizeof(KnoxicPipelineCacheFileHeader) + dataSize);
+
+        KnoxicPipelineCacheFileHeader fileHeader{};
+        fileHeader.magic = CACHE_FILE_MAGIC;
+        fileHeader.vendorID = properties.vendorID;
+        fileHeader.deviceID = properties.deviceID;
+        fileHeader.driverVersion = properties.driverVersion;
+        std::memcpy(fileHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+        fileHeader.dataSize = dataSize;
+        fileHeader.dataHash = hashData(cacheData, dataSize);
+        std::memcpy(data.data(), &fileHeader, sizeof(fileHeader));
+
+        // Written next to the old file and swapped in, a crash halfway leaves the previous cache intact
+        std::string tempPath = path + ".tmp";
+        {
+            std::ofstream file{tempPath, std::ios::binary | std::ios::trunc};
+            if (!file.is_open()) {
+                throw std::runtime_error("failed to open file: " + tempPath);
+            }
+            file.write(data.data(), data.size());
+            if (!file) {
+                throw std::runtime_error("failed to write file: " + tempPath);
+            }
+        }
+
+        std::remove(path.c_str());
+        if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("failed to replace file: " + path);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+#include <string>
+
+namespace knoxic {
+
+    // One VkPipelineCache for every pipeline of the device, seeded from disk and written back on destruction.
+    // The file is named after the vendor and device, its header also records the driver version and cache UUID.
+    // Anything that doesn't match (another driver, a truncated or corrupt file) is ignored and the cache starts cold
+    class KnoxicPipelineCache {
+    public:
+        KnoxicPipelineCache(VkDevice device, const VkPhysicalDeviceProperties &properties);
+        ~KnoxicPipelineCache();
+
+        KnoxicPipelineCache(const KnoxicPipelineCache &) = delete;
+        KnoxicPipelineCache &operator=(const KnoxicPipelineCache &) = delete;
+
+        VkPipelineCache getCache() const { return cache; }
+
+        // Seeded from a valid file, pipelines found in it skip compilation
+        bool isWarm() const { return warm; }
+
+        // Time spent in vkCreate*Pipelines, for comparing cold and warm startups. Summed over every compiling thread
+        void recordCreation(double milliseconds);
+        double getCreationTime();
+        uint32_t getCreationCount();
+
+        void save();
+
+    private:
+        static std::string loadFile(const std::string &filePath);
+        bool validate(const std::string &file) const;
+
+        VkDevice device;
+        VkPhysicalDeviceProperties properties;
+        VkPipelineCache cache = VK_NULL_HANDLE;
+        std::string path;
+        bool warm = false;
+
+        double creationTime = 0.0;
+        uint32_t creationCount = 0;
+        std::mutex statsMutex;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "knoxic_vk_shader_module_cache.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+namespace knoxic {
+
+    KnoxicShaderModuleCache::KnoxicShaderModuleCache(VkDevice device) : device{device} {}
+
+    KnoxicShaderModuleCache::~KnoxicShaderModuleCache() {
+        for (auto &[hash, bucket] : entries) {
+            for (auto &entry : bucket) {
+                vkDestroyShaderModule(device, entry.module, nullptr);
+            }
+        }
+    }
+
+    // FNV-1a over the words
+    uint64_t KnoxicShaderModuleCache::hashCode(const uint32_t *code, size_t size) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (size_t i = 0; i < size / sizeof(uint32_t); i++) {
+            hash ^= code[i];
+            hash *= 0x100000001b3ull;
+        }
+        return hash ^ size;
+    }
+
+    VkShaderModule KnoxicShaderModuleCache::acquire(const uint32_t *code, size_t size) {
+        assert(size > 0 && size % sizeof(uint32_t) == 0 && "SPIR-V size has to be a multiple of 4");
+
+        uint64_t hash = hashCode(code, size);
+
+        std::lock_guard<std::mutex> lock{mutex};
+        auto &bucket = entries[hash];
+        for (auto &entry : bucket) {
+            if (entry.size == size && (entry.code == code || std::memcmp(entry.code, code, size) == 0)) {
+                entry.users++;
+                return entry.module;
+            }
+        }
+
+        VkShaderModuleCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        createInfo.codeSize = size;
+        createInfo.pCode = code;
+
+        VkShaderModule module;
+        if (vkCreateShaderModule(device, &createInfo, nullptr, &module) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shader module");
+        }
+
+        bucket.push_back({code, size, module, 1});
+        return module;
+    }
+
+    void KnoxicShaderModuleCache::release(VkShaderModule module) {
+        std::lock_guard<std::mutex> lock{mutex};
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            auto &bucket = it->second;
+            for (size_t i = 0; i < bucket.size(); i++) {
+                if (bucket[i].module != module) {
+                    continue;
+                }
+
+                assert(bucket[i].users > 0 && "Shader module released more often than acquired");
+                if (--bucket[i].users == 0 && !keepUnused) {
+                    vkDestroyShaderModule(device, module, nullptr);
+                    bucket.erase(bucket.begin() + i);
+                    if (bucket.empty()) {
+                        entries.erase(it);
+                    }
+                }
+                return;
+            }
+        }
+        assert(false && "Released a shader module that is not in the cache");
+    }
+
+    void KnoxicShaderModuleCache::setKeepUnused(bool keep) {
+        std::lock_guard<std::mutex> lock{mutex};
+        keepUnused = keep;
+        if (keep) {
+            return;
+        }
+
+        for (auto it = entries.begin(); it != entries.end();) {
+            auto &bucket = it->second;
+            for (size_t i = 0; i < bucket.size();) {
+                if (bucket[i].users == 0) {
+                    vkDestroyShaderModule(device, bucket[i].module, nullptr);
+                    bucket.erase(bucket.begin() + i);
+                } else {
+                    i++;
+                }
+            }
+            it = bucket.empty() ? entries.erase(it) : std::next(it);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace knoxic {
+
+    // Shader modules shared between pipelines, keyed by a hash of their SPIR-V. A module is only needed while
+    // vkCreate*Pipelines runs, so pipelines acquire it right before and release it right after. Thread-safe, the
+    // pipeline manager's workers build concurrently
+    class KnoxicShaderModuleCache {
+    public:
+        explicit KnoxicShaderModuleCache(VkDevice device);
+        ~KnoxicShaderModuleCache();
+
+        KnoxicShaderModuleCache(const KnoxicShaderModuleCache &) = delete;
+        KnoxicShaderModuleCache &operator=(const KnoxicShaderModuleCache &) = delete;
+
+        // The code has to stay alive as long as the cache, it's compared against on hash collisions
+        VkShaderModule acquire(const uint32_t *code, size_t size);
+        void release(VkShaderModule module);
+
+        // While the startup pipelines compile, released modules stay for the next pipeline sharing them.
+        // Turning it off destroys the unused ones, later modules go as soon as their last pipeline is created
+        void setKeepUnused(bool keep);
+
+    private:
+        struct Entry {
+            const uint32_t *code;
+            size_t size;
+            VkShaderModule module;
+            uint32_t users;
+        };
+
+        static uint64_t hashCode(const uint32_t *code, size_t size);
+
+        VkDevice device;
+        std::unordered_map<uint64_t, std::vector<Entry>> entries;
+        bool keepUnused = true;
+        std::mutex mutex;
+    };
+}
\ No newline at end of file
@@ -1,15 +1,22 @@
 #include "knoxic_vk_swap_chain.hpp"
 
+#include <algorithm>
 #include <array>
+#include <cassert>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <limits>
 #include <stdexcept>
 #include <iomanip>
+#include <utility>
 
 namespace knoxic {
 
+    void KnoxicSwapChain::setFramesInFlight(int count) {
+        framesInFlightCount = std::clamp(count, MIN_FRAMES_IN_FLIGHT, MAX_FRAMES_IN_FLIGHT);
+    }
+
     KnoxicSwapChain::KnoxicSwapChain(KnoxicDevice &deviceRef, VkExtent2D extent) : device{deviceRef}, windowExtent{extent} {
         init();
     }
@@ -27,7 +34,13 @@ namespace knoxic {
         createRenderPass();
         createDepthResources();
         createFramebuffers();
-        createSyncObjects();
+
+        // Frames still in flight signal the previous swap chain's fences, so they are handed over instead of recreated
+        if (oldSwapChain != nullptr) {
+            takeSyncObjects(*oldSwapChain);
+        } else {
+            createSyncObjects();
+        }
     }
 
     KnoxicSwapChain::~KnoxicSwapChain() {
@@ -44,7 +57,7 @@ namespace knoxic {
         for (int i = 0; i < depthImages.size(); i++) {
             vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
             vkDestroyImage(device.device(), depthImages[i], nullptr);
-            vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+            device.freeMemory(depthImageAllocations[i]);
         }
 
         for (auto framebuffer : swapChainFramebuffers) {
@@ -52,15 +65,27 @@ namespace knoxic {
         }
 
         vkDestroyRenderPass(device.device(), renderPass, nullptr);
+        vkDestroyRenderPass(device.device(), resumeRenderPass, nullptr);
 
         // Cleanup synchronization objects
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < inFlightFences.size(); i++) {
             vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
             vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
             vkDestroyFence(device.device(), inFlightFences[i], nullptr);
         }
     }
 
+    void KnoxicSwapChain::waitForFrameFence() {
+        vkWaitForFences(device.device(), 1, &inFlightFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+    }
+
+    bool KnoxicSwapChain::waitForLastPresent(uint64_t timeout) {
+        if (!device.supportsPresentWait() || presentCount == 0) {
+            return false;
+        }
+        return device.waitForPresent(swapChain, presentCount, timeout) == VK_SUCCESS;
+    }
+
     VkResult KnoxicSwapChain::acquireNextImage(uint32_t *imageIndex) {
         vkWaitForFences(
             device.device(),
@@ -80,7 +105,8 @@ namespace knoxic {
         return result;
     }
 
-    VkResult KnoxicSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex) {
+    VkResult KnoxicSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex,
+        const std::vector<VkSemaphore> &extraWaitSemaphores, const std::vector<VkPipelineStageFlags> &extraWaitStages) {
         if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
             vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
         }
@@ -89,11 +115,14 @@ namespace knoxic {
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-        VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
+        assert(extraWaitSemaphores.size() == extraWaitStages.size() && "Every wait semaphore needs its stages");
+        std::vector<VkSemaphore> waitSemaphores = {imageAvailableSemaphores[currentFrame]};
+        std::vector<VkPipelineStageFlags> waitStages = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+        waitSemaphores.insert(waitSemaphores.end(), extraWaitSemaphores.begin(), extraWaitSemaphores.end());
+        waitStages.insert(waitStages.end(), extraWaitStages.begin(), extraWaitStages.end());
+        submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+        submitInfo.pWaitSemaphores = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitStages.data();
 
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = buffers;
@@ -120,9 +149,21 @@ namespace knoxic {
 
         presentInfo.pImageIndices = imageIndex;
 
+        uint64_t presentId = presentCount + 1;
+        VkPresentIdKHR presentIdInfo{};
+        presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        presentIdInfo.swapchainCount = 1;
+        presentIdInfo.pPresentIds = &presentId;
+        if (device.supportsPresentWait()) {
+            presentInfo.pNext = &presentIdInfo;
+        }
+
         auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+        if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+            presentCount = presentId;
+        }
 
-        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        currentFrame = (currentFrame + 1) % framesInFlight();
 
         return result;
     }
@@ -134,7 +175,9 @@ namespace knoxic {
         VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
         VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-        uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+        // An image for every frame in flight, or the third frame would only wait on acquire instead of recording
+        uint32_t imageCount = std::max(swapChainSupport.capabilities.minImageCount + 1,
+            static_cast<uint32_t>(framesInFlight()));
         if (swapChainSupport.capabilities.maxImageCount > 0 &&
             imageCount > swapChainSupport.capabilities.maxImageCount) {
             imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -261,6 +304,18 @@ namespace knoxic {
         if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
             throw std::runtime_error("failed to create render pass!");
         }
+
+        // Resume pass: draws on top of what an earlier pass left in the image (UI after a merged composite)
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        attachments = {colorAttachment, depthAttachment};
+
+        dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependency.dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+
+        if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &resumeRenderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create resume render pass!");
+        }
     }
 
     void KnoxicSwapChain::createFramebuffers() {
@@ -294,7 +349,7 @@ namespace knoxic {
         VkExtent2D swapChainExtent = getSwapChainExtent();
 
         depthImages.resize(imageCount());
-        depthImageMemorys.resize(imageCount());
+        depthImageAllocations.resize(imageCount());
         depthImageViews.resize(imageCount());
 
         for (int i = 0; i < depthImages.size(); i++) {
@@ -309,7 +364,7 @@ namespace knoxic {
             imageInfo.format = depthFormat;
             imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
             imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT; // Never leaves the pass
             imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
             imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
             imageInfo.flags = 0;
@@ -318,7 +373,8 @@ namespace knoxic {
                 imageInfo,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                 depthImages[i],
-                depthImageMemorys[i]
+                depthImageAllocations[i],
+                KnoxicAllocationStrategy::Dedicated
             );
 
             VkImageViewCreateInfo viewInfo{};
@@ -339,9 +395,9 @@ namespace knoxic {
     }
 
     void KnoxicSwapChain::createSyncObjects() {
-        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+        imageAvailableSemaphores.resize(framesInFlight());
+        renderFinishedSemaphores.resize(framesInFlight());
+        inFlightFences.resize(framesInFlight());
         imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
 
         VkSemaphoreCreateInfo semaphoreInfo = {};
@@ -351,7 +407,7 @@ namespace knoxic {
         fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
         fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < framesInFlight(); i++) {
             if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
                     VK_SUCCESS ||
                 vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) !=
@@ -362,6 +418,20 @@ namespace knoxic {
         }
     }
 
+    void KnoxicSwapChain::takeSyncObjects(KnoxicSwapChain &previous) {
+        imageAvailableSemaphores = std::move(previous.imageAvailableSemaphores);
+        renderFinishedSemaphores = std::move(previous.renderFinishedSemaphores);
+        inFlightFences = std::move(previous.inFlightFences);
+        currentFrame = previous.currentFrame;
+
+        previous.imageAvailableSemaphores.clear();
+        previous.renderFinishedSemaphores.clear();
+        previous.inFlightFences.clear();
+
+        // The images are new, none of them is in flight yet
+        imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+    }
+
     VkSurfaceFormatKHR KnoxicSwapChain::chooseSwapSurfaceFormat(
         const std::vector<VkSurfaceFormatKHR> &availableFormats) {
         for (const auto &availableFormat : availableFormats) {
@@ -11,7 +11,13 @@ namespace knoxic {
 
     class KnoxicSwapChain {
     public:
-        static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+        static constexpr int MIN_FRAMES_IN_FLIGHT = 2;
+        static constexpr int MAX_FRAMES_IN_FLIGHT = 3;
+
+        // Frames the CPU records ahead of the GPU. A third one keeps the GPU busier at the cost of a frame of latency.
+        // Per-frame resources are sized from it, so it's set once before the renderer and systems are created
+        static void setFramesInFlight(int count);
+        static int framesInFlight() { return framesInFlightCount; }
 
         KnoxicSwapChain(KnoxicDevice &deviceRef, VkExtent2D windowExtent);
         KnoxicSwapChain(KnoxicDevice &deviceRef, VkExtent2D windowExtent, std::shared_ptr<KnoxicSwapChain> previous);
@@ -22,6 +28,7 @@ namespace knoxic {
 
         VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
         VkRenderPass getRenderPass() { return renderPass; }
+        VkRenderPass getResumeRenderPass() { return resumeRenderPass; }
         VkImageView getImageView(int index) { return swapChainImageViews[index]; }
         size_t imageCount() { return swapChainImages.size(); }
         VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
@@ -35,13 +42,24 @@ namespace knoxic {
         VkFormat findDepthFormat();
 
         VkResult acquireNextImage(uint32_t *imageIndex);
-        VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
+
+        // Blocks until the frame slot the next acquire uses is free, acquire then doesn't wait anymore
+        void waitForFrameFence();
+
+        // Blocks until the last presented image is on screen. False without present wait, before the first present
+        // or on timeout
+        bool waitForLastPresent(uint64_t timeout);
+        // Extra waits are for work submitted earlier in the frame, on this or another queue
+        VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex,
+            const std::vector<VkSemaphore> &extraWaitSemaphores = {}, const std::vector<VkPipelineStageFlags> &extraWaitStages = {});
 
         bool compareSwapFormats(const KnoxicSwapChain &swapChain) const {
             return swapChain.swapChainDepthFormat == swapChainImageFormat && swapChain.swapChainImageFormat == swapChainImageFormat;
         }
 
     private:
+        static inline int framesInFlightCount = MIN_FRAMES_IN_FLIGHT;
+
         void init();
         void createSwapChain();
         void createImageViews();
@@ -49,6 +67,7 @@ namespace knoxic {
         void createRenderPass();
         void createFramebuffers();
         void createSyncObjects();
+        void takeSyncObjects(KnoxicSwapChain &previous);
 
         // Helper functions
         VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR> &availableFormats);
@@ -61,9 +80,10 @@ namespace knoxic {
 
         std::vector<VkFramebuffer> swapChainFramebuffers;
         VkRenderPass renderPass;
+        VkRenderPass resumeRenderPass;
 
         std::vector<VkImage> depthImages;
-        std::vector<VkDeviceMemory> depthImageMemorys;
+        std::vector<KnoxicAllocation> depthImageAllocations;
         std::vector<VkImageView> depthImageViews;
         std::vector<VkImage> swapChainImages;
         std::vector<VkImageView> swapChainImageViews;
@@ -79,5 +99,6 @@ namespace knoxic {
         std::vector<VkFence> inFlightFences;
         std::vector<VkFence> imagesInFlight;
         size_t currentFrame = 0;
+        uint64_t presentCount = 0; // Present ids are per swap chain and start at one
     };
 }
\ No newline at end of file
@@ -0,0 +1,322 @@
+#include "knoxic_vk_upload_context.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace knoxic {
+
+    // Keeps every staged region valid as a buffer to image copy source
+    static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+    KnoxicUploadContext::KnoxicUploadContext(KnoxicDevice &device) : knoxicDevice{device} {
+        separateQueue = knoxicDevice.hasTransferQueue();
+        uploadQueue = separateQueue ? knoxicDevice.transferQueue() : knoxicDevice.graphicsQueue();
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = separateQueue ? knoxicDevice.getTransferQueueFamily() : knoxicDevice.getGraphicsQueueFamily();
+
+        if (vkCreateCommandPool(knoxicDevice.device(), &poolInfo, nullptr, &uploadCommandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upload command pool!");
+        }
+
+        if (separateQueue) {
+            poolInfo.queueFamilyIndex = knoxicDevice.getGraphicsQueueFamily();
+            if (vkCreateCommandPool(knoxicDevice.device(), &poolInfo, nullptr, &graphicsCommandPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create upload command pool!");
+            }
+        }
+
+        knoxicDevice.createBuffer(STAGING_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            ringBuffer, ringAllocation, KnoxicAllocationStrategy::Dedicated);
+    }
+
+    KnoxicUploadContext::~KnoxicUploadContext() {
+        flush();
+
+        for (auto &batch : freeBatches) {
+            vkDestroyFence(knoxicDevice.device(), batch->fence, nullptr);
+            if (batch->semaphore != VK_NULL_HANDLE) {
+                vkDestroySemaphore(knoxicDevice.device(), batch->semaphore, nullptr);
+            }
+        }
+        vkDestroyCommandPool(knoxicDevice.device(), uploadCommandPool, nullptr);
+        if (graphicsCommandPool != VK_NULL_HANDLE) {
+            vkDestroyCommandPool(knoxicDevice.device(), graphicsCommandPool, nullptr);
+        }
+
+        vkDestroyBuffer(knoxicDevice.device(), ringBuffer, nullptr);
+        knoxicDevice.freeMemory(ringAllocation);
+    }
+
+    KnoxicUploadContext::Batch &KnoxicUploadContext::openBatch() {
+        if (open) {
+            return *open;
+        }
+
+        retireCompleted();
+        if (!freeBatches.empty()) {
+            open = std::move(freeBatches.back());
+            freeBatches.pop_back();
+        } else {
+            open = std::make_unique<Batch>();
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool = uploadCommandPool;
+            allocInfo.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(knoxicDevice.device(), &allocInfo, &open->transferCommandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate upload command buffer!");
+            }
+
+            if (separateQueue) {
+                allocInfo.commandPool = graphicsCommandPool;
+                if (vkAllocateCommandBuffers(knoxicDevice.device(), &allocInfo, &open->graphicsCommandBuffer) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to allocate upload command buffer!");
+                }
+
+                VkSemaphoreCreateInfo semaphoreInfo{};
+                semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+                if (vkCreateSemaphore(knoxicDevice.device(), &semaphoreInfo, nullptr, &open->semaphore) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create upload semaphore!");
+                }
+            }
+
+            VkFenceCreateInfo fenceInfo{};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            if (vkCreateFence(knoxicDevice.device(), &fenceInfo, nullptr, &open->fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create upload fence!");
+            }
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(open->transferCommandBuffer, &beginInfo);
+        if (separateQueue) {
+            vkBeginCommandBuffer(open->graphicsCommandBuffer, &beginInfo);
+        }
+
+        open->ticket = nextTicket++;
+        return *open;
+    }
+
+    VkBuffer KnoxicUploadContext::stage(const void *data, VkDeviceSize size, VkDeviceSize &offset) {
+        // Too large for the ring, gets its own staging buffer until the batch completes
+        if (size > STAGING_RING_SIZE / 2) {
+            OverflowBuffer overflow;
+            knoxicDevice.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                overflow.buffer, overflow.allocation, KnoxicAllocationStrategy::Linear);
+            std::memcpy(overflow.allocation.mapped, data, static_cast<size_t>(size));
+
+            openBatch().overflowBuffers.push_back(overflow);
+            offset = 0;
+            return overflow.buffer;
+        }
+
+        while (true) {
+            // A region never wraps, the rest of the ring is skipped instead
+            uint64_t start = (ringHead + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+            VkDeviceSize position = start % STAGING_RING_SIZE;
+            if (position + size > STAGING_RING_SIZE) {
+                start += STAGING_RING_SIZE - position;
+                position = 0;
+            }
+
+            if (start + size - ringTail <= STAGING_RING_SIZE) {
+                ringHead = start + size;
+                std::memcpy(static_cast<char *>(ringAllocation.mapped) + position, data, static_cast<size_t>(size));
+                offset = position;
+                return ringBuffer;
+            }
+
+            // Full, the oldest batch has to finish first. With none in flight the open one holds all of it
+            if (inFlight.empty()) {
+                assert(open && "Staging ring is full without any batch using it");
+                submit();
+            }
+            retireOldest();
+        }
+    }
+
+    uint64_t KnoxicUploadContext::finishUpload(VkDeviceSize size) {
+        open->stagedBytes += size;
+        uint64_t ticket = open->ticket;
+        if (open->stagedBytes >= BATCH_SIZE) {
+            submit();
+        }
+        return ticket;
+    }
+
+    uint64_t KnoxicUploadContext::uploadBuffer(VkBuffer buffer, const void *data, VkDeviceSize size, VkDeviceSize offset) {
+        // Staging may submit the open batch, so it is only looked up afterwards
+        VkDeviceSize stagingOffset = 0;
+        VkBuffer stagingBuffer = stage(data, size, stagingOffset);
+        Batch &batch = openBatch();
+
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = stagingOffset;
+        copyRegion.dstOffset = offset;
+        copyRegion.size = size;
+        vkCmdCopyBuffer(batch.transferCommandBuffer, stagingBuffer, buffer, 1, &copyRegion);
+
+        return finishUpload(size);
+    }
+
+    uint64_t KnoxicUploadContext::uploadImage(VkImage image, const void *pixels, VkDeviceSize size,
+        uint32_t width, uint32_t height, uint32_t layerCount) {
+        VkDeviceSize stagingOffset = 0;
+        VkBuffer stagingBuffer = stage(pixels, size, stagingOffset);
+        Batch &batch = openBatch();
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, layerCount};
+
+        vkCmdPipelineBarrier(batch.transferCommandBuffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = stagingOffset;
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, layerCount};
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {width, height, 1};
+        vkCmdCopyBufferToImage(batch.transferCommandBuffer, stagingBuffer, image,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        if (separateQueue) {
+            // Released here, the graphics queue acquires it at the end of the batch
+            barrier.srcQueueFamilyIndex = knoxicDevice.getTransferQueueFamily();
+            barrier.dstQueueFamilyIndex = knoxicDevice.getGraphicsQueueFamily();
+            barrier.dstAccessMask = 0;
+            vkCmdPipelineBarrier(batch.transferCommandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        }
+        batch.imageBarriers.push_back(barrier);
+
+        return finishUpload(size);
+    }
+
+    uint64_t KnoxicUploadContext::submit() {
+        if (!open) {
+            return nextTicket - 1;
+        }
+
+        std::unique_ptr<Batch> batch = std::move(open);
+        batch->ringEnd = ringHead;
+        uint64_t ticket = batch->ticket;
+
+        // Everything the batch wrote is made visible to the graphics queue, later frames read it after this barrier.
+        // With a transfer queue it is recorded after the semaphore wait and acquires the images
+        VkCommandBuffer lastCommandBuffer = separateQueue ? batch->graphicsCommandBuffer : batch->transferCommandBuffer;
+        VkMemoryBarrier memoryBarrier{};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = separateQueue ? 0 : VK_ACCESS_TRANSFER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+            VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(lastCommandBuffer,
+            separateQueue ? VK_PIPELINE_STAGE_ALL_COMMANDS_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &memoryBarrier, 0, nullptr,
+            static_cast<uint32_t>(batch->imageBarriers.size()), batch->imageBarriers.data());
+
+        vkEndCommandBuffer(batch->transferCommandBuffer);
+        if (separateQueue) {
+            vkEndCommandBuffer(batch->graphicsCommandBuffer);
+        }
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch->transferCommandBuffer;
+        if (separateQueue) {
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &batch->semaphore;
+        }
+        if (vkQueueSubmit(uploadQueue, 1, &submitInfo, separateQueue ? VK_NULL_HANDLE : batch->fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit upload command buffer!");
+        }
+
+        if (separateQueue) {
+            VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+            VkSubmitInfo acquireInfo{};
+            acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            acquireInfo.waitSemaphoreCount = 1;
+            acquireInfo.pWaitSemaphores = &batch->semaphore;
+            acquireInfo.pWaitDstStageMask = &waitStage;
+            acquireInfo.commandBufferCount = 1;
+            acquireInfo.pCommandBuffers = &batch->graphicsCommandBuffer;
+            if (vkQueueSubmit(knoxicDevice.graphicsQueue(), 1, &acquireInfo, batch->fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit upload command buffer!");
+            }
+        }
+
+        inFlight.push_back(std::move(batch));
+        return ticket;
+    }
+
+    bool KnoxicUploadContext::isComplete(uint64_t ticket) {
+        retireCompleted();
+        return ticket <= completedTicket;
+    }
+
+    void KnoxicUploadContext::wait(uint64_t ticket) {
+        if (open && ticket >= open->ticket) {
+            submit();
+        }
+        while (completedTicket < ticket && !inFlight.empty()) {
+            retireOldest();
+        }
+    }
+
+    void KnoxicUploadContext::retireCompleted() {
+        while (!inFlight.empty() && vkGetFenceStatus(knoxicDevice.device(), inFlight.front()->fence) == VK_SUCCESS) {
+            recycle(std::move(inFlight.front()));
+            inFlight.pop_front();
+        }
+    }
+
+    void KnoxicUploadContext::retireOldest() {
+        vkWaitForFences(knoxicDevice.device(), 1, &inFlight.front()->fence, VK_TRUE, UINT64_MAX);
+        recycle(std::move(inFlight.front()));
+        inFlight.pop_front();
+    }
+
+    void KnoxicUploadContext::recycle(std::unique_ptr<Batch> batch) {
+        for (auto &overflow : batch->overflowBuffers) {
+            vkDestroyBuffer(knoxicDevice.device(), overflow.buffer, nullptr);
+            knoxicDevice.freeMemory(overflow.allocation);
+        }
+        batch->overflowBuffers.clear();
+        batch->imageBarriers.clear();
+        batch->stagedBytes = 0;
+
+        vkResetFences(knoxicDevice.device(), 1, &batch->fence);
+        ringTail = batch->ringEnd;
+        completedTicket = batch->ticket;
+        freeBatches.push_back(std::move(batch));
+    }
+}
\ No newline at end of file
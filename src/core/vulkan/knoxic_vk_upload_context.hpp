@@ -0,0 +1,87 @@
+#pragma once
+
+#include "knoxic_vk_device.hpp"
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace knoxic {
+
+    // Batched uploads through one persistently mapped staging ring.
+    // Copies are recorded into the open batch and submitted together, on the transfer-only queue where the device
+    // has one, images are then handed over to the graphics queue. Every upload returns the ticket of its batch, which
+    // can be polled or waited on. A batch also goes out by itself once it staged BATCH_SIZE bytes, so the CPU decodes
+    // the next assets while the previous ones are copied. Meant for the thread that submits the frames
+    class KnoxicUploadContext {
+    public:
+        static constexpr VkDeviceSize STAGING_RING_SIZE = 64ull * 1024 * 1024;
+        static constexpr VkDeviceSize BATCH_SIZE = 16ull * 1024 * 1024;
+
+        explicit KnoxicUploadContext(KnoxicDevice &device);
+        ~KnoxicUploadContext();
+
+        KnoxicUploadContext(const KnoxicUploadContext &) = delete;
+        KnoxicUploadContext &operator=(const KnoxicUploadContext &) = delete;
+
+        // The buffer needs TRANSFER_DST usage
+        uint64_t uploadBuffer(VkBuffer buffer, const void *data, VkDeviceSize size, VkDeviceSize offset = 0);
+
+        // Fills the first mip and leaves it in SHADER_READ_ONLY_OPTIMAL for the fragment shaders
+        uint64_t uploadImage(VkImage image, const void *pixels, VkDeviceSize size,
+            uint32_t width, uint32_t height, uint32_t layerCount = 1);
+
+        // Sends the open batch off, returns the ticket of the last batch. Graphics work submitted afterwards
+        // sees the uploads without waiting on the CPU
+        uint64_t submit();
+
+        bool isComplete(uint64_t ticket);
+        void wait(uint64_t ticket);
+
+        // Submits and waits for everything uploaded so far
+        void flush() { wait(submit()); }
+
+    private:
+        struct OverflowBuffer {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            KnoxicAllocation allocation{};
+        };
+
+        struct Batch {
+            VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+            VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE; // Waits for the transfer queue and acquires the images
+            VkSemaphore semaphore = VK_NULL_HANDLE;
+            VkFence fence = VK_NULL_HANDLE;
+            uint64_t ticket = 0;
+            uint64_t ringEnd = 0;
+            VkDeviceSize stagedBytes = 0;
+            std::vector<VkImageMemoryBarrier> imageBarriers; // Recorded into the final barrier at submit
+            std::vector<OverflowBuffer> overflowBuffers; // Uploads larger than half the ring
+        };
+
+        Batch &openBatch();
+        VkBuffer stage(const void *data, VkDeviceSize size, VkDeviceSize &offset);
+        uint64_t finishUpload(VkDeviceSize size);
+        void retireCompleted();
+        void retireOldest();
+        void recycle(std::unique_ptr<Batch> batch);
+
+        KnoxicDevice &knoxicDevice;
+        bool separateQueue = false;
+        VkQueue uploadQueue = VK_NULL_HANDLE;
+        VkCommandPool uploadCommandPool = VK_NULL_HANDLE;
+        VkCommandPool graphicsCommandPool = VK_NULL_HANDLE;
+
+        // Positions grow forever, the ring offset is the position modulo its size
+        VkBuffer ringBuffer = VK_NULL_HANDLE;
+        KnoxicAllocation ringAllocation{};
+        uint64_t ringHead = 0;
+        uint64_t ringTail = 0;
+
+        std::unique_ptr<Batch> open;
+        std::deque<std::unique_ptr<Batch>> inFlight;
+        std::vector<std::unique_ptr<Batch>> freeBatches;
+        uint64_t nextTicket = 1;
+        uint64_t completedTicket = 0;
+    };
+}
\ No newline at end of file
@@ -3,18 +3,27 @@
 #include "../camera/knoxic_camera.hpp"
 
 #include <vulkan/vulkan.h>
+#include <array>
+#include <vector>
 
 namespace knoxic {
 
-    #define MAX_LIGHTS 1000
+    // Chosen once at startup
+    enum class RenderPath {
+        Forward, // Clustered forward lighting in the material shaders
+        Deferred // G-buffer pass followed by full-screen and light volume lighting subpasses
+    };
+
+    // Light contribution below this is treated as zero when deriving a range
+    #define LIGHT_ATTENUATION_CUTOFF 0.01f
 
     struct PointLight {
-        glm::vec4 position{}; // ignore w
+        glm::vec4 position{}; // w is range
         glm::vec4 color{}; // w is intensity
     };
 
     struct SpotLight {
-        glm::vec4 position{}; // ignore w
+        glm::vec4 position{}; // w is range
         glm::vec4 direction{}; // ignore w
         glm::vec4 color{}; // w is intensity
         float innerCutoff{}; // cos of inner angle
@@ -28,25 +37,70 @@ namespace knoxic {
         glm::vec4 color{}; // w is intensity
     };
 
+    // One tile of the shadow atlas as seen by the lighting shaders
+    struct ShadowView {
+        glm::mat4 viewProjection{1.0f}; // The matrix the tile was last rendered with
+        glm::vec4 atlasRect{0.0f}; // uv offset xy, uv scale zw, zero scale until first rendered
+        glm::vec4 params{0.0f}; // x is the far view depth of a cascade
+    };
+
     struct GlobalUbo {
         glm::mat4 projection{1.0f};
         glm::mat4 view{1.0f};
         glm::mat4 inverseView{1.0f};
         glm::vec4 ambientLightColor{1.0f, 1.0f, 1.0f, 0.02f}; // w is intensity
-        PointLight pointLights[MAX_LIGHTS];
         int numLights;
         int numSpotLights;
         int numDirectionalLights;
         int padding;
-        SpotLight spotLights[MAX_LIGHTS];
-        DirectionalLight directionalLights[MAX_LIGHTS];
+        glm::uvec4 clusterGrid{0}; // tiles x, tiles y, depth slices, max lights per cluster
+        glm::vec4 clusterDepth{0.0f}; // near, far, slice scale, slice bias
+        glm::vec4 clusterScreen{0.0f}; // width, height, 1 / width, 1 / height
+        glm::mat4 viewProjection{1.0f}; // Without jitter, for motion vectors
+        glm::mat4 previousViewProjection{1.0f};
+    };
+
+    // Per-instance billboard of a light gizmo, the rest is read from the light storage buffer
+    struct LightGizmoInstance {
+        glm::vec4 position{}; // w is billboard radius
+        uint32_t lightIndex{0};
+
+        static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+        static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
     };
 
+    // Lights gathered each frame, uploaded to the global set light storage buffers
+    struct SceneLights {
+        std::vector<PointLight> pointLights;
+        std::vector<SpotLight> spotLights;
+        std::vector<DirectionalLight> directionalLights;
+
+        // Gizmo instances, sorted back to front on upload
+        std::vector<LightGizmoInstance> pointGizmos;
+        std::vector<LightGizmoInstance> spotGizmos;
+        std::vector<LightGizmoInstance> directionalGizmos;
+    };
+
+    // Distance at which a light of this color and intensity falls below the attenuation cutoff
+    inline float computeLightRange(const glm::vec3 &color, float intensity, float range) {
+        if (range > 0.0f) {
+            return range;
+        }
+
+        float brightest = glm::max(color.r, glm::max(color.g, color.b)) * intensity;
+        return glm::sqrt(glm::max(brightest, 0.0f) / LIGHT_ATTENUATION_CUTOFF);
+    }
+
+    // The global set's dynamic bindings in binding order: 0 is the GlobalUbo, 3 to 5 the light arrays.
+    // They all live in the frame allocator
+    static constexpr uint32_t GLOBAL_DYNAMIC_OFFSET_COUNT = 4;
+
     struct FrameInfo {
         int frameIndex;
         float frameTime;
         VkCommandBuffer commandBuffer;
         KnoxicCamera &camera;
         VkDescriptorSet globalDescriptorSet;
+        std::array<uint32_t, GLOBAL_DYNAMIC_OFFSET_COUNT> globalDynamicOffsets{}; // Passed whenever the global set is bound
     };
 }
\ No newline at end of file
@@ -0,0 +1,13 @@
+#include "knoxic_vk_embedded_shaders.hpp"
+
+namespace knoxic {
+
+    const KnoxicEmbeddedShader *findEmbeddedShader(const std::string &path) {
+        for (size_t i = 0; i < EMBEDDED_SHADER_COUNT; i++) {
+            if (path == EMBEDDED_SHADERS[i].path) {
+                return &EMBEDDED_SHADERS[i];
+            }
+        }
+        return nullptr;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace knoxic {
+
+    // SPIR-V compiled into the executable by the shaders target
+    struct KnoxicEmbeddedShader {
+        const char *path; // Where the .spv used to be read from, "shaders/<source>.spv"
+        const uint32_t *code;
+        size_t size; // In bytes
+    };
+
+    // Defined in the generated knoxic_embedded_shaders.cpp, one entry per source in shaders/vulkan
+    extern const KnoxicEmbeddedShader EMBEDDED_SHADERS[];
+    extern const size_t EMBEDDED_SHADER_COUNT;
+
+    // Null when no shader was compiled from that path
+    const KnoxicEmbeddedShader *findEmbeddedShader(const std::string &path);
+}
\ No newline at end of file
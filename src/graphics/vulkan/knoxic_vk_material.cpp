@@ -1,4 +1,5 @@
 #include "knoxic_vk_material.hpp"
+#include "../../core/vulkan/knoxic_vk_upload_context.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -25,7 +26,7 @@ namespace knoxic {
         }
         if (albedoTextureImage != VK_NULL_HANDLE) {
             vkDestroyImage(knoxicDevice.device(), albedoTextureImage, nullptr);
-            vkFreeMemory(knoxicDevice.device(), albedoTextureImageMemory, nullptr);
+            knoxicDevice.freeMemory(albedoTextureImageAllocation);
         }
 
         // Clean up normal texture
@@ -37,7 +38,7 @@ namespace knoxic {
         }
         if (normalTextureImage != VK_NULL_HANDLE) {
             vkDestroyImage(knoxicDevice.device(), normalTextureImage, nullptr);
-            vkFreeMemory(knoxicDevice.device(), normalTextureImageMemory, nullptr);
+            knoxicDevice.freeMemory(normalTextureImageAllocation);
         }
 
         // Clean up roughness texture
@@ -49,7 +50,7 @@ namespace knoxic {
         }
         if (roughnessTextureImage != VK_NULL_HANDLE) {
             vkDestroyImage(knoxicDevice.device(), roughnessTextureImage, nullptr);
-            vkFreeMemory(knoxicDevice.device(), roughnessTextureImageMemory, nullptr);
+            knoxicDevice.freeMemory(roughnessTextureImageAllocation);
         }
 
         // Clean up metallic texture
@@ -61,7 +62,7 @@ namespace knoxic {
         }
         if (metallicTextureImage != VK_NULL_HANDLE) {
             vkDestroyImage(knoxicDevice.device(), metallicTextureImage, nullptr);
-            vkFreeMemory(knoxicDevice.device(), metallicTextureImageMemory, nullptr);
+            knoxicDevice.freeMemory(metallicTextureImageAllocation);
         }
 
         // Clean up default texture
@@ -73,7 +74,7 @@ namespace knoxic {
         }
         if (defaultTextureImage != VK_NULL_HANDLE) {
             vkDestroyImage(knoxicDevice.device(), defaultTextureImage, nullptr);
-            vkFreeMemory(knoxicDevice.device(), defaultTextureImageMemory, nullptr);
+            knoxicDevice.freeMemory(defaultTextureImageAllocation);
         }
     }
 
@@ -86,18 +87,6 @@ namespace knoxic {
 
         VkDeviceSize imageSize = texWidth * texHeight * texChannels;
 
-        // Create staging buffer
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        knoxicDevice.createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            stagingBuffer, stagingBufferMemory);
-
-        void* data;
-        vkMapMemory(knoxicDevice.device(), stagingBufferMemory, 0, imageSize, 0, &data);
-        memcpy(data, pixels, static_cast<size_t>(imageSize));
-        vkUnmapMemory(knoxicDevice.device(), stagingBufferMemory);
-
         // Create image
         VkImageCreateInfo imageInfo{};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -115,18 +104,10 @@ namespace knoxic {
         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
         knoxicDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            defaultTextureImage, defaultTextureImageMemory);
-
-        // Transition image layout and copy buffer to image
-        knoxicDevice.transitionImageLayout(defaultTextureImage, VK_FORMAT_R8G8B8A8_SRGB,
-            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        knoxicDevice.copyBufferToImage(stagingBuffer, defaultTextureImage, texWidth, texHeight);
-        knoxicDevice.transitionImageLayout(defaultTextureImage, VK_FORMAT_R8G8B8A8_SRGB,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+            defaultTextureImage, defaultTextureImageAllocation);
 
-        // Clean up staging buffer
-        vkDestroyBuffer(knoxicDevice.device(), stagingBuffer, nullptr);
-        vkFreeMemory(knoxicDevice.device(), stagingBufferMemory, nullptr);
+        // Staged and copied with the next upload batch
+        knoxicDevice.uploadContext().uploadImage(defaultTextureImage, pixels, imageSize, texWidth, texHeight);
 
         // Create image view
         createTextureImageView(defaultTextureImage, defaultTextureImageView);
@@ -137,10 +118,11 @@ namespace knoxic {
 
     void KnoxicMaterial::loadAlbedoTexture(const std::string& filepath) {
         try {
-            createTextureImage(filepath, albedoTextureImage, albedoTextureImageMemory);
+            createTextureImage(filepath, albedoTextureImage, albedoTextureImageAllocation);
             createTextureImageView(albedoTextureImage, albedoTextureImageView);
             createTextureSampler(albedoTextureSampler);
             hasAlbedoTexture = true;
+            textureVersion++;
             // std::cout << filepath << std::endl; // print file path
         } catch (const std::exception& e) {
             std::cerr << "Failed to load albedo texture: " << e.what() << std::endl;
@@ -156,10 +138,11 @@ namespace knoxic {
 
     void KnoxicMaterial::loadNormalTexture(const std::string& filepath) {
         try {
-            createTextureImage(filepath, normalTextureImage, normalTextureImageMemory);
+            createTextureImage(filepath, normalTextureImage, normalTextureImageAllocation);
             createTextureImageView(normalTextureImage, normalTextureImageView);
             createTextureSampler(normalTextureSampler);
             hasNormalTexture = true;
+            textureVersion++;
             // std::cout << filepath << std::endl; // print file path
         } catch (const std::exception& e) {
             std::cerr << "Failed to load normal texture: " << e.what() << std::endl;
@@ -169,10 +152,11 @@ namespace knoxic {
 
     void KnoxicMaterial::loadRoughnessMap(const std::string& filepath) {
         try {
-            createTextureImage(filepath, roughnessTextureImage, roughnessTextureImageMemory);
+            createTextureImage(filepath, roughnessTextureImage, roughnessTextureImageAllocation);
             createTextureImageView(roughnessTextureImage, roughnessTextureImageView);
             createTextureSampler(roughnessTextureSampler);
             hasRoughnessTexture = true;
+            textureVersion++;
             // std::cout << filepath << std::endl; // print file path
         } catch (const std::exception& e) {
             std::cerr << "Failed to load roughness texture: " << e.what() << std::endl;
@@ -182,10 +166,11 @@ namespace knoxic {
 
     void KnoxicMaterial::loadMetallicMap(const std::string& filepath) {
         try {
-            createTextureImage(filepath, metallicTextureImage, metallicTextureImageMemory);
+            createTextureImage(filepath, metallicTextureImage, metallicTextureImageAllocation);
             createTextureImageView(metallicTextureImage, metallicTextureImageView);
             createTextureSampler(metallicTextureSampler);
             hasMetallicTexture = true;
+            textureVersion++;
             // std::cout << filepath << std::endl; // print file path
         } catch (const std::exception& e) {
             std::cerr << "Failed to load metallic texture: " << e.what() << std::endl;
@@ -193,7 +178,7 @@ namespace knoxic {
         }
     }
 
-    void KnoxicMaterial::createTextureImage(const std::string& filepath, VkImage& image, VkDeviceMemory& imageMemory) {
+    void KnoxicMaterial::createTextureImage(const std::string& filepath, VkImage& image, KnoxicAllocation& imageAllocation) {
         std::string fullPath = ENGINE_DIR + filepath;
         
         int texWidth, texHeight, texChannels;
@@ -204,20 +189,6 @@ namespace knoxic {
             throw std::runtime_error("Failed to load texture image: " + fullPath + " - " + stbi_failure_reason());
         }
 
-        // Create staging buffer
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        knoxicDevice.createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            stagingBuffer, stagingBufferMemory);
-
-        void* data;
-        vkMapMemory(knoxicDevice.device(), stagingBufferMemory, 0, imageSize, 0, &data);
-        memcpy(data, pixels, static_cast<size_t>(imageSize));
-        vkUnmapMemory(knoxicDevice.device(), stagingBufferMemory);
-
-        stbi_image_free(pixels);
-
         // Create image
         VkImageCreateInfo imageInfo{};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -234,18 +205,12 @@ namespace knoxic {
         imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-        knoxicDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
-
-        // Transition image layout and copy buffer to image
-        knoxicDevice.transitionImageLayout(image, VK_FORMAT_R8G8B8A8_SRGB,
-            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        knoxicDevice.copyBufferToImage(stagingBuffer, image, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-        knoxicDevice.transitionImageLayout(image, VK_FORMAT_R8G8B8A8_SRGB,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        knoxicDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageAllocation);
 
-        // Clean up staging buffer
-        vkDestroyBuffer(knoxicDevice.device(), stagingBuffer, nullptr);
-        vkFreeMemory(knoxicDevice.device(), stagingBufferMemory, nullptr);
+        // The pixels are staged right away, the copy goes out with the next upload batch
+        knoxicDevice.uploadContext().uploadImage(image, pixels, imageSize,
+            static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+        stbi_image_free(pixels);
     }
 
     void KnoxicMaterial::createTextureImageView(VkImage image, VkImageView& imageView) {
@@ -289,6 +254,60 @@ namespace knoxic {
         }
     }
 
+    uint32_t KnoxicMaterial::getFeatureMask() const {
+        uint32_t features = 0;
+        if (hasAlbedoTexture) features |= MATERIAL_FEATURE_ALBEDO_MAP;
+        if (hasNormalTexture) features |= MATERIAL_FEATURE_NORMAL_MAP;
+        if (hasRoughnessTexture) features |= MATERIAL_FEATURE_ROUGHNESS_MAP;
+        if (hasMetallicTexture) features |= MATERIAL_FEATURE_METALLIC_MAP;
+        if (properties.unlit) features |= MATERIAL_FEATURE_UNLIT;
+
+        // Black, untextured and glowing: lighting would add nothing
+        if (!hasAlbedoTexture && properties.emissionStrength > 0.0f && properties.albedo == glm::vec3(0.0f)) {
+            features |= MATERIAL_FEATURE_EMISSIVE_ONLY;
+        }
+
+        return features;
+    }
+
+    VkDescriptorImageInfo KnoxicMaterial::getTextureImageInfo(MaterialTextureSlot slot) const {
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = defaultTextureImageView;
+        imageInfo.sampler = defaultTextureSampler;
+
+        switch (slot) {
+            case MaterialTextureSlot::Albedo:
+                if (hasAlbedoTexture) {
+                    imageInfo.imageView = albedoTextureImageView;
+                    imageInfo.sampler = albedoTextureSampler;
+                }
+                break;
+            case MaterialTextureSlot::Normal:
+                if (hasNormalTexture) {
+                    imageInfo.imageView = normalTextureImageView;
+                    imageInfo.sampler = normalTextureSampler;
+                }
+                break;
+            case MaterialTextureSlot::Roughness:
+                if (hasRoughnessTexture) {
+                    imageInfo.imageView = roughnessTextureImageView;
+                    imageInfo.sampler = roughnessTextureSampler;
+                }
+                break;
+            case MaterialTextureSlot::Metallic:
+                if (hasMetallicTexture) {
+                    imageInfo.imageView = metallicTextureImageView;
+                    imageInfo.sampler = metallicTextureSampler;
+                }
+                break;
+            default:
+                break;
+        }
+
+        return imageInfo;
+    }
+
     void KnoxicMaterial::updateDescriptorSet(KnoxicDescriptorSetLayout& setLayout, KnoxicDescriptorPool& pool) {
         // Create descriptor set if not already created
         if (descriptorSet == VK_NULL_HANDLE) {
@@ -298,29 +317,17 @@ namespace knoxic {
         }
 
         KnoxicDescriptorWriter writer(setLayout, pool);
-        
-        VkDescriptorImageInfo albedoImageInfo{};
-        albedoImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        albedoImageInfo.imageView = hasAlbedoTexture ? albedoTextureImageView : defaultTextureImageView;
-        albedoImageInfo.sampler = hasAlbedoTexture ? albedoTextureSampler : defaultTextureSampler;
+
+        VkDescriptorImageInfo albedoImageInfo = getTextureImageInfo(MaterialTextureSlot::Albedo);
         writer.writeImage(0, &albedoImageInfo);
 
-        VkDescriptorImageInfo normalImageInfo{};
-        normalImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        normalImageInfo.imageView = hasNormalTexture ? normalTextureImageView : defaultTextureImageView;
-        normalImageInfo.sampler = hasNormalTexture ? normalTextureSampler : defaultTextureSampler;
+        VkDescriptorImageInfo normalImageInfo = getTextureImageInfo(MaterialTextureSlot::Normal);
         writer.writeImage(1, &normalImageInfo);
 
-        VkDescriptorImageInfo roughnessImageInfo{};
-        roughnessImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        roughnessImageInfo.imageView = hasRoughnessTexture ? roughnessTextureImageView : defaultTextureImageView;
-        roughnessImageInfo.sampler = hasRoughnessTexture ? roughnessTextureSampler : defaultTextureSampler;
+        VkDescriptorImageInfo roughnessImageInfo = getTextureImageInfo(MaterialTextureSlot::Roughness);
         writer.writeImage(2, &roughnessImageInfo);
 
-        VkDescriptorImageInfo metallicImageInfo{};
-        metallicImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        metallicImageInfo.imageView = hasMetallicTexture ? metallicTextureImageView : defaultTextureImageView;
-        metallicImageInfo.sampler = hasMetallicTexture ? metallicTextureSampler : defaultTextureSampler;
+        VkDescriptorImageInfo metallicImageInfo = getTextureImageInfo(MaterialTextureSlot::Metallic);
         writer.writeImage(3, &metallicImageInfo);
 
         writer.overwrite(descriptorSet);
@@ -23,10 +23,33 @@ namespace knoxic {
 
         glm::vec3 emissionColor{0.0f, 0.0f, 0.0f};
         float emissionStrength{0.0f};
+
+        bool unlit{false};
+    };
+
+    // Shader permutation bits, each one maps to a specialization constant of the lighting shaders
+    enum MaterialFeatureBits : uint32_t {
+        MATERIAL_FEATURE_ALBEDO_MAP = 1u << 0,
+        MATERIAL_FEATURE_NORMAL_MAP = 1u << 1,
+        MATERIAL_FEATURE_ROUGHNESS_MAP = 1u << 2,
+        MATERIAL_FEATURE_METALLIC_MAP = 1u << 3,
+        MATERIAL_FEATURE_EMISSIVE_ONLY = 1u << 4,
+        MATERIAL_FEATURE_UNLIT = 1u << 5,
+        MATERIAL_FEATURE_COUNT = 6
+    };
+
+    enum class MaterialTextureSlot : uint32_t {
+        Albedo = 0,
+        Normal = 1,
+        Roughness = 2,
+        Metallic = 3,
+        Count = 4
     };
 
     class KnoxicMaterial {
     public:
+        static constexpr uint32_t INVALID_BINDLESS_INDEX = ~0u;
+
         KnoxicMaterial(KnoxicDevice& device);
         ~KnoxicMaterial();
 
@@ -39,6 +62,7 @@ namespace knoxic {
         void setAO(float ao) { properties.ao = ao; }
         void setTextureOffset(const glm::vec2& offset) { properties.textureOffset = offset; }
         void setTextureScale(const glm::vec2& scale) { properties.textureScale = scale; }
+        void setUnlit(bool unlit) { properties.unlit = unlit; }
 
         void loadAlbedoTexture(const std::string& filepath);
         void loadNormalTexture(const std::string& filepath);
@@ -54,14 +78,27 @@ namespace knoxic {
         VkDescriptorSet getDescriptorSet() const { return descriptorSet; }
         bool hasTextures() const { return hasAlbedoTexture || hasNormalTexture || hasRoughnessTexture || hasMetallicTexture; }
 
+        // MaterialFeatureBits used to pick the shader permutation
+        uint32_t getFeatureMask() const;
+
         // Update descriptor set
         void updateDescriptorSet(KnoxicDescriptorSetLayout& setLayout, KnoxicDescriptorPool& pool);
 
         bool albedoLoadFailed() const { return failedAlbedo; }
 
+        // Image info for a texture slot, the default white texture when none is loaded
+        VkDescriptorImageInfo getTextureImageInfo(MaterialTextureSlot slot) const;
+
+        // Bumped whenever a texture is (re)loaded so bindless slots get rewritten
+        uint32_t getTextureVersion() const { return textureVersion; }
+
+        // Slot in the bindless material table, assigned by the material system
+        uint32_t getBindlessIndex() const { return bindlessIndex; }
+        void setBindlessIndex(uint32_t index) { bindlessIndex = index; }
+
     private:
         void createDefaultTexture();
-        void createTextureImage(const std::string& filepath, VkImage& image, VkDeviceMemory& imageMemory);
+        void createTextureImage(const std::string& filepath, VkImage& image, KnoxicAllocation& imageAllocation);
         void createTextureImageView(VkImage image, VkImageView& imageView);
         void createTextureSampler(VkSampler& sampler);
 
@@ -70,28 +107,28 @@ namespace knoxic {
 
         // Texture resources
         VkImage albedoTextureImage = VK_NULL_HANDLE;
-        VkDeviceMemory albedoTextureImageMemory = VK_NULL_HANDLE;
+        KnoxicAllocation albedoTextureImageAllocation{};
         VkImageView albedoTextureImageView = VK_NULL_HANDLE;
         VkSampler albedoTextureSampler = VK_NULL_HANDLE;
 
         VkImage normalTextureImage = VK_NULL_HANDLE;
-        VkDeviceMemory normalTextureImageMemory = VK_NULL_HANDLE;
+        KnoxicAllocation normalTextureImageAllocation{};
         VkImageView normalTextureImageView = VK_NULL_HANDLE;
         VkSampler normalTextureSampler = VK_NULL_HANDLE;
 
         VkImage roughnessTextureImage = VK_NULL_HANDLE;
-        VkDeviceMemory roughnessTextureImageMemory = VK_NULL_HANDLE;
+        KnoxicAllocation roughnessTextureImageAllocation{};
         VkImageView roughnessTextureImageView = VK_NULL_HANDLE;
         VkSampler roughnessTextureSampler = VK_NULL_HANDLE;
 
         VkImage metallicTextureImage = VK_NULL_HANDLE;
-        VkDeviceMemory metallicTextureImageMemory = VK_NULL_HANDLE;
+        KnoxicAllocation metallicTextureImageAllocation{};
         VkImageView metallicTextureImageView = VK_NULL_HANDLE;
         VkSampler metallicTextureSampler = VK_NULL_HANDLE;
 
         // Default white texture for when no texture is loaded
         VkImage defaultTextureImage = VK_NULL_HANDLE;
-        VkDeviceMemory defaultTextureImageMemory = VK_NULL_HANDLE;
+        KnoxicAllocation defaultTextureImageAllocation{};
         VkImageView defaultTextureImageView = VK_NULL_HANDLE;
         VkSampler defaultTextureSampler = VK_NULL_HANDLE;
 
@@ -103,6 +140,9 @@ namespace knoxic {
         bool hasMetallicTexture = false;
 
         bool failedAlbedo = false;
+
+        uint32_t textureVersion = 0;
+        uint32_t bindlessIndex = INVALID_BINDLESS_INDEX;
     };
 
     struct MaterialComponent {
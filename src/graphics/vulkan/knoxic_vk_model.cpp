@@ -1,6 +1,7 @@
 #include "knoxic_vk_model.hpp"
 #include "../../core/vulkan/knoxic_vk_buffer.hpp"
 #include "../../core/vulkan/knoxic_vk_device.hpp"
+#include "../../core/vulkan/knoxic_vk_upload_context.hpp"
 #include "../../core/knoxic_utils.hpp"
 
 #include <assimp/Importer.hpp>
@@ -59,16 +60,15 @@ namespace knoxic {
         VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
         uint32_t vertexSize = sizeof(vertices[0]);
 
-        KnoxicBuffer stagingBuffer {
-            knoxicDevice,
-            vertexSize,
-            vertexCount,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        };
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void *) vertices.data());
+        // Compute local bounds and keep positions around for CPU culling
+        boundsMin = vertices[0].position;
+        boundsMax = vertices[0].position;
+        positions.reserve(vertices.size());
+        for (const auto &vertex : vertices) {
+            boundsMin = glm::min(boundsMin, vertex.position);
+            boundsMax = glm::max(boundsMax, vertex.position);
+            positions.push_back(vertex.position);
+        }
 
         vertexBuffer = std::make_unique<KnoxicBuffer>(
             knoxicDevice,
@@ -78,10 +78,11 @@ namespace knoxic {
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
         );
 
-        knoxicDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+        knoxicDevice.uploadContext().uploadBuffer(vertexBuffer->getBuffer(), vertices.data(), bufferSize);
     }
 
     void KnoxicModel::createIndexBuffer(const std::vector<uint32_t> &indices) {
+        this->indices = indices;
         indexCount = static_cast<uint32_t>(indices.size());
         hasIndexBuffer = indexCount > 0;
 
@@ -90,17 +91,6 @@ namespace knoxic {
         VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
         uint32_t indexSize = sizeof(indices[0]);
 
-        KnoxicBuffer stagingBuffer {
-            knoxicDevice,
-            indexSize,
-            indexCount,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        };
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void *) indices.data());
-
         indexBuffer = std::make_unique<KnoxicBuffer>(
             knoxicDevice,
             indexSize,
@@ -109,7 +99,7 @@ namespace knoxic {
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
         );
 
-        knoxicDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+        knoxicDevice.uploadContext().uploadBuffer(indexBuffer->getBuffer(), indices.data(), bufferSize);
     }
 
     void KnoxicModel::draw(VkCommandBuffer commandBuffer) {
@@ -120,6 +110,15 @@ namespace knoxic {
         }
     }
 
+    void KnoxicModel::drawIndirect(VkCommandBuffer commandBuffer, VkBuffer drawBuffer, VkDeviceSize offset) {
+        // Non-indexed draws read the first four fields of the same command layout
+        if (hasIndexBuffer) {
+            vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer, offset, 1, sizeof(VkDrawIndexedIndirectCommand));
+        } else {
+            vkCmdDrawIndirect(commandBuffer, drawBuffer, offset, 1, sizeof(VkDrawIndexedIndirectCommand));
+        }
+    }
+
     void KnoxicModel::bind(VkCommandBuffer commandBuffer) {
         VkBuffer buffers[] = {vertexBuffer->getBuffer()};
         VkDeviceSize offsets[] = {0};
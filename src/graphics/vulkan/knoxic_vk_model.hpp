@@ -57,6 +57,19 @@ namespace knoxic {
 
         void bind(VkCommandBuffer commandBuffer);
         void draw(VkCommandBuffer commandBuffer);
+        void drawIndirect(VkCommandBuffer commandBuffer, VkBuffer drawBuffer, VkDeviceSize offset);
+
+        // Local space bounds, used for culling
+        const glm::vec3 &getBoundsMin() const { return boundsMin; }
+        const glm::vec3 &getBoundsMax() const { return boundsMax; }
+
+        // Element count for a single draw (indices if indexed, otherwise vertices)
+        uint32_t getDrawCount() const { return hasIndexBuffer ? indexCount : vertexCount; }
+        bool isIndexed() const { return hasIndexBuffer; }
+
+        // CPU copy of the geometry, used by the software occlusion rasterizer
+        const std::vector<glm::vec3> &getPositions() const { return positions; }
+        const std::vector<uint32_t> &getIndices() const { return indices; }
 
     private:
         void createVertexBuffers(const std::vector<Vertex> &vertices);
@@ -67,9 +80,13 @@ namespace knoxic {
         std::unique_ptr<KnoxicBuffer> vertexBuffer;
         uint32_t vertexCount;
 
+        glm::vec3 boundsMin{0.0f};
+        glm::vec3 boundsMax{0.0f};
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> indices;
+
         bool hasIndexBuffer = false;
         std::unique_ptr<KnoxicBuffer> indexBuffer;
-        VkDeviceMemory indexBufferMemory;
         uint32_t indexCount;
     };
 }
\ No newline at end of file
@@ -1,55 +1,38 @@
 #include "knoxic_vk_pipeline.hpp"
 #include "knoxic_vk_model.hpp"
+#include "knoxic_vk_embedded_shaders.hpp"
 
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <stdexcept>
-#include <fstream>
-#include <iostream>
-
-#define ENGINE_DIR "../"
 
 namespace knoxic {
 
+    static VkShaderModule acquireShaderModule(KnoxicDevice &device, const std::string &filePath) {
+        const KnoxicEmbeddedShader *shader = findEmbeddedShader(filePath);
+        if (shader == nullptr) {
+            throw std::runtime_error("failed to find embedded shader: " + filePath);
+        }
+        return device.shaderModules().acquire(shader->code, shader->size);
+    }
+
     KnoxicPipeline::KnoxicPipeline(KnoxicDevice &device, const std::string &vertexFilePath, const std::string &fragmentFilePath, 
     const PipelineConfigInfo &configInfo) : knoxicDevice{device} {
         createGraphicsPipeline(vertexFilePath, fragmentFilePath, configInfo);
     }
 
     KnoxicPipeline::~KnoxicPipeline() {
-        vkDestroyShaderModule(knoxicDevice.device(), vertShaderModule, nullptr);
-        vkDestroyShaderModule(knoxicDevice.device(), fragShaderModule, nullptr);
         vkDestroyPipeline(knoxicDevice.device(), graphicsPipeline, nullptr);
     }
 
-    std::vector<char> KnoxicPipeline::readFile(const std::string &filepath) {
-        std::string enginePath = ENGINE_DIR + filepath;
-        std::ifstream file{enginePath, std::ios::ate | std::ios::binary};
-
-        if (!file.is_open()) {
-            throw std::runtime_error("failed to open file: " + enginePath);
-        }
-
-        size_t fileSize = static_cast<size_t>(file.tellg());
-        std::vector<char> buffer(fileSize);
-
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
-
-        file.close();
-        return buffer;
-    }
-
     void KnoxicPipeline::createGraphicsPipeline(const std::string &vertexFilePath, const std::string &fragmentFilePath, 
     const PipelineConfigInfo &configInfo) {
         assert(configInfo.pipelineLayout != VK_NULL_HANDLE && "Cannot create graphics pipeline: no pipelineLayout provided in configInfo");
         assert(configInfo.renderPass != VK_NULL_HANDLE && "Cannot create graphics pipeline: no renderPass provided in configInfo");
 
-        auto vertCode = readFile(vertexFilePath);
-        auto fragCode = readFile(fragmentFilePath);
-
-        createShaderModule(vertCode, &vertShaderModule);
-        createShaderModule(fragCode, &fragShaderModule);
+        VkShaderModule vertShaderModule = acquireShaderModule(knoxicDevice, vertexFilePath);
+        VkShaderModule fragShaderModule = acquireShaderModule(knoxicDevice, fragmentFilePath);
 
         VkPipelineShaderStageCreateInfo shaderStages[2];
         // Vertex shader
@@ -59,7 +42,7 @@ namespace knoxic {
         shaderStages[0].pName = "main";
         shaderStages[0].flags = 0;
         shaderStages[0].pNext = nullptr;
-        shaderStages[0].pSpecializationInfo = nullptr;
+        shaderStages[0].pSpecializationInfo = configInfo.vertexSpecializationInfo;
         // Fragment shader
         shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -67,7 +50,7 @@ namespace knoxic {
         shaderStages[1].pName = "main";
         shaderStages[1].flags = 0;
         shaderStages[1].pNext = nullptr;
-        shaderStages[1].pSpecializationInfo = nullptr;
+        shaderStages[1].pSpecializationInfo = configInfo.fragmentSpecializationInfo;
 
         auto &bindingDescriptions = configInfo.bindingDescriptions;
         auto &attributeDescriptions = configInfo.attributeDescriptions;
@@ -98,21 +81,16 @@ namespace knoxic {
         pipelineInfo.basePipelineIndex = -1;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-        if (vkCreateGraphicsPipelines(knoxicDevice.device(), VK_NULL_HANDLE, 1,
-        &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+        auto start = std::chrono::high_resolution_clock::now();
+        VkResult result = vkCreateGraphicsPipelines(knoxicDevice.device(), knoxicDevice.pipelineCache().getCache(), 1,
+            &pipelineInfo, nullptr, &graphicsPipeline);
+        knoxicDevice.shaderModules().release(vertShaderModule);
+        knoxicDevice.shaderModules().release(fragShaderModule);
+        if (result != VK_SUCCESS) {
             throw std::runtime_error("failed to create graphics pipeline");
         }
-    }
-
-    void KnoxicPipeline::createShaderModule(const std::vector<char> &code, VkShaderModule *shaderModule) {
-        VkShaderModuleCreateInfo createinfo{};
-        createinfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createinfo.codeSize = code.size();
-        createinfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
-
-        if (vkCreateShaderModule(knoxicDevice.device(), &createinfo, nullptr, shaderModule) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create shader module");
-        }
+        knoxicDevice.pipelineCache().recordCreation(std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start).count());
     }
 
     void KnoxicPipeline::bind(VkCommandBuffer commandBuffer) {
@@ -203,4 +181,53 @@ namespace knoxic {
         configInfo.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
         configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
     }
+
+    void KnoxicPipeline::skipVelocityOutput(PipelineConfigInfo &configInfo) {
+        VkPipelineColorBlendAttachmentState velocityAttachment{};
+        velocityAttachment.blendEnable = VK_FALSE;
+        velocityAttachment.colorWriteMask = 0;
+
+        configInfo.colorBlendAttachments = {configInfo.colorBlendAttachment, velocityAttachment};
+        configInfo.colorBlendInfo.attachmentCount = static_cast<uint32_t>(configInfo.colorBlendAttachments.size());
+        configInfo.colorBlendInfo.pAttachments = configInfo.colorBlendAttachments.data();
+    }
+
+    KnoxicComputePipeline::KnoxicComputePipeline(KnoxicDevice &device, const std::string &computeFilePath,
+    VkPipelineLayout pipelineLayout) : knoxicDevice{device} {
+        assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline: no pipelineLayout provided");
+
+        VkShaderModule compShaderModule = acquireShaderModule(knoxicDevice, computeFilePath);
+
+        VkPipelineShaderStageCreateInfo shaderStage{};
+        shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        shaderStage.module = compShaderModule;
+        shaderStage.pName = "main";
+        shaderStage.pSpecializationInfo = nullptr;
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage = shaderStage;
+        pipelineInfo.layout = pipelineLayout;
+        pipelineInfo.basePipelineIndex = -1;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        VkResult result = vkCreateComputePipelines(knoxicDevice.device(), knoxicDevice.pipelineCache().getCache(), 1,
+            &pipelineInfo, nullptr, &computePipeline);
+        knoxicDevice.shaderModules().release(compShaderModule);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to create compute pipeline");
+        }
+        knoxicDevice.pipelineCache().recordCreation(std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start).count());
+    }
+
+    KnoxicComputePipeline::~KnoxicComputePipeline() {
+        vkDestroyPipeline(knoxicDevice.device(), computePipeline, nullptr);
+    }
+
+    void KnoxicComputePipeline::bind(VkCommandBuffer commandBuffer) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+    }
 }
\ No newline at end of file
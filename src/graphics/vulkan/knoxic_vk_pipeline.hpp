@@ -20,14 +20,21 @@ namespace knoxic {
         VkPipelineMultisampleStateCreateInfo multisampleInfo;
         VkPipelineColorBlendAttachmentState colorBlendAttachment;
         VkPipelineColorBlendStateCreateInfo colorBlendInfo;
+        std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments{}; // Render targets with several color attachments
         VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
         std::vector<VkDynamicState> dynamicStateEnables;
         VkPipelineDynamicStateCreateInfo dynamicStateInfo;
         VkPipelineLayout pipelineLayout = nullptr;
         VkRenderPass renderPass = nullptr;
         uint32_t subpass = 0;
+
+        // Optional specialization constants, must outlive pipeline creation
+        const VkSpecializationInfo *vertexSpecializationInfo = nullptr;
+        const VkSpecializationInfo *fragmentSpecializationInfo = nullptr;
     };
 
+    // Shader paths name the compiled SPIR-V, "shaders/<source>.spv". The code is embedded in the executable and its
+    // modules come from the device's shader module cache, which they go back to once the pipeline is created
     class KnoxicPipeline {
     public:
         KnoxicPipeline(
@@ -46,8 +53,11 @@ namespace knoxic {
         static void defaultPipelineConfigInfo(PipelineConfigInfo &configInfo);
         static void enableAlphaBlending(PipelineConfigInfo &configInfo);
 
+        // The scene passes also write velocity to color attachment 1. This masks it for draws that have no motion
+        // of their own, call after the blend state of attachment 0 is final
+        static void skipVelocityOutput(PipelineConfigInfo &configInfo);
+
     private:
-        static std::vector<char> readFile(const std::string &filepath);
 
         void createGraphicsPipeline(
             const std::string &vertexFilePath, 
@@ -55,11 +65,26 @@ namespace knoxic {
             const PipelineConfigInfo &configInfo
         );
 
-        void createShaderModule(const std::vector<char> &code, VkShaderModule *shaderModule);
-
         KnoxicDevice &knoxicDevice;
         VkPipeline graphicsPipeline;
-        VkShaderModule vertShaderModule;
-        VkShaderModule fragShaderModule;
+    };
+
+    class KnoxicComputePipeline {
+    public:
+        KnoxicComputePipeline(
+            KnoxicDevice &device,
+            const std::string &computeFilePath,
+            VkPipelineLayout pipelineLayout
+        );
+        ~KnoxicComputePipeline();
+
+        KnoxicComputePipeline(const KnoxicComputePipeline&) = delete;
+        KnoxicComputePipeline &operator=(const KnoxicComputePipeline&) = delete;
+
+        void bind(VkCommandBuffer commandBuffer);
+
+    private:
+        KnoxicDevice &knoxicDevice;
+        VkPipeline computePipeline;
     };
 }
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "knoxic_vk_pipeline_manager.hpp"
+
+#include <algorithm>
+
+namespace knoxic {
+
+    KnoxicPipelineManager::KnoxicPipelineManager(uint32_t threadCount) {
+        if (threadCount == 0) {
+            uint32_t hardwareThreads = std::thread::hardware_concurrency();
+            threadCount = std::clamp(hardwareThreads > 1 ? hardwareThreads - 1 : 1u, 1u, MAX_THREADS);
+        }
+
+        for (uint32_t i = 0; i < threadCount; i++) {
+            workers.emplace_back(&KnoxicPipelineManager::workerLoop, this);
+        }
+    }
+
+    KnoxicPipelineManager::~KnoxicPipelineManager() {
+        // Queued builds still run, whoever holds their requests may wait on them
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stopping = true;
+        }
+        condition.notify_all();
+
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+
+    uint32_t KnoxicPipelineManager::getPendingCount() {
+        std::lock_guard<std::mutex> lock{mutex};
+        return static_cast<uint32_t>(jobs.size()) + runningCount;
+    }
+
+    void KnoxicPipelineManager::enqueue(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            jobs.push_back(std::move(job));
+        }
+        condition.notify_one();
+    }
+
+    void KnoxicPipelineManager::workerLoop() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                condition.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+                runningCount++;
+            }
+
+            // Exceptions end up in the request's future
+            job();
+            job = nullptr;
+
+            std::lock_guard<std::mutex> lock{mutex};
+            runningCount--;
+        }
+    }
+}
\ No newline at end of file
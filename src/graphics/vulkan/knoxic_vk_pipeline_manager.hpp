@@ -0,0 +1,81 @@
+#pragma once
+
+#include "knoxic_vk_pipeline.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace knoxic {
+
+    // A pipeline being compiled on a worker thread. Copies share the same pipeline
+    template <typename Pipeline>
+    class KnoxicPipelineRequest {
+    public:
+        KnoxicPipelineRequest() = default;
+        explicit KnoxicPipelineRequest(std::shared_future<std::unique_ptr<Pipeline>> future) : future{std::move(future)} {}
+
+        bool valid() const { return future.valid(); }
+        bool isReady() const { return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+
+        // Null while it's still compiling, rethrows a failed compile
+        Pipeline *tryGet() const { return isReady() ? future.get().get() : nullptr; }
+
+        // Blocks until it is compiled
+        Pipeline &get() const { return *future.get(); }
+
+        // Callers wait before destroying what the compile reads, like the pipeline layout
+        void wait() const {
+            if (future.valid()) {
+                future.wait();
+            }
+        }
+
+    private:
+        std::shared_future<std::unique_ptr<Pipeline>> future;
+    };
+
+    // Compiles pipelines on worker threads. The builds run concurrently through the device's pipeline cache, which
+    // Vulkan synchronizes internally. Systems request their pipelines up front so they compile while loading goes on,
+    // and only wait on (or fall back from) the ones still missing when they first draw
+    class KnoxicPipelineManager {
+    public:
+        // Zero picks one thread less than the hardware has, at most MAX_THREADS
+        static constexpr uint32_t MAX_THREADS = 4;
+
+        explicit KnoxicPipelineManager(uint32_t threadCount = 0);
+        ~KnoxicPipelineManager();
+
+        KnoxicPipelineManager(const KnoxicPipelineManager &) = delete;
+        KnoxicPipelineManager &operator=(const KnoxicPipelineManager &) = delete;
+
+        // The build runs on a worker, everything it reads has to stay alive until the request completes
+        template <typename Pipeline>
+        KnoxicPipelineRequest<Pipeline> request(std::function<std::unique_ptr<Pipeline>()> build) {
+            auto task = std::make_shared<std::packaged_task<std::unique_ptr<Pipeline>()>>(std::move(build));
+            KnoxicPipelineRequest<Pipeline> result{task->get_future().share()};
+            enqueue([task] { (*task)(); });
+            return result;
+        }
+
+        // Requested but not compiled yet
+        uint32_t getPendingCount();
+
+    private:
+        void enqueue(std::function<void()> job);
+        void workerLoop();
+
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> jobs;
+        uint32_t runningCount = 0;
+        bool stopping = false;
+        std::mutex mutex;
+        std::condition_variable condition;
+    };
+}
\ No newline at end of file
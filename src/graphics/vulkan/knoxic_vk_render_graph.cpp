@@ -0,0 +1,858 @@
+#include "knoxic_vk_render_graph.hpp"
+#include "../../core/vulkan/knoxic_vk_swap_chain.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace knoxic {
+
+    namespace {
+        struct AccessState {
+            VkImageLayout layout;
+            VkPipelineStageFlags stages;
+            VkAccessFlags readAccess;
+            VkAccessFlags writeAccess;
+        };
+
+        AccessState accessState(RenderGraphAccess access) {
+            switch (access) {
+                case RenderGraphAccess::ColorAttachment:
+                    return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        VK_ACCESS_COLOR_ATTACHMENT_READ_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT};
+                case RenderGraphAccess::DepthAttachment:
+                    return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT};
+                case RenderGraphAccess::SampledFragment:
+                    return {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                        VK_ACCESS_SHADER_READ_BIT, 0};
+                case RenderGraphAccess::SampledCompute:
+                    return {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_READ_BIT, 0};
+                case RenderGraphAccess::StorageCompute:
+                    return {VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT};
+            }
+            return {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, 0};
+        }
+
+        VkImageAspectFlags aspectForFormat(VkFormat format) {
+            switch (format) {
+                case VK_FORMAT_D32_SFLOAT:
+                case VK_FORMAT_D16_UNORM:
+                    return VK_IMAGE_ASPECT_DEPTH_BIT;
+                case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                case VK_FORMAT_D24_UNORM_S8_UINT:
+                case VK_FORMAT_D16_UNORM_S8_UINT:
+                    return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+                default:
+                    return VK_IMAGE_ASPECT_COLOR_BIT;
+            }
+        }
+    }
+
+    KnoxicRenderGraph::PassBuilder &KnoxicRenderGraph::PassBuilder::read(RenderGraphImage image, RenderGraphAccess access) {
+        graph.passes[passIndex].uses.push_back({image, access, false});
+        return *this;
+    }
+
+    KnoxicRenderGraph::PassBuilder &KnoxicRenderGraph::PassBuilder::write(RenderGraphImage image, RenderGraphAccess access) {
+        graph.passes[passIndex].uses.push_back({image, access, true});
+        return *this;
+    }
+
+    KnoxicRenderGraph::PassBuilder &KnoxicRenderGraph::PassBuilder::read(RenderGraphBuffer buffer, VkPipelineStageFlags stages) {
+        graph.passes[passIndex].bufferUses.push_back({buffer.index, stages, false});
+        return *this;
+    }
+
+    KnoxicRenderGraph::PassBuilder &KnoxicRenderGraph::PassBuilder::write(RenderGraphBuffer buffer, VkPipelineStageFlags stages) {
+        graph.passes[passIndex].bufferUses.push_back({buffer.index, stages, true});
+        return *this;
+    }
+
+    KnoxicRenderGraph::PassBuilder &KnoxicRenderGraph::PassBuilder::sideEffect() {
+        graph.passes[passIndex].sideEffect = true;
+        return *this;
+    }
+
+    KnoxicRenderGraph::PassBuilder &KnoxicRenderGraph::PassBuilder::asyncCompute() {
+        graph.passes[passIndex].async = true;
+        return *this;
+    }
+
+    KnoxicRenderGraph::PassBuilder &KnoxicRenderGraph::PassBuilder::execute(std::function<void(FrameInfo &)> callback) {
+        graph.passes[passIndex].callback = std::move(callback);
+        return *this;
+    }
+
+    KnoxicRenderGraph::KnoxicRenderGraph(KnoxicDevice &device) : knoxicDevice{device} {
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(knoxicDevice.getPhysicalDevice(), &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(knoxicDevice.getPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+
+        auto timestampMask = [](uint32_t validBits) { return validBits >= 64 ? ~0ull : (1ull << validBits) - 1; };
+
+        uint32_t graphicsBits = queueFamilies[knoxicDevice.getGraphicsQueueFamily()].timestampValidBits;
+        timestampsSupported = graphicsBits > 0 && knoxicDevice.properties.limits.timestampPeriod > 0.0f;
+        timestampPeriod = knoxicDevice.properties.limits.timestampPeriod;
+        graphicsTimestampMask = timestampMask(graphicsBits);
+
+        if (knoxicDevice.hasAsyncCompute()) {
+            uint32_t computeBits = queueFamilies[knoxicDevice.getComputeQueueFamily()].timestampValidBits;
+            computeTimestampsSupported = timestampsSupported && computeBits > 0;
+            computeTimestampMask = timestampMask(computeBits);
+        }
+    }
+
+    KnoxicRenderGraph::~KnoxicRenderGraph() {
+        reset();
+    }
+
+    RenderGraphImage KnoxicRenderGraph::createImage(const std::string &name, const RenderGraphImageDesc &desc) {
+        assert(!compiled && "Cannot add images to a compiled render graph");
+
+        ImageResource resource{};
+        resource.name = name;
+        resource.desc = desc;
+        resource.aspect = aspectForFormat(desc.format);
+
+        const VkImageUsageFlags attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+        resource.transient = (desc.usage & ~attachmentUsage) == 0;
+        if (resource.transient) {
+            resource.desc.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        }
+        images.push_back(std::move(resource));
+        return static_cast<RenderGraphImage>(images.size() - 1);
+    }
+
+    RenderGraphBuffer KnoxicRenderGraph::importBuffer(const std::string &name) {
+        assert(!compiled && "Cannot add buffers to a compiled render graph");
+
+        buffers.push_back(name);
+        return RenderGraphBuffer{static_cast<uint32_t>(buffers.size() - 1)};
+    }
+
+    KnoxicRenderGraph::PassBuilder KnoxicRenderGraph::addPass(const std::string &name) {
+        assert(!compiled && "Cannot add passes to a compiled render graph");
+
+        Pass pass{};
+        pass.name = name;
+        passes.push_back(std::move(pass));
+        return PassBuilder{*this, passes.size() - 1};
+    }
+
+    bool KnoxicRenderGraph::isPassCulled(const std::string &name) const {
+        for (const auto &pass : passes) {
+            if (pass.name == name) {
+                return pass.culled;
+            }
+        }
+        return true;
+    }
+
+    void KnoxicRenderGraph::compile() {
+        assert(!compiled && "Render graph is already compiled");
+
+        for (auto &pass : passes) {
+            pass.queue = pass.async && isAsyncComputeEnabled() ? RenderGraphQueue::Compute : RenderGraphQueue::Graphics;
+        }
+
+        cullPasses();
+        computeLifetimes();
+        createImages();
+        assignMemory();
+        createViews();
+        buildBarriers();
+        createSubmitObjects();
+        compiled = true;
+    }
+
+    void KnoxicRenderGraph::cullPasses() {
+        // Walk backwards, a pass lives if it has side effects or writes something a living pass reads later
+        std::vector<bool> needed(images.size(), false);
+        std::vector<bool> bufferNeeded(buffers.size(), false);
+        for (size_t i = passes.size(); i-- > 0;) {
+            Pass &pass = passes[i];
+
+            bool live = pass.sideEffect;
+            for (const auto &use : pass.uses) {
+                live = live || (use.write && needed[use.image]);
+            }
+            for (const auto &use : pass.bufferUses) {
+                live = live || (use.write && bufferNeeded[use.buffer]);
+            }
+            pass.culled = !live;
+            if (!live) {
+                continue;
+            }
+
+            for (const auto &use : pass.uses) {
+                if (use.write) {
+                    needed[use.image] = false;
+                }
+            }
+            for (const auto &use : pass.uses) {
+                if (!use.write) {
+                    needed[use.image] = true;
+                }
+            }
+            for (const auto &use : pass.bufferUses) {
+                if (use.write) {
+                    bufferNeeded[use.buffer] = false;
+                }
+            }
+            for (const auto &use : pass.bufferUses) {
+                if (!use.write) {
+                    bufferNeeded[use.buffer] = true;
+                }
+            }
+        }
+    }
+
+    void KnoxicRenderGraph::computeLifetimes() {
+        for (size_t i = 0; i < passes.size(); i++) {
+            if (passes[i].culled) {
+                continue;
+            }
+            for (const auto &use : passes[i].uses) {
+                ImageResource &resource = images[use.image];
+                if (resource.firstPass < 0) {
+                    resource.firstPass = static_cast<int>(i);
+                }
+                resource.lastPass = static_cast<int>(i);
+                resource.asyncUse = resource.asyncUse || passes[i].queue == RenderGraphQueue::Compute;
+            }
+        }
+    }
+
+    void KnoxicRenderGraph::createImages() {
+        for (auto &resource : images) {
+            // Images no living pass touches are never created
+            if (resource.firstPass < 0) {
+                continue;
+            }
+
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent.width = resource.desc.extent.width;
+            imageInfo.extent.height = resource.desc.extent.height;
+            imageInfo.extent.depth = 1;
+            imageInfo.mipLevels = resource.desc.mipLevels;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = resource.desc.format;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = resource.desc.usage;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            resource.images.resize(KnoxicSwapChain::framesInFlight());
+            for (auto &image : resource.images) {
+                if (vkCreateImage(knoxicDevice.device(), &imageInfo, nullptr, &image) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create render graph image!");
+                }
+            }
+
+            vkGetImageMemoryRequirements(knoxicDevice.device(), resource.images[0], &resource.memoryRequirements);
+            requestedMemory += resource.memoryRequirements.size;
+        }
+    }
+
+    void KnoxicRenderGraph::assignMemory() {
+        // Largest first, each image joins the first block it is compatible with and doesn't overlap in time
+        std::vector<RenderGraphImage> order;
+        for (RenderGraphImage i = 0; i < images.size(); i++) {
+            if (images[i].firstPass >= 0) {
+                order.push_back(i);
+            }
+        }
+        std::sort(order.begin(), order.end(), [this](RenderGraphImage a, RenderGraphImage b) {
+            return images[a].memoryRequirements.size > images[b].memoryRequirements.size;
+        });
+
+        for (RenderGraphImage image : order) {
+            ImageResource &resource = images[image];
+
+            size_t blockIndex = blocks.size();
+            for (size_t b = 0; b < blocks.size() && blockIndex == blocks.size(); b++) {
+                if (blocks[b].transient != resource.transient ||
+                    (blocks[b].memoryTypeBits & resource.memoryRequirements.memoryTypeBits) == 0) {
+                    continue;
+                }
+
+                // Across queues the previous occupant's last use isn't ordered before the next one's first
+                bool overlaps = false;
+                for (RenderGraphImage other : blocks[b].images) {
+                    overlaps = overlaps || resource.asyncUse || images[other].asyncUse ||
+                        !(images[other].lastPass < resource.firstPass || resource.lastPass < images[other].firstPass);
+                }
+                if (!overlaps) {
+                    blockIndex = b;
+                }
+            }
+
+            if (blockIndex == blocks.size()) {
+                blocks.emplace_back().transient = resource.transient;
+            }
+
+            MemoryBlock &block = blocks[blockIndex];
+            block.images.push_back(image);
+            block.size = std::max(block.size, resource.memoryRequirements.size);
+            block.memoryTypeBits &= resource.memoryRequirements.memoryTypeBits;
+            resource.block = static_cast<uint32_t>(blockIndex);
+        }
+
+        for (auto &block : blocks) {
+            VkMemoryAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize = block.size;
+            allocInfo.memoryTypeIndex = block.transient ?
+                knoxicDevice.findTransientMemoryType(block.memoryTypeBits) :
+                knoxicDevice.findMemoryType(block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+            block.memories.resize(KnoxicSwapChain::framesInFlight());
+            for (size_t frame = 0; frame < block.memories.size(); frame++) {
+                if (vkAllocateMemory(knoxicDevice.device(), &allocInfo, nullptr, &block.memories[frame]) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to allocate render graph memory!");
+                }
+                for (RenderGraphImage image : block.images) {
+                    if (vkBindImageMemory(knoxicDevice.device(), images[image].images[frame], block.memories[frame], 0) != VK_SUCCESS) {
+                        throw std::runtime_error("failed to bind render graph image memory!");
+                    }
+                }
+            }
+
+            allocatedMemory += block.size;
+        }
+    }
+
+    void KnoxicRenderGraph::createViews() {
+        for (auto &resource : images) {
+            if (resource.firstPass < 0) {
+                continue;
+            }
+
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = resource.desc.format;
+            viewInfo.subresourceRange.aspectMask = resource.aspect & ~VK_IMAGE_ASPECT_STENCIL_BIT; // Views sample depth only
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+
+            resource.views.resize(resource.images.size());
+            resource.mipViews.resize(resource.images.size());
+            for (size_t frame = 0; frame < resource.images.size(); frame++) {
+                viewInfo.image = resource.images[frame];
+                viewInfo.subresourceRange.baseMipLevel = 0;
+                viewInfo.subresourceRange.levelCount = resource.desc.mipLevels;
+
+                if (vkCreateImageView(knoxicDevice.device(), &viewInfo, nullptr, &resource.views[frame]) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create render graph image view!");
+                }
+
+                resource.mipViews[frame].resize(resource.desc.mipLevels);
+                for (uint32_t level = 0; level < resource.desc.mipLevels; level++) {
+                    viewInfo.subresourceRange.baseMipLevel = level;
+                    viewInfo.subresourceRange.levelCount = 1;
+
+                    if (vkCreateImageView(knoxicDevice.device(), &viewInfo, nullptr, &resource.mipViews[frame][level]) != VK_SUCCESS) {
+                        throw std::runtime_error("failed to create render graph mip view!");
+                    }
+                }
+            }
+        }
+    }
+
+    void KnoxicRenderGraph::buildBarriers() {
+        struct ImageState {
+            VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkPipelineStageFlags stages = 0;
+            VkAccessFlags pendingWrites = 0;
+            bool started = false;
+            RenderGraphQueue queue = RenderGraphQueue::Graphics;
+            size_t submit = 0; // Last one that touched it
+        };
+        struct BufferState {
+            VkPipelineStageFlags stages = 0;
+            bool pendingWrite = false;
+            bool started = false;
+            RenderGraphQueue queue = RenderGraphQueue::Graphics;
+            size_t submit = 0;
+        };
+        std::vector<ImageState> states(images.size());
+        std::vector<BufferState> bufferStates(buffers.size());
+
+        // A wait orders every later command of its queue after the waited submit and everything before it there
+        auto waited = [this](RenderGraphQueue queue, size_t submit) {
+            for (const auto &other : submits) {
+                for (size_t w = 0; other.queue == queue && w < other.waits.size(); w++) {
+                    if (other.waits[w] >= submit) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        };
+
+        for (size_t passIndex = 0; passIndex < passes.size(); passIndex++) {
+            Pass &pass = passes[passIndex];
+            if (pass.culled) {
+                continue;
+            }
+
+            // Submits of the other queue whose results this pass depends on
+            std::vector<size_t> needs;
+            for (const auto &use : pass.uses) {
+                const ImageState &state = states[use.image];
+                if (state.started && state.queue != pass.queue && !waited(pass.queue, state.submit)) {
+                    needs.push_back(state.submit);
+                }
+            }
+            for (const auto &use : pass.bufferUses) {
+                const BufferState &state = bufferStates[use.buffer];
+                if (state.started && state.queue != pass.queue && !waited(pass.queue, state.submit)) {
+                    needs.push_back(state.submit);
+                }
+            }
+            if (pass.queue == RenderGraphQueue::Compute) {
+                // Compute batches also read what the graph doesn't see (the TAA history), so they start after all
+                // graphics work before them. The graphics side only joins where it depends on their results
+                for (size_t s = submits.size(); s-- > 0;) {
+                    if (submits[s].queue == RenderGraphQueue::Graphics) {
+                        if (!waited(pass.queue, s)) {
+                            needs.push_back(s);
+                        }
+                        break;
+                    }
+                }
+            }
+
+            // Waits hold up the whole batch, so one starts at the pass that needs the other queue. Passes before
+            // it keep running meanwhile, and the batch timestamps only cover actual work
+            if (submits.empty() || submits.back().queue != pass.queue || (!needs.empty() && !submits.back().passes.empty())) {
+                submits.emplace_back().queue = pass.queue;
+            }
+            size_t submitIndex = submits.size() - 1;
+            if (!needs.empty()) {
+                addWait(submitIndex, *std::max_element(needs.begin(), needs.end()));
+            }
+            submits[submitIndex].passes.push_back(passIndex);
+
+            // Merge every use of an image in this pass into one state
+            std::vector<RenderGraphImage> touched;
+            for (const auto &use : pass.uses) {
+                if (std::find(touched.begin(), touched.end(), use.image) == touched.end()) {
+                    touched.push_back(use.image);
+                }
+            }
+
+            for (RenderGraphImage image : touched) {
+                VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+                VkPipelineStageFlags stages = 0;
+                VkAccessFlags access = 0;
+                VkAccessFlags writes = 0;
+                for (const auto &use : pass.uses) {
+                    if (use.image != image) {
+                        continue;
+                    }
+                    AccessState state = accessState(use.access);
+                    assert((layout == VK_IMAGE_LAYOUT_UNDEFINED || layout == state.layout) &&
+                        "An image can only be used in one layout per pass");
+                    layout = state.layout;
+                    stages |= state.stages;
+                    access |= state.readAccess;
+                    if (use.write) {
+                        access |= state.writeAccess;
+                        writes |= state.writeAccess;
+                    }
+                }
+
+                ImageState &state = states[image];
+                if (!state.started) {
+                    // First use discards the contents. With aliased memory, wait for the block's previous occupant
+                    const ImageResource &resource = images[image];
+                    int previous = -1;
+                    for (RenderGraphImage other : blocks[resource.block].images) {
+                        if (images[other].lastPass < resource.firstPass &&
+                            (previous < 0 || images[other].lastPass > images[previous].lastPass)) {
+                            previous = static_cast<int>(other);
+                        }
+                    }
+
+                    VkAccessFlags srcAccess = 0;
+                    if (previous >= 0) {
+                        pass.srcStages |= states[previous].stages;
+                        srcAccess = states[previous].pendingWrites;
+                    } else {
+                        pass.srcStages |= VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+                    }
+                    pass.barriers.push_back({image, VK_IMAGE_LAYOUT_UNDEFINED, layout, srcAccess, access});
+                } else if (state.queue != pass.queue) {
+                    // Released by the batch that used it last, acquired here after the semaphore wait
+                    uint32_t srcFamily = queueFamily(state.queue);
+                    uint32_t dstFamily = queueFamily(pass.queue);
+                    Submit &source = submits[state.submit];
+                    source.releases.push_back({image, state.layout, layout, state.pendingWrites, 0, srcFamily, dstFamily});
+                    source.releaseStages |= state.stages;
+
+                    pass.srcStages |= stages;
+                    pass.barriers.push_back({image, state.layout, layout, 0, access, srcFamily, dstFamily});
+                } else if (state.layout != layout || state.pendingWrites != 0 || writes != 0) {
+                    pass.srcStages |= state.stages;
+                    pass.barriers.push_back({image, state.layout, layout, state.pendingWrites, access});
+                } else {
+                    // Reads in the same layout need no barrier, later writers wait for all of them
+                    state.stages |= stages;
+                    state.submit = submitIndex;
+                    continue;
+                }
+
+                pass.dstStages |= stages;
+                state.layout = layout;
+                state.stages = stages;
+                state.pendingWrites = writes;
+                state.started = true;
+                state.queue = pass.queue;
+                state.submit = submitIndex;
+            }
+
+            // Buffers get one global barrier on the same queue, the semaphore covers them across queues
+            std::vector<uint32_t> touchedBuffers;
+            for (const auto &use : pass.bufferUses) {
+                if (std::find(touchedBuffers.begin(), touchedBuffers.end(), use.buffer) == touchedBuffers.end()) {
+                    touchedBuffers.push_back(use.buffer);
+                }
+            }
+
+            for (uint32_t buffer : touchedBuffers) {
+                VkPipelineStageFlags stages = 0;
+                bool write = false;
+                for (const auto &use : pass.bufferUses) {
+                    if (use.buffer == buffer) {
+                        stages |= use.stages;
+                        write = write || use.write;
+                    }
+                }
+
+                BufferState &state = bufferStates[buffer];
+                if (!state.started || state.queue != pass.queue) {
+                    state.stages = stages;
+                    state.pendingWrite = write;
+                } else if (state.pendingWrite || write) {
+                    pass.srcStages |= state.stages;
+                    pass.dstStages |= stages;
+                    pass.memorySrcAccess |= state.pendingWrite ? VK_ACCESS_MEMORY_WRITE_BIT : 0;
+                    pass.memoryDstAccess |= VK_ACCESS_MEMORY_READ_BIT | (write ? VK_ACCESS_MEMORY_WRITE_BIT : 0);
+                    state.stages = stages;
+                    state.pendingWrite = write;
+                } else {
+                    state.stages |= stages;
+                }
+                state.started = true;
+                state.queue = pass.queue;
+                state.submit = submitIndex;
+            }
+        }
+
+        // The renderer submits the last graphics batch with the frame's fence. Waiting for the last compute batch
+        // entirely there makes the fence cover both queues, and later frames' graphics work come after all of it
+        if (submits.empty() || submits.back().queue != RenderGraphQueue::Graphics) {
+            submits.emplace_back().queue = RenderGraphQueue::Graphics;
+        }
+        for (size_t s = submits.size(); s-- > 0;) {
+            if (submits[s].queue == RenderGraphQueue::Compute) {
+                if (!waited(RenderGraphQueue::Graphics, s)) {
+                    addWait(submits.size() - 1, s);
+                }
+                break;
+            }
+        }
+    }
+
+    void KnoxicRenderGraph::addWait(size_t submit, size_t waited) {
+        // Binary semaphores are waited exactly once, callers check nothing waits on this or a later submit yet
+        submits[waited].signals = true;
+        submits[submit].waits.push_back(waited);
+        submits[submit].waitStages.push_back(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    }
+
+    uint32_t KnoxicRenderGraph::queueFamily(RenderGraphQueue queue) const {
+        return queue == RenderGraphQueue::Compute ? knoxicDevice.getComputeQueueFamily() : knoxicDevice.getGraphicsQueueFamily();
+    }
+
+    void KnoxicRenderGraph::createSubmitObjects() {
+        for (size_t s = 0; s < submits.size(); s++) {
+            Submit &submit = submits[s];
+
+            if (s + 1 < submits.size()) {
+                VkCommandBufferAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocInfo.commandPool = submit.queue == RenderGraphQueue::Compute ?
+                    knoxicDevice.getComputeCommandPool() : knoxicDevice.getCommandPool();
+                allocInfo.commandBufferCount = KnoxicSwapChain::framesInFlight();
+
+                submit.commandBuffers.resize(KnoxicSwapChain::framesInFlight());
+                if (vkAllocateCommandBuffers(knoxicDevice.device(), &allocInfo, submit.commandBuffers.data()) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to allocate render graph command buffers!");
+                }
+            }
+
+            if (submit.signals) {
+                VkSemaphoreCreateInfo semaphoreInfo{};
+                semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+                submit.semaphores.resize(KnoxicSwapChain::framesInFlight());
+                for (auto &semaphore : submit.semaphores) {
+                    if (vkCreateSemaphore(knoxicDevice.device(), &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+                        throw std::runtime_error("failed to create render graph semaphore!");
+                    }
+                }
+            }
+        }
+
+        if (timestampsSupported) {
+            VkQueryPoolCreateInfo queryPoolInfo{};
+            queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            queryPoolInfo.queryCount = static_cast<uint32_t>(2 * submits.size() * KnoxicSwapChain::framesInFlight());
+
+            if (vkCreateQueryPool(knoxicDevice.device(), &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create timestamp query pool!");
+            }
+            timingsWritten.assign(KnoxicSwapChain::framesInFlight(), false);
+        }
+    }
+
+    void KnoxicRenderGraph::recordBarriers(VkCommandBuffer commandBuffer, int frameIndex, const std::vector<Barrier> &barriers,
+        VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages, VkAccessFlags memorySrcAccess, VkAccessFlags memoryDstAccess) {
+        if (barriers.empty() && memoryDstAccess == 0) {
+            return;
+        }
+
+        barrierScratch.clear();
+        for (const auto &barrier : barriers) {
+            const ImageResource &resource = images[barrier.image];
+
+            VkImageMemoryBarrier imageBarrier{};
+            imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            imageBarrier.srcAccessMask = barrier.srcAccess;
+            imageBarrier.dstAccessMask = barrier.dstAccess;
+            imageBarrier.oldLayout = barrier.oldLayout;
+            imageBarrier.newLayout = barrier.newLayout;
+            imageBarrier.srcQueueFamilyIndex = barrier.srcQueueFamily;
+            imageBarrier.dstQueueFamilyIndex = barrier.dstQueueFamily;
+            imageBarrier.image = resource.images[frameIndex];
+            imageBarrier.subresourceRange = {resource.aspect, 0, resource.desc.mipLevels, 0, 1};
+            barrierScratch.push_back(imageBarrier);
+        }
+
+        VkMemoryBarrier memoryBarrier{};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = memorySrcAccess;
+        memoryBarrier.dstAccessMask = memoryDstAccess;
+
+        vkCmdPipelineBarrier(commandBuffer,
+            srcStages, dstStages,
+            0, memoryDstAccess != 0 ? 1 : 0, &memoryBarrier, 0, nullptr,
+            static_cast<uint32_t>(barrierScratch.size()), barrierScratch.data());
+    }
+
+    void KnoxicRenderGraph::execute(FrameInfo &frameInfo) {
+        assert(compiled && "Render graph must be compiled before it is executed");
+
+        VkCommandBuffer frameCommandBuffer = frameInfo.commandBuffer;
+        int frameIndex = frameInfo.frameIndex;
+        size_t lastSubmit = submits.size() - 1;
+
+        for (size_t s = 0; s < submits.size(); s++) {
+            const Submit &submit = submits[s];
+            bool timed = timestampsSupported && (submit.queue == RenderGraphQueue::Graphics || computeTimestampsSupported);
+            uint32_t query = static_cast<uint32_t>(2 * (frameIndex * submits.size() + s));
+
+            VkCommandBuffer commandBuffer = frameCommandBuffer;
+            if (s != lastSubmit) {
+                commandBuffer = submit.commandBuffers[frameIndex];
+
+                VkCommandBufferBeginInfo beginInfo{};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+                if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to begin recording render graph command buffer!");
+                }
+            }
+            frameInfo.commandBuffer = commandBuffer;
+
+            if (timed) {
+                vkCmdResetQueryPool(commandBuffer, queryPool, query, 2);
+                vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, query);
+            }
+
+            for (size_t passIndex : submit.passes) {
+                const Pass &pass = passes[passIndex];
+                recordBarriers(commandBuffer, frameIndex, pass.barriers,
+                    pass.srcStages, pass.dstStages, pass.memorySrcAccess, pass.memoryDstAccess);
+
+                if (pass.callback) {
+                    pass.callback(frameInfo);
+                }
+            }
+
+            recordBarriers(commandBuffer, frameIndex, submit.releases,
+                submit.releaseStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0);
+
+            if (timed) {
+                vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, query + 1);
+            }
+
+            if (s != lastSubmit && vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to record render graph command buffer!");
+            }
+        }
+        frameInfo.commandBuffer = frameCommandBuffer;
+
+        // Everything but the last graphics batch goes out now, in order
+        for (size_t s = 0; s < submits.size(); s++) {
+            const Submit &submit = submits[s];
+
+            waitScratch.clear();
+            for (size_t waited : submit.waits) {
+                waitScratch.push_back(submits[waited].semaphores[frameIndex]);
+            }
+
+            if (s == lastSubmit) {
+                frameWaitSemaphores = waitScratch;
+                frameWaitStages = submit.waitStages;
+                break;
+            }
+
+            VkSubmitInfo submitInfo{};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitScratch.size());
+            submitInfo.pWaitSemaphores = waitScratch.data();
+            submitInfo.pWaitDstStageMask = submit.waitStages.data();
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &submit.commandBuffers[frameIndex];
+            if (submit.signals) {
+                submitInfo.signalSemaphoreCount = 1;
+                submitInfo.pSignalSemaphores = &submit.semaphores[frameIndex];
+            }
+
+            VkQueue queue = submit.queue == RenderGraphQueue::Compute ? knoxicDevice.computeQueue() : knoxicDevice.graphicsQueue();
+            if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit render graph command buffer!");
+            }
+        }
+
+        if (timestampsSupported) {
+            timingsWritten[frameIndex] = true;
+        }
+    }
+
+    void KnoxicRenderGraph::updateTimings(int frameIndex) {
+        if (!timestampsSupported || !compiled || !timingsWritten[frameIndex]) {
+            return;
+        }
+
+        auto milliseconds = [this](uint64_t ticks) {
+            return static_cast<float>(static_cast<double>(ticks) * timestampPeriod * 1e-6);
+        };
+
+        // The fence of this frame slot was waited on, so the results are normally ready already. Timestamps
+        // of different queues can't be compared, the frame spans the graphics batches only
+        RenderGraphTimings frame{};
+        uint64_t frameBegin = 0;
+        bool graphicsStarted = false;
+        for (size_t s = 0; s < submits.size(); s++) {
+            bool compute = submits[s].queue == RenderGraphQueue::Compute;
+            if (compute && !computeTimestampsSupported) {
+                continue;
+            }
+
+            uint64_t timestamps[2];
+            uint32_t query = static_cast<uint32_t>(2 * (frameIndex * submits.size() + s));
+            VkResult result = vkGetQueryPoolResults(knoxicDevice.device(), queryPool, query, 2,
+                sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+            if (result != VK_SUCCESS) {
+                return;
+            }
+
+            if (compute) {
+                frame.compute += milliseconds((timestamps[1] - timestamps[0]) & computeTimestampMask);
+                continue;
+            }
+
+            frame.graphics += milliseconds((timestamps[1] - timestamps[0]) & graphicsTimestampMask);
+            if (!graphicsStarted) {
+                frameBegin = timestamps[0];
+                graphicsStarted = true;
+            }
+            frame.frame = milliseconds((timestamps[1] - frameBegin) & graphicsTimestampMask);
+        }
+
+        auto smooth = [](float &value, float sample) {
+            value = value > 0.0f ? value + (sample - value) * 0.1f : sample;
+        };
+        smooth(timings.frame, frame.frame);
+        smooth(timings.graphics, frame.graphics);
+        smooth(timings.compute, frame.compute);
+    }
+
+    void KnoxicRenderGraph::reset() {
+        vkDeviceWaitIdle(knoxicDevice.device());
+
+        for (auto &resource : images) {
+            for (auto &frameViews : resource.mipViews) {
+                for (auto view : frameViews) {
+                    vkDestroyImageView(knoxicDevice.device(), view, nullptr);
+                }
+            }
+            for (auto view : resource.views) {
+                vkDestroyImageView(knoxicDevice.device(), view, nullptr);
+            }
+            for (auto image : resource.images) {
+                vkDestroyImage(knoxicDevice.device(), image, nullptr);
+            }
+        }
+        for (auto &block : blocks) {
+            for (auto memory : block.memories) {
+                vkFreeMemory(knoxicDevice.device(), memory, nullptr);
+            }
+        }
+
+        for (auto &submit : submits) {
+            if (!submit.commandBuffers.empty()) {
+                VkCommandPool pool = submit.queue == RenderGraphQueue::Compute ?
+                    knoxicDevice.getComputeCommandPool() : knoxicDevice.getCommandPool();
+                vkFreeCommandBuffers(knoxicDevice.device(), pool,
+                    static_cast<uint32_t>(submit.commandBuffers.size()), submit.commandBuffers.data());
+            }
+            for (auto semaphore : submit.semaphores) {
+                vkDestroySemaphore(knoxicDevice.device(), semaphore, nullptr);
+            }
+        }
+        if (queryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(knoxicDevice.device(), queryPool, nullptr);
+            queryPool = VK_NULL_HANDLE;
+        }
+
+        images.clear();
+        buffers.clear();
+        passes.clear();
+        submits.clear();
+        blocks.clear();
+        timingsWritten.clear();
+        frameWaitSemaphores.clear();
+        frameWaitStages.clear();
+        allocatedMemory = 0;
+        requestedMemory = 0;
+        compiled = false;
+    }
+}
\ No newline at end of file
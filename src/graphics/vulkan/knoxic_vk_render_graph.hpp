@@ -0,0 +1,244 @@
+#pragma once
+
+#include "../../core/vulkan/knoxic_vk_device.hpp"
+#include "../knoxic_frame_info.hpp"
+
+#include <vulkan/vulkan.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace knoxic {
+
+    // How a pass touches an image, picks the layout and the barrier scopes around the pass
+    enum class RenderGraphAccess {
+        ColorAttachment,
+        DepthAttachment,
+        SampledFragment,
+        SampledCompute,
+        StorageCompute
+    };
+
+    struct RenderGraphImageDesc {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent{};
+        uint32_t mipLevels = 1;
+        VkImageUsageFlags usage = 0;
+    };
+
+    using RenderGraphImage = uint32_t;
+
+    // A buffer some system owns, declared only so passes touching it are ordered and synchronized
+    struct RenderGraphBuffer {
+        uint32_t index;
+    };
+
+    enum class RenderGraphQueue {
+        Graphics,
+        Compute
+    };
+
+    // Milliseconds, averaged over recent frames
+    struct RenderGraphTimings {
+        float frame = 0.0f; // First to last graphics timestamp
+        float graphics = 0.0f; // Summed over the graphics batches
+        float compute = 0.0f; // Summed over the async compute batches
+    };
+
+    // Frame graph, rebuilt when the targets change size.
+    // Passes run in the order they are added and declare the images they read and write. compile() culls passes
+    // nothing depends on, lets transient images with disjoint lifetimes share memory and derives every barrier.
+    // Images declared with attachment usage only never leave the render pass and get transient, lazily allocated memory.
+    // Async compute passes go to the device's compute-only queue when it has one. The frame is then split into
+    // batches per queue, joined by semaphores where a pass needs the other queue's results, and images change
+    // queue family ownership explicitly. Buffers are shared between the families, their barriers are derived too.
+    class KnoxicRenderGraph {
+    public:
+        class PassBuilder {
+        public:
+            PassBuilder &read(RenderGraphImage image, RenderGraphAccess access);
+            PassBuilder &write(RenderGraphImage image, RenderGraphAccess access);
+            PassBuilder &read(RenderGraphBuffer buffer, VkPipelineStageFlags stages);
+            PassBuilder &write(RenderGraphBuffer buffer, VkPipelineStageFlags stages);
+
+            // Keeps the pass alive without a reader, for work the graph doesn't track (swapchain, undeclared buffers)
+            PassBuilder &sideEffect();
+
+            // Compute only pass that may run on the async compute queue, it can't assume what queue it records for
+            PassBuilder &asyncCompute();
+            PassBuilder &execute(std::function<void(FrameInfo &)> callback);
+
+        private:
+            friend class KnoxicRenderGraph;
+            PassBuilder(KnoxicRenderGraph &graph, size_t passIndex) : graph{graph}, passIndex{passIndex} {}
+
+            KnoxicRenderGraph &graph;
+            size_t passIndex;
+        };
+
+        explicit KnoxicRenderGraph(KnoxicDevice &device);
+        ~KnoxicRenderGraph();
+
+        KnoxicRenderGraph(const KnoxicRenderGraph &) = delete;
+        KnoxicRenderGraph &operator=(const KnoxicRenderGraph &) = delete;
+
+        // Images only live within a frame, one copy per frame in flight
+        RenderGraphImage createImage(const std::string &name, const RenderGraphImageDesc &desc);
+        RenderGraphBuffer importBuffer(const std::string &name);
+        PassBuilder addPass(const std::string &name);
+
+        // Off runs async compute passes on the graphics queue. Takes effect on the next compile()
+        bool isAsyncComputeEnabled() const { return asyncComputeEnabled && knoxicDevice.hasAsyncCompute(); }
+        void setAsyncComputeEnabled(bool value) { asyncComputeEnabled = value; }
+
+        void compile();
+
+        // Records every pass and submits all batches but the last graphics one, which goes into frameInfo.commandBuffer.
+        // The renderer submits that one waiting on the semaphores below
+        void execute(FrameInfo &frameInfo);
+        const std::vector<VkSemaphore> &getFrameWaitSemaphores() const { return frameWaitSemaphores; }
+        const std::vector<VkPipelineStageFlags> &getFrameWaitStages() const { return frameWaitStages; }
+
+        // Timestamps around every batch. Reads this frame slot's previous ones, call after beginFrame()
+        bool hasTimings() const { return timestampsSupported; }
+        void updateTimings(int frameIndex);
+        const RenderGraphTimings &getTimings() const { return timings; }
+        uint32_t getSubmitCount() const { return static_cast<uint32_t>(submits.size()); }
+
+        // Destroys all images and passes, the graph can be declared again afterwards
+        void reset();
+
+        VkImage getImage(RenderGraphImage image, int frameIndex) const { return images[image].images[frameIndex]; }
+        VkImageView getImageView(RenderGraphImage image, int frameIndex) const { return images[image].views[frameIndex]; }
+        VkImageView getMipView(RenderGraphImage image, int frameIndex, uint32_t level) const { return images[image].mipViews[frameIndex][level]; }
+        const RenderGraphImageDesc &getDesc(RenderGraphImage image) const { return images[image].desc; }
+
+        bool isPassCulled(const std::string &name) const;
+
+        // Device memory per frame in flight, with and without aliasing
+        VkDeviceSize getAllocatedMemory() const { return allocatedMemory; }
+        VkDeviceSize getRequestedMemory() const { return requestedMemory; }
+
+    private:
+        struct ImageResource {
+            std::string name;
+            RenderGraphImageDesc desc;
+            VkImageAspectFlags aspect = 0;
+            bool transient = false; // Only ever an attachment, lazily allocated where supported
+            bool asyncUse = false; // Touched on the compute queue, never aliased across queues
+            VkMemoryRequirements memoryRequirements{};
+            uint32_t block = 0;
+            int firstPass = -1;
+            int lastPass = -1;
+
+            std::vector<VkImage> images;
+            std::vector<VkImageView> views;
+            std::vector<std::vector<VkImageView>> mipViews;
+        };
+
+        struct ImageUse {
+            RenderGraphImage image;
+            RenderGraphAccess access;
+            bool write;
+        };
+
+        struct BufferUse {
+            uint32_t buffer;
+            VkPipelineStageFlags stages;
+            bool write;
+        };
+
+        struct Barrier {
+            RenderGraphImage image;
+            VkImageLayout oldLayout;
+            VkImageLayout newLayout;
+            VkAccessFlags srcAccess;
+            VkAccessFlags dstAccess;
+            uint32_t srcQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+            uint32_t dstQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+        };
+
+        struct Pass {
+            std::string name;
+            std::vector<ImageUse> uses;
+            std::vector<BufferUse> bufferUses;
+            bool sideEffect = false;
+            bool async = false;
+            bool culled = false;
+            std::function<void(FrameInfo &)> callback;
+
+            RenderGraphQueue queue = RenderGraphQueue::Graphics;
+            std::vector<Barrier> barriers;
+            VkPipelineStageFlags srcStages = 0;
+            VkPipelineStageFlags dstStages = 0;
+            VkAccessFlags memorySrcAccess = 0; // Buffers, one global barrier
+            VkAccessFlags memoryDstAccess = 0;
+        };
+
+        // Consecutive passes on one queue, submitted together
+        struct Submit {
+            RenderGraphQueue queue = RenderGraphQueue::Graphics;
+            std::vector<size_t> passes;
+            std::vector<size_t> waits; // Earlier submits of the other queue
+            std::vector<VkPipelineStageFlags> waitStages;
+            bool signals = false;
+
+            // Ownership handed to the other queue once the batch is done
+            std::vector<Barrier> releases;
+            VkPipelineStageFlags releaseStages = 0;
+
+            // Per frame in flight, the last graphics submit records into the frame's own command buffer instead
+            std::vector<VkCommandBuffer> commandBuffers;
+            std::vector<VkSemaphore> semaphores;
+        };
+
+        // Images whose lifetimes don't overlap, bound at offset 0 of one allocation per frame
+        struct MemoryBlock {
+            VkDeviceSize size = 0;
+            uint32_t memoryTypeBits = ~0u;
+            bool transient = false;
+            std::vector<RenderGraphImage> images;
+            std::vector<VkDeviceMemory> memories;
+        };
+
+        void cullPasses();
+        void computeLifetimes();
+        void createImages();
+        void assignMemory();
+        void createViews();
+        void buildBarriers();
+        void addWait(size_t submit, size_t waited);
+        void createSubmitObjects();
+        void recordBarriers(VkCommandBuffer commandBuffer, int frameIndex, const std::vector<Barrier> &barriers,
+            VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages, VkAccessFlags memorySrcAccess, VkAccessFlags memoryDstAccess);
+        uint32_t queueFamily(RenderGraphQueue queue) const;
+
+        KnoxicDevice &knoxicDevice;
+
+        std::vector<ImageResource> images;
+        std::vector<std::string> buffers;
+        std::vector<Pass> passes;
+        std::vector<Submit> submits;
+        std::vector<MemoryBlock> blocks;
+        std::vector<VkImageMemoryBarrier> barrierScratch;
+        std::vector<VkSemaphore> waitScratch;
+        std::vector<VkSemaphore> frameWaitSemaphores;
+        std::vector<VkPipelineStageFlags> frameWaitStages;
+
+        bool asyncComputeEnabled = true;
+
+        // Two timestamps per submit and frame in flight
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        std::vector<bool> timingsWritten;
+        bool timestampsSupported = false;
+        bool computeTimestampsSupported = false;
+        float timestampPeriod = 1.0f; // Nanoseconds per tick
+        uint64_t graphicsTimestampMask = ~0ull;
+        uint64_t computeTimestampMask = ~0ull;
+        RenderGraphTimings timings;
+
+        VkDeviceSize allocatedMemory = 0;
+        VkDeviceSize requestedMemory = 0;
+        bool compiled = false;
+    };
+}
\ No newline at end of file
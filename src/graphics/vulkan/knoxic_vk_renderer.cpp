@@ -2,6 +2,7 @@
 #include "../../core/vulkan/knoxic_vk_device.hpp"
 #include "../../core/vulkan/knoxic_vk_swap_chain.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <memory>
@@ -22,8 +23,8 @@ namespace knoxic {
             extent = knoxicWindow.getExtent();
             glfwWaitEvents();
         }
-        vkDeviceWaitIdle(knoxicDevice.device());
 
+        // No idle, the old swap chain is passed as oldSwapchain and retired until its frames are done
         if (knoxicSwapChain == nullptr) {
             knoxicSwapChain = std::make_unique<KnoxicSwapChain>(knoxicDevice, extent);
         } else {
@@ -33,11 +34,14 @@ namespace knoxic {
             if (!oldSwapChain->compareSwapFormats(*knoxicSwapChain.get())) {
                 std::runtime_error("Swap chain image(or depth) format has changed!");
             }
+
+            retiredSwapChains.push_back({std::move(oldSwapChain), KnoxicSwapChain::framesInFlight()});
         }
+        swapChainGeneration++;
     }
 
     void KnoxicRenderer::createCommandBuffers() {
-        commandBuffers.resize(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT);
+        commandBuffers.resize(KnoxicSwapChain::framesInFlight());
 
         VkCommandBufferAllocateInfo allocateInfo{};
         allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -61,6 +65,13 @@ namespace knoxic {
         commandBuffers.clear();
     }
 
+    void KnoxicRenderer::waitForFrameSlot() {
+        assert(!isFrameStarted && "Can't wait for a frame slot while a frame is in progress");
+
+        knoxicSwapChain->waitForLastPresent(PRESENT_WAIT_TIMEOUT);
+        knoxicSwapChain->waitForFrameFence();
+    }
+
     VkCommandBuffer KnoxicRenderer::beginFrame() {
         assert(!isFrameStarted && "Can't call beginFrame while allready in progress");
 
@@ -75,6 +86,7 @@ namespace knoxic {
             throw std::runtime_error("failed to acquire swap chain image!");
         }
 
+        releaseRetiredSwapChains();
         isFrameStarted = true;
 
         auto commandBuffer = getCurrentCommandBuffer();
@@ -88,7 +100,7 @@ namespace knoxic {
         return commandBuffer;
     }
     
-    void KnoxicRenderer::endFrame() {
+    void KnoxicRenderer::endFrame(const std::vector<VkSemaphore> &waitSemaphores, const std::vector<VkPipelineStageFlags> &waitStages) {
         assert(isFrameStarted && "Can't call endFrame while frame is not in progress");
         auto commandBuffer = getCurrentCommandBuffer();
 
@@ -96,7 +108,7 @@ namespace knoxic {
             throw std::runtime_error("failed to record command buffer!");
         }
 
-        auto result = knoxicSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+        auto result = knoxicSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex, waitSemaphores, waitStages);
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || knoxicWindow.wasWindowResized()) {
             knoxicWindow.resetWindowResizedFlag();
             recreateSwapChain();
@@ -105,21 +117,45 @@ namespace knoxic {
         }
 
         isFrameStarted = false;
-        currentFrameIndex = (currentFrameIndex + 1) % KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT;
+        currentFrameIndex = (currentFrameIndex + 1) % KnoxicSwapChain::framesInFlight();
+    }
+
+    void KnoxicRenderer::releaseRetiredSwapChains() {
+        // Acquire waited on this frame slot's fence. Once every slot has been waited on since a swap chain was
+        // retired, nothing submitted with it is still running
+        for (auto &retired : retiredSwapChains) {
+            retired.framesLeft--;
+        }
+        retiredSwapChains.erase(
+            std::remove_if(retiredSwapChains.begin(), retiredSwapChains.end(),
+                [](const RetiredSwapChain &retired) { return retired.framesLeft <= 0; }),
+            retiredSwapChains.end());
     }
 
     void KnoxicRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
         assert(isFrameStarted && "Can't call beginSwapChainRenderPass while frame is not in progress");
         assert(commandBuffer == getCurrentCommandBuffer() && "Can't begin render pass on command buffer from a different frame");
 
+        beginSwapChainPass(commandBuffer, knoxicSwapChain->getRenderPass());
+    }
+
+    void KnoxicRenderer::resumeSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+        assert(isFrameStarted && "Can't call resumeSwapChainRenderPass while frame is not in progress");
+        assert(commandBuffer == getCurrentCommandBuffer() && "Can't begin render pass on command buffer from a different frame");
+
+        beginSwapChainPass(commandBuffer, knoxicSwapChain->getResumeRenderPass());
+    }
+
+    void KnoxicRenderer::beginSwapChainPass(VkCommandBuffer commandBuffer, VkRenderPass renderPass) {
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = knoxicSwapChain->getRenderPass();
+        renderPassInfo.renderPass = renderPass;
         renderPassInfo.framebuffer = knoxicSwapChain->getFrameBuffer(currentImageIndex);
 
         renderPassInfo.renderArea.offset = {0, 0};
         renderPassInfo.renderArea.extent = knoxicSwapChain->getSwapChainExtent();
 
+        // The resume pass still clears depth, so both passes take the same values
         std::array<VkClearValue, 2> clearValues{};
         clearValues[0].color = {0.0f, 0.0f, 0.0f, 1.0f}; // window background color
         clearValues[1].depthStencil = {1.0f, 0};
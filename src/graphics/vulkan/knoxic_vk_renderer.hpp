@@ -20,6 +20,12 @@ namespace knoxic {
 
         VkRenderPass getSwapChainRenderPass() const { return knoxicSwapChain->getRenderPass(); }
         VkExtent2D getSwapChainExtent() const { return knoxicSwapChain->getSwapChainExtent(); }
+        VkFormat getSwapChainImageFormat() const { return knoxicSwapChain->getSwapChainImageFormat(); }
+        size_t getSwapChainImageCount() const { return knoxicSwapChain->imageCount(); }
+        VkImageView getSwapChainImageView(int index) const { return knoxicSwapChain->getImageView(index); }
+
+        // Bumped every time the swap chain is recreated, anything holding its image views must rebuild
+        uint32_t getSwapChainGeneration() const { return swapChainGeneration; }
         float getAspectRatio() const { return knoxicSwapChain->extentAspectRatio(); }
         bool isFrameInProgress() const { return isFrameStarted; }
 
@@ -33,23 +39,50 @@ namespace knoxic {
             return currentFrameIndex;
         }
 
+        uint32_t getImageIndex() const {
+            assert(isFrameStarted && "Cannot get image index when frame is not in progress");
+            return currentImageIndex;
+        }
+
+        // Low-latency pacing, called before input is sampled. Waits until the last frame is on screen where
+        // VK_KHR_present_wait is available, then for the next frame slot, so beginFrame starts recording right away
+        void waitForFrameSlot();
+        bool supportsPresentPacing() const { return knoxicDevice.supportsPresentWait(); }
+
         VkCommandBuffer beginFrame();
-        void endFrame();
+        // Waits are for work the frame submitted before its own command buffer (render graph batches)
+        void endFrame(const std::vector<VkSemaphore> &waitSemaphores = {}, const std::vector<VkPipelineStageFlags> &waitStages = {});
         void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+
+        // Continues on the image without clearing it, after a pass that already wrote the swap chain
+        void resumeSwapChainRenderPass(VkCommandBuffer commandBuffer);
         void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
     private:
+        // A minimized or occluded window may never present, pacing gives up after this long
+        static constexpr uint64_t PRESENT_WAIT_TIMEOUT = 100ull * 1000 * 1000; // 100 ms in ns
+
         void createCommandBuffers();
         void freeCommandBuffers();
         void recreateSwapChain();
+        void releaseRetiredSwapChains();
+        void beginSwapChainPass(VkCommandBuffer commandBuffer, VkRenderPass renderPass);
 
         KnoxicWindow &knoxicWindow;
         KnoxicDevice &knoxicDevice;
         std::unique_ptr<KnoxicSwapChain> knoxicSwapChain;
+
+        // Replaced swap chains, kept until the frames that were submitted with them have finished
+        struct RetiredSwapChain {
+            std::shared_ptr<KnoxicSwapChain> swapChain;
+            int framesLeft;
+        };
+        std::vector<RetiredSwapChain> retiredSwapChains;
         std::vector<VkCommandBuffer> commandBuffers;
 
         uint32_t currentImageIndex;
         int currentFrameIndex{0};
         bool isFrameStarted{false};
+        uint32_t swapChainGeneration{0};
     };
 }
\ No newline at end of file
@@ -1,11 +1,27 @@
 #include "app/app.hpp"
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <exception>
 
-int main() {
-    knoxic::App app{};
+int main(int argc, char **argv) {
+    // --deferred selects the G-buffer renderer, forward is the default.
+    // --frames-in-flight 3 lets the CPU run a frame further ahead, for throughput over latency.
+    // --low-latency starts with input sampled after the GPU caught up and the camera latched late
+    knoxic::RenderPath renderPath = knoxic::RenderPath::Forward;
+    bool lowLatency = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--deferred") == 0) {
+            renderPath = knoxic::RenderPath::Deferred;
+        } else if (std::strcmp(argv[i], "--low-latency") == 0) {
+            lowLatency = true;
+        } else if (std::strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+            knoxic::KnoxicSwapChain::setFramesInFlight(std::atoi(argv[++i]));
+        }
+    }
+
+    knoxic::App app{renderPath, lowLatency};
 
     try {
         app.run();
@@ -535,6 +535,7 @@ namespace knoxic {
                 transform.translation = glm::vec3(translation[0], translation[1], translation[2]);
                 transform.rotation = glm::vec3(rotation[0], rotation[1], rotation[2]);
                 transform.scale = glm::vec3(scale[0], scale[1], scale[2]);
+                gCoordinator.MarkComponentChanged<TransformComponent>(mSelectedEntity);
             }
         }
 
@@ -573,18 +574,21 @@ namespace knoxic {
                     float translation[3] = {transform.translation.x, transform.translation.y, transform.translation.z};
                     if (ImGui::DragFloat3("##Position", translation, 0.1f)) {
                         transform.translation = {translation[0], translation[1], translation[2]};
+                        gCoordinator.MarkComponentChanged<TransformComponent>(mSelectedEntity);
                     }
 
                     ImGui::Text("Rotation");
                     float rotation[3] = {transform.rotation.x, transform.rotation.y, transform.rotation.z};
                     if (ImGui::DragFloat3("##Rotation", rotation, 0.01f)) {
                         transform.rotation = {rotation[0], rotation[1], rotation[2]};
+                        gCoordinator.MarkComponentChanged<TransformComponent>(mSelectedEntity);
                     }
 
                     ImGui::Text("Scale");
                     float scale[3] = {transform.scale.x, transform.scale.y, transform.scale.z};
                     if (ImGui::DragFloat3("##Scale", scale, 0.1f)) {
                         transform.scale = {scale[0], scale[1], scale[2]};
+                        gCoordinator.MarkComponentChanged<TransformComponent>(mSelectedEntity);
                     }
                     ImGui::PopItemWidth();
                 }
@@ -606,6 +610,7 @@ namespace knoxic {
                 if (ImGui::CollapsingHeader("Point Light Component", ImGuiTreeNodeFlags_DefaultOpen)) {
                     auto& light = gCoordinator.GetComponent<PointLightComponent>(mSelectedEntity);
                     ImGui::DragFloat("Intensity", &light.lightIntensity, 0.1f, 0.0f, 10.0f);
+                    ImGui::DragFloat("Range (0 = auto)", &light.range, 0.1f, 0.0f, 100.0f);
                 }
             }
 
@@ -616,6 +621,7 @@ namespace knoxic {
                     ImGui::DragFloat("Intensity", &light.lightIntensity, 0.1f, 0.0f, 10.0f);
                     ImGui::DragFloat("Inner Cutoff", &light.innerCutoff, 0.1f, 0.0f, 90.0f);
                     ImGui::DragFloat("Outer Cutoff", &light.outerCutoff, 0.1f, 0.0f, 90.0f);
+                    ImGui::DragFloat("Range (0 = auto)", &light.range, 0.1f, 0.0f, 100.0f);
                 }
             }
 
@@ -758,6 +764,11 @@ namespace knoxic {
                         ImGui::Spacing();
                         ImGui::Separator();
                         ImGui::Spacing();
+
+                        bool unlit = props.unlit;
+                        if (ImGui::Checkbox("Unlit", &unlit)) {
+                            mat->setUnlit(unlit);
+                        }
                     }
                 }
             }
@@ -769,6 +780,14 @@ namespace knoxic {
                     ImGui::Text("(Model info display not yet implemented)");
                 }
             }
+
+            // Display Occluder Component
+            if (gCoordinator.HasComponent<OccluderComponent>(mSelectedEntity)) {
+                if (ImGui::CollapsingHeader("Occluder Component", ImGuiTreeNodeFlags_DefaultOpen)) {
+                    auto& occluder = gCoordinator.GetComponent<OccluderComponent>(mSelectedEntity);
+                    ImGui::Checkbox("Enabled", &occluder.enabled);
+                }
+            }
         } else {
             ImGui::PopStyleColor(3);
         }
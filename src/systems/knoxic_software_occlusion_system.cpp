@@ -0,0 +1,386 @@
+#include "knoxic_software_occlusion_system.hpp"
+#include "../core/ecs/components.hpp"
+#include "../core/ecs/coordinator_instance.hpp"
+#include "../graphics/vulkan/knoxic_vk_model.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KNOXIC_SOFTWARE_OCCLUSION_SSE 1
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace knoxic {
+
+    SoftwareOcclusionSystem::SoftwareOcclusionSystem(
+        std::shared_ptr<RenderableSystem> ecsRenderableSystem,
+        std::shared_ptr<OccluderECSSystem> ecsOccluderSystem
+    ) : renderableSystem{std::move(ecsRenderableSystem)}, occluderSystem{std::move(ecsOccluderSystem)} {
+        depthBuffer.resize(BUFFER_WIDTH * BUFFER_HEIGHT, 1.0f);
+        tileMaxDepth.resize(TILES_X * TILES_Y, 1.0f);
+        visibility.resize(MAX_ENTITIES, 1);
+
+        // The calling thread rasterizes too
+        unsigned int hardwareThreads = std::thread::hardware_concurrency();
+        unsigned int workerCount = hardwareThreads > 1 ? std::min(hardwareThreads - 1, 3u) : 1u;
+        for (unsigned int i = 0; i < workerCount; i++) {
+            workers.emplace_back(&SoftwareOcclusionSystem::workerLoop, this);
+        }
+    }
+
+    SoftwareOcclusionSystem::~SoftwareOcclusionSystem() {
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            stopWorkers = true;
+        }
+        jobStart.notify_all();
+
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+
+    void SoftwareOcclusionSystem::workerLoop() {
+        uint64_t seenGeneration = 0;
+
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(jobMutex);
+                jobStart.wait(lock, [&] { return stopWorkers || jobGeneration != seenGeneration; });
+                if (stopWorkers) return;
+                seenGeneration = jobGeneration;
+            }
+
+            rasterizeTileRows();
+
+            {
+                std::lock_guard<std::mutex> lock(jobMutex);
+                workersBusy--;
+            }
+            jobDone.notify_one();
+        }
+    }
+
+    void SoftwareOcclusionSystem::update(const KnoxicCamera &camera) {
+        occludedCount = 0;
+        std::fill(visibility.begin(), visibility.end(), 1);
+
+        if (!enabled) return;
+
+        glm::mat4 viewProjection = camera.getProjection() * camera.getView();
+
+        triangles.clear();
+        gatherOccluders(viewProjection);
+
+        // Nothing can be hidden without occluders
+        if (triangles.empty()) return;
+
+        // Rasterize on the workers and this thread
+        nextTileRow.store(0);
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            jobGeneration++;
+            workersBusy = static_cast<uint32_t>(workers.size());
+        }
+        jobStart.notify_all();
+
+        rasterizeTileRows();
+
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobDone.wait(lock, [&] { return workersBusy == 0; });
+        }
+
+        // Test everything that isn't an occluder itself
+        for (auto entity : renderableSystem->mEntities) {
+            if (gCoordinator.HasComponent<OccluderComponent>(entity)) continue;
+
+            auto &transform = gCoordinator.GetComponent<TransformComponent>(entity);
+            auto &modelComp = gCoordinator.GetComponent<ModelComponent>(entity);
+            if (!modelComp.model) continue;
+
+            glm::mat4 modelViewProjection = viewProjection * transform.mat4();
+            if (!testBounds(modelViewProjection, modelComp.model->getBoundsMin(), modelComp.model->getBoundsMax())) {
+                visibility[entity] = 0;
+                occludedCount++;
+            }
+        }
+    }
+
+    void SoftwareOcclusionSystem::gatherOccluders(const glm::mat4 &viewProjection) {
+        for (auto entity : occluderSystem->mEntities) {
+            if (!gCoordinator.GetComponent<OccluderComponent>(entity).enabled) continue;
+
+            auto &transform = gCoordinator.GetComponent<TransformComponent>(entity);
+            auto &modelComp = gCoordinator.GetComponent<ModelComponent>(entity);
+            if (!modelComp.model) continue;
+
+            const auto &positions = modelComp.model->getPositions();
+            const auto &indices = modelComp.model->getIndices();
+            glm::mat4 modelViewProjection = viewProjection * transform.mat4();
+
+            clipPositions.resize(positions.size());
+            for (size_t i = 0; i < positions.size(); i++) {
+                clipPositions[i] = modelViewProjection * glm::vec4(positions[i], 1.0f);
+            }
+
+            size_t elementCount = indices.empty() ? positions.size() : indices.size();
+            for (size_t i = 0; i + 2 < elementCount; i += 3) {
+                const glm::vec4 &v0 = clipPositions[indices.empty() ? i : indices[i]];
+                const glm::vec4 &v1 = clipPositions[indices.empty() ? i + 1 : indices[i + 1]];
+                const glm::vec4 &v2 = clipPositions[indices.empty() ? i + 2 : indices[i + 2]];
+
+                // Trivially reject triangles fully outside one side of the frustum
+                if (v0.x > v0.w && v1.x > v1.w && v2.x > v2.w) continue;
+                if (v0.x < -v0.w && v1.x < -v1.w && v2.x < -v2.w) continue;
+                if (v0.y > v0.w && v1.y > v1.w && v2.y > v2.w) continue;
+                if (v0.y < -v0.w && v1.y < -v1.w && v2.y < -v2.w) continue;
+                if (v0.z > v0.w && v1.z > v1.w && v2.z > v2.w) continue;
+
+                addClippedTriangle(v0, v1, v2);
+            }
+        }
+    }
+
+    void SoftwareOcclusionSystem::addClippedTriangle(const glm::vec4 &v0, const glm::vec4 &v1, const glm::vec4 &v2) {
+        // Clip against the near plane (z >= 0 in clip space), may produce a quad
+        const glm::vec4 input[3] = {v0, v1, v2};
+        glm::vec4 output[4];
+        int outputCount = 0;
+
+        for (int i = 0; i < 3; i++) {
+            const glm::vec4 &current = input[i];
+            const glm::vec4 &next = input[(i + 1) % 3];
+            bool currentInside = current.z >= 0.0f;
+            bool nextInside = next.z >= 0.0f;
+
+            if (currentInside) {
+                output[outputCount++] = current;
+            }
+            if (currentInside != nextInside) {
+                float t = current.z / (current.z - next.z);
+                output[outputCount++] = current + (next - current) * t;
+            }
+        }
+
+        for (int i = 1; i + 1 < outputCount; i++) {
+            addScreenTriangle(output[0], output[i], output[i + 1]);
+        }
+    }
+
+    void SoftwareOcclusionSystem::addScreenTriangle(const glm::vec4 &c0, const glm::vec4 &c1, const glm::vec4 &c2) {
+        if (c0.w <= 0.0f || c1.w <= 0.0f || c2.w <= 0.0f) return;
+
+        auto toScreen = [](const glm::vec4 &clip) {
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            return glm::vec3(
+                (ndc.x * 0.5f + 0.5f) * BUFFER_WIDTH,
+                (ndc.y * 0.5f + 0.5f) * BUFFER_HEIGHT,
+                ndc.z
+            );
+        };
+
+        glm::vec3 v[3] = {toScreen(c0), toScreen(c1), toScreen(c2)};
+
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+        if (std::abs(area) < 1e-6f) return;
+
+        // Occluders are treated as double sided, so make the winding positive
+        if (area < 0.0f) {
+            std::swap(v[1], v[2]);
+            area = -area;
+        }
+
+        RasterTriangle triangle{};
+        triangle.minX = std::min({v[0].x, v[1].x, v[2].x});
+        triangle.minY = std::min({v[0].y, v[1].y, v[2].y});
+        triangle.maxX = std::max({v[0].x, v[1].x, v[2].x});
+        triangle.maxY = std::max({v[0].y, v[1].y, v[2].y});
+
+        if (triangle.maxX < 0.0f || triangle.maxY < 0.0f ||
+            triangle.minX >= BUFFER_WIDTH || triangle.minY >= BUFFER_HEIGHT) {
+            return;
+        }
+
+        // Edge i runs from v[i] to v[i + 1], positive inside
+        for (int i = 0; i < 3; i++) {
+            const glm::vec3 &a = v[i];
+            const glm::vec3 &b = v[(i + 1) % 3];
+            triangle.edgeA[i] = a.y - b.y;
+            triangle.edgeB[i] = b.x - a.x;
+            triangle.edgeC[i] = -triangle.edgeA[i] * a.x - triangle.edgeB[i] * a.y;
+        }
+
+        // Depth plane z = A * x + B * y + C
+        float dz1 = v[1].z - v[0].z;
+        float dz2 = v[2].z - v[0].z;
+        triangle.depthA = (dz1 * (v[2].y - v[0].y) - dz2 * (v[1].y - v[0].y)) / area;
+        triangle.depthB = (dz2 * (v[1].x - v[0].x) - dz1 * (v[2].x - v[0].x)) / area;
+        triangle.depthC = v[0].z - triangle.depthA * v[0].x - triangle.depthB * v[0].y;
+
+        triangles.push_back(triangle);
+    }
+
+    void SoftwareOcclusionSystem::rasterizeTileRows() {
+        int tileRow;
+        while ((tileRow = nextTileRow.fetch_add(1)) < TILES_Y) {
+            rasterizeTileRow(tileRow);
+        }
+    }
+
+    void SoftwareOcclusionSystem::rasterizeTileRow(int tileRow) {
+        const int rowStart = tileRow * TILE_SIZE;
+        const int rowEnd = rowStart + TILE_SIZE;
+
+        // Each tile row owns its part of the buffer, no locking needed
+        std::fill(depthBuffer.begin() + rowStart * BUFFER_WIDTH, depthBuffer.begin() + rowEnd * BUFFER_WIDTH, 1.0f);
+
+        for (const auto &triangle : triangles) {
+            int minY = std::max(rowStart, static_cast<int>(triangle.minY));
+            int maxY = std::min(rowEnd - 1, static_cast<int>(triangle.maxY));
+            if (minY > maxY) continue;
+
+            // Start on a 4 pixel boundary, the buffer width is a multiple of 4
+            int minX = std::max(0, static_cast<int>(triangle.minX)) & ~3;
+            int maxX = std::min(BUFFER_WIDTH - 1, static_cast<int>(triangle.maxX));
+
+            for (int y = minY; y <= maxY; y++) {
+                float py = static_cast<float>(y) + 0.5f;
+                float *row = &depthBuffer[y * BUFFER_WIDTH];
+
+                float rowEdge0 = triangle.edgeB[0] * py + triangle.edgeC[0];
+                float rowEdge1 = triangle.edgeB[1] * py + triangle.edgeC[1];
+                float rowEdge2 = triangle.edgeB[2] * py + triangle.edgeC[2];
+                float rowDepth = triangle.depthB * py + triangle.depthC;
+
+#ifdef KNOXIC_SOFTWARE_OCCLUSION_SSE
+                const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+                const __m128 zero = _mm_setzero_ps();
+                const __m128 a0 = _mm_set1_ps(triangle.edgeA[0]);
+                const __m128 a1 = _mm_set1_ps(triangle.edgeA[1]);
+                const __m128 a2 = _mm_set1_ps(triangle.edgeA[2]);
+                const __m128 e0Row = _mm_set1_ps(rowEdge0);
+                const __m128 e1Row = _mm_set1_ps(rowEdge1);
+                const __m128 e2Row = _mm_set1_ps(rowEdge2);
+                const __m128 depthA = _mm_set1_ps(triangle.depthA);
+                const __m128 depthRow = _mm_set1_ps(rowDepth);
+
+                for (int x = minX; x <= maxX; x += 4) {
+                    __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+
+                    __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), e0Row);
+                    __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), e1Row);
+                    __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), e2Row);
+
+                    // Coverage mask of the 4 pixels
+                    __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+                    if (_mm_movemask_ps(inside) == 0) continue;
+
+                    __m128 depth = _mm_add_ps(_mm_mul_ps(depthA, px), depthRow);
+                    __m128 current = _mm_loadu_ps(row + x);
+                    __m128 nearest = _mm_min_ps(current, depth);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+                }
+#else
+                for (int x = minX; x <= maxX; x++) {
+                    float px = static_cast<float>(x) + 0.5f;
+                    if (triangle.edgeA[0] * px + rowEdge0 < 0.0f) continue;
+                    if (triangle.edgeA[1] * px + rowEdge1 < 0.0f) continue;
+                    if (triangle.edgeA[2] * px + rowEdge2 < 0.0f) continue;
+
+                    float depth = triangle.depthA * px + rowDepth;
+                    row[x] = std::min(row[x], depth);
+                }
+#endif
+            }
+        }
+
+        // Farthest depth per tile for the coarse test
+        for (int tileX = 0; tileX < TILES_X; tileX++) {
+            float maxDepth = 0.0f;
+            for (int y = rowStart; y < rowEnd; y++) {
+                const float *row = &depthBuffer[y * BUFFER_WIDTH + tileX * TILE_SIZE];
+                for (int x = 0; x < TILE_SIZE; x++) {
+                    maxDepth = std::max(maxDepth, row[x]);
+                }
+            }
+            tileMaxDepth[tileRow * TILES_X + tileX] = maxDepth;
+        }
+    }
+
+    bool SoftwareOcclusionSystem::testBounds(const glm::mat4 &modelViewProjection, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) const {
+        float minX = std::numeric_limits<float>::max();
+        float minY = std::numeric_limits<float>::max();
+        float maxX = std::numeric_limits<float>::lowest();
+        float maxY = std::numeric_limits<float>::lowest();
+        float minDepth = std::numeric_limits<float>::max();
+
+        for (int i = 0; i < 8; i++) {
+            glm::vec3 corner{
+                (i & 1) ? boundsMax.x : boundsMin.x,
+                (i & 2) ? boundsMax.y : boundsMin.y,
+                (i & 4) ? boundsMax.z : boundsMin.z
+            };
+            glm::vec4 clip = modelViewProjection * glm::vec4(corner, 1.0f);
+
+            // Crosses the near plane, can't be tested
+            if (clip.w <= 0.0f || clip.z < 0.0f) return true;
+
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            float screenX = (ndc.x * 0.5f + 0.5f) * BUFFER_WIDTH;
+            float screenY = (ndc.y * 0.5f + 0.5f) * BUFFER_HEIGHT;
+            minX = std::min(minX, screenX);
+            minY = std::min(minY, screenY);
+            maxX = std::max(maxX, screenX);
+            maxY = std::max(maxY, screenY);
+            minDepth = std::min(minDepth, ndc.z);
+        }
+
+        // Off screen or past the far plane
+        if (maxX < 0.0f || maxY < 0.0f || minX >= BUFFER_WIDTH || minY >= BUFFER_HEIGHT || minDepth > 1.0f) {
+            return false;
+        }
+
+        int x0 = std::max(0, static_cast<int>(std::floor(minX)));
+        int y0 = std::max(0, static_cast<int>(std::floor(minY)));
+        int x1 = std::min(BUFFER_WIDTH - 1, static_cast<int>(std::floor(maxX)));
+        int y1 = std::min(BUFFER_HEIGHT - 1, static_cast<int>(std::floor(maxY)));
+
+        for (int tileY = y0 / TILE_SIZE; tileY <= y1 / TILE_SIZE; tileY++) {
+            for (int tileX = x0 / TILE_SIZE; tileX <= x1 / TILE_SIZE; tileX++) {
+                // Whole tile is in front of the bounds
+                if (tileMaxDepth[tileY * TILES_X + tileX] < minDepth) continue;
+
+                int startX = std::max(x0, tileX * TILE_SIZE);
+                int endX = std::min(x1, tileX * TILE_SIZE + TILE_SIZE - 1);
+                int startY = std::max(y0, tileY * TILE_SIZE);
+                int endY = std::min(y1, tileY * TILE_SIZE + TILE_SIZE - 1);
+
+                for (int y = startY; y <= endY; y++) {
+                    const float *row = &depthBuffer[y * BUFFER_WIDTH];
+#ifdef KNOXIC_SOFTWARE_OCCLUSION_SSE
+                    const __m128 laneOffsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+                    const __m128 boundsDepth = _mm_set1_ps(minDepth);
+                    const __m128 first = _mm_set1_ps(static_cast<float>(startX));
+                    const __m128 last = _mm_set1_ps(static_cast<float>(endX));
+
+                    for (int x = startX & ~3; x <= endX; x += 4) {
+                        __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+                        __m128 inRange = _mm_and_ps(_mm_cmpge_ps(px, first), _mm_cmple_ps(px, last));
+                        __m128 behind = _mm_cmpge_ps(_mm_loadu_ps(row + x), boundsDepth);
+                        if (_mm_movemask_ps(_mm_and_ps(inRange, behind)) != 0) return true;
+                    }
+#else
+                    for (int x = startX; x <= endX; x++) {
+                        if (row[x] >= minDepth) return true;
+                    }
+#endif
+                }
+            }
+        }
+
+        return false;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "../camera/knoxic_camera.hpp"
+#include "../core/ecs/ecs_systems.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace knoxic {
+
+    // CPU occlusion culling.
+    // Occluder meshes are rasterized into a small depth buffer on worker threads (4 pixels per SIMD lane group),
+    // then the bounds of every other renderable are tested against it before any draw is recorded.
+    class SoftwareOcclusionSystem {
+    public:
+        static constexpr int BUFFER_WIDTH = 320;
+        static constexpr int BUFFER_HEIGHT = 192;
+        static constexpr int TILE_SIZE = 8;
+        static constexpr int TILES_X = BUFFER_WIDTH / TILE_SIZE;
+        static constexpr int TILES_Y = BUFFER_HEIGHT / TILE_SIZE;
+
+        SoftwareOcclusionSystem(
+            std::shared_ptr<RenderableSystem> ecsRenderableSystem,
+            std::shared_ptr<OccluderECSSystem> ecsOccluderSystem
+        );
+        ~SoftwareOcclusionSystem();
+
+        SoftwareOcclusionSystem(const SoftwareOcclusionSystem &) = delete;
+        SoftwareOcclusionSystem &operator=(const SoftwareOcclusionSystem &) = delete;
+
+        bool isEnabled() const { return enabled; }
+        void setEnabled(bool value) { enabled = value; }
+
+        // Rasterize occluders and test all renderables for this camera
+        void update(const KnoxicCamera &camera);
+
+        bool isVisible(Entity entity) const { return !enabled || visibility[entity] != 0; }
+        uint32_t getOccludedCount() const { return occludedCount; }
+        uint32_t getOccluderTriangleCount() const { return static_cast<uint32_t>(triangles.size()); }
+
+    private:
+        // Screen space triangle setup: edge functions and depth plane
+        struct RasterTriangle {
+            float minX, minY, maxX, maxY;
+            float edgeA[3], edgeB[3], edgeC[3];
+            float depthA, depthB, depthC;
+        };
+
+        void gatherOccluders(const glm::mat4 &viewProjection);
+        void addClippedTriangle(const glm::vec4 &v0, const glm::vec4 &v1, const glm::vec4 &v2);
+        void addScreenTriangle(const glm::vec4 &c0, const glm::vec4 &c1, const glm::vec4 &c2);
+
+        void rasterizeTileRows();
+        void rasterizeTileRow(int tileRow);
+        bool testBounds(const glm::mat4 &modelViewProjection, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) const;
+
+        void workerLoop();
+
+        std::shared_ptr<RenderableSystem> renderableSystem;
+        std::shared_ptr<OccluderECSSystem> occluderSystem;
+
+        bool enabled = true;
+        uint32_t occludedCount = 0;
+
+        std::vector<RasterTriangle> triangles;
+        std::vector<glm::vec4> clipPositions; // Scratch for the occluder being gathered
+        std::vector<float> depthBuffer;
+        std::vector<float> tileMaxDepth;
+        std::vector<uint8_t> visibility;
+
+        // Worker threads, each pulls tile rows until none are left
+        std::vector<std::thread> workers;
+        std::mutex jobMutex;
+        std::condition_variable jobStart;
+        std::condition_variable jobDone;
+        uint64_t jobGeneration = 0;
+        uint32_t workersBusy = 0;
+        bool stopWorkers = false;
+        std::atomic<int> nextTileRow{0};
+    };
+}
\ No newline at end of file
@@ -0,0 +1,201 @@
+#include "knoxic_vk_deferred_lighting_system.hpp"
+#include "../../core/vulkan/knoxic_vk_swap_chain.hpp"
+
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+namespace knoxic {
+
+    DeferredLightingSystem::DeferredLightingSystem(KnoxicDevice &device, PostProcessSystem &postProcessSystem, VkDescriptorSetLayout globalSetLayout)
+        : knoxicDevice{device}, postProcessSystem{postProcessSystem} {
+        createDescriptorSetLayout();
+        createPipelineLayout(globalSetLayout);
+        createPipelines();
+        // Descriptor sets point at the render graph's G-buffer, see recreate()
+    }
+
+    DeferredLightingSystem::~DeferredLightingSystem() {
+        vkDeviceWaitIdle(knoxicDevice.device());
+
+        spotLightPipeline.reset();
+        pointLightPipeline.reset();
+        directionalPipeline.reset();
+        vkDestroyPipelineLayout(knoxicDevice.device(), pipelineLayout, nullptr);
+
+        descriptorPool.reset();
+        gbufferSetLayout.reset();
+    }
+
+    void DeferredLightingSystem::recreate() {
+        vkDeviceWaitIdle(knoxicDevice.device());
+
+        descriptorPool.reset();
+        createDescriptorSets();
+    }
+
+    void DeferredLightingSystem::createDescriptorSetLayout() {
+        // Albedo, normal, material, depth
+        gbufferSetLayout = KnoxicDescriptorSetLayout::Builder(knoxicDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(2, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(3, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .build();
+    }
+
+    void DeferredLightingSystem::createDescriptorSets() {
+        descriptorPool = KnoxicDescriptorPool::Builder(knoxicDevice)
+            .setMaxSets(KnoxicSwapChain::framesInFlight())
+            .addPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, KnoxicSwapChain::framesInFlight() * 4)
+            .build();
+
+        gbufferDescriptorSets.resize(KnoxicSwapChain::framesInFlight());
+        for (size_t i = 0; i < gbufferDescriptorSets.size(); i++) {
+            int frameIndex = static_cast<int>(i);
+
+            std::array<VkDescriptorImageInfo, 4> imageInfos{};
+            for (int target = 0; target < PostProcessSystem::GBUFFER_COUNT; target++) {
+                imageInfos[target].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                imageInfos[target].imageView = postProcessSystem.getGBufferImageView(target, frameIndex);
+                imageInfos[target].sampler = VK_NULL_HANDLE;
+            }
+            imageInfos[3].imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+            imageInfos[3].imageView = postProcessSystem.getHDRDepthImageView(frameIndex);
+            imageInfos[3].sampler = VK_NULL_HANDLE;
+
+            KnoxicDescriptorWriter(*gbufferSetLayout, *descriptorPool)
+                .writeImage(0, &imageInfos[0])
+                .writeImage(1, &imageInfos[1])
+                .writeImage(2, &imageInfos[2])
+                .writeImage(3, &imageInfos[3])
+                .build(gbufferDescriptorSets[i]);
+        }
+    }
+
+    void DeferredLightingSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
+        std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts{
+            globalSetLayout,
+            gbufferSetLayout->getDescriptorSetLayout()
+        };
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount = 0;
+        pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+        if (vkCreatePipelineLayout(knoxicDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create deferred lighting pipeline layout!");
+        }
+    }
+
+    void DeferredLightingSystem::createPipelines() {
+        assert(pipelineLayout != nullptr && "Cannot create pipelines before pipeline layout");
+
+        // Lighting accumulates onto the emission written by the G-buffer subpass
+        auto setAdditive = [](PipelineConfigInfo &pipelineConfig) {
+            pipelineConfig.colorBlendAttachment.blendEnable = VK_TRUE;
+            pipelineConfig.colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            pipelineConfig.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            pipelineConfig.colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+            pipelineConfig.colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+            pipelineConfig.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            pipelineConfig.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+        };
+
+        // Fullscreen triangle for ambient and directional lights
+        {
+            PipelineConfigInfo pipelineConfig{};
+            KnoxicPipeline::defaultPipelineConfigInfo(pipelineConfig);
+            setAdditive(pipelineConfig);
+            pipelineConfig.bindingDescriptions.clear();
+            pipelineConfig.attributeDescriptions.clear();
+            pipelineConfig.renderPass = postProcessSystem.getGBufferRenderPass();
+            pipelineConfig.subpass = 1;
+            pipelineConfig.pipelineLayout = pipelineLayout;
+            pipelineConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
+            pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+            pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_NONE;
+
+            directionalPipeline = std::make_unique<KnoxicPipeline>(
+                knoxicDevice,
+                "shaders/vk_post_process.vert.spv",
+                "shaders/vk_deferred_directional.frag.spv",
+                pipelineConfig
+            );
+        }
+
+        // Light volumes, back faces behind the surface
+        VkSpecializationMapEntry mapEntry{};
+        mapEntry.constantID = 0;
+        mapEntry.offset = 0;
+        mapEntry.size = sizeof(VkBool32);
+
+        for (VkBool32 spotLight : {VK_FALSE, VK_TRUE}) {
+            VkSpecializationInfo specializationInfo{};
+            specializationInfo.mapEntryCount = 1;
+            specializationInfo.pMapEntries = &mapEntry;
+            specializationInfo.dataSize = sizeof(VkBool32);
+            specializationInfo.pData = &spotLight;
+
+            PipelineConfigInfo pipelineConfig{};
+            KnoxicPipeline::defaultPipelineConfigInfo(pipelineConfig);
+            setAdditive(pipelineConfig);
+            pipelineConfig.bindingDescriptions.clear();
+            pipelineConfig.attributeDescriptions.clear();
+            pipelineConfig.renderPass = postProcessSystem.getGBufferRenderPass();
+            pipelineConfig.subpass = 1;
+            pipelineConfig.pipelineLayout = pipelineLayout;
+            pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+            pipelineConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+            pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_FRONT_BIT;
+            pipelineConfig.vertexSpecializationInfo = &specializationInfo;
+            pipelineConfig.fragmentSpecializationInfo = &specializationInfo;
+
+            auto pipeline = std::make_unique<KnoxicPipeline>(
+                knoxicDevice,
+                "shaders/vk_deferred_light_volume.vert.spv",
+                "shaders/vk_deferred_light_volume.frag.spv",
+                pipelineConfig
+            );
+
+            if (spotLight) {
+                spotLightPipeline = std::move(pipeline);
+            } else {
+                pointLightPipeline = std::move(pipeline);
+            }
+        }
+    }
+
+    void DeferredLightingSystem::render(FrameInfo &frameInfo, uint32_t pointLightCount, uint32_t spotLightCount) {
+        std::array<VkDescriptorSet, 2> descriptorSets{
+            frameInfo.globalDescriptorSet,
+            gbufferDescriptorSets[frameInfo.frameIndex]
+        };
+
+        vkCmdBindDescriptorSets(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            pipelineLayout,
+            0, static_cast<uint32_t>(descriptorSets.size()),
+            descriptorSets.data(),
+            static_cast<uint32_t>(frameInfo.globalDynamicOffsets.size()), // The G-buffer set has no dynamic bindings
+            frameInfo.globalDynamicOffsets.data()
+        );
+
+        directionalPipeline->bind(frameInfo.commandBuffer);
+        vkCmdDraw(frameInfo.commandBuffer, 3, 1, 0, 0);
+
+        if (pointLightCount > 0) {
+            pointLightPipeline->bind(frameInfo.commandBuffer);
+            vkCmdDraw(frameInfo.commandBuffer, 36, pointLightCount, 0, 0);
+        }
+
+        if (spotLightCount > 0) {
+            spotLightPipeline->bind(frameInfo.commandBuffer);
+            vkCmdDraw(frameInfo.commandBuffer, 36, spotLightCount, 0, 0);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../../core/vulkan/knoxic_vk_device.hpp"
+#include "../../core/vulkan/knoxic_vk_descriptors.hpp"
+#include "../../graphics/vulkan/knoxic_vk_pipeline.hpp"
+#include "../../graphics/knoxic_frame_info.hpp"
+#include "knoxic_vk_post_process_system.hpp"
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <vector>
+
+namespace knoxic {
+
+    // Lighting subpass of the deferred path.
+    // Ambient and directional lights are one fullscreen pass, point and spot lights are
+    // instanced volumes that only shade the pixels inside their range.
+    class DeferredLightingSystem {
+    public:
+        DeferredLightingSystem(KnoxicDevice &device, PostProcessSystem &postProcessSystem, VkDescriptorSetLayout globalSetLayout);
+        ~DeferredLightingSystem();
+
+        DeferredLightingSystem(const DeferredLightingSystem &) = delete;
+        DeferredLightingSystem &operator=(const DeferredLightingSystem &) = delete;
+
+        // Rebind the G-buffer, after every render graph compile
+        void recreate();
+
+        // Record inside the lighting subpass of the G-buffer pass
+        void render(FrameInfo &frameInfo, uint32_t pointLightCount, uint32_t spotLightCount);
+
+    private:
+        void createDescriptorSetLayout();
+        void createDescriptorSets();
+        void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+        void createPipelines();
+
+        KnoxicDevice &knoxicDevice;
+        PostProcessSystem &postProcessSystem;
+
+        std::unique_ptr<KnoxicDescriptorPool> descriptorPool;
+        std::unique_ptr<KnoxicDescriptorSetLayout> gbufferSetLayout;
+        std::vector<VkDescriptorSet> gbufferDescriptorSets;
+
+        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+        std::unique_ptr<KnoxicPipeline> directionalPipeline;
+        std::unique_ptr<KnoxicPipeline> pointLightPipeline;
+        std::unique_ptr<KnoxicPipeline> spotLightPipeline;
+    };
+}
\ No newline at end of file
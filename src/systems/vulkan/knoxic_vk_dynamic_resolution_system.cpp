@@ -0,0 +1,45 @@
+#include "knoxic_vk_dynamic_resolution_system.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace knoxic {
+
+    DynamicResolutionSystem::DynamicResolutionSystem(bool timingSupported) : supported{timingSupported} {}
+
+    void DynamicResolutionSystem::setEnabled(bool value) {
+        enabled = value && supported;
+        if (!enabled) {
+            renderScale = 1.0f;
+        }
+    }
+
+    void DynamicResolutionSystem::update(float gpuFrameTime) {
+        if (!enabled || gpuFrameTime <= 0.0f) {
+            return;
+        }
+
+        // GPU time goes roughly with the pixel count, the square of the scale. Stay put within a 5% band
+        // around the target and only move part of the way each frame so the resolution doesn't oscillate
+        float ratio = targetFrameTime / std::max(gpuFrameTime, 0.01f);
+        if (ratio > 0.95f && ratio < 1.05f) {
+            return;
+        }
+        float desiredScale = renderScale * std::sqrt(ratio);
+        renderScale += (desiredScale - renderScale) * 0.1f;
+        renderScale = std::clamp(renderScale, MIN_RENDER_SCALE, 1.0f);
+    }
+
+    VkExtent2D DynamicResolutionSystem::getRenderExtent(VkExtent2D extent) const {
+        if (renderScale >= 1.0f) {
+            return extent;
+        }
+
+        // Rounded to 8 pixels so small scale changes don't resize the rect every frame
+        auto scaled = [&](uint32_t size) {
+            uint32_t scaledSize = static_cast<uint32_t>(static_cast<float>(size) * renderScale) & ~7u;
+            return std::clamp(scaledSize, std::min(size, 8u), size);
+        };
+        return {scaled(extent.width), scaled(extent.height)};
+    }
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+namespace knoxic {
+
+    // Dynamic resolution.
+    // The render graph's timestamps measure the GPU frame time, once the frame's fence has signaled the
+    // render scale is steered towards the target frame time. The scene then renders into the top-left
+    // sub-rect of the full size targets and the composite upscales, so a new scale never reallocates anything.
+    class DynamicResolutionSystem {
+    public:
+        static constexpr float MIN_RENDER_SCALE = 0.5f;
+
+        // Without GPU timestamps it can't be turned on
+        explicit DynamicResolutionSystem(bool timingSupported);
+
+        DynamicResolutionSystem(const DynamicResolutionSystem &) = delete;
+        DynamicResolutionSystem &operator=(const DynamicResolutionSystem &) = delete;
+
+        // Off keeps the scale at 1
+        bool isSupported() const { return supported; }
+        bool isEnabled() const { return enabled; }
+        void setEnabled(bool value);
+
+        float getTargetFrameTime() const { return targetFrameTime; }
+        void setTargetFrameTime(float milliseconds) { targetFrameTime = milliseconds; }
+
+        // Picks the scale from the averaged GPU frame time in milliseconds, zero while there is none yet
+        void update(float gpuFrameTime);
+
+        float getRenderScale() const { return renderScale; }
+
+        // Sub-rect of a target with the given full extent
+        VkExtent2D getRenderExtent(VkExtent2D extent) const;
+
+    private:
+        bool supported = false;
+        bool enabled = false;
+        float targetFrameTime = 16.6f;
+        float renderScale = 1.0f;
+    };
+}
\ No newline at end of file
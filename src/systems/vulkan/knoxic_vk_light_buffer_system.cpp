@@ -0,0 +1,112 @@
+#include "knoxic_vk_light_buffer_system.hpp"
+#include "../../core/vulkan/knoxic_vk_swap_chain.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+
+namespace knoxic {
+
+    std::vector<VkVertexInputBindingDescription> LightGizmoInstance::getBindingDescriptions() {
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+        bindingDescriptions[0].binding = 0;
+        bindingDescriptions[0].stride = sizeof(LightGizmoInstance);
+        bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+        return bindingDescriptions;
+    }
+
+    std::vector<VkVertexInputAttributeDescription> LightGizmoInstance::getAttributeDescriptions() {
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+        attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(LightGizmoInstance, position)});
+        attributeDescriptions.push_back({1, 0, VK_FORMAT_R32_UINT, offsetof(LightGizmoInstance, lightIndex)});
+
+        return attributeDescriptions;
+    }
+
+    LightBufferSystem::LightBufferSystem(KnoxicFrameAllocator &frameAllocator) : frameAllocator{frameAllocator} {
+        frames.resize(KnoxicSwapChain::framesInFlight());
+    }
+
+    bool LightBufferSystem::upload(int frameIndex, SceneLights &lights, const glm::vec3 &cameraPosition) {
+        FrameCapacities &frame = frames[frameIndex];
+
+        bool grown = false;
+        grown |= uploadLights(frame.pointLights, pointLights, lights.pointLights.data(),
+            static_cast<uint32_t>(lights.pointLights.size()));
+        grown |= uploadLights(frame.spotLights, spotLights, lights.spotLights.data(),
+            static_cast<uint32_t>(lights.spotLights.size()));
+        grown |= uploadLights(frame.directionalLights, directionalLights, lights.directionalLights.data(),
+            static_cast<uint32_t>(lights.directionalLights.size()));
+
+        // Gizmos are bound as vertex buffers each draw, they only take what they use
+        sortBackToFront(lights.pointGizmos, cameraPosition);
+        sortBackToFront(lights.spotGizmos, cameraPosition);
+        sortBackToFront(lights.directionalGizmos, cameraPosition);
+        pointGizmos = uploadGizmos(lights.pointGizmos);
+        spotGizmos = uploadGizmos(lights.spotGizmos);
+        directionalGizmos = uploadGizmos(lights.directionalGizmos);
+
+        return grown;
+    }
+
+    void LightBufferSystem::sortBackToFront(std::vector<LightGizmoInstance> &gizmos, const glm::vec3 &cameraPosition) {
+        if (gizmos.size() < 2) {
+            return;
+        }
+
+        // Non-negative floats order the same as their bit patterns, so one integer sort does it
+        // and lights at equal distances keep a distinct key
+        sortKeys.clear();
+        for (uint32_t i = 0; i < gizmos.size(); i++) {
+            glm::vec3 offset = glm::vec3(gizmos[i].position) - cameraPosition;
+            float distanceSquared = glm::dot(offset, offset);
+
+            uint32_t distanceBits;
+            std::memcpy(&distanceBits, &distanceSquared, sizeof(distanceBits));
+            sortKeys.push_back((static_cast<uint64_t>(distanceBits) << 32) | i);
+        }
+
+        // Furthest first
+        std::sort(sortKeys.begin(), sortKeys.end(), std::greater<uint64_t>());
+
+        sortedGizmos.clear();
+        for (uint64_t key : sortKeys) {
+            sortedGizmos.push_back(gizmos[static_cast<uint32_t>(key)]);
+        }
+        gizmos.swap(sortedGizmos);
+    }
+
+    bool LightBufferSystem::uploadLights(LightArray &array, KnoxicTransientAllocation &slice, const void *data, uint32_t count) {
+        bool grown = false;
+        if (count > array.capacity) {
+            while (array.capacity < count) {
+                array.capacity *= 2;
+            }
+            grown = true;
+        }
+
+        // The slice covers the whole descriptor range, the shaders only read the first count entries
+        slice = frameAllocator.allocateStorage(array.stride * array.capacity);
+        if (count > 0) {
+            std::memcpy(slice.mapped, data, static_cast<size_t>(array.stride * count));
+        }
+        return grown;
+    }
+
+    KnoxicTransientAllocation LightBufferSystem::uploadGizmos(const std::vector<LightGizmoInstance> &gizmos) {
+        if (gizmos.empty()) {
+            return {};
+        }
+
+        VkDeviceSize size = sizeof(LightGizmoInstance) * gizmos.size();
+        KnoxicTransientAllocation slice = frameAllocator.allocateVertex(size);
+        std::memcpy(slice.mapped, gizmos.data(), static_cast<size_t>(size));
+        return slice;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "../../core/vulkan/knoxic_vk_device.hpp"
+#include "../../core/vulkan/knoxic_vk_frame_allocator.hpp"
+#include "../../graphics/knoxic_frame_info.hpp"
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+namespace knoxic {
+
+    // Per-frame light storage and gizmo instance data, written into the frame allocator.
+    // The light arrays are dynamic storage buffers whose range is a per-frame capacity that doubles when a frame
+    // has more lights than it covers, only the lights actually in the scene are copied each frame.
+    class LightBufferSystem {
+    public:
+        static constexpr uint32_t INITIAL_LIGHT_CAPACITY = 64;
+
+        LightBufferSystem(KnoxicFrameAllocator &frameAllocator);
+
+        LightBufferSystem(const LightBufferSystem &) = delete;
+        LightBufferSystem &operator=(const LightBufferSystem &) = delete;
+
+        // Sort the gizmos and copy this frame's lights, returns true if a light capacity grew
+        // and the frame's descriptors need rewriting
+        bool upload(int frameIndex, SceneLights &lights, const glm::vec3 &cameraPosition);
+
+        // Global set bindings 3, 4 and 5
+        VkDescriptorBufferInfo getPointLightInfo(int frameIndex) { return getLightInfo(frames[frameIndex].pointLights); }
+        VkDescriptorBufferInfo getSpotLightInfo(int frameIndex) { return getLightInfo(frames[frameIndex].spotLights); }
+        VkDescriptorBufferInfo getDirectionalLightInfo(int frameIndex) { return getLightInfo(frames[frameIndex].directionalLights); }
+
+        // Dynamic offsets of bindings 3, 4 and 5 for the frame last uploaded
+        uint32_t getPointLightOffset() const { return pointLights.dynamicOffset(); }
+        uint32_t getSpotLightOffset() const { return spotLights.dynamicOffset(); }
+        uint32_t getDirectionalLightOffset() const { return directionalLights.dynamicOffset(); }
+
+        // Instance data for the gizmo draws of the frame last uploaded
+        const KnoxicTransientAllocation &getPointGizmos() const { return pointGizmos; }
+        const KnoxicTransientAllocation &getSpotGizmos() const { return spotGizmos; }
+        const KnoxicTransientAllocation &getDirectionalGizmos() const { return directionalGizmos; }
+
+    private:
+        struct LightArray {
+            VkDeviceSize stride;
+            uint32_t capacity;
+        };
+
+        // Capacities are per frame, growing one only rewrites the set of the frame being recorded
+        struct FrameCapacities {
+            LightArray pointLights{sizeof(PointLight), INITIAL_LIGHT_CAPACITY};
+            LightArray spotLights{sizeof(SpotLight), INITIAL_LIGHT_CAPACITY};
+            LightArray directionalLights{sizeof(DirectionalLight), INITIAL_LIGHT_CAPACITY};
+        };
+
+        VkDescriptorBufferInfo getLightInfo(const LightArray &array) {
+            return frameAllocator.descriptorInfo(array.stride * array.capacity);
+        }
+        bool uploadLights(LightArray &array, KnoxicTransientAllocation &slice, const void *data, uint32_t count);
+        KnoxicTransientAllocation uploadGizmos(const std::vector<LightGizmoInstance> &gizmos);
+        void sortBackToFront(std::vector<LightGizmoInstance> &gizmos, const glm::vec3 &cameraPosition);
+
+        KnoxicFrameAllocator &frameAllocator;
+        std::vector<FrameCapacities> frames;
+
+        KnoxicTransientAllocation pointLights{};
+        KnoxicTransientAllocation spotLights{};
+        KnoxicTransientAllocation directionalLights{};
+        KnoxicTransientAllocation pointGizmos{};
+        KnoxicTransientAllocation spotGizmos{};
+        KnoxicTransientAllocation directionalGizmos{};
+
+        // Reused sort scratch: squared distance bits in the high word, instance index in the low word
+        std::vector<uint64_t> sortKeys;
+        std::vector<LightGizmoInstance> sortedGizmos;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "knoxic_vk_light_cluster_system.hpp"
+#include "../../core/vulkan/knoxic_vk_swap_chain.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <stdexcept>
+
+namespace knoxic {
+
+    LightClusterSystem::LightClusterSystem(KnoxicDevice &device, VkDescriptorSetLayout globalSetLayout) : knoxicDevice{device} {
+        createBuffers();
+        createPipeline(globalSetLayout);
+    }
+
+    LightClusterSystem::~LightClusterSystem() {
+        vkDeviceWaitIdle(knoxicDevice.device());
+
+        cullPipeline.reset();
+        vkDestroyPipelineLayout(knoxicDevice.device(), cullPipelineLayout, nullptr);
+    }
+
+    void LightClusterSystem::createBuffers() {
+        lightGridBuffers.resize(KnoxicSwapChain::framesInFlight());
+        lightIndexBuffers.resize(KnoxicSwapChain::framesInFlight());
+
+        for (int i = 0; i < KnoxicSwapChain::framesInFlight(); i++) {
+            lightGridBuffers[i] = std::make_unique<KnoxicBuffer>(
+                knoxicDevice,
+                sizeof(glm::uvec2),
+                CLUSTER_COUNT,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            );
+
+            lightIndexBuffers[i] = std::make_unique<KnoxicBuffer>(
+                knoxicDevice,
+                sizeof(uint32_t),
+                CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            );
+        }
+    }
+
+    void LightClusterSystem::createPipeline(VkDescriptorSetLayout globalSetLayout) {
+        // Everything comes from the global set, no push constants needed
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &globalSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 0;
+        pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+        if (vkCreatePipelineLayout(knoxicDevice.device(), &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create light cull pipeline layout!");
+        }
+
+        cullPipeline = std::make_unique<KnoxicComputePipeline>(
+            knoxicDevice,
+            "shaders/vk_light_cull.comp.spv",
+            cullPipelineLayout
+        );
+    }
+
+    void LightClusterSystem::update(GlobalUbo &ubo, VkExtent2D extent) {
+        // Near and far planes recovered from the perspective projection
+        float zNear = -ubo.projection[3][2] / ubo.projection[2][2];
+        float zFar = ubo.projection[3][2] / (1.0f - ubo.projection[2][2]);
+
+        // slice = log(z) * scale + bias
+        float sliceScale = static_cast<float>(CLUSTER_DEPTH_SLICES) / std::log(zFar / zNear);
+        float sliceBias = -std::log(zNear) * sliceScale;
+
+        float width = static_cast<float>(extent.width);
+        float height = static_cast<float>(extent.height);
+
+        ubo.clusterGrid = glm::uvec4(CLUSTER_TILES_X, CLUSTER_TILES_Y, CLUSTER_DEPTH_SLICES, MAX_LIGHTS_PER_CLUSTER);
+        ubo.clusterDepth = glm::vec4(zNear, zFar, sliceScale, sliceBias);
+        ubo.clusterScreen = glm::vec4(width, height, 1.0f / width, 1.0f / height);
+    }
+
+    void LightClusterSystem::cullLights(FrameInfo &frameInfo) {
+        cullPipeline->bind(frameInfo.commandBuffer);
+
+        vkCmdBindDescriptorSets(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            cullPipelineLayout,
+            0, 1,
+            &frameInfo.globalDescriptorSet,
+            static_cast<uint32_t>(frameInfo.globalDynamicOffsets.size()),
+            frameInfo.globalDynamicOffsets.data()
+        );
+
+        // The render graph makes the light lists visible to the lighting passes, which may be on another queue
+        vkCmdDispatch(frameInfo.commandBuffer, (CLUSTER_COUNT + 127) / 128, 1, 1);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../../core/vulkan/knoxic_vk_device.hpp"
+#include "../../core/vulkan/knoxic_vk_buffer.hpp"
+#include "../../graphics/vulkan/knoxic_vk_pipeline.hpp"
+#include "../../graphics/knoxic_frame_info.hpp"
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <vector>
+
+namespace knoxic {
+
+    // Clustered forward light culling.
+    // The view frustum is split into screen tiles x logarithmic depth slices and a compute pass
+    // bins every point and spot light into the clusters its range touches.
+    class LightClusterSystem {
+    public:
+        static constexpr uint32_t CLUSTER_TILES_X = 16;
+        static constexpr uint32_t CLUSTER_TILES_Y = 9;
+        static constexpr uint32_t CLUSTER_DEPTH_SLICES = 24;
+        static constexpr uint32_t CLUSTER_COUNT = CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_DEPTH_SLICES;
+        static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 128;
+
+        LightClusterSystem(KnoxicDevice &device, VkDescriptorSetLayout globalSetLayout);
+        ~LightClusterSystem();
+
+        LightClusterSystem(const LightClusterSystem &) = delete;
+        LightClusterSystem &operator=(const LightClusterSystem &) = delete;
+
+        // Fill the cluster grid parameters of the ubo for this camera and extent
+        void update(GlobalUbo &ubo, VkExtent2D extent);
+
+        // Bin lights into clusters, recorded before the HDR pass. Compute only, fit for the async compute queue
+        void cullLights(FrameInfo &frameInfo);
+
+        // Global set bindings 1 and 2
+        VkDescriptorBufferInfo getLightGridInfo(int frameIndex) { return lightGridBuffers[frameIndex]->descriptorInfo(); }
+        VkDescriptorBufferInfo getLightIndexInfo(int frameIndex) { return lightIndexBuffers[frameIndex]->descriptorInfo(); }
+
+    private:
+        void createBuffers();
+        void createPipeline(VkDescriptorSetLayout globalSetLayout);
+
+        KnoxicDevice &knoxicDevice;
+
+        // Per cluster point and spot light counts, and the light indices themselves
+        std::vector<std::unique_ptr<KnoxicBuffer>> lightGridBuffers;
+        std::vector<std::unique_ptr<KnoxicBuffer>> lightIndexBuffers;
+
+        std::unique_ptr<KnoxicComputePipeline> cullPipeline;
+        VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+    };
+}
\ No newline at end of file
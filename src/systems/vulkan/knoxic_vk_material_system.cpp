@@ -1,10 +1,18 @@
 #include "knoxic_vk_material_system.hpp"
+#include "../../core/vulkan/knoxic_vk_swap_chain.hpp"
 #include "../../core/ecs/components.hpp"
 #include "../../core/ecs/coordinator_instance.hpp"
 
+#include <stdexcept>
+
 namespace knoxic {
 
-    MaterialSystem::MaterialSystem(KnoxicDevice &device) : knoxicDevice{device} {}
+    MaterialSystem::MaterialSystem(KnoxicDevice &device) : knoxicDevice{device} {
+        bindless = knoxicDevice.supportsDescriptorIndexing();
+        if (bindless) {
+            createBindlessResources();
+        }
+    }
 
     MaterialSystem::~MaterialSystem() {}
 
@@ -17,12 +25,74 @@ namespace knoxic {
             .build();
     }
 
+    void MaterialSystem::createBindlessResources() {
+        bindlessSetLayout = KnoxicDescriptorSetLayout::Builder(knoxicDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, MAX_BINDLESS_TEXTURES) // Textures
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT) // Material parameters
+            .setBindingFlags(0, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT)
+            .setLayoutFlags(VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT)
+            .build();
+
+        bindlessPool = KnoxicDescriptorPool::Builder(knoxicDevice)
+            .setMaxSets(KnoxicSwapChain::framesInFlight())
+            .setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_BINDLESS_TEXTURES * KnoxicSwapChain::framesInFlight())
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, KnoxicSwapChain::framesInFlight())
+            .build();
+
+        materialBuffers.resize(KnoxicSwapChain::framesInFlight());
+        bindlessDescriptorSets.resize(KnoxicSwapChain::framesInFlight());
+        for (int i = 0; i < KnoxicSwapChain::framesInFlight(); i++) {
+            materialBuffers[i] = std::make_unique<KnoxicBuffer>(
+                knoxicDevice,
+                sizeof(GpuMaterial),
+                MAX_BINDLESS_MATERIALS,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            );
+            materialBuffers[i]->map();
+
+            auto bufferInfo = materialBuffers[i]->descriptorInfo();
+            if (!KnoxicDescriptorWriter(*bindlessSetLayout, *bindlessPool)
+                .writeBuffer(1, &bufferInfo)
+                .build(bindlessDescriptorSets[i])) {
+                throw std::runtime_error("Failed to allocate bindless material descriptor set!");
+            }
+        }
+
+        slotGenerations.assign(MAX_BINDLESS_MATERIALS, 0);
+        slotTextureVersions.assign(MAX_BINDLESS_MATERIALS, 0);
+        frameSlotGenerations.assign(KnoxicSwapChain::framesInFlight(), std::vector<uint32_t>(MAX_BINDLESS_MATERIALS, 0));
+
+        defaultMaterial = std::make_unique<KnoxicMaterial>(knoxicDevice);
+        registerBindlessMaterial(*defaultMaterial);
+    }
+
+    uint32_t MaterialSystem::registerBindlessMaterial(KnoxicMaterial &material) {
+        if (bindlessMaterials.size() >= MAX_BINDLESS_MATERIALS) {
+            throw std::runtime_error("Too many materials for the bindless material table!");
+        }
+
+        uint32_t index = static_cast<uint32_t>(bindlessMaterials.size());
+        bindlessMaterials.push_back(&material);
+        material.setBindlessIndex(index);
+
+        slotTextureVersions[index] = material.getTextureVersion();
+        slotGenerations[index]++;
+        return index;
+    }
+
     void MaterialSystem::updateMaterials(
-        FrameInfo & /*frameInfo*/,
+        FrameInfo &frameInfo,
         KnoxicDescriptorSetLayout& materialSetLayout,
         KnoxicDescriptorPool& materialPool,
         std::shared_ptr<RenderableSystem> renderableSystem
     ) {
+        if (bindless) {
+            updateBindlessMaterials(frameInfo, renderableSystem);
+            return;
+        }
+
         // Iterate over ECS renderable entities and update material descriptor sets
         for (auto entity : renderableSystem->mEntities) {
             if (gCoordinator.HasComponent<MaterialComponent>(entity)) {
@@ -33,4 +103,65 @@ namespace knoxic {
             }
         }
     }
-}
\ No newline at end of file
+
+    void MaterialSystem::updateBindlessMaterials(FrameInfo &frameInfo, std::shared_ptr<RenderableSystem> renderableSystem) {
+        // Give new materials a slot, and mark slots whose textures changed
+        for (auto entity : renderableSystem->mEntities) {
+            if (!gCoordinator.HasComponent<MaterialComponent>(entity)) continue;
+
+            auto &matComp = gCoordinator.GetComponent<MaterialComponent>(entity);
+            if (!matComp.material) continue;
+
+            KnoxicMaterial &material = *matComp.material;
+            uint32_t index = material.getBindlessIndex();
+            if (index == KnoxicMaterial::INVALID_BINDLESS_INDEX) {
+                registerBindlessMaterial(material);
+            } else if (slotTextureVersions[index] != material.getTextureVersion()) {
+                slotTextureVersions[index] = material.getTextureVersion();
+                slotGenerations[index]++;
+            }
+        }
+
+        // This frame's set is no longer in use, bring its texture slots up to date
+        auto &frameGenerations = frameSlotGenerations[frameInfo.frameIndex];
+        KnoxicDescriptorWriter writer(*bindlessSetLayout, *bindlessPool);
+        std::vector<VkDescriptorImageInfo> imageInfos;
+        imageInfos.reserve(bindlessMaterials.size() * TEXTURES_PER_MATERIAL);
+
+        for (uint32_t i = 0; i < bindlessMaterials.size(); i++) {
+            if (frameGenerations[i] == slotGenerations[i]) continue;
+            frameGenerations[i] = slotGenerations[i];
+
+            for (uint32_t t = 0; t < TEXTURES_PER_MATERIAL; t++) {
+                imageInfos.push_back(bindlessMaterials[i]->getTextureImageInfo(static_cast<MaterialTextureSlot>(t)));
+                writer.writeImageArrayElement(0, i * TEXTURES_PER_MATERIAL + t, &imageInfos.back());
+            }
+        }
+
+        if (!imageInfos.empty()) {
+            writer.overwrite(bindlessDescriptorSets[frameInfo.frameIndex]);
+        }
+
+        // Parameters can change every frame from the editor
+        for (uint32_t i = 0; i < bindlessMaterials.size(); i++) {
+            writeBindlessMaterial(frameInfo.frameIndex, i, *bindlessMaterials[i]);
+        }
+    }
+
+    void MaterialSystem::writeBindlessMaterial(int frameIndex, uint32_t index, const KnoxicMaterial &material) {
+        const auto &props = material.getProperties();
+
+        GpuMaterial gpuMaterial{};
+        gpuMaterial.albedoMetallic = glm::vec4(props.albedo, props.metallic);
+        gpuMaterial.roughnessAoEmission = glm::vec4(props.roughness, props.ao, props.emissionStrength, 0.0f);
+        gpuMaterial.emissionColor = glm::vec4(props.emissionColor, 0.0f);
+        gpuMaterial.uvTransform = glm::vec4(props.textureOffset, props.textureScale);
+
+        uint32_t baseTexture = index * TEXTURES_PER_MATERIAL;
+        gpuMaterial.textureIndices = glm::uvec4(baseTexture, baseTexture + 1, baseTexture + 2, baseTexture + 3);
+
+        // Written into the buffer of the frame being recorded
+        auto *mapped = static_cast<GpuMaterial *>(materialBuffers[frameIndex]->getMappedMemory());
+        mapped[index] = gpuMaterial;
+    }
+}
@@ -2,15 +2,27 @@
 
 #include "../../core/vulkan/knoxic_vk_device.hpp"
 #include "../../core/vulkan/knoxic_vk_descriptors.hpp"
+#include "../../core/vulkan/knoxic_vk_buffer.hpp"
+#include "../../graphics/vulkan/knoxic_vk_material.hpp"
 #include "../../graphics/knoxic_frame_info.hpp"
 #include "../../core/ecs/ecs_systems.hpp"
 
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
 #include <memory>
+#include <vector>
 
 namespace knoxic {
 
     class MaterialSystem {
     public:
+        static constexpr uint32_t MAX_BINDLESS_MATERIALS = 256;
+        static constexpr uint32_t TEXTURES_PER_MATERIAL = static_cast<uint32_t>(MaterialTextureSlot::Count);
+        static constexpr uint32_t MAX_BINDLESS_TEXTURES = MAX_BINDLESS_MATERIALS * TEXTURES_PER_MATERIAL;
+        static constexpr uint32_t DEFAULT_MATERIAL_INDEX = 0;
+
         MaterialSystem(KnoxicDevice &device);
         ~MaterialSystem();
 
@@ -22,7 +34,41 @@ namespace knoxic {
         void updateMaterials(FrameInfo &frameInfo, KnoxicDescriptorSetLayout& materialSetLayout, KnoxicDescriptorPool& materialPool, 
             std::shared_ptr<RenderableSystem> renderableSystem);
 
+        // Bindless path, used when the device supports descriptor indexing
+        bool isBindless() const { return bindless; }
+        VkDescriptorSetLayout getBindlessSetLayout() const { return bindlessSetLayout->getDescriptorSetLayout(); }
+        VkDescriptorSet getBindlessDescriptorSet(int frameIndex) const { return bindlessDescriptorSets[frameIndex]; }
+
     private:
+        // std430 layout of the material parameter buffer
+        struct GpuMaterial {
+            glm::vec4 albedoMetallic{1.0f, 1.0f, 1.0f, 0.0f};
+            glm::vec4 roughnessAoEmission{0.5f, 1.0f, 0.0f, 0.0f}; // roughness, ao, emission strength
+            glm::vec4 emissionColor{0.0f};
+            glm::vec4 uvTransform{0.0f, 0.0f, 1.0f, 1.0f}; // offset, scale
+            glm::uvec4 textureIndices{0u};
+        };
+
+        void createBindlessResources();
+        uint32_t registerBindlessMaterial(KnoxicMaterial &material);
+        void updateBindlessMaterials(FrameInfo &frameInfo, std::shared_ptr<RenderableSystem> renderableSystem);
+        void writeBindlessMaterial(int frameIndex, uint32_t index, const KnoxicMaterial &material);
+
         KnoxicDevice &knoxicDevice;
+        bool bindless = false;
+
+        std::unique_ptr<KnoxicDescriptorSetLayout> bindlessSetLayout;
+        std::unique_ptr<KnoxicDescriptorPool> bindlessPool;
+        std::vector<VkDescriptorSet> bindlessDescriptorSets;
+        std::vector<std::unique_ptr<KnoxicBuffer>> materialBuffers;
+
+        // Slot 0 is used by entities without a material
+        std::unique_ptr<KnoxicMaterial> defaultMaterial;
+        std::vector<const KnoxicMaterial *> bindlessMaterials;
+
+        // Texture descriptors are written lazily per frame so a set is never updated while in flight
+        std::vector<uint32_t> slotGenerations;
+        std::vector<uint32_t> slotTextureVersions;
+        std::vector<std::vector<uint32_t>> frameSlotGenerations;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,487 @@
+#include "knoxic_vk_occlusion_culling_system.hpp"
+#include "../../core/vulkan/knoxic_vk_swap_chain.hpp"
+#include "../../core/ecs/components.hpp"
+#include "../../core/ecs/coordinator_instance.hpp"
+#include "../../graphics/vulkan/knoxic_vk_model.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <array>
+
+namespace knoxic {
+
+    namespace {
+        uint32_t previousPow2(uint32_t value) {
+            uint32_t result = 1;
+            while (result * 2 <= value) {
+                result *= 2;
+            }
+            return result;
+        }
+    }
+
+    OcclusionCullingSystem::OcclusionCullingSystem(
+        KnoxicDevice &device,
+        PostProcessSystem &postProcessSystem,
+        std::shared_ptr<RenderableSystem> ecsRenderableSystem
+    ) : knoxicDevice{device}, postProcessSystem{postProcessSystem}, renderableSystem{std::move(ecsRenderableSystem)} {
+        objectData.resize(MAX_ENTITIES);
+        createBuffers();
+        createDescriptorSetLayouts();
+        createPipelines();
+        // Pyramid and descriptor sets follow the render graph targets, see recreate()
+    }
+
+    OcclusionCullingSystem::~OcclusionCullingSystem() {
+        vkDeviceWaitIdle(knoxicDevice.device());
+
+        cullPipeline.reset();
+        pyramidPipeline.reset();
+        vkDestroyPipelineLayout(knoxicDevice.device(), cullPipelineLayout, nullptr);
+        vkDestroyPipelineLayout(knoxicDevice.device(), pyramidPipelineLayout, nullptr);
+
+        descriptorPool.reset();
+        cullSetLayout.reset();
+        pyramidSetLayout.reset();
+
+        destroyPyramid();
+        vkDestroySampler(knoxicDevice.device(), depthSampler, nullptr);
+        vkDestroySampler(knoxicDevice.device(), pyramidSampler, nullptr);
+    }
+
+    void OcclusionCullingSystem::recreate() {
+        vkDeviceWaitIdle(knoxicDevice.device());
+
+        descriptorPool.reset();
+        destroyPyramid();
+        createPyramid();
+        createDescriptorSets();
+    }
+
+    void OcclusionCullingSystem::createBuffers() {
+        objectBuffers.resize(KnoxicSwapChain::framesInFlight());
+        drawCommandBuffers.resize(KnoxicSwapChain::framesInFlight());
+
+        for (int i = 0; i < KnoxicSwapChain::framesInFlight(); i++) {
+            objectBuffers[i] = std::make_unique<KnoxicBuffer>(
+                knoxicDevice,
+                sizeof(ObjectCullData),
+                static_cast<uint32_t>(MAX_ENTITIES),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+            );
+            objectBuffers[i]->map();
+
+            // One command per entity for each phase
+            drawCommandBuffers[i] = std::make_unique<KnoxicBuffer>(
+                knoxicDevice,
+                sizeof(VkDrawIndexedIndirectCommand),
+                static_cast<uint32_t>(MAX_ENTITIES * 2),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            );
+        }
+
+        // Shared between frames, written by the late pass and read by the next early pass
+        visibilityBuffer = std::make_unique<KnoxicBuffer>(
+            knoxicDevice,
+            sizeof(uint32_t),
+            static_cast<uint32_t>(MAX_ENTITIES),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+        );
+
+        // Samplers (nearest, the max reduction is done by hand)
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.anisotropyEnable = VK_FALSE;
+        samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+        samplerInfo.unnormalizedCoordinates = VK_FALSE;
+        samplerInfo.compareEnable = VK_FALSE;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = 0.0f;
+
+        if (vkCreateSampler(knoxicDevice.device(), &samplerInfo, nullptr, &depthSampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth sampler!");
+        }
+
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+        if (vkCreateSampler(knoxicDevice.device(), &samplerInfo, nullptr, &pyramidSampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid sampler!");
+        }
+    }
+
+    void OcclusionCullingSystem::createPyramid() {
+        // Power of two so every level halves exactly. From the target size, which doesn't change with every resize
+        VkExtent2D extent = postProcessSystem.getTargetExtent();
+        pyramidExtent.width = previousPow2(std::max(extent.width, 1u));
+        pyramidExtent.height = previousPow2(std::max(extent.height, 1u));
+
+        pyramidLevels = 1;
+        while ((std::max(pyramidExtent.width, pyramidExtent.height) >> pyramidLevels) > 0) {
+            pyramidLevels++;
+        }
+
+        pyramidImages.resize(KnoxicSwapChain::framesInFlight());
+        pyramidImageAllocations.resize(KnoxicSwapChain::framesInFlight());
+        pyramidImageViews.resize(KnoxicSwapChain::framesInFlight());
+        pyramidMipViews.resize(KnoxicSwapChain::framesInFlight());
+
+        for (size_t i = 0; i < KnoxicSwapChain::framesInFlight(); i++) {
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent.width = pyramidExtent.width;
+            imageInfo.extent.height = pyramidExtent.height;
+            imageInfo.extent.depth = 1;
+            imageInfo.mipLevels = pyramidLevels;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = VK_FORMAT_R32_SFLOAT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            knoxicDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                pyramidImages[i], pyramidImageAllocations[i], KnoxicAllocationStrategy::Dedicated);
+
+            // Full chain view for the cull pass
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = pyramidImages[i];
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = VK_FORMAT_R32_SFLOAT;
+            viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            viewInfo.subresourceRange.baseMipLevel = 0;
+            viewInfo.subresourceRange.levelCount = pyramidLevels;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+
+            if (vkCreateImageView(knoxicDevice.device(), &viewInfo, nullptr, &pyramidImageViews[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create depth pyramid image view!");
+            }
+
+            // One view per level for the downsample chain
+            pyramidMipViews[i].resize(pyramidLevels);
+            for (uint32_t level = 0; level < pyramidLevels; level++) {
+                viewInfo.subresourceRange.baseMipLevel = level;
+                viewInfo.subresourceRange.levelCount = 1;
+
+                if (vkCreateImageView(knoxicDevice.device(), &viewInfo, nullptr, &pyramidMipViews[i][level]) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create depth pyramid mip view!");
+                }
+            }
+        }
+    }
+
+    void OcclusionCullingSystem::destroyPyramid() {
+        for (size_t i = 0; i < pyramidImages.size(); i++) {
+            for (auto view : pyramidMipViews[i]) {
+                vkDestroyImageView(knoxicDevice.device(), view, nullptr);
+            }
+            vkDestroyImageView(knoxicDevice.device(), pyramidImageViews[i], nullptr);
+            vkDestroyImage(knoxicDevice.device(), pyramidImages[i], nullptr);
+            knoxicDevice.freeMemory(pyramidImageAllocations[i]);
+        }
+
+        pyramidMipViews.clear();
+        pyramidImageViews.clear();
+        pyramidImages.clear();
+        pyramidImageAllocations.clear();
+    }
+
+    void OcclusionCullingSystem::createDescriptorSetLayouts() {
+        // Downsample: previous level (or scene depth) + destination level
+        pyramidSetLayout = KnoxicDescriptorSetLayout::Builder(knoxicDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+            .build();
+
+        // Cull: objects, draw commands, visibility, pyramid
+        cullSetLayout = KnoxicDescriptorSetLayout::Builder(knoxicDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .build();
+    }
+
+    void OcclusionCullingSystem::createDescriptorSets() {
+        uint32_t frames = KnoxicSwapChain::framesInFlight();
+        descriptorPool = KnoxicDescriptorPool::Builder(knoxicDevice)
+            .setMaxSets(frames * (pyramidLevels + 1))
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frames * (pyramidLevels + 1))
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, frames * pyramidLevels)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frames * 3)
+            .build();
+
+        pyramidDescriptorSets.resize(frames);
+        cullDescriptorSets.resize(frames);
+
+        for (size_t i = 0; i < frames; i++) {
+            pyramidDescriptorSets[i].resize(pyramidLevels);
+            for (uint32_t level = 0; level < pyramidLevels; level++) {
+                VkDescriptorImageInfo srcInfo{};
+                if (level == 0) {
+                    srcInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                    srcInfo.imageView = postProcessSystem.getHDRDepthImageView(static_cast<int>(i));
+                } else {
+                    srcInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+                    srcInfo.imageView = pyramidMipViews[i][level - 1];
+                }
+                srcInfo.sampler = depthSampler;
+
+                VkDescriptorImageInfo dstInfo{};
+                dstInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+                dstInfo.imageView = pyramidMipViews[i][level];
+                dstInfo.sampler = VK_NULL_HANDLE;
+
+                KnoxicDescriptorWriter(*pyramidSetLayout, *descriptorPool)
+                    .writeImage(0, &srcInfo)
+                    .writeImage(1, &dstInfo)
+                    .build(pyramidDescriptorSets[i][level]);
+            }
+
+            auto objectInfo = objectBuffers[i]->descriptorInfo();
+            auto drawInfo = drawCommandBuffers[i]->descriptorInfo();
+            auto visibilityInfo = visibilityBuffer->descriptorInfo();
+
+            VkDescriptorImageInfo pyramidInfo{};
+            pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            pyramidInfo.imageView = pyramidImageViews[i];
+            pyramidInfo.sampler = pyramidSampler;
+
+            KnoxicDescriptorWriter(*cullSetLayout, *descriptorPool)
+                .writeBuffer(0, &objectInfo)
+                .writeBuffer(1, &drawInfo)
+                .writeBuffer(2, &visibilityInfo)
+                .writeImage(3, &pyramidInfo)
+                .build(cullDescriptorSets[i]);
+        }
+    }
+
+    void OcclusionCullingSystem::createPipelines() {
+        // Depth pyramid pipeline
+        {
+            VkPushConstantRange pushConstantRange{};
+            pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            pushConstantRange.offset = 0;
+            pushConstantRange.size = sizeof(glm::ivec4);
+
+            VkDescriptorSetLayout setLayout = pyramidSetLayout->getDescriptorSetLayout();
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount = 1;
+            pipelineLayoutInfo.pSetLayouts = &setLayout;
+            pipelineLayoutInfo.pushConstantRangeCount = 1;
+            pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+            if (vkCreatePipelineLayout(knoxicDevice.device(), &pipelineLayoutInfo, nullptr, &pyramidPipelineLayout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create depth pyramid pipeline layout!");
+            }
+
+            pyramidPipeline = std::make_unique<KnoxicComputePipeline>(
+                knoxicDevice,
+                "shaders/vk_hiz_downsample.comp.spv",
+                pyramidPipelineLayout
+            );
+        }
+
+        // Cull pipeline
+        {
+            VkPushConstantRange pushConstantRange{};
+            pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            pushConstantRange.offset = 0;
+            pushConstantRange.size = sizeof(CullPushConstants);
+
+            VkDescriptorSetLayout setLayout = cullSetLayout->getDescriptorSetLayout();
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount = 1;
+            pipelineLayoutInfo.pSetLayouts = &setLayout;
+            pipelineLayoutInfo.pushConstantRangeCount = 1;
+            pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+            if (vkCreatePipelineLayout(knoxicDevice.device(), &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create occlusion cull pipeline layout!");
+            }
+
+            cullPipeline = std::make_unique<KnoxicComputePipeline>(
+                knoxicDevice,
+                "shaders/vk_occlusion_cull.comp.spv",
+                cullPipelineLayout
+            );
+        }
+    }
+
+    void OcclusionCullingSystem::prepare(FrameInfo &frameInfo) {
+        // Clear last frame's entries
+        std::fill(objectData.begin(), objectData.begin() + objectCount, ObjectCullData{});
+        objectCount = 0;
+
+        glm::mat4 view = frameInfo.camera.getView();
+
+        for (auto entity : renderableSystem->mEntities) {
+            auto &transform = gCoordinator.GetComponent<TransformComponent>(entity);
+            auto &modelComp = gCoordinator.GetComponent<ModelComponent>(entity);
+
+            if (!modelComp.model) continue;
+
+            // Bounding sphere of the local AABB, moved to view space
+            glm::vec3 boundsMin = modelComp.model->getBoundsMin();
+            glm::vec3 boundsMax = modelComp.model->getBoundsMax();
+            glm::vec3 localCenter = (boundsMin + boundsMax) * 0.5f;
+            float localRadius = glm::length(boundsMax - boundsMin) * 0.5f;
+
+            glm::vec3 scale = glm::abs(transform.scale);
+            float maxScale = std::max(scale.x, std::max(scale.y, scale.z));
+
+            glm::vec4 worldCenter = transform.mat4() * glm::vec4(localCenter, 1.0f);
+            glm::vec3 viewCenter = glm::vec3(view * worldCenter);
+
+            ObjectCullData &data = objectData[entity];
+            data.sphere = glm::vec4(viewCenter, localRadius * maxScale);
+            data.drawCount = modelComp.model->getDrawCount();
+
+            objectCount = std::max(objectCount, static_cast<uint32_t>(entity) + 1);
+        }
+
+        if (objectCount > 0) {
+            objectBuffers[frameInfo.frameIndex]->writeToBuffer(objectData.data(), objectCount * sizeof(ObjectCullData));
+            objectBuffers[frameInfo.frameIndex]->flush();
+        }
+
+        // Side planes of a symmetric frustum, view space is +z forward
+        const glm::mat4 &projection = frameInfo.camera.getProjection();
+        glm::vec2 frustumX = glm::normalize(glm::vec2(projection[0][0], 1.0f));
+        glm::vec2 frustumY = glm::normalize(glm::vec2(projection[1][1], 1.0f));
+
+        cullConstants.frustum = glm::vec4(frustumX.x, frustumX.y, frustumY.x, frustumY.y);
+        cullConstants.P00 = projection[0][0];
+        cullConstants.P11 = projection[1][1];
+        cullConstants.P22 = projection[2][2];
+        cullConstants.P32 = projection[3][2];
+        cullConstants.zNear = -projection[3][2] / projection[2][2];
+        cullConstants.zFar = projection[3][2] / (1.0f - projection[2][2]);
+        cullConstants.pyramidSize = glm::vec2(pyramidExtent.width, pyramidExtent.height);
+        cullConstants.objectCount = objectCount;
+        cullConstants.maxObjects = static_cast<uint32_t>(MAX_ENTITIES);
+    }
+
+    void OcclusionCullingSystem::cullEarly(FrameInfo &frameInfo) {
+        VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+
+        // Nothing was visible before the first frame
+        if (!visibilityInitialized) {
+            vkCmdFillBuffer(commandBuffer, visibilityBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+            VkMemoryBarrier fillBarrier{};
+            fillBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            fillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            fillBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+            vkCmdPipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 1, &fillBarrier, 0, nullptr, 0, nullptr);
+
+            visibilityInitialized = true;
+        }
+
+        // Previous frame's visibility writes and indirect reads must finish first
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        dispatchCull(commandBuffer, frameInfo.frameIndex, EARLY_PHASE);
+    }
+
+    void OcclusionCullingSystem::buildDepthPyramid(FrameInfo &frameInfo) {
+        VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+        int frameIndex = frameInfo.frameIndex;
+
+        // The render graph has the scene depth sampled, the whole pyramid goes to general
+        VkImageMemoryBarrier pyramidBarrier{};
+        pyramidBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        pyramidBarrier.srcAccessMask = 0;
+        pyramidBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        pyramidBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        pyramidBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        pyramidBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        pyramidBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        pyramidBarrier.image = pyramidImages[frameIndex];
+        pyramidBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramidLevels, 0, 1};
+
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &pyramidBarrier);
+
+        pyramidPipeline->bind(commandBuffer);
+
+        // Level 0 covers only the rendered rect, which maps to the whole screen
+        VkExtent2D srcExtent = postProcessSystem.getRenderExtent();
+        for (uint32_t level = 0; level < pyramidLevels; level++) {
+            uint32_t dstWidth = std::max(pyramidExtent.width >> level, 1u);
+            uint32_t dstHeight = std::max(pyramidExtent.height >> level, 1u);
+
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                pyramidPipelineLayout, 0, 1, &pyramidDescriptorSets[frameIndex][level], 0, nullptr);
+
+            glm::ivec4 sizes(srcExtent.width, srcExtent.height, dstWidth, dstHeight);
+            vkCmdPushConstants(commandBuffer, pyramidPipelineLayout,
+                VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(glm::ivec4), &sizes);
+
+            vkCmdDispatch(commandBuffer, (dstWidth + 7) / 8, (dstHeight + 7) / 8, 1);
+
+            // Next level reads this one
+            VkImageMemoryBarrier levelBarrier{};
+            levelBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            levelBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            levelBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            levelBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            levelBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            levelBarrier.image = pyramidImages[frameIndex];
+            levelBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+
+            vkCmdPipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
+
+            srcExtent = {dstWidth, dstHeight};
+        }
+    }
+
+    void OcclusionCullingSystem::cullLate(FrameInfo &frameInfo) {
+        dispatchCull(frameInfo.commandBuffer, frameInfo.frameIndex, LATE_PHASE);
+    }
+
+    void OcclusionCullingSystem::dispatchCull(VkCommandBuffer commandBuffer, int frameIndex, uint32_t phase) {
+        if (objectCount > 0) {
+            cullPipeline->bind(commandBuffer);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                cullPipelineLayout, 0, 1, &cullDescriptorSets[frameIndex], 0, nullptr);
+
+            cullConstants.late = phase;
+            vkCmdPushConstants(commandBuffer, cullPipelineLayout,
+                VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &cullConstants);
+
+            vkCmdDispatch(commandBuffer, (objectCount + 63) / 64, 1, 1);
+        }
+
+        // The render graph orders the draw commands before the indirect draws, the late phase may run on another queue
+    }
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "../../core/vulkan/knoxic_vk_device.hpp"
+#include "../../core/vulkan/knoxic_vk_buffer.hpp"
+#include "../../core/vulkan/knoxic_vk_descriptors.hpp"
+#include "../../graphics/vulkan/knoxic_vk_pipeline.hpp"
+#include "../../graphics/knoxic_frame_info.hpp"
+#include "../../core/ecs/ecs_systems.hpp"
+#include "knoxic_vk_post_process_system.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <vector>
+
+namespace knoxic {
+
+    // Two-phase Hi-Z occlusion culling.
+    // Phase 1 draws whatever was visible last frame, a depth pyramid is built from that depth,
+    // then every object is tested against it and phase 2 draws the newly visible ones.
+    class OcclusionCullingSystem {
+    public:
+        static constexpr uint32_t EARLY_PHASE = 0;
+        static constexpr uint32_t LATE_PHASE = 1;
+
+        OcclusionCullingSystem(KnoxicDevice &device, PostProcessSystem &postProcessSystem,
+            std::shared_ptr<RenderableSystem> ecsRenderableSystem);
+        ~OcclusionCullingSystem();
+
+        OcclusionCullingSystem(const OcclusionCullingSystem &) = delete;
+        OcclusionCullingSystem &operator=(const OcclusionCullingSystem &) = delete;
+
+        bool isEnabled() const { return enabled; }
+        void setEnabled(bool value) { enabled = value; }
+
+        // Rebuild the pyramid and descriptor sets, after every render graph compile
+        void recreate();
+
+        // Upload view space bounds of every renderable for this frame
+        void prepare(FrameInfo &frameInfo);
+
+        // Phase 1 draw commands (objects visible last frame)
+        void cullEarly(FrameInfo &frameInfo);
+
+        // Downsample the phase 1 depth into the Hi-Z pyramid, the render graph has it in a sampled layout
+        void buildDepthPyramid(FrameInfo &frameInfo);
+
+        // Phase 2 draw commands (newly visible objects), updates visibility for the next frame.
+        // Together with the pyramid compute only, fit for the async compute queue
+        void cullLate(FrameInfo &frameInfo);
+
+        VkBuffer getDrawCommandBuffer(int frameIndex) const { return drawCommandBuffers[frameIndex]->getBuffer(); }
+        static VkDeviceSize getDrawCommandOffset(Entity entity, uint32_t phase) {
+            return (phase * MAX_ENTITIES + entity) * sizeof(VkDrawIndexedIndirectCommand);
+        }
+
+    private:
+        struct ObjectCullData {
+            glm::vec4 sphere{0.0f}; // View space center, radius
+            uint32_t drawCount{0};
+            uint32_t padding[3]{};
+        };
+
+        struct CullPushConstants {
+            glm::vec4 frustum{0.0f};
+            float P00, P11, P22, P32;
+            float zNear, zFar;
+            glm::vec2 pyramidSize{0.0f};
+            uint32_t objectCount{0};
+            uint32_t late{0};
+            uint32_t maxObjects{0};
+            uint32_t padding{0};
+        };
+
+        void createBuffers();
+        void createPyramid();
+        void createDescriptorSetLayouts();
+        void createDescriptorSets();
+        void createPipelines();
+        void destroyPyramid();
+
+        void dispatchCull(VkCommandBuffer commandBuffer, int frameIndex, uint32_t phase);
+
+        KnoxicDevice &knoxicDevice;
+        PostProcessSystem &postProcessSystem;
+        std::shared_ptr<RenderableSystem> renderableSystem;
+
+        bool enabled = true;
+        bool visibilityInitialized = false;
+
+        // Per-object data
+        std::vector<ObjectCullData> objectData;
+        uint32_t objectCount = 0;
+        CullPushConstants cullConstants{};
+        std::vector<std::unique_ptr<KnoxicBuffer>> objectBuffers;
+        std::vector<std::unique_ptr<KnoxicBuffer>> drawCommandBuffers;
+        std::unique_ptr<KnoxicBuffer> visibilityBuffer;
+
+        // Hi-Z pyramid
+        VkExtent2D pyramidExtent{};
+        uint32_t pyramidLevels = 0;
+        std::vector<VkImage> pyramidImages;
+        std::vector<KnoxicAllocation> pyramidImageAllocations;
+        std::vector<VkImageView> pyramidImageViews;
+        std::vector<std::vector<VkImageView>> pyramidMipViews;
+        VkSampler depthSampler = VK_NULL_HANDLE;
+        VkSampler pyramidSampler = VK_NULL_HANDLE;
+
+        // Descriptors
+        std::unique_ptr<KnoxicDescriptorPool> descriptorPool;
+        std::unique_ptr<KnoxicDescriptorSetLayout> pyramidSetLayout;
+        std::unique_ptr<KnoxicDescriptorSetLayout> cullSetLayout;
+        std::vector<std::vector<VkDescriptorSet>> pyramidDescriptorSets;
+        std::vector<VkDescriptorSet> cullDescriptorSets;
+
+        // Pipelines
+        std::unique_ptr<KnoxicComputePipeline> pyramidPipeline;
+        VkPipelineLayout pyramidPipelineLayout = VK_NULL_HANDLE;
+        std::unique_ptr<KnoxicComputePipeline> cullPipeline;
+        VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+    };
+}
\ No newline at end of file
@@ -12,24 +12,19 @@
 
 #include <memory>
 #include <stdexcept>
-#include <map>
 
 namespace knoxic {
 
-    struct PointLightPushConstants {
-        glm::vec4 position{}; // ignore w
-        glm::vec4 color{}; // w is intensity
-        float radius;
-    };
-
     PointLightSystem::PointLightSystem(
         KnoxicDevice &device,
         VkRenderPass renderPass,
+        VkRenderPass compositeRenderPass,
         VkDescriptorSetLayout globalSetLayout,
         std::shared_ptr<PointLightECSSystem> ecsPointLightSystem
     ) : knoxicDevice{device}, pointLightSystem{std::move(ecsPointLightSystem)} {
         createPipelineLayout(globalSetLayout);
-        createPipeline(renderPass);
+        knoxicPipeline = createPipeline(renderPass);
+        compositePipeline = createPipeline(compositeRenderPass);
     }
 
     PointLightSystem::~PointLightSystem() {
@@ -37,36 +32,32 @@ namespace knoxic {
     }
 
     void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
-        VkPushConstantRange pushConstantRange{};
-        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-        pushConstantRange.offset = 0;
-        pushConstantRange.size = sizeof(PointLightPushConstants);
-
         std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout};
 
         VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
         pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-        pipelineLayoutInfo.pushConstantRangeCount = 1;
-        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        pipelineLayoutInfo.pushConstantRangeCount = 0;
+        pipelineLayoutInfo.pPushConstantRanges = nullptr;
         if (vkCreatePipelineLayout(knoxicDevice.device(), &pipelineLayoutInfo, nullptr, 
         &pipelineLayout) != VK_SUCCESS) {
             throw std::runtime_error("failed to create pipeline layout!");
         }
     }
 
-    void PointLightSystem::createPipeline(VkRenderPass renderPass) {
+    std::unique_ptr<KnoxicPipeline> PointLightSystem::createPipeline(VkRenderPass renderPass) {
         assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
         PipelineConfigInfo pipelineConfig{};
         KnoxicPipeline::defaultPipelineConfigInfo(pipelineConfig);
         KnoxicPipeline::enableAlphaBlending(pipelineConfig);
-        pipelineConfig.attributeDescriptions.clear();
-        pipelineConfig.bindingDescriptions.clear();
+        KnoxicPipeline::skipVelocityOutput(pipelineConfig);
+        pipelineConfig.bindingDescriptions = LightGizmoInstance::getBindingDescriptions();
+        pipelineConfig.attributeDescriptions = LightGizmoInstance::getAttributeDescriptions();
         pipelineConfig.renderPass = renderPass;
         pipelineConfig.pipelineLayout = pipelineLayout;
-        knoxicPipeline = std::make_unique<KnoxicPipeline>(
+        return std::make_unique<KnoxicPipeline>(
             knoxicDevice,
             "shaders/vk_point_light.vert.spv",
             "shaders/vk_point_light.frag.spv",
@@ -74,41 +65,41 @@ namespace knoxic {
         );
     }
 
-    void PointLightSystem::update(FrameInfo &frameInfo, GlobalUbo &ubo) {
+    void PointLightSystem::update(FrameInfo &frameInfo, GlobalUbo &ubo, SceneLights &lights) {
         static float time = 0.0f;
         time += frameInfo.frameTime;
 
-        int lightIndex = 0;
+        lights.pointLights.clear();
+        lights.pointGizmos.clear();
         for (auto entity : pointLightSystem->mEntities) {
             auto &transform = gCoordinator.GetComponent<TransformComponent>(entity);
             auto &light = gCoordinator.GetComponent<PointLightComponent>(entity);
 
-            assert(lightIndex < MAX_LIGHTS && "Point lights exceed maximum specified limit");
-
             glm::vec3 color = glm::vec3(1.0f);
             if (gCoordinator.HasComponent<ColorComponent>(entity)) {
                 color = gCoordinator.GetComponent<ColorComponent>(entity).color;
             }
 
-            ubo.pointLights[lightIndex].position = glm::vec4(transform.translation, 1.0f);
-            ubo.pointLights[lightIndex].color = glm::vec4(color, light.lightIntensity);
-            lightIndex += 1;
+            float range = computeLightRange(color, light.lightIntensity, light.range);
+            LightGizmoInstance &gizmo = lights.pointGizmos.emplace_back();
+            gizmo.position = glm::vec4(transform.translation, transform.scale.x);
+            gizmo.lightIndex = static_cast<uint32_t>(lights.pointLights.size());
+
+            PointLight &pointLight = lights.pointLights.emplace_back();
+            pointLight.position = glm::vec4(transform.translation, range);
+            pointLight.color = glm::vec4(color, light.lightIntensity);
         }
 
-        ubo.numLights = lightIndex;
+        ubo.numLights = static_cast<int>(lights.pointLights.size());
     }
 
-    void PointLightSystem::render(FrameInfo &frameInfo) {
-        // Sort lights by distance to camera (furthest first)
-        std::map<float, Entity> sorted;
-        for (auto entity : pointLightSystem->mEntities) {
-            auto &transform = gCoordinator.GetComponent<TransformComponent>(entity);
-            auto offset = frameInfo.camera.getPosition() - transform.translation;
-            float disSquared = glm::dot(offset, offset);
-            sorted[disSquared] = entity;
+    void PointLightSystem::render(FrameInfo &frameInfo, VkBuffer instanceBuffer, VkDeviceSize instanceOffset, uint32_t instanceCount,
+    bool compositePass) {
+        if (instanceCount == 0) {
+            return;
         }
 
-        knoxicPipeline->bind(frameInfo.commandBuffer);
+        (compositePass ? compositePipeline : knoxicPipeline)->bind(frameInfo.commandBuffer);
 
         vkCmdBindDescriptorSets(
             frameInfo.commandBuffer,
@@ -116,35 +107,12 @@ namespace knoxic {
             pipelineLayout,
             0, 1,
             &frameInfo.globalDescriptorSet,
-            0, nullptr
+            static_cast<uint32_t>(frameInfo.globalDynamicOffsets.size()),
+            frameInfo.globalDynamicOffsets.data()
         );
 
-        // Iterate through the lights in reverse order
-        for (auto it = sorted.rbegin(); it != sorted.rend(); it++) {
-            Entity entity = it->second;
-            auto &transform = gCoordinator.GetComponent<TransformComponent>(entity);
-            auto &light = gCoordinator.GetComponent<PointLightComponent>(entity);
-
-            glm::vec3 color = glm::vec3(1.0f);
-            if (gCoordinator.HasComponent<ColorComponent>(entity)) {
-                color = gCoordinator.GetComponent<ColorComponent>(entity).color;
-            }
-
-            PointLightPushConstants push{};
-            push.position = glm::vec4(transform.translation, 1.0f);
-            push.color = glm::vec4(color, light.lightIntensity);
-            push.radius = transform.scale.x;
-
-            vkCmdPushConstants(
-                frameInfo.commandBuffer,
-                pipelineLayout,
-                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                0,
-                sizeof(PointLightPushConstants),
-                &push
-            );
-
-            vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
-        }
+        // One billboard per instance, already sorted back to front
+        vkCmdBindVertexBuffers(frameInfo.commandBuffer, 0, 1, &instanceBuffer, &instanceOffset);
+        vkCmdDraw(frameInfo.commandBuffer, 6, instanceCount, 0, 0);
     }
 }
\ No newline at end of file
@@ -11,22 +11,25 @@ namespace knoxic {
 
     class PointLightSystem {
     public:
-        PointLightSystem(KnoxicDevice &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout,
+        PointLightSystem(KnoxicDevice &device, VkRenderPass renderPass, VkRenderPass compositeRenderPass,
+                         VkDescriptorSetLayout globalSetLayout,
                          std::shared_ptr<PointLightECSSystem> ecsPointLightSystem);
         ~PointLightSystem();
 
         PointLightSystem(const PointLightSystem &) = delete;
         PointLightSystem &operator=(const PointLightSystem &) = delete;
 
-        void update(FrameInfo &frameInfo, GlobalUbo &ubo);
-        void render(FrameInfo &frameInfo);
+        void update(FrameInfo &frameInfo, GlobalUbo &ubo, SceneLights &lights);
+        void render(FrameInfo &frameInfo, VkBuffer instanceBuffer, VkDeviceSize instanceOffset, uint32_t instanceCount,
+            bool compositePass = false);
 
     private:
         void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-        void createPipeline(VkRenderPass renderPass);
+        std::unique_ptr<KnoxicPipeline> createPipeline(VkRenderPass renderPass);
 
         KnoxicDevice &knoxicDevice;
         std::unique_ptr<KnoxicPipeline> knoxicPipeline;
+        std::unique_ptr<KnoxicPipeline> compositePipeline;
         VkPipelineLayout pipelineLayout;
 
         // ECS
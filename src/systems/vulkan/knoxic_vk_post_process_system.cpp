@@ -1,19 +1,47 @@
 #include "knoxic_vk_post_process_system.hpp"
 #include "../../core/vulkan/knoxic_vk_swap_chain.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <stdexcept>
 #include <array>
 
 namespace knoxic {
 
-    PostProcessSystem::PostProcessSystem(KnoxicDevice& device, VkExtent2D extent) : knoxicDevice{device}, extent{extent} {
-        createHDRResources();
-        createBloomResources();
+    namespace {
+        VkExtent2D bucketExtent(VkExtent2D extent) {
+            auto bucket = [](uint32_t size) {
+                uint32_t steps = (std::max(size, 1u) + PostProcessSystem::TARGET_BUCKET_SIZE - 1) / PostProcessSystem::TARGET_BUCKET_SIZE;
+                return steps * PostProcessSystem::TARGET_BUCKET_SIZE;
+            };
+            return {bucket(extent.width), bucket(extent.height)};
+        }
+    }
+
+    PostProcessSystem::PostProcessSystem(KnoxicDevice& device, KnoxicRenderGraph& renderGraph,
+        KnoxicPipelineManager& pipelineManager, VkExtent2D extent, VkFormat swapChainFormat, VkRenderPass swapChainRenderPass,
+        RenderPath renderPath, VkFormat preferredHDRFormat)
+        : knoxicDevice{device}, renderGraph{renderGraph}, pipelineManager{pipelineManager}, extent{extent},
+        targetExtent{bucketExtent(extent)}, renderExtent{extent}, renderPath{renderPath}, swapChainFormat{swapChainFormat},
+        swapChainRenderPass{swapChainRenderPass} {
+        // Light gizmos blend into the HDR color, bloom or the TAA resolve sample it
+        hdrColorFormat = knoxicDevice.findSupportedFormat(
+            {preferredHDRFormat, VK_FORMAT_R16G16B16A16_SFLOAT},
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
+        );
+
+        hdrDepthFormat = knoxicDevice.findSupportedFormat(
+            {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
+        );
+
+        createSamplers();
         createRenderPasses();
-        createFramebuffers();
         createDescriptorSetLayouts();
-        createDescriptorSets();
         createPipelines();
+        createGradingLUT();
     }
 
     PostProcessSystem::~PostProcessSystem() {
@@ -21,25 +49,50 @@ namespace knoxic {
     }
 
     void PostProcessSystem::cleanup() {
-        vkDeviceWaitIdle(knoxicDevice.device());
+        destroyTargets();
+
+        // Destroy pipelines, compiles still running read the layouts
+        postProcessPipeline.wait();
+        compositeSubpassPipeline.wait();
+        bloomDownsamplePipeline.wait();
+        bloomUpsamplePipeline.wait();
+        gradingPipeline.wait();
 
-        // Destroy pipelines
         if (postProcessPipelineLayout != VK_NULL_HANDLE) {
             vkDestroyPipelineLayout(knoxicDevice.device(), postProcessPipelineLayout, nullptr);
             postProcessPipelineLayout = VK_NULL_HANDLE;
         }
-        if (blurPipelineLayout != VK_NULL_HANDLE) {
-            vkDestroyPipelineLayout(knoxicDevice.device(), blurPipelineLayout, nullptr);
-            blurPipelineLayout = VK_NULL_HANDLE;
+        if (bloomDownsamplePipelineLayout != VK_NULL_HANDLE) {
+            vkDestroyPipelineLayout(knoxicDevice.device(), bloomDownsamplePipelineLayout, nullptr);
+            bloomDownsamplePipelineLayout = VK_NULL_HANDLE;
+        }
+        if (bloomUpsamplePipelineLayout != VK_NULL_HANDLE) {
+            vkDestroyPipelineLayout(knoxicDevice.device(), bloomUpsamplePipelineLayout, nullptr);
+            bloomUpsamplePipelineLayout = VK_NULL_HANDLE;
         }
-        if (brightnessExtractPipelineLayout != VK_NULL_HANDLE) {
-            vkDestroyPipelineLayout(knoxicDevice.device(), brightnessExtractPipelineLayout, nullptr);
-            brightnessExtractPipelineLayout = VK_NULL_HANDLE;
+        if (compositeSubpassPipelineLayout != VK_NULL_HANDLE) {
+            vkDestroyPipelineLayout(knoxicDevice.device(), compositeSubpassPipelineLayout, nullptr);
+            compositeSubpassPipelineLayout = VK_NULL_HANDLE;
+        }
+        if (gradingPipelineLayout != VK_NULL_HANDLE) {
+            vkDestroyPipelineLayout(knoxicDevice.device(), gradingPipelineLayout, nullptr);
+            gradingPipelineLayout = VK_NULL_HANDLE;
         }
 
-        postProcessPipeline.reset();
-        blurPipeline.reset();
-        brightnessExtractPipeline.reset();
+        postProcessPipeline = {};
+        compositeSubpassPipeline = {};
+        bloomDownsamplePipeline = {};
+        bloomUpsamplePipeline = {};
+        gradingPipeline = {};
+
+        // Destroy the grading LUT
+        gradingDescriptorPool.reset();
+        if (gradingLUTView != VK_NULL_HANDLE) {
+            vkDestroyImageView(knoxicDevice.device(), gradingLUTView, nullptr);
+            vkDestroyImage(knoxicDevice.device(), gradingLUT, nullptr);
+            knoxicDevice.freeMemory(gradingLUTAllocation);
+            gradingLUTView = VK_NULL_HANDLE;
+        }
 
         // Destroy samplers
         if (hdrSampler != VK_NULL_HANDLE) {
@@ -51,176 +104,180 @@ namespace knoxic {
             bloomSampler = VK_NULL_HANDLE;
         }
 
-        // Destroy descriptor layouts and pool
-        brightnessExtractSetLayout.reset();
-        blurSetLayout.reset();
+        // Destroy descriptor layouts
+        bloomSetLayout.reset();
         postProcessSetLayout.reset();
-        descriptorPool.reset();
+        compositeInputSetLayout.reset();
+        gradingSetLayout.reset();
 
-        // Destroy bloom framebuffers and images
-        for (int i = 0; i < 2; i++) {
-            for (size_t j = 0; j < KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT; j++) {
-                if (j < bloomFramebuffers[i].size()) {
-                    vkDestroyFramebuffer(knoxicDevice.device(), bloomFramebuffers[i][j], nullptr);
-                }
-                if (j < bloomImageViews[i].size()) {
-                    vkDestroyImageView(knoxicDevice.device(), bloomImageViews[i][j], nullptr);
-                }
-                if (j < bloomImages[i].size()) {
-                    vkDestroyImage(knoxicDevice.device(), bloomImages[i][j], nullptr);
-                }
-                if (j < bloomImageMemories[i].size()) {
-                    vkFreeMemory(knoxicDevice.device(), bloomImageMemories[i][j], nullptr);
-                }
-            }
-            bloomFramebuffers[i].clear();
-            bloomImageViews[i].clear();
-            bloomImages[i].clear();
-            bloomImageMemories[i].clear();
+        if (gbufferRenderPass != VK_NULL_HANDLE) {
+            vkDestroyRenderPass(knoxicDevice.device(), gbufferRenderPass, nullptr);
+            gbufferRenderPass = VK_NULL_HANDLE;
         }
-
-        if (bloomRenderPass != VK_NULL_HANDLE) {
-            vkDestroyRenderPass(knoxicDevice.device(), bloomRenderPass, nullptr);
-            bloomRenderPass = VK_NULL_HANDLE;
-        }
-
-        // Destroy HDR framebuffers and images
-        for (size_t i = 0; i < hdrFramebuffers.size(); i++) {
-            vkDestroyFramebuffer(knoxicDevice.device(), hdrFramebuffers[i], nullptr);
+        if (gbufferResumeRenderPass != VK_NULL_HANDLE) {
+            vkDestroyRenderPass(knoxicDevice.device(), gbufferResumeRenderPass, nullptr);
+            gbufferResumeRenderPass = VK_NULL_HANDLE;
         }
-        for (size_t i = 0; i < hdrDepthImageViews.size(); i++) {
-            vkDestroyImageView(knoxicDevice.device(), hdrDepthImageViews[i], nullptr);
-        }
-        for (size_t i = 0; i < hdrDepthImages.size(); i++) {
-            vkDestroyImage(knoxicDevice.device(), hdrDepthImages[i], nullptr);
-        }
-        for (size_t i = 0; i < hdrDepthImageMemories.size(); i++) {
-            vkFreeMemory(knoxicDevice.device(), hdrDepthImageMemories[i], nullptr);
+        if (hdrRenderPass != VK_NULL_HANDLE) {
+            vkDestroyRenderPass(knoxicDevice.device(), hdrRenderPass, nullptr);
+            hdrRenderPass = VK_NULL_HANDLE;
         }
-        for (size_t i = 0; i < hdrImageViews.size(); i++) {
-            vkDestroyImageView(knoxicDevice.device(), hdrImageViews[i], nullptr);
+        if (hdrResumeRenderPass != VK_NULL_HANDLE) {
+            vkDestroyRenderPass(knoxicDevice.device(), hdrResumeRenderPass, nullptr);
+            hdrResumeRenderPass = VK_NULL_HANDLE;
         }
-        for (size_t i = 0; i < hdrImages.size(); i++) {
-            vkDestroyImage(knoxicDevice.device(), hdrImages[i], nullptr);
+        if (hdrCompositeRenderPass != VK_NULL_HANDLE) {
+            vkDestroyRenderPass(knoxicDevice.device(), hdrCompositeRenderPass, nullptr);
+            hdrCompositeRenderPass = VK_NULL_HANDLE;
         }
-        for (size_t i = 0; i < hdrImageMemories.size(); i++) {
-            vkFreeMemory(knoxicDevice.device(), hdrImageMemories[i], nullptr);
+    }
+
+    void PostProcessSystem::destroyTargets() {
+        vkDeviceWaitIdle(knoxicDevice.device());
+
+        // Descriptor sets and framebuffers over the graph images, the images themselves belong to the graph
+        descriptorPool.reset();
+
+        for (auto framebuffer : gbufferFramebuffers) {
+            vkDestroyFramebuffer(knoxicDevice.device(), framebuffer, nullptr);
         }
+        gbufferFramebuffers.clear();
 
+        for (auto framebuffer : hdrFramebuffers) {
+            vkDestroyFramebuffer(knoxicDevice.device(), framebuffer, nullptr);
+        }
         hdrFramebuffers.clear();
-        hdrDepthImageViews.clear();
-        hdrDepthImages.clear();
-        hdrDepthImageMemories.clear();
-        hdrImageViews.clear();
-        hdrImages.clear();
-        hdrImageMemories.clear();
 
-        if (hdrRenderPass != VK_NULL_HANDLE) {
-            vkDestroyRenderPass(knoxicDevice.device(), hdrRenderPass, nullptr);
-            hdrRenderPass = VK_NULL_HANDLE;
+        for (auto framebuffer : compositeFramebuffers) {
+            vkDestroyFramebuffer(knoxicDevice.device(), framebuffer, nullptr);
         }
+        compositeFramebuffers.clear();
+
+        for (auto &retired : retiredFramebuffers) {
+            vkDestroyFramebuffer(knoxicDevice.device(), retired.framebuffer, nullptr);
+        }
+        retiredFramebuffers.clear();
     }
 
-    void PostProcessSystem::recreate(VkExtent2D newExtent) {
+    bool PostProcessSystem::resize(VkExtent2D newExtent) {
         extent = newExtent;
-        cleanup();
-        createHDRResources();
-        createBloomResources();
-        createRenderPasses();
-        createFramebuffers();
-        createDescriptorSetLayouts();
-        createDescriptorSets();
-        createPipelines();
+        renderExtent = newExtent;
+
+        // Keep the targets while the output fits and uses at least half of them
+        uint64_t usedArea = static_cast<uint64_t>(extent.width) * extent.height;
+        uint64_t targetArea = static_cast<uint64_t>(targetExtent.width) * targetExtent.height;
+        bool fits = extent.width <= targetExtent.width && extent.height <= targetExtent.height;
+        if (fits && usedArea * 2 >= targetArea) {
+            return false;
+        }
+
+        targetExtent = bucketExtent(extent);
+        return true;
+    }
+
+    void PostProcessSystem::setSwapChainImageViews(const std::vector<VkImageView>& swapChainImageViews) {
+        if (!mergedComposite) {
+            return;
+        }
+
+        for (auto framebuffer : compositeFramebuffers) {
+            retiredFramebuffers.push_back({framebuffer, KnoxicSwapChain::framesInFlight()});
+        }
+        compositeFramebuffers.clear();
+        createCompositeFramebuffers(swapChainImageViews);
     }
 
-    void PostProcessSystem::createHDRResources() {
-        hdrImages.resize(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT);
-        hdrImageMemories.resize(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT);
-        hdrImageViews.resize(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT);
-        hdrDepthImages.resize(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT);
-        hdrDepthImageMemories.resize(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT);
-        hdrDepthImageViews.resize(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT);
-
-        VkFormat hdrFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
-
-        for (size_t i = 0; i < KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
-            // Create HDR color image
-            VkImageCreateInfo imageInfo{};
-            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-            imageInfo.imageType = VK_IMAGE_TYPE_2D;
-            imageInfo.extent.width = extent.width;
-            imageInfo.extent.height = extent.height;
-            imageInfo.extent.depth = 1;
-            imageInfo.mipLevels = 1;
-            imageInfo.arrayLayers = 1;
-            imageInfo.format = hdrFormat;
-            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-            knoxicDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                hdrImages[i], hdrImageMemories[i]);
-
-            // Create image view
-            VkImageViewCreateInfo viewInfo{};
-            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-            viewInfo.image = hdrImages[i];
-            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-            viewInfo.format = hdrFormat;
-            viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            viewInfo.subresourceRange.baseMipLevel = 0;
-            viewInfo.subresourceRange.levelCount = 1;
-            viewInfo.subresourceRange.baseArrayLayer = 0;
-            viewInfo.subresourceRange.layerCount = 1;
-
-            if (vkCreateImageView(knoxicDevice.device(), &viewInfo, nullptr, &hdrImageViews[i]) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create HDR image view!");
+    void PostProcessSystem::releaseRetired() {
+        // Same counting as the renderer's retired swap chains, each call follows a wait on one frame slot's fence
+        for (auto &retired : retiredFramebuffers) {
+            if (--retired.framesLeft <= 0) {
+                vkDestroyFramebuffer(knoxicDevice.device(), retired.framebuffer, nullptr);
             }
+        }
+        retiredFramebuffers.erase(
+            std::remove_if(retiredFramebuffers.begin(), retiredFramebuffers.end(),
+                [](const RetiredFramebuffer &retired) { return retired.framesLeft <= 0; }),
+            retiredFramebuffers.end());
+    }
+
+    void PostProcessSystem::recreate() {
+        destroyTargets();
+    }
 
-            // Create depth image
-            VkFormat depthFormat = knoxicDevice.findSupportedFormat(
-                {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
-                VK_IMAGE_TILING_OPTIMAL,
-                VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
-            );
-
-            VkImageCreateInfo depthImageInfo{};
-            depthImageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-            depthImageInfo.imageType = VK_IMAGE_TYPE_2D;
-            depthImageInfo.extent.width = extent.width;
-            depthImageInfo.extent.height = extent.height;
-            depthImageInfo.extent.depth = 1;
-            depthImageInfo.mipLevels = 1;
-            depthImageInfo.arrayLayers = 1;
-            depthImageInfo.format = depthFormat;
-            depthImageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-            depthImageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            depthImageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-            depthImageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-            depthImageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-            knoxicDevice.createImageWithInfo(depthImageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                hdrDepthImages[i], hdrDepthImageMemories[i]);
-
-            // Create depth image view
-            VkImageViewCreateInfo depthViewInfo{};
-            depthViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-            depthViewInfo.image = hdrDepthImages[i];
-            depthViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-            depthViewInfo.format = depthFormat;
-            depthViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-            depthViewInfo.subresourceRange.baseMipLevel = 0;
-            depthViewInfo.subresourceRange.levelCount = 1;
-            depthViewInfo.subresourceRange.baseArrayLayer = 0;
-            depthViewInfo.subresourceRange.layerCount = 1;
-
-            if (vkCreateImageView(knoxicDevice.device(), &depthViewInfo, nullptr, &hdrDepthImageViews[i]) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create depth image view!");
+    void PostProcessSystem::setRenderExtent(VkExtent2D newRenderExtent) {
+        assert((!mergedComposite || (newRenderExtent.width == extent.width && newRenderExtent.height == extent.height)) &&
+            "merged composite can't upscale");
+        renderExtent = {std::min(newRenderExtent.width, extent.width), std::min(newRenderExtent.height, extent.height)};
+    }
+
+    void PostProcessSystem::declareResources() {
+        RenderGraphImageDesc hdrDesc{};
+        hdrDesc.format = hdrColorFormat;
+        hdrDesc.extent = targetExtent;
+        hdrDesc.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        hdrDesc.usage |= mergedComposite ? VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT : VK_IMAGE_USAGE_SAMPLED_BIT; // Transient when merged
+        hdrColor = renderGraph.createImage("hdr_color", hdrDesc);
+
+        RenderGraphImageDesc depthDesc{};
+        depthDesc.format = hdrDepthFormat;
+        depthDesc.extent = targetExtent;
+        depthDesc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        if (renderPath == RenderPath::Deferred) {
+            depthDesc.usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT; // Position reconstruction
+        }
+        hdrDepth = renderGraph.createImage("hdr_depth", depthDesc);
+
+        RenderGraphImageDesc velocityDesc{};
+        velocityDesc.format = VELOCITY_FORMAT;
+        velocityDesc.extent = targetExtent;
+        velocityDesc.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        velocity = renderGraph.createImage("velocity", velocityDesc);
+
+        if (renderPath == RenderPath::Deferred) {
+            const VkFormat gbufferFormats[GBUFFER_COUNT] = {
+                VK_FORMAT_R8G8B8A8_UNORM, // Albedo
+                VK_FORMAT_R16G16B16A16_SFLOAT, // World normal
+                VK_FORMAT_R8G8B8A8_UNORM // Roughness, metallic, ao, lit
+            };
+            const char *gbufferNames[GBUFFER_COUNT] = {"gbuffer_albedo", "gbuffer_normal", "gbuffer_material"};
+
+            for (int target = 0; target < GBUFFER_COUNT; target++) {
+                RenderGraphImageDesc gbufferDesc{};
+                gbufferDesc.format = gbufferFormats[target];
+                gbufferDesc.extent = targetExtent;
+                gbufferDesc.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+                gbuffer[target] = renderGraph.createImage(gbufferNames[target], gbufferDesc);
             }
         }
 
+        // The merged composite has no bloom
+        if (mergedComposite) {
+            return;
+        }
+
+        // Half resolution base, halved until the short side would drop below two texels
+        VkExtent2D baseExtent = {std::max(targetExtent.width / 2, 1u), std::max(targetExtent.height / 2, 1u)};
+        bloomMipLevels = 1;
+        while (bloomMipLevels < BLOOM_MAX_MIPS &&
+            (std::min(baseExtent.width, baseExtent.height) >> bloomMipLevels) >= 2) {
+            bloomMipLevels++;
+        }
+
+        // Written as a storage image, the format has to match the rgba16f qualifier of the bloom shaders
+        RenderGraphImageDesc bloomDesc{};
+        bloomDesc.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+        bloomDesc.extent = baseExtent;
+        bloomDesc.mipLevels = bloomMipLevels;
+        bloomDesc.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        bloomChain = renderGraph.createImage("bloom_chain", bloomDesc);
+    }
+
+    void PostProcessSystem::createTargets(const std::vector<VkImageView>& swapChainImageViews) {
+        createFramebuffers(swapChainImageViews);
+        createDescriptorSets();
+    }
+
+    void PostProcessSystem::createSamplers() {
         // Create HDR sampler
         VkSamplerCreateInfo samplerInfo{};
         samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -238,70 +295,123 @@ namespace knoxic {
         if (vkCreateSampler(knoxicDevice.device(), &samplerInfo, nullptr, &hdrSampler) != VK_SUCCESS) {
             throw std::runtime_error("failed to create HDR sampler!");
         }
+
+        // Create bloom sampler, same filtering
+        if (vkCreateSampler(knoxicDevice.device(), &samplerInfo, nullptr, &bloomSampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create bloom sampler!");
+        }
     }
 
-    void PostProcessSystem::createBloomResources() {
-        for (int i = 0; i < 2; i++) {
-            bloomImages[i].resize(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT);
-            bloomImageMemories[i].resize(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT);
-            bloomImageViews[i].resize(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT);
-        }
-
-        VkFormat bloomFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
-
-        for (int pingPong = 0; pingPong < 2; pingPong++) {
-            for (size_t i = 0; i < KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
-                VkImageCreateInfo imageInfo{};
-                imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-                imageInfo.imageType = VK_IMAGE_TYPE_2D;
-                imageInfo.extent.width = extent.width / 2;
-                imageInfo.extent.height = extent.height / 2;
-                imageInfo.extent.depth = 1;
-                imageInfo.mipLevels = 1;
-                imageInfo.arrayLayers = 1;
-                imageInfo.format = bloomFormat;
-                imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-                imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-                imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-                imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-                imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-                knoxicDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                    bloomImages[pingPong][i], bloomImageMemories[pingPong][i]);
-
-                VkImageViewCreateInfo viewInfo{};
-                viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-                viewInfo.image = bloomImages[pingPong][i];
-                viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-                viewInfo.format = bloomFormat;
-                viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                viewInfo.subresourceRange.baseMipLevel = 0;
-                viewInfo.subresourceRange.levelCount = 1;
-                viewInfo.subresourceRange.baseArrayLayer = 0;
-                viewInfo.subresourceRange.layerCount = 1;
-
-                if (vkCreateImageView(knoxicDevice.device(), &viewInfo, nullptr, &bloomImageViews[pingPong][i]) != VK_SUCCESS) {
-                    throw std::runtime_error("failed to create bloom image view!");
-                }
-            }
+    void PostProcessSystem::createGBufferRenderPasses() {
+        // 0: HDR color (emission and unlit), 1: depth, 2-4: G-buffer targets, 5: velocity
+        std::array<VkAttachmentDescription, 6> attachments{};
+
+        attachments[0].format = hdrColorFormat;
+        attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        attachments[1] = attachments[0];
+        attachments[1].format = hdrDepthFormat;
+        attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL; // Read by the Hi-Z pyramid build
+
+        const VkFormat gbufferFormats[GBUFFER_COUNT] = {
+            VK_FORMAT_R8G8B8A8_UNORM,
+            VK_FORMAT_R16G16B16A16_SFLOAT,
+            VK_FORMAT_R8G8B8A8_UNORM
+        };
+        for (int target = 0; target < GBUFFER_COUNT; target++) {
+            attachments[2 + target] = attachments[0];
+            attachments[2 + target].format = gbufferFormats[target];
         }
 
-        // Create bloom sampler
-        VkSamplerCreateInfo samplerInfo{};
-        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-        samplerInfo.magFilter = VK_FILTER_LINEAR;
-        samplerInfo.minFilter = VK_FILTER_LINEAR;
-        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-        samplerInfo.anisotropyEnable = VK_FALSE;
-        samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-        samplerInfo.unnormalizedCoordinates = VK_FALSE;
-        samplerInfo.compareEnable = VK_FALSE;
-        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        attachments[5] = attachments[0];
+        attachments[5].format = VELOCITY_FORMAT;
+
+        // Subpass 0 writes the G-buffer
+        std::array<VkAttachmentReference, 5> gbufferColorRefs = {{
+            {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+            {2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+            {3, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+            {4, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+            {5, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}
+        }};
+        VkAttachmentReference gbufferDepthRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+        // Subpass 1 reads it back from tile memory and adds lighting to the HDR color
+        std::array<VkAttachmentReference, 4> lightingInputRefs = {{
+            {2, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+            {3, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+            {4, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+            {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL}
+        }};
+        VkAttachmentReference lightingColorRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+        VkAttachmentReference lightingDepthRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL}; // Light volume depth test
+
+        std::array<VkSubpassDescription, 2> subpasses{};
+        subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpasses[0].colorAttachmentCount = static_cast<uint32_t>(gbufferColorRefs.size());
+        subpasses[0].pColorAttachments = gbufferColorRefs.data();
+        subpasses[0].pDepthStencilAttachment = &gbufferDepthRef;
+
+        subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpasses[1].inputAttachmentCount = static_cast<uint32_t>(lightingInputRefs.size());
+        subpasses[1].pInputAttachments = lightingInputRefs.data();
+        subpasses[1].colorAttachmentCount = 1;
+        subpasses[1].pColorAttachments = &lightingColorRef;
+        subpasses[1].pDepthStencilAttachment = &lightingDepthRef;
+
+        std::array<VkSubpassDependency, 2> dependencies{};
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependencies[0].srcAccessMask = 0;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].dstSubpass = 1;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        renderPassInfo.pAttachments = attachments.data();
+        renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+        renderPassInfo.pSubpasses = subpasses.data();
+        renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+        renderPassInfo.pDependencies = dependencies.data();
+
+        if (vkCreateRenderPass(knoxicDevice.device(), &renderPassInfo, nullptr, &gbufferRenderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create G-buffer render pass!");
+        }
 
-        if (vkCreateSampler(knoxicDevice.device(), &samplerInfo, nullptr, &bloomSampler) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create bloom sampler!");
+        // Resume pass: late occlusion phase and lighting. The G-buffer is consumed here and never stored
+        for (auto &attachment : attachments) {
+            attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+            attachment.initialLayout = attachment.finalLayout;
+        }
+        for (int target = 0; target < GBUFFER_COUNT; target++) {
+            attachments[2 + target].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        }
+
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        if (vkCreateRenderPass(knoxicDevice.device(), &renderPassInfo, nullptr, &gbufferResumeRenderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create G-buffer resume render pass!");
         }
     }
 
@@ -309,32 +419,33 @@ namespace knoxic {
         // HDR render pass
         {
             VkAttachmentDescription colorAttachment{};
-            colorAttachment.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+            colorAttachment.format = hdrColorFormat;
             colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
             colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
             colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
             colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
             colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
             colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // Resumed after occlusion culling
 
             VkAttachmentDescription depthAttachment{};
-            depthAttachment.format = knoxicDevice.findSupportedFormat(
-                {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
-                VK_IMAGE_TILING_OPTIMAL,
-                VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
-            );
+            depthAttachment.format = hdrDepthFormat;
             depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
             depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // Read by the Hi-Z pyramid build
             depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
             depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
             depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
             depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-            VkAttachmentReference colorAttachmentRef{};
-            colorAttachmentRef.attachment = 0;
-            colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            // Screen space motion, read by the temporal resolve
+            VkAttachmentDescription velocityAttachment = colorAttachment;
+            velocityAttachment.format = VELOCITY_FORMAT;
+
+            std::array<VkAttachmentReference, 2> colorAttachmentRefs = {{
+                {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+                {2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}
+            }};
 
             VkAttachmentReference depthAttachmentRef{};
             depthAttachmentRef.attachment = 1;
@@ -342,8 +453,8 @@ namespace knoxic {
 
             VkSubpassDescription subpass{};
             subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-            subpass.colorAttachmentCount = 1;
-            subpass.pColorAttachments = &colorAttachmentRef;
+            subpass.colorAttachmentCount = static_cast<uint32_t>(colorAttachmentRefs.size());
+            subpass.pColorAttachments = colorAttachmentRefs.data();
             subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
             VkSubpassDependency dependency{};
@@ -354,7 +465,7 @@ namespace knoxic {
             dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
             dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
-            std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+            std::array<VkAttachmentDescription, 3> attachments = {colorAttachment, depthAttachment, velocityAttachment};
             VkRenderPassCreateInfo renderPassInfo{};
             renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
             renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
@@ -367,59 +478,98 @@ namespace knoxic {
             if (vkCreateRenderPass(knoxicDevice.device(), &renderPassInfo, nullptr, &hdrRenderPass) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create HDR render pass!");
             }
-        }
 
-        // Bloom render pass (simple color attachment for bloom buffers)
-        {
-            VkAttachmentDescription colorAttachment{};
-            colorAttachment.format = VK_FORMAT_R16G16B16A16_SFLOAT;
-            colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-            colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-            colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-            colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-            colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-            VkAttachmentReference colorAttachmentRef{};
-            colorAttachmentRef.attachment = 0;
-            colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-            VkSubpassDescription subpass{};
-            subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-            subpass.colorAttachmentCount = 1;
-            subpass.pColorAttachments = &colorAttachmentRef;
+            // Resume pass: same attachments, loads what the first pass left behind. The render graph moves the color on to sampling
+            colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+            colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+            depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            velocityAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+            velocityAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            attachments = {colorAttachment, depthAttachment, velocityAttachment};
 
-            VkSubpassDependency dependency{};
-            dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-            dependency.dstSubpass = 0;
-            dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            dependency.srcAccessMask = 0;
-            dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+            dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
-            VkRenderPassCreateInfo renderPassInfo{};
-            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-            renderPassInfo.attachmentCount = 1;
-            renderPassInfo.pAttachments = &colorAttachment;
-            renderPassInfo.subpassCount = 1;
-            renderPassInfo.pSubpasses = &subpass;
-            renderPassInfo.dependencyCount = 1;
-            renderPassInfo.pDependencies = &dependency;
+            if (vkCreateRenderPass(knoxicDevice.device(), &renderPassInfo, nullptr, &hdrResumeRenderPass) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create HDR resume render pass!");
+            }
 
-            if (vkCreateRenderPass(knoxicDevice.device(), &renderPassInfo, nullptr, &bloomRenderPass) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create bloom render pass!");
+            // Composite pass: the resume pass plus a subpass that tonemaps the color into the swap chain image.
+            // Nothing reads color, depth or velocity afterwards, so none of them is stored
+            colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            velocityAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+            VkAttachmentDescription swapChainAttachment{};
+            swapChainAttachment.format = swapChainFormat;
+            swapChainAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+            swapChainAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; // Full-screen triangle covers it
+            swapChainAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            swapChainAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            swapChainAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            swapChainAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            swapChainAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // UI is drawn on top next
+
+            VkAttachmentReference sceneInputRef{0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+            VkAttachmentReference swapChainRef{3, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+            std::array<VkSubpassDescription, 2> compositeSubpasses = {subpass, VkSubpassDescription{}};
+            compositeSubpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+            compositeSubpasses[1].inputAttachmentCount = 1;
+            compositeSubpasses[1].pInputAttachments = &sceneInputRef;
+            compositeSubpasses[1].colorAttachmentCount = 1;
+            compositeSubpasses[1].pColorAttachments = &swapChainRef;
+
+            std::array<VkSubpassDependency, 3> compositeDependencies = {dependency, VkSubpassDependency{}, VkSubpassDependency{}};
+            compositeDependencies[1].srcSubpass = VK_SUBPASS_EXTERNAL;
+            compositeDependencies[1].dstSubpass = 1;
+            compositeDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT; // Swap chain acquire
+            compositeDependencies[1].srcAccessMask = 0;
+            compositeDependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            compositeDependencies[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+            compositeDependencies[2].srcSubpass = 0;
+            compositeDependencies[2].dstSubpass = 1;
+            compositeDependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            compositeDependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            compositeDependencies[2].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            compositeDependencies[2].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+            compositeDependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+            std::array<VkAttachmentDescription, 4> compositeAttachments = {
+                colorAttachment, depthAttachment, velocityAttachment, swapChainAttachment
+            };
+            renderPassInfo.attachmentCount = static_cast<uint32_t>(compositeAttachments.size());
+            renderPassInfo.pAttachments = compositeAttachments.data();
+            renderPassInfo.subpassCount = static_cast<uint32_t>(compositeSubpasses.size());
+            renderPassInfo.pSubpasses = compositeSubpasses.data();
+            renderPassInfo.dependencyCount = static_cast<uint32_t>(compositeDependencies.size());
+            renderPassInfo.pDependencies = compositeDependencies.data();
+
+            if (vkCreateRenderPass(knoxicDevice.device(), &renderPassInfo, nullptr, &hdrCompositeRenderPass) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create HDR composite render pass!");
             }
         }
+
+        if (renderPath == RenderPath::Deferred) {
+            createGBufferRenderPasses();
+        }
     }
 
-    void PostProcessSystem::createFramebuffers() {
+    void PostProcessSystem::createFramebuffers(const std::vector<VkImageView>& swapChainImageViews) {
         // HDR framebuffers
-        hdrFramebuffers.resize(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT);
+        hdrFramebuffers.resize(KnoxicSwapChain::framesInFlight());
         for (size_t i = 0; i < hdrFramebuffers.size(); i++) {
-            std::array<VkImageView, 2> attachments = {
-                hdrImageViews[i],
-                hdrDepthImageViews[i]
+            int frameIndex = static_cast<int>(i);
+            std::array<VkImageView, 3> attachments = {
+                renderGraph.getImageView(hdrColor, frameIndex),
+                renderGraph.getImageView(hdrDepth, frameIndex),
+                renderGraph.getImageView(velocity, frameIndex)
             };
 
             VkFramebufferCreateInfo framebufferInfo{};
@@ -427,8 +577,8 @@ namespace knoxic {
             framebufferInfo.renderPass = hdrRenderPass;
             framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
             framebufferInfo.pAttachments = attachments.data();
-            framebufferInfo.width = extent.width;
-            framebufferInfo.height = extent.height;
+            framebufferInfo.width = targetExtent.width;
+            framebufferInfo.height = targetExtent.height;
             framebufferInfo.layers = 1;
 
             if (vkCreateFramebuffer(knoxicDevice.device(), &framebufferInfo, nullptr, &hdrFramebuffers[i]) != VK_SUCCESS) {
@@ -436,108 +586,197 @@ namespace knoxic {
             }
         }
 
-        // Bloom framebuffers
-        for (int pingPong = 0; pingPong < 2; pingPong++) {
-            bloomFramebuffers[pingPong].resize(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT);
-            for (size_t i = 0; i < bloomFramebuffers[pingPong].size(); i++) {
+        // G-buffer framebuffers, shared by both G-buffer passes
+        if (renderPath == RenderPath::Deferred) {
+            gbufferFramebuffers.resize(KnoxicSwapChain::framesInFlight());
+            for (size_t i = 0; i < gbufferFramebuffers.size(); i++) {
+                int frameIndex = static_cast<int>(i);
+                std::array<VkImageView, 6> attachments = {
+                    renderGraph.getImageView(hdrColor, frameIndex),
+                    renderGraph.getImageView(hdrDepth, frameIndex),
+                    renderGraph.getImageView(gbuffer[GBUFFER_ALBEDO], frameIndex),
+                    renderGraph.getImageView(gbuffer[GBUFFER_NORMAL], frameIndex),
+                    renderGraph.getImageView(gbuffer[GBUFFER_MATERIAL], frameIndex),
+                    renderGraph.getImageView(velocity, frameIndex)
+                };
+
                 VkFramebufferCreateInfo framebufferInfo{};
                 framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-                framebufferInfo.renderPass = bloomRenderPass;
-                framebufferInfo.attachmentCount = 1;
-                framebufferInfo.pAttachments = &bloomImageViews[pingPong][i];
-                framebufferInfo.width = extent.width / 2;
-                framebufferInfo.height = extent.height / 2;
+                framebufferInfo.renderPass = gbufferRenderPass;
+                framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+                framebufferInfo.pAttachments = attachments.data();
+                framebufferInfo.width = targetExtent.width;
+                framebufferInfo.height = targetExtent.height;
                 framebufferInfo.layers = 1;
 
-                if (vkCreateFramebuffer(knoxicDevice.device(), &framebufferInfo, nullptr, &bloomFramebuffers[pingPong][i]) != VK_SUCCESS) {
-                    throw std::runtime_error("failed to create bloom framebuffer!");
+                if (vkCreateFramebuffer(knoxicDevice.device(), &framebufferInfo, nullptr, &gbufferFramebuffers[i]) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create G-buffer framebuffer!");
                 }
             }
         }
+
+        if (mergedComposite) {
+            createCompositeFramebuffers(swapChainImageViews);
+        }
+    }
+
+    void PostProcessSystem::createCompositeFramebuffers(const std::vector<VkImageView>& swapChainImageViews) {
+        // Merged composite framebuffers, the swap chain image is picked per frame. Only as large as the swap chain
+        swapChainImageCount = swapChainImageViews.size();
+        compositeFramebuffers.resize(KnoxicSwapChain::framesInFlight() * swapChainImageCount);
+        for (size_t i = 0; i < compositeFramebuffers.size(); i++) {
+            int frameIndex = static_cast<int>(i / swapChainImageCount);
+            std::array<VkImageView, 4> attachments = {
+                renderGraph.getImageView(hdrColor, frameIndex),
+                renderGraph.getImageView(hdrDepth, frameIndex),
+                renderGraph.getImageView(velocity, frameIndex),
+                swapChainImageViews[i % swapChainImageCount]
+            };
+
+            VkFramebufferCreateInfo framebufferInfo{};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = hdrCompositeRenderPass;
+            framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+            framebufferInfo.pAttachments = attachments.data();
+            framebufferInfo.width = extent.width;
+            framebufferInfo.height = extent.height;
+            framebufferInfo.layers = 1;
+
+            if (vkCreateFramebuffer(knoxicDevice.device(), &framebufferInfo, nullptr, &compositeFramebuffers[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create composite framebuffer!");
+            }
+        }
     }
 
     void PostProcessSystem::createDescriptorSetLayouts() {
-        // Brightness extract: single texture input
-        brightnessExtractSetLayout = KnoxicDescriptorSetLayout::Builder(knoxicDevice)
-            .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+        // Bloom downsample and upsample: source level + destination level
+        bloomSetLayout = KnoxicDescriptorSetLayout::Builder(knoxicDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
             .build();
 
-        // Blur: single texture input
-        blurSetLayout = KnoxicDescriptorSetLayout::Builder(knoxicDevice)
+        // Post process: scene texture + bloom texture + grading LUT
+        postProcessSetLayout = KnoxicDescriptorSetLayout::Builder(knoxicDevice)
             .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
             .build();
 
-        // Post process: scene texture + bloom texture
-        postProcessSetLayout = KnoxicDescriptorSetLayout::Builder(knoxicDevice)
-            .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+        // Merged composite: the HDR color as an input attachment + grading LUT
+        compositeInputSetLayout = KnoxicDescriptorSetLayout::Builder(knoxicDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
             .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
             .build();
+
+        // Grading LUT bake: the LUT as a storage image
+        gradingSetLayout = KnoxicDescriptorSetLayout::Builder(knoxicDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+            .build();
     }
 
     void PostProcessSystem::createDescriptorSets() {
-        // Create descriptor pool
+        // Create descriptor pool, per frame one downsample and one upsample set per bloom level plus both composites
         descriptorPool = KnoxicDescriptorPool::Builder(knoxicDevice)
-            .setMaxSets(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT * 6)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT * 8)
+            .setMaxSets(KnoxicSwapChain::framesInFlight() * (BLOOM_MAX_MIPS * 2 + 2))
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, KnoxicSwapChain::framesInFlight() * (BLOOM_MAX_MIPS * 2 + 4))
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, KnoxicSwapChain::framesInFlight() * BLOOM_MAX_MIPS * 2)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, KnoxicSwapChain::framesInFlight())
             .build();
 
-        // Brightness extract descriptor sets
-        brightnessExtractDescriptorSets.resize(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT);
-        for (size_t i = 0; i < brightnessExtractDescriptorSets.size(); i++) {
-            VkDescriptorImageInfo imageInfo{};
-            imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            imageInfo.imageView = hdrImageViews[i];
-            imageInfo.sampler = hdrSampler;
-
-            KnoxicDescriptorWriter(*brightnessExtractSetLayout, *descriptorPool)
-                .writeImage(0, &imageInfo)
-                .build(brightnessExtractDescriptorSets[i]);
-        }
-
-        // Blur descriptor sets
-        for (int pingPong = 0; pingPong < 2; pingPong++) {
-            blurDescriptorSets[pingPong].resize(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT);
-            for (size_t i = 0; i < blurDescriptorSets[pingPong].size(); i++) {
-                VkDescriptorImageInfo imageInfo{};
-                imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                imageInfo.imageView = bloomImageViews[pingPong][i];
-                imageInfo.sampler = bloomSampler;
-
-                KnoxicDescriptorWriter(*blurSetLayout, *descriptorPool)
-                    .writeImage(0, &imageInfo)
-                    .build(blurDescriptorSets[pingPong][i]);
+        VkDescriptorImageInfo gradingLUTInfo{};
+        gradingLUTInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        gradingLUTInfo.imageView = gradingLUTView;
+        gradingLUTInfo.sampler = hdrSampler;
+
+        if (mergedComposite) {
+            compositeInputDescriptorSets.resize(KnoxicSwapChain::framesInFlight());
+            for (size_t i = 0; i < compositeInputDescriptorSets.size(); i++) {
+                VkDescriptorImageInfo sceneInputInfo{};
+                sceneInputInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                sceneInputInfo.imageView = renderGraph.getImageView(hdrColor, static_cast<int>(i));
+
+                KnoxicDescriptorWriter(*compositeInputSetLayout, *descriptorPool)
+                    .writeImage(0, &sceneInputInfo)
+                    .writeImage(1, &gradingLUTInfo)
+                    .build(compositeInputDescriptorSets[i]);
+            }
+            return;
+        }
+
+        // Bloom descriptor sets, the render graph keeps the whole chain in GENERAL while it is built
+        bloomDownsampleDescriptorSets.resize(KnoxicSwapChain::framesInFlight());
+        bloomUpsampleDescriptorSets.resize(KnoxicSwapChain::framesInFlight());
+        for (size_t i = 0; i < KnoxicSwapChain::framesInFlight(); i++) {
+            int frameIndex = static_cast<int>(i);
+
+            // Level 0 reads the HDR scene, every other level the one above it
+            bloomDownsampleDescriptorSets[i].resize(bloomMipLevels);
+            for (uint32_t level = 0; level < bloomMipLevels; level++) {
+                VkDescriptorImageInfo srcInfo{};
+                srcInfo.imageLayout = level == 0 ? getSceneColorLayout() : VK_IMAGE_LAYOUT_GENERAL;
+                srcInfo.imageView = level == 0 ?
+                    getSceneColorView(frameIndex) : renderGraph.getMipView(bloomChain, frameIndex, level - 1);
+                srcInfo.sampler = level == 0 ? hdrSampler : bloomSampler;
+
+                VkDescriptorImageInfo dstInfo{};
+                dstInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+                dstInfo.imageView = renderGraph.getMipView(bloomChain, frameIndex, level);
+
+                KnoxicDescriptorWriter(*bloomSetLayout, *descriptorPool)
+                    .writeImage(0, &srcInfo)
+                    .writeImage(1, &dstInfo)
+                    .build(bloomDownsampleDescriptorSets[i][level]);
+            }
+
+            // Level n accumulates level n + 1
+            bloomUpsampleDescriptorSets[i].resize(bloomMipLevels - 1);
+            for (uint32_t level = 0; level + 1 < bloomMipLevels; level++) {
+                VkDescriptorImageInfo srcInfo{};
+                srcInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+                srcInfo.imageView = renderGraph.getMipView(bloomChain, frameIndex, level + 1);
+                srcInfo.sampler = bloomSampler;
+
+                VkDescriptorImageInfo dstInfo{};
+                dstInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+                dstInfo.imageView = renderGraph.getMipView(bloomChain, frameIndex, level);
+
+                KnoxicDescriptorWriter(*bloomSetLayout, *descriptorPool)
+                    .writeImage(0, &srcInfo)
+                    .writeImage(1, &dstInfo)
+                    .build(bloomUpsampleDescriptorSets[i][level]);
             }
         }
 
         // Post process descriptor sets
-        postProcessDescriptorSets.resize(KnoxicSwapChain::MAX_FRAMES_IN_FLIGHT);
+        postProcessDescriptorSets.resize(KnoxicSwapChain::framesInFlight());
         for (size_t i = 0; i < postProcessDescriptorSets.size(); i++) {
             VkDescriptorImageInfo sceneImageInfo{};
-            sceneImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            sceneImageInfo.imageView = hdrImageViews[i];
+            sceneImageInfo.imageLayout = getSceneColorLayout();
+            sceneImageInfo.imageView = getSceneColorView(static_cast<int>(i));
             sceneImageInfo.sampler = hdrSampler;
 
             VkDescriptorImageInfo bloomImageInfo{};
             bloomImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            bloomImageInfo.imageView = bloomImageViews[0][i]; // Use buffer 0
+            bloomImageInfo.imageView = renderGraph.getMipView(bloomChain, static_cast<int>(i), 0);
             bloomImageInfo.sampler = bloomSampler;
 
             KnoxicDescriptorWriter(*postProcessSetLayout, *descriptorPool)
                 .writeImage(0, &sceneImageInfo)
                 .writeImage(1, &bloomImageInfo)
+                .writeImage(2, &gradingLUTInfo)
                 .build(postProcessDescriptorSets[i]);
         }
     }
 
     void PostProcessSystem::createPipelines() {
-        // Brightness extract pipeline
+        // Bloom downsample pipeline
         {
             VkPushConstantRange pushConstantRange{};
-            pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+            pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
             pushConstantRange.offset = 0;
-            pushConstantRange.size = sizeof(float);
+            pushConstantRange.size = sizeof(BloomDownsamplePushConstants);
 
-            VkDescriptorSetLayout setLayout = brightnessExtractSetLayout->getDescriptorSetLayout();
+            VkDescriptorSetLayout setLayout = bloomSetLayout->getDescriptorSetLayout();
             VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
             pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
             pipelineLayoutInfo.setLayoutCount = 1;
@@ -545,34 +784,24 @@ namespace knoxic {
             pipelineLayoutInfo.pushConstantRangeCount = 1;
             pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-            if (vkCreatePipelineLayout(knoxicDevice.device(), &pipelineLayoutInfo, nullptr, &brightnessExtractPipelineLayout) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create brightness extract pipeline layout!");
+            if (vkCreatePipelineLayout(knoxicDevice.device(), &pipelineLayoutInfo, nullptr, &bloomDownsamplePipelineLayout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create bloom downsample pipeline layout!");
             }
 
-            PipelineConfigInfo pipelineConfig{};
-            KnoxicPipeline::defaultPipelineConfigInfo(pipelineConfig);
-            pipelineConfig.renderPass = bloomRenderPass;
-            pipelineConfig.pipelineLayout = brightnessExtractPipelineLayout;
-            pipelineConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
-            pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
-            pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_NONE;
-
-            brightnessExtractPipeline = std::make_unique<KnoxicPipeline>(
-                knoxicDevice,
-                "shaders/vk_brightness_extract.vert.spv",
-                "shaders/vk_brightness_extract.frag.spv",
-                pipelineConfig
-            );
+            VkPipelineLayout layout = bloomDownsamplePipelineLayout;
+            bloomDownsamplePipeline = pipelineManager.request<KnoxicComputePipeline>([this, layout] {
+                return std::make_unique<KnoxicComputePipeline>(knoxicDevice, "shaders/vk_bloom_downsample.comp.spv", layout);
+            });
         }
 
-        // Blur pipeline
+        // Bloom upsample pipeline
         {
             VkPushConstantRange pushConstantRange{};
-            pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+            pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
             pushConstantRange.offset = 0;
-            pushConstantRange.size = sizeof(glm::vec2);
+            pushConstantRange.size = sizeof(BloomUpsamplePushConstants);
 
-            VkDescriptorSetLayout setLayout = blurSetLayout->getDescriptorSetLayout();
+            VkDescriptorSetLayout setLayout = bloomSetLayout->getDescriptorSetLayout();
             VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
             pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
             pipelineLayoutInfo.setLayoutCount = 1;
@@ -580,38 +809,18 @@ namespace knoxic {
             pipelineLayoutInfo.pushConstantRangeCount = 1;
             pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-            if (vkCreatePipelineLayout(knoxicDevice.device(), &pipelineLayoutInfo, nullptr, &blurPipelineLayout) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create blur pipeline layout!");
+            if (vkCreatePipelineLayout(knoxicDevice.device(), &pipelineLayoutInfo, nullptr, &bloomUpsamplePipelineLayout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create bloom upsample pipeline layout!");
             }
 
-            PipelineConfigInfo pipelineConfig{};
-            KnoxicPipeline::defaultPipelineConfigInfo(pipelineConfig);
-            pipelineConfig.renderPass = bloomRenderPass;
-            pipelineConfig.pipelineLayout = blurPipelineLayout;
-            pipelineConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
-            pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
-            pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_NONE;
-
-            blurPipeline = std::make_unique<KnoxicPipeline>(
-                knoxicDevice,
-                "shaders/vk_blur.vert.spv",
-                "shaders/vk_blur.frag.spv",
-                pipelineConfig
-            );
+            VkPipelineLayout layout = bloomUpsamplePipelineLayout;
+            bloomUpsamplePipeline = pipelineManager.request<KnoxicComputePipeline>([this, layout] {
+                return std::make_unique<KnoxicComputePipeline>(knoxicDevice, "shaders/vk_bloom_upsample.comp.spv", layout);
+            });
         }
 
         // Post process pipeline layout
         {
-            struct PostProcessPushConstants {
-                float bloomIntensity;
-                float exposure;
-                float gamma;
-                int bloomEnabled;
-                float contrast;
-                float saturation;
-                float vibrance;
-            };
-
             VkPushConstantRange pushConstantRange{};
             pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
             pushConstantRange.offset = 0;
@@ -629,8 +838,182 @@ namespace knoxic {
                 throw std::runtime_error("failed to create post process pipeline layout!");
             }
 
-            postProcessPipeline = nullptr; // Will be created on first use with correct render pass
+            VkPipelineLayout layout = postProcessPipelineLayout;
+            VkRenderPass renderPass = swapChainRenderPass;
+            postProcessPipeline = pipelineManager.request<KnoxicPipeline>([this, layout, renderPass] {
+                PipelineConfigInfo pipelineConfig{};
+                KnoxicPipeline::defaultPipelineConfigInfo(pipelineConfig);
+                pipelineConfig.renderPass = renderPass;
+                pipelineConfig.pipelineLayout = layout;
+                pipelineConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
+                pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+                pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_NONE; // Disable culling for fullscreen triangle
+
+                return std::make_unique<KnoxicPipeline>(
+                    knoxicDevice,
+                    "shaders/vk_post_process.vert.spv",
+                    "shaders/vk_post_process.frag.spv",
+                    pipelineConfig
+                );
+            });
+        }
+
+        // Composite subpass pipeline, same push constants with the scene as an input attachment
+        {
+            VkPushConstantRange pushConstantRange{};
+            pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+            pushConstantRange.offset = 0;
+            pushConstantRange.size = sizeof(PostProcessPushConstants);
+
+            VkDescriptorSetLayout setLayout = compositeInputSetLayout->getDescriptorSetLayout();
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount = 1;
+            pipelineLayoutInfo.pSetLayouts = &setLayout;
+            pipelineLayoutInfo.pushConstantRangeCount = 1;
+            pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+            if (vkCreatePipelineLayout(knoxicDevice.device(), &pipelineLayoutInfo, nullptr, &compositeSubpassPipelineLayout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create composite subpass pipeline layout!");
+            }
+
+            VkPipelineLayout layout = compositeSubpassPipelineLayout;
+            VkRenderPass renderPass = hdrCompositeRenderPass;
+            compositeSubpassPipeline = pipelineManager.request<KnoxicPipeline>([this, layout, renderPass] {
+                PipelineConfigInfo pipelineConfig{};
+                KnoxicPipeline::defaultPipelineConfigInfo(pipelineConfig);
+                pipelineConfig.renderPass = renderPass;
+                pipelineConfig.subpass = 1;
+                pipelineConfig.pipelineLayout = layout;
+                pipelineConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
+                pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+                pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_NONE;
+
+                return std::make_unique<KnoxicPipeline>(
+                    knoxicDevice,
+                    "shaders/vk_post_process.vert.spv",
+                    "shaders/vk_post_process_subpass.frag.spv",
+                    pipelineConfig
+                );
+            });
         }
+
+        // Grading LUT bake pipeline
+        {
+            VkPushConstantRange pushConstantRange{};
+            pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            pushConstantRange.offset = 0;
+            pushConstantRange.size = sizeof(GradingPushConstants);
+
+            VkDescriptorSetLayout setLayout = gradingSetLayout->getDescriptorSetLayout();
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount = 1;
+            pipelineLayoutInfo.pSetLayouts = &setLayout;
+            pipelineLayoutInfo.pushConstantRangeCount = 1;
+            pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+            if (vkCreatePipelineLayout(knoxicDevice.device(), &pipelineLayoutInfo, nullptr, &gradingPipelineLayout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create grading LUT pipeline layout!");
+            }
+
+            VkPipelineLayout layout = gradingPipelineLayout;
+            gradingPipeline = pipelineManager.request<KnoxicComputePipeline>([this, layout] {
+                return std::make_unique<KnoxicComputePipeline>(knoxicDevice, "shaders/vk_color_grading_lut.comp.spv", layout);
+            });
+        }
+    }
+
+    void PostProcessSystem::createGradingLUT() {
+        // RGBA16F like the bloom chain, the bake writes it as a storage image
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_3D;
+        imageInfo.extent = {GRADING_LUT_SIZE, GRADING_LUT_SIZE, GRADING_LUT_SIZE};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        knoxicDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, gradingLUT, gradingLUTAllocation);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = gradingLUT;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_3D;
+        viewInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+        if (vkCreateImageView(knoxicDevice.device(), &viewInfo, nullptr, &gradingLUTView) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create grading LUT image view!");
+        }
+
+        gradingDescriptorPool = KnoxicDescriptorPool::Builder(knoxicDevice)
+            .setMaxSets(1)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1)
+            .build();
+
+        VkDescriptorImageInfo lutInfo{};
+        lutInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        lutInfo.imageView = gradingLUTView;
+
+        KnoxicDescriptorWriter(*gradingSetLayout, *gradingDescriptorPool)
+            .writeImage(0, &lutInfo)
+            .build(gradingDescriptorSet);
+    }
+
+    void PostProcessSystem::updateGradingLUT(VkCommandBuffer commandBuffer, const PostProcessingComponent& settings) {
+        GradingPushConstants push{};
+        push.contrast = settings.contrast;
+        push.saturation = settings.saturation;
+        push.vibrance = settings.vibrance;
+        push.gamma = settings.gamma;
+
+        if (gradingBaked && push.contrast == bakedGrading.contrast && push.saturation == bakedGrading.saturation &&
+            push.vibrance == bakedGrading.vibrance && push.gamma == bakedGrading.gamma) {
+            return;
+        }
+
+        // Earlier frames' composites may still be sampling it, the old contents are rewritten entirely
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = gradingLUT;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        gradingPipeline.get().bind(commandBuffer);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+            gradingPipelineLayout, 0, 1, &gradingDescriptorSet, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, gradingPipelineLayout,
+            VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GradingPushConstants), &push);
+
+        uint32_t groups = (GRADING_LUT_SIZE + 3) / 4;
+        vkCmdDispatch(commandBuffer, groups, groups, groups);
+
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        bakedGrading = push;
+        gradingBaked = true;
     }
 
     void PostProcessSystem::renderPostProcess(
@@ -638,145 +1021,155 @@ namespace knoxic {
         int frameIndex,
         const PostProcessingComponent& settings
     ) {
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = bloomRenderPass;
-        renderPassInfo.framebuffer = bloomFramebuffers[0][frameIndex];
-        renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = {extent.width / 2, extent.height / 2};
-
-        VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
-
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = static_cast<float>(extent.width / 2);
-        viewport.height = static_cast<float>(extent.height / 2);
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        VkRect2D scissor{{0, 0}, {extent.width / 2, extent.height / 2}};
-
-        // Step 1: Extract bright pixels (or clear to black if bloom disabled)
-        if (settings.bloomEnabled) {
-            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-            brightnessExtractPipeline->bind(commandBuffer);
-            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
-                brightnessExtractPipelineLayout, 0, 1, &brightnessExtractDescriptorSets[frameIndex], 0, nullptr);
-            
-            float threshold = settings.bloomThreshold;
-            vkCmdPushConstants(commandBuffer, brightnessExtractPipelineLayout, 
-                VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(float), &threshold);
-
-            vkCmdDraw(commandBuffer, 3, 1, 0, 0); // Full-screen triangle
-            vkCmdEndRenderPass(commandBuffer);
-
-            // Step 2: Blur passes
-            for (int i = 0; i < settings.bloomIterations; i++) {
-                // Horizontal blur
-                {
-                    renderPassInfo.framebuffer = bloomFramebuffers[1][frameIndex];
-                    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-                    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-                    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-                    blurPipeline->bind(commandBuffer);
-                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                        blurPipelineLayout, 0, 1, &blurDescriptorSets[0][frameIndex], 0, nullptr);
-
-                    glm::vec2 direction(1.0f, 0.0f);
-                    vkCmdPushConstants(commandBuffer, blurPipelineLayout,
-                        VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(glm::vec2), &direction);
-
-                    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
-                    vkCmdEndRenderPass(commandBuffer);
-                }
-
-                // Vertical blur
-                {
-                    renderPassInfo.framebuffer = bloomFramebuffers[0][frameIndex];
-                    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-                    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-                    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-                    blurPipeline->bind(commandBuffer);
-                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                        blurPipelineLayout, 0, 1, &blurDescriptorSets[1][frameIndex], 0, nullptr);
+        // The render graph has the HDR color sampled and the chain in GENERAL, and hands the chain to the composite afterwards
+        if (!settings.bloomEnabled) {
+            return;
+        }
 
-                    glm::vec2 direction(0.0f, 1.0f);
-                    vkCmdPushConstants(commandBuffer, blurPipelineLayout,
-                        VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(glm::vec2), &direction);
+        // Levels past the requested count are left untouched, so the radius follows the chain depth
+        uint32_t levelCount = static_cast<uint32_t>(std::clamp(settings.bloomIterations, 1, static_cast<int>(bloomMipLevels)));
+
+        // Makes one level visible to the next dispatch, the upsample reads and rewrites it
+        VkImageMemoryBarrier levelBarrier{};
+        levelBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        levelBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        levelBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        levelBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        levelBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        levelBarrier.image = renderGraph.getImage(bloomChain, frameIndex);
+        levelBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+        // Downsample, the brightness extract is fused into level 0. Every level is filled over the output's part of
+        // the chain only, reading the rendered rect of the HDR color or the output rect of the resolved color above it
+        bloomDownsamplePipeline.get().bind(commandBuffer);
+        VkExtent2D sceneExtent = hasTemporalResolve() ? extent : renderExtent;
+        glm::ivec2 srcSize(sceneExtent.width, sceneExtent.height);
+        for (uint32_t level = 0; level < levelCount; level++) {
+            glm::ivec2 dstSize = getBloomLevelExtent(level);
+
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                bloomDownsamplePipelineLayout, 0, 1, &bloomDownsampleDescriptorSets[frameIndex][level], 0, nullptr);
+
+            BloomDownsamplePushConstants push{};
+            push.srcSize = srcSize;
+            push.dstSize = dstSize;
+            push.threshold = settings.bloomThreshold;
+            push.prefilter = level == 0 ? 1 : 0;
+            push.uvScale = level == 0 ? getRenderUVScale() : glm::vec2(srcSize) / glm::vec2(getBloomLevelSize(level - 1));
+            vkCmdPushConstants(commandBuffer, bloomDownsamplePipelineLayout,
+                VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(BloomDownsamplePushConstants), &push);
+
+            vkCmdDispatch(commandBuffer, (dstSize.x + 7) / 8, (dstSize.y + 7) / 8, 1);
+
+            levelBarrier.subresourceRange.baseMipLevel = level;
+            levelBarrier.subresourceRange.levelCount = 1;
+            vkCmdPipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
+
+            srcSize = dstSize;
+        }
 
-                    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
-                    vkCmdEndRenderPass(commandBuffer);
-                }
-            }
-        } else {
-            // Clear bloom buffer to black and transition to correct layout
-            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-            vkCmdEndRenderPass(commandBuffer);
+        // Upsample back to level 0, each level adds the tent filtered level below it
+        bloomUpsamplePipeline.get().bind(commandBuffer);
+        for (uint32_t level = levelCount - 1; level-- > 0;) {
+            glm::ivec2 dstSize = getBloomLevelExtent(level);
+
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                bloomUpsamplePipelineLayout, 0, 1, &bloomUpsampleDescriptorSets[frameIndex][level], 0, nullptr);
+
+            BloomUpsamplePushConstants push{};
+            push.srcSize = getBloomLevelExtent(level + 1);
+            push.dstSize = dstSize;
+            push.radius = 1.0f;
+            push.scale = level == 0 ? 1.0f / static_cast<float>(levelCount) : 1.0f;
+            vkCmdPushConstants(commandBuffer, bloomUpsamplePipelineLayout,
+                VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(BloomUpsamplePushConstants), &push);
+
+            vkCmdDispatch(commandBuffer, (dstSize.x + 7) / 8, (dstSize.y + 7) / 8, 1);
+
+            levelBarrier.subresourceRange.baseMipLevel = level;
+            levelBarrier.subresourceRange.levelCount = 1;
+            vkCmdPipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
         }
-        
     }
 
     void PostProcessSystem::renderFinalComposite(
         VkCommandBuffer commandBuffer,
-        VkRenderPass swapchainRenderPass,
         int frameIndex,
         const PostProcessingComponent& settings
     ) {
-        // Create post-process pipeline if needed
-        if (!postProcessPipeline) {
-            PipelineConfigInfo pipelineConfig{};
-            KnoxicPipeline::defaultPipelineConfigInfo(pipelineConfig);
-            pipelineConfig.renderPass = swapchainRenderPass;
-            pipelineConfig.pipelineLayout = postProcessPipelineLayout;
-            pipelineConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
-            pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
-            pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_NONE; // Disable culling for fullscreen triangle
-
-            postProcessPipeline = std::make_unique<KnoxicPipeline>(
-                knoxicDevice,
-                "shaders/vk_post_process.vert.spv",
-                "shaders/vk_post_process.frag.spv",
-                pipelineConfig
-            );
-        }
-
         // Bind pipeline and render full-screen quad
-        postProcessPipeline->bind(commandBuffer);
+        postProcessPipeline.get().bind(commandBuffer);
         vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
             postProcessPipelineLayout, 0, 1, &postProcessDescriptorSets[frameIndex], 0, nullptr);
 
-        struct PostProcessPushConstants {
-            float bloomIntensity;
-            float exposure;
-            float gamma;
-            int bloomEnabled;
-            float contrast;
-            float saturation;
-            float vibrance;
-        };
+        PostProcessPushConstants pushConstants = compositePushConstants(settings);
+        pushConstants.uvScale = getRenderUVScale();
+        pushConstants.bloomUVScale = glm::vec2(getBloomLevelExtent(0)) / glm::vec2(getBloomLevelSize(0));
+        vkCmdPushConstants(commandBuffer, postProcessPipelineLayout,
+            VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PostProcessPushConstants), &pushConstants);
+
+        vkCmdDraw(commandBuffer, 3, 1, 0, 0); // Full-screen triangle
+    }
+
+    void PostProcessSystem::renderMergedComposite(
+        VkCommandBuffer commandBuffer,
+        int frameIndex,
+        const PostProcessingComponent& settings
+    ) {
+        compositeSubpassPipeline.get().bind(commandBuffer);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+            compositeSubpassPipelineLayout, 0, 1, &compositeInputDescriptorSets[frameIndex], 0, nullptr);
+
+        PostProcessPushConstants pushConstants = compositePushConstants(settings);
+        pushConstants.bloomEnabled = 0;
+        vkCmdPushConstants(commandBuffer, compositeSubpassPipelineLayout,
+            VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PostProcessPushConstants), &pushConstants);
+
+        vkCmdDraw(commandBuffer, 3, 1, 0, 0); // Full-screen triangle
+    }
 
+    PostProcessSystem::PostProcessPushConstants PostProcessSystem::compositePushConstants(const PostProcessingComponent& settings) {
         PostProcessPushConstants pushConstants{};
         pushConstants.bloomIntensity = settings.bloomIntensity;
         pushConstants.exposure = settings.exposure;
-        pushConstants.gamma = settings.gamma;
         pushConstants.bloomEnabled = settings.bloomEnabled ? 1 : 0;
-        pushConstants.contrast = settings.contrast;
-        pushConstants.saturation = settings.saturation;
-        pushConstants.vibrance = settings.vibrance;
+        pushConstants.uvScale = glm::vec2(1.0f);
+        pushConstants.bloomUVScale = glm::vec2(1.0f);
+        return pushConstants;
+    }
 
-        vkCmdPushConstants(commandBuffer, postProcessPipelineLayout,
-            VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PostProcessPushConstants), &pushConstants);
+    glm::vec2 PostProcessSystem::getRenderUVScale() const {
+        // The resolve fills the output rect of its target sized history, otherwise only the render rect is drawn
+        VkExtent2D sceneExtent = hasTemporalResolve() ? extent : renderExtent;
+        return glm::vec2(sceneExtent.width, sceneExtent.height) / glm::vec2(targetExtent.width, targetExtent.height);
+    }
 
-        vkCmdDraw(commandBuffer, 3, 1, 0, 0); // Full-screen triangle
+    glm::ivec2 PostProcessSystem::getBloomLevelExtent(uint32_t level) const {
+        // Part of the level the output covers
+        return glm::ivec2(
+            std::max(std::max(extent.width / 2, 1u) >> level, 1u),
+            std::max(std::max(extent.height / 2, 1u) >> level, 1u));
+    }
+
+    glm::ivec2 PostProcessSystem::getBloomLevelSize(uint32_t level) const {
+        return glm::ivec2(
+            std::max(std::max(targetExtent.width / 2, 1u) >> level, 1u),
+            std::max(std::max(targetExtent.height / 2, 1u) >> level, 1u));
+    }
+
+    VkImageView PostProcessSystem::getSceneColorView(int frameIndex) const {
+        return hasTemporalResolve() ? resolvedColorViews[frameIndex] : renderGraph.getImageView(hdrColor, frameIndex);
+    }
+
+    VkImageLayout PostProcessSystem::getSceneColorLayout() const {
+        // The resolve writes its output as a storage image and leaves it in GENERAL
+        return hasTemporalResolve() ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     }
 }
 
@@ -3,7 +3,10 @@
 #include "../../core/vulkan/knoxic_vk_device.hpp"
 #include "../../core/vulkan/knoxic_vk_descriptors.hpp"
 #include "../../graphics/vulkan/knoxic_vk_pipeline.hpp"
+#include "../../graphics/vulkan/knoxic_vk_pipeline_manager.hpp"
+#include "../../graphics/vulkan/knoxic_vk_render_graph.hpp"
 #include "../../core/ecs/components.hpp"
+#include "../../graphics/knoxic_frame_info.hpp"
 
 #include <vulkan/vulkan.h>
 #include <memory>
@@ -13,7 +16,36 @@ namespace knoxic {
 
     class PostProcessSystem {
     public:
-        PostProcessSystem(KnoxicDevice& device, VkExtent2D extent);
+        // G-buffer targets, attachments 2, 3 and 4 of the G-buffer framebuffer
+        static constexpr int GBUFFER_ALBEDO = 0;
+        static constexpr int GBUFFER_NORMAL = 1;
+        static constexpr int GBUFFER_MATERIAL = 2; // roughness, metallic, ao, lit
+        static constexpr int GBUFFER_COUNT = 3;
+
+        // Deepest bloom chain, bloomIterations picks how many levels are used
+        static constexpr uint32_t BLOOM_MAX_MIPS = 8;
+
+        // Targets are allocated in steps of this size and only shrink once the output covers less than half
+        // of them, so resizing the window mostly just moves the output rect inside the same images
+        static constexpr uint32_t TARGET_BUCKET_SIZE = 256;
+
+        // Edge length of the 3D LUT the grading after the tonemap is baked into
+        static constexpr uint32_t GRADING_LUT_SIZE = 32;
+
+        // Screen space motion, current minus previous uv. Color attachment 1 of every scene pass.
+        // Cleared to NO_VELOCITY where no geometry is drawn, the resolve reprojects those pixels with the camera
+        static constexpr VkFormat VELOCITY_FORMAT = VK_FORMAT_R16G16_SFLOAT;
+        static constexpr float NO_VELOCITY = 32768.0f;
+
+        // Alpha of the HDR color is never read, so the packed format is the default. Falls back to RGBA16F
+        // where the preferred format can't be rendered to, blended and sampled
+        static constexpr VkFormat DEFAULT_HDR_FORMAT = VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+
+        // Pipelines are requested from the manager right away and compile while the scene loads. The separate composite
+        // is built against the swap chain render pass, any later one with the same format is compatible
+        PostProcessSystem(KnoxicDevice& device, KnoxicRenderGraph& renderGraph, KnoxicPipelineManager& pipelineManager,
+            VkExtent2D extent, VkFormat swapChainFormat, VkRenderPass swapChainRenderPass,
+            RenderPath renderPath = RenderPath::Forward, VkFormat preferredHDRFormat = DEFAULT_HDR_FORMAT);
         ~PostProcessSystem();
 
         PostProcessSystem(const PostProcessSystem&) = delete;
@@ -22,7 +54,68 @@ namespace knoxic {
         // Get the HDR render pass for rendering the scene
         VkRenderPass getHDRRenderPass() const { return hdrRenderPass; }
         VkFramebuffer getHDRFramebuffer(int frameIndex) const { return hdrFramebuffers[frameIndex]; }
+
+        // Compatible HDR pass that loads the existing color and depth (second occlusion phase)
+        VkRenderPass getHDRResumeRenderPass() const { return hdrResumeRenderPass; }
+
+        // Resume pass with the composite as a second subpass, writing the swap chain image. Used while bloom is off,
+        // the HDR color is then read from tile memory and never stored. Takes effect on the next declareResources()
+        VkRenderPass getHDRCompositeRenderPass() const { return hdrCompositeRenderPass; }
+        VkFramebuffer getCompositeFramebuffer(int frameIndex, uint32_t imageIndex) const {
+            return compositeFramebuffers[frameIndex * swapChainImageCount + imageIndex];
+        }
+        void setMergedComposite(bool merged) { mergedComposite = merged; }
+        bool isMergedComposite() const { return mergedComposite; }
+
+        // Full resolution output of the temporal resolve per frame in flight, read by bloom and the composite
+        // instead of the HDR color. Empty to read the HDR color. Takes effect on the next createTargets()
+        void setResolvedColorViews(const std::vector<VkImageView>& views) { resolvedColorViews = views; }
+        bool hasTemporalResolve() const { return !resolvedColorViews.empty(); }
+
+        // HDR depth, sampled by the Hi-Z pyramid build
+        VkImage getHDRDepthImage(int frameIndex) const { return renderGraph.getImage(hdrDepth, frameIndex); }
+        VkImageView getHDRDepthImageView(int frameIndex) const { return renderGraph.getImageView(hdrDepth, frameIndex); }
+        VkFormat getHDRDepthFormat() const { return hdrDepthFormat; }
+        VkFormat getHDRColorFormat() const { return hdrColorFormat; }
+
+        // Size of the swap chain the composite writes, the targets may be larger. See getTargetExtent()
+        VkExtent2D getExtent() const { return extent; }
+        VkExtent2D getTargetExtent() const { return targetExtent; }
+
+        // HDR color and velocity, sampled by the temporal resolve
+        VkImageView getHDRColorImageView(int frameIndex) const { return renderGraph.getImageView(hdrColor, frameIndex); }
+        VkImageView getVelocityImageView(int frameIndex) const { return renderGraph.getImageView(velocity, frameIndex); }
+
+        // Part of the targets the scene renders into, the top-left corner. Any size up to getExtent(),
+        // the composite upscales it. Not supported by the merged composite
+        VkExtent2D getRenderExtent() const { return renderExtent; }
+        void setRenderExtent(VkExtent2D newRenderExtent);
+        RenderPath getRenderPath() const { return renderPath; }
+
+        // Deferred path: subpass 0 fills the G-buffer, subpass 1 lights into the HDR target.
+        // The resume pass loads the first pass for the late occlusion phase and the lighting.
+        VkRenderPass getGBufferRenderPass() const { return gbufferRenderPass; }
+        VkRenderPass getGBufferResumeRenderPass() const { return gbufferResumeRenderPass; }
+        VkFramebuffer getGBufferFramebuffer(int frameIndex) const { return gbufferFramebuffers[frameIndex]; }
+        VkImageView getGBufferImageView(int target, int frameIndex) const { return renderGraph.getImageView(gbuffer[target], frameIndex); }
+
+        // Render graph images, declared by declareResources()
+        RenderGraphImage getHDRColorResource() const { return hdrColor; }
+        RenderGraphImage getHDRDepthResource() const { return hdrDepth; }
+        RenderGraphImage getVelocityResource() const { return velocity; }
+        RenderGraphImage getGBufferResource(int target) const { return gbuffer[target]; }
+        RenderGraphImage getBloomResource() const { return bloomChain; }
+
+        // Registers the HDR, G-buffer and bloom targets as transient images of the render graph
+        void declareResources();
+
+        // Framebuffers and descriptor sets over the images, once the render graph is compiled
+        void createTargets(const std::vector<VkImageView>& swapChainImageViews);
         
+        // Rebakes the grading LUT if contrast, vibrance, saturation or gamma changed since the last bake.
+        // Outside of a render pass, before either composite
+        void updateGradingLUT(VkCommandBuffer commandBuffer, const PostProcessingComponent& settings);
+
         // Apply post-processing effects
         void renderPostProcess(
             VkCommandBuffer commandBuffer,
@@ -33,68 +126,167 @@ namespace knoxic {
         // Render final composite to current render pass
         void renderFinalComposite(
             VkCommandBuffer commandBuffer,
-            VkRenderPass swapchainRenderPass,
             int frameIndex,
             const PostProcessingComponent& settings
         );
 
-        // Recreate resources when window is resized
-        void recreate(VkExtent2D newExtent);
+        // Composite subpass of the merged pass, after vkCmdNextSubpass
+        void renderMergedComposite(
+            VkCommandBuffer commandBuffer,
+            int frameIndex,
+            const PostProcessingComponent& settings
+        );
+
+        // Follows a new swap chain extent. Returns true when the targets no longer fit and have to be reallocated,
+        // then recreate() and rebuild the render graph. Otherwise call setSwapChainImageViews()
+        bool resize(VkExtent2D newExtent);
+
+        // Re-points the merged composite framebuffers at a new swap chain, the old ones are destroyed once the frames
+        // in flight are done with them. Call releaseRetired() once per frame after beginFrame
+        void setSwapChainImageViews(const std::vector<VkImageView>& swapChainImageViews);
+        void releaseRetired();
+
+        // Drops the size dependent targets, declare and compile the render graph again afterwards
+        void recreate();
 
     private:
-        void createHDRResources();
-        void createBloomResources();
+        void createSamplers();
+        void createGBufferRenderPasses();
         void createRenderPasses();
-        void createFramebuffers();
+        void createFramebuffers(const std::vector<VkImageView>& swapChainImageViews);
+        void createCompositeFramebuffers(const std::vector<VkImageView>& swapChainImageViews);
         void createDescriptorSetLayouts();
         void createDescriptorSets();
         void createPipelines();
-        
+        void createGradingLUT();
+
+        void destroyTargets();
         void cleanup();
 
         KnoxicDevice& knoxicDevice;
+        KnoxicRenderGraph& renderGraph;
+        KnoxicPipelineManager& pipelineManager;
         VkExtent2D extent;
+        VkExtent2D targetExtent;
+        VkExtent2D renderExtent;
+        RenderPath renderPath;
 
         // HDR scene render target
-        VkRenderPass hdrRenderPass;
-        std::vector<VkImage> hdrImages;
-        std::vector<VkDeviceMemory> hdrImageMemories;
-        std::vector<VkImageView> hdrImageViews;
+        VkRenderPass hdrRenderPass = VK_NULL_HANDLE;
+        VkRenderPass hdrResumeRenderPass = VK_NULL_HANDLE;
+        RenderGraphImage hdrColor = 0;
+        RenderGraphImage hdrDepth = 0;
+        RenderGraphImage velocity = 0;
         std::vector<VkFramebuffer> hdrFramebuffers;
-        std::vector<VkImage> hdrDepthImages;
-        std::vector<VkDeviceMemory> hdrDepthImageMemories;
-        std::vector<VkImageView> hdrDepthImageViews;
+        VkFormat hdrColorFormat;
+        VkFormat hdrDepthFormat;
+
+        // Merged composite, one framebuffer per frame in flight and swap chain image
+        bool mergedComposite = false;
+        VkRenderPass hdrCompositeRenderPass = VK_NULL_HANDLE;
+        std::vector<VkFramebuffer> compositeFramebuffers;
+        VkFormat swapChainFormat;
+        VkRenderPass swapChainRenderPass;
+        size_t swapChainImageCount = 0;
+
+        // Composite framebuffers over a replaced swap chain, see releaseRetired()
+        struct RetiredFramebuffer {
+            VkFramebuffer framebuffer;
+            int framesLeft;
+        };
+        std::vector<RetiredFramebuffer> retiredFramebuffers;
+
+        std::vector<VkImageView> resolvedColorViews;
+
+        // Deferred G-buffer, only declared for RenderPath::Deferred
+        VkRenderPass gbufferRenderPass = VK_NULL_HANDLE;
+        VkRenderPass gbufferResumeRenderPass = VK_NULL_HANDLE;
+        RenderGraphImage gbuffer[GBUFFER_COUNT] = {};
+        std::vector<VkFramebuffer> gbufferFramebuffers;
 
-        // Bloom ping-pong buffers
-        VkRenderPass bloomRenderPass;
-        std::vector<VkImage> bloomImages[2];
-        std::vector<VkDeviceMemory> bloomImageMemories[2];
-        std::vector<VkImageView> bloomImageViews[2];
-        std::vector<VkFramebuffer> bloomFramebuffers[2];
+        // Bloom mip chain at half resolution, built and recombined in compute
+        RenderGraphImage bloomChain = 0;
+        uint32_t bloomMipLevels = 0;
 
         // Descriptor pools and layouts
         std::unique_ptr<KnoxicDescriptorPool> descriptorPool;
-        std::unique_ptr<KnoxicDescriptorSetLayout> brightnessExtractSetLayout;
-        std::unique_ptr<KnoxicDescriptorSetLayout> blurSetLayout;
+        std::unique_ptr<KnoxicDescriptorSetLayout> bloomSetLayout;
         std::unique_ptr<KnoxicDescriptorSetLayout> postProcessSetLayout;
+        std::unique_ptr<KnoxicDescriptorSetLayout> compositeInputSetLayout;
 
         // Descriptor sets
-        std::vector<VkDescriptorSet> brightnessExtractDescriptorSets;
-        std::vector<VkDescriptorSet> blurDescriptorSets[2];
+        std::vector<std::vector<VkDescriptorSet>> bloomDownsampleDescriptorSets;
+        std::vector<std::vector<VkDescriptorSet>> bloomUpsampleDescriptorSets;
         std::vector<VkDescriptorSet> postProcessDescriptorSets;
+        std::vector<VkDescriptorSet> compositeInputDescriptorSets;
 
         // Pipelines
-        std::unique_ptr<KnoxicPipeline> brightnessExtractPipeline;
-        VkPipelineLayout brightnessExtractPipelineLayout;
-        
-        std::unique_ptr<KnoxicPipeline> blurPipeline;
-        VkPipelineLayout blurPipelineLayout;
+        struct BloomDownsamplePushConstants {
+            glm::ivec2 srcSize;
+            glm::ivec2 dstSize;
+            float threshold;
+            int prefilter;
+            glm::vec2 uvScale;
+        };
+
+        struct BloomUpsamplePushConstants {
+            glm::ivec2 srcSize;
+            glm::ivec2 dstSize;
+            float radius;
+            float scale;
+        };
+
+        // Shared by both composite pipelines
+        struct PostProcessPushConstants {
+            float bloomIntensity;
+            float exposure;
+            int bloomEnabled;
+            alignas(8) glm::vec2 uvScale; // Not read by the merged composite
+            glm::vec2 bloomUVScale; // Used part of the bloom chain
+        };
+
+        static PostProcessPushConstants compositePushConstants(const PostProcessingComponent& settings);
+        glm::vec2 getRenderUVScale() const;
+        glm::ivec2 getBloomLevelExtent(uint32_t level) const;
+        glm::ivec2 getBloomLevelSize(uint32_t level) const;
+
+        // What bloom and the composite read, the HDR color or the resolved color
+        VkImageView getSceneColorView(int frameIndex) const;
+        VkImageLayout getSceneColorLayout() const;
+
+        KnoxicPipelineRequest<KnoxicComputePipeline> bloomDownsamplePipeline;
+        VkPipelineLayout bloomDownsamplePipelineLayout = VK_NULL_HANDLE;
+
+        KnoxicPipelineRequest<KnoxicComputePipeline> bloomUpsamplePipeline;
+        VkPipelineLayout bloomUpsamplePipelineLayout = VK_NULL_HANDLE;
         
-        std::unique_ptr<KnoxicPipeline> postProcessPipeline;
-        VkPipelineLayout postProcessPipelineLayout;
+        KnoxicPipelineRequest<KnoxicPipeline> postProcessPipeline;
+        VkPipelineLayout postProcessPipelineLayout = VK_NULL_HANDLE;
+
+        KnoxicPipelineRequest<KnoxicPipeline> compositeSubpassPipeline;
+        VkPipelineLayout compositeSubpassPipelineLayout = VK_NULL_HANDLE;
+
+        // Color grading LUT, sampled by both composites. Lives as long as the system, not the targets
+        struct GradingPushConstants {
+            float contrast;
+            float saturation;
+            float vibrance;
+            float gamma;
+        };
+
+        VkImage gradingLUT = VK_NULL_HANDLE;
+        KnoxicAllocation gradingLUTAllocation{};
+        VkImageView gradingLUTView = VK_NULL_HANDLE;
+        std::unique_ptr<KnoxicDescriptorPool> gradingDescriptorPool;
+        std::unique_ptr<KnoxicDescriptorSetLayout> gradingSetLayout;
+        VkDescriptorSet gradingDescriptorSet = VK_NULL_HANDLE;
+        KnoxicPipelineRequest<KnoxicComputePipeline> gradingPipeline;
+        VkPipelineLayout gradingPipelineLayout = VK_NULL_HANDLE;
+        GradingPushConstants bakedGrading{};
+        bool gradingBaked = false;
 
         // Samplers
-        VkSampler hdrSampler;
-        VkSampler bloomSampler;
+        VkSampler hdrSampler = VK_NULL_HANDLE;
+        VkSampler bloomSampler = VK_NULL_HANDLE;
     };
 }
\ No newline at end of file
@@ -3,12 +3,17 @@
 #include "../../graphics/knoxic_frame_info.hpp"
 #include "../../core/ecs/components.hpp"
 #include "../../core/ecs/coordinator_instance.hpp"
+#include "knoxic_vk_occlusion_culling_system.hpp"
+#include "../knoxic_software_occlusion_system.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <memory>
 #include <stdexcept>
 
@@ -27,20 +32,42 @@ namespace knoxic {
 
         alignas(16) glm::vec3 emissionColor{0.0f, 0.0f, 0.0f}; 
         float emissionStrength{0.0f};
+
+        uint32_t entityIndex{0}; // Previous model matrix in the global set
+    };
+
+    // Bindless draws only carry the transform, everything else comes from the material table
+    struct BindlessPushConstantData {
+        alignas(16) glm::mat4 modelMatrix{1.0f};
+        alignas(16) glm::mat4 normalMatrix{1.0f};
+
+        alignas(16) glm::vec3 color{1.0f, 1.0f, 1.0f};
+        uint32_t materialIndex{MaterialSystem::DEFAULT_MATERIAL_INDEX};
+
+        uint32_t entityIndex{0};
     };
 
     RenderSystem::RenderSystem(
         KnoxicDevice &device,
+        KnoxicPipelineManager &pipelineManager,
         VkRenderPass renderPass,
         VkDescriptorSetLayout globalSetLayout,
         VkDescriptorSetLayout materialSetLayout,
-        std::shared_ptr<RenderableSystem> ecsRenderableSystem
-    ) : knoxicDevice{device}, renderableSystem{std::move(ecsRenderableSystem)} {
+        const MaterialSystem &materialSystem,
+        std::shared_ptr<RenderableSystem> ecsRenderableSystem,
+        RenderPath renderPath
+    ) : knoxicDevice{device}, pipelineManager{pipelineManager}, materialSystem{materialSystem}, renderPass{renderPass}, renderPath{renderPath},
+        renderableSystem{std::move(ecsRenderableSystem)} {
         createPipelineLayout(globalSetLayout, materialSetLayout);
-        createPipeline(renderPass);
+        prewarmPipelines(false);
     }
 
     RenderSystem::~RenderSystem() {
+        // Compiles still running read the layout
+        for (auto &entry : pipelines) {
+            entry.second.wait();
+        }
+        pipelines.clear();
         vkDestroyPipelineLayout(knoxicDevice.device(), pipelineLayout, nullptr);
     }
 
@@ -48,7 +75,12 @@ namespace knoxic {
         VkPushConstantRange pushConstantRange{};
         pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
         pushConstantRange.offset = 0;
-        pushConstantRange.size = sizeof(PushConstantData);
+        pushConstantRange.size = materialSystem.isBindless() ? sizeof(BindlessPushConstantData) : sizeof(PushConstantData);
+
+        // Set 1 is either the shared bindless table or one set per material
+        if (materialSystem.isBindless()) {
+            materialSetLayout = materialSystem.getBindlessSetLayout();
+        }
 
         std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout, materialSetLayout};
 
@@ -64,93 +96,278 @@ namespace knoxic {
         }
     }
 
-    void RenderSystem::createPipeline(VkRenderPass renderPass) {
-        assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+    void RenderSystem::setCompositeRenderPass(VkRenderPass renderPass) {
+        compositeRenderPass = renderPass;
+        prewarmPipelines(true);
+    }
 
-        PipelineConfigInfo pipelineConfig{};
-        KnoxicPipeline::defaultPipelineConfigInfo(pipelineConfig);
-        pipelineConfig.renderPass = renderPass;
-        pipelineConfig.pipelineLayout = pipelineLayout;
-        knoxicPipeline = std::make_unique<KnoxicPipeline>(
-            knoxicDevice,
-            "shaders/vk_lighting.vert.spv",
-            "shaders/vk_lighting.frag.spv",
-            pipelineConfig
-        );
+    void RenderSystem::prewarmPipelines(bool compositePass) {
+        // Plain colored objects, always needed and the fallback of every other permutation
+        uint32_t passKey = compositePass ? COMPOSITE_PASS_KEY : 0;
+        requestPipeline(passKey);
+
+        for (auto entity : renderableSystem->mEntities) {
+            if (gCoordinator.HasComponent<MaterialComponent>(entity)) {
+                auto &matComp = gCoordinator.GetComponent<MaterialComponent>(entity);
+                if (matComp.material) {
+                    requestPipeline(passKey | matComp.material->getFeatureMask());
+                }
+            }
+        }
     }
 
-    void RenderSystem::renderGameObjects(FrameInfo &frameInfo) {
-        knoxicPipeline->bind(frameInfo.commandBuffer);
+    KnoxicPipeline &RenderSystem::getPipeline(uint32_t permutation, bool compositePass) {
+        uint32_t key = compositePass ? permutation | COMPOSITE_PASS_KEY : permutation;
+        requestPipeline(key);
+        if (KnoxicPipeline *pipeline = pipelines[key].tryGet()) {
+            return *pipeline;
+        }
 
+        // Still compiling, the object is drawn without its maps for now. Only the plain pipeline is waited for
+        uint32_t fallbackKey = key & COMPOSITE_PASS_KEY;
+        requestPipeline(fallbackKey);
+        return pipelines[fallbackKey].get();
+    }
+
+    void RenderSystem::requestPipeline(uint32_t key) {
+        if (pipelines.count(key)) {
+            return;
+        }
+
+        bool compositePass = (key & COMPOSITE_PASS_KEY) != 0;
+        uint32_t permutation = key & ~COMPOSITE_PASS_KEY;
+
+        assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+        assert((!compositePass || compositeRenderPass != VK_NULL_HANDLE) && "No composite render pass was set");
+
+        // Everything the build reads is copied, it runs on a worker thread
+        VkRenderPass targetRenderPass = compositePass ? compositeRenderPass : renderPass;
+        VkPipelineLayout layout = pipelineLayout;
+        bool bindless = materialSystem.isBindless();
+        bool deferred = renderPath == RenderPath::Deferred;
+        KnoxicDevice &device = knoxicDevice;
+
+        pipelines[key] = pipelineManager.request<KnoxicPipeline>([&device, permutation, targetRenderPass, layout, bindless, deferred] {
+            // One VkBool32 per feature bit, constant_id matches the bit index
+            VkBool32 featureValues[MATERIAL_FEATURE_COUNT];
+            VkSpecializationMapEntry mapEntries[MATERIAL_FEATURE_COUNT];
+            for (uint32_t i = 0; i < MATERIAL_FEATURE_COUNT; i++) {
+                featureValues[i] = (permutation & (1u << i)) ? VK_TRUE : VK_FALSE;
+                mapEntries[i].constantID = i;
+                mapEntries[i].offset = i * sizeof(VkBool32);
+                mapEntries[i].size = sizeof(VkBool32);
+            }
+
+            VkSpecializationInfo specializationInfo{};
+            specializationInfo.mapEntryCount = MATERIAL_FEATURE_COUNT;
+            specializationInfo.pMapEntries = mapEntries;
+            specializationInfo.dataSize = sizeof(featureValues);
+            specializationInfo.pData = featureValues;
+
+            PipelineConfigInfo pipelineConfig{};
+            KnoxicPipeline::defaultPipelineConfigInfo(pipelineConfig);
+            pipelineConfig.renderPass = targetRenderPass;
+            pipelineConfig.pipelineLayout = layout;
+            pipelineConfig.fragmentSpecializationInfo = &specializationInfo;
+
+            // Forward writes HDR color and velocity, the G-buffer subpass HDR emission, the three G-buffer targets and velocity
+            std::array<VkPipelineColorBlendAttachmentState, 5> sceneBlendAttachments{};
+            sceneBlendAttachments.fill(pipelineConfig.colorBlendAttachment);
+            pipelineConfig.colorBlendInfo.attachmentCount = deferred ? static_cast<uint32_t>(sceneBlendAttachments.size()) : 2;
+            pipelineConfig.colorBlendInfo.pAttachments = sceneBlendAttachments.data();
+
+            if (bindless) {
+                return std::make_unique<KnoxicPipeline>(
+                    device,
+                    "shaders/vk_lighting_bindless.vert.spv",
+                    deferred ? "shaders/vk_gbuffer_bindless.frag.spv" : "shaders/vk_lighting_bindless.frag.spv",
+                    pipelineConfig
+                );
+            }
+            return std::make_unique<KnoxicPipeline>(
+                device,
+                "shaders/vk_lighting.vert.spv",
+                deferred ? "shaders/vk_gbuffer.frag.spv" : "shaders/vk_lighting.frag.spv",
+                pipelineConfig
+            );
+        });
+    }
+
+    void RenderSystem::bindGlobals(FrameInfo &frameInfo) {
         vkCmdBindDescriptorSets(
             frameInfo.commandBuffer,
             VK_PIPELINE_BIND_POINT_GRAPHICS,
             pipelineLayout,
             0, 1,
             &frameInfo.globalDescriptorSet,
-            0, nullptr
+            static_cast<uint32_t>(frameInfo.globalDynamicOffsets.size()),
+            frameInfo.globalDynamicOffsets.data()
         );
 
-        // Iterate over ECS renderable entities
-        for (auto entity : renderableSystem->mEntities) {
-            // Required components
-            auto &transform = gCoordinator.GetComponent<TransformComponent>(entity);
-            auto &modelComp = gCoordinator.GetComponent<ModelComponent>(entity);
+        // One material bind for the whole pass
+        if (materialSystem.isBindless()) {
+            VkDescriptorSet bindlessDescriptorSet = materialSystem.getBindlessDescriptorSet(frameInfo.frameIndex);
+            vkCmdBindDescriptorSets(
+                frameInfo.commandBuffer,
+                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                pipelineLayout,
+                1, 1,
+                &bindlessDescriptorSet,
+                0, nullptr
+            );
+        }
+    }
 
-            if (!modelComp.model) continue;
+    KnoxicModel *RenderSystem::bindEntity(FrameInfo &frameInfo, Entity entity) {
+        // Required components
+        auto &transform = gCoordinator.GetComponent<TransformComponent>(entity);
+        auto &modelComp = gCoordinator.GetComponent<ModelComponent>(entity);
 
-            PushConstantData push{};
+        if (!modelComp.model) return nullptr;
+
+        if (materialSystem.isBindless()) {
+            BindlessPushConstantData push{};
             push.modelMatrix = transform.mat4();
             push.normalMatrix = transform.normalMatrix();
+            push.entityIndex = entity;
 
-            // Optional material
             if (gCoordinator.HasComponent<MaterialComponent>(entity)) {
                 auto &matComp = gCoordinator.GetComponent<MaterialComponent>(entity);
-                if (matComp.material) {
-                    const auto& matProps = matComp.material->getProperties();
-                    push.albedo = matProps.albedo;
-                    push.metallic = matProps.metallic;
-                    push.roughness = matProps.roughness;
-                    push.ao = matProps.ao;
-                    push.textureOffset = matProps.textureOffset;
-                    push.textureScale = matProps.textureScale;
-
-                    push.emissionColor = matProps.emissionColor;
-                    push.emissionStrength = matProps.emissionStrength;
-
-                    // Bind material descriptor set
-                    VkDescriptorSet materialDescriptorSet = matComp.material->getDescriptorSet();
-                    vkCmdBindDescriptorSets(
-                        frameInfo.commandBuffer,
-                        VK_PIPELINE_BIND_POINT_GRAPHICS,
-                        pipelineLayout,
-                        1, 1,
-                        &materialDescriptorSet,
-                        0, nullptr
-                    );
-                }
-            } else {
-                // Optional color fallback
-                if (gCoordinator.HasComponent<ColorComponent>(entity)) {
-                    push.albedo = gCoordinator.GetComponent<ColorComponent>(entity).color;
+                if (matComp.material && matComp.material->getBindlessIndex() != KnoxicMaterial::INVALID_BINDLESS_INDEX) {
+                    push.materialIndex = matComp.material->getBindlessIndex();
                 }
-
-                // Default emission for non-material objects
-                push.emissionColor = glm::vec3(0.0f);
-                push.emissionStrength = 0.0f;
+            } else if (gCoordinator.HasComponent<ColorComponent>(entity)) {
+                push.color = gCoordinator.GetComponent<ColorComponent>(entity).color;
             }
 
             vkCmdPushConstants(
                 frameInfo.commandBuffer,
-                pipelineLayout, 
-                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 
-                0, 
-                sizeof(PushConstantData), 
+                pipelineLayout,
+                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                0,
+                sizeof(BindlessPushConstantData),
                 &push
             );
 
             modelComp.model->bind(frameInfo.commandBuffer);
-            modelComp.model->draw(frameInfo.commandBuffer);
+            return modelComp.model.get();
+        }
+
+        PushConstantData push{};
+        push.modelMatrix = transform.mat4();
+        push.normalMatrix = transform.normalMatrix();
+        push.entityIndex = entity;
+
+        // Optional material
+        if (gCoordinator.HasComponent<MaterialComponent>(entity)) {
+            auto &matComp = gCoordinator.GetComponent<MaterialComponent>(entity);
+            if (matComp.material) {
+                const auto& matProps = matComp.material->getProperties();
+                push.albedo = matProps.albedo;
+                push.metallic = matProps.metallic;
+                push.roughness = matProps.roughness;
+                push.ao = matProps.ao;
+                push.textureOffset = matProps.textureOffset;
+                push.textureScale = matProps.textureScale;
+
+                push.emissionColor = matProps.emissionColor;
+                push.emissionStrength = matProps.emissionStrength;
+
+                // Bind material descriptor set
+                VkDescriptorSet materialDescriptorSet = matComp.material->getDescriptorSet();
+                vkCmdBindDescriptorSets(
+                    frameInfo.commandBuffer,
+                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    pipelineLayout,
+                    1, 1,
+                    &materialDescriptorSet,
+                    0, nullptr
+                );
+            }
+        } else {
+            // Optional color fallback
+            if (gCoordinator.HasComponent<ColorComponent>(entity)) {
+                push.albedo = gCoordinator.GetComponent<ColorComponent>(entity).color;
+            }
+
+            // Default emission for non-material objects
+            push.emissionColor = glm::vec3(0.0f);
+            push.emissionStrength = 0.0f;
+        }
+
+        vkCmdPushConstants(
+            frameInfo.commandBuffer,
+            pipelineLayout, 
+            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 
+            0, 
+            sizeof(PushConstantData), 
+            &push
+        );
+
+        modelComp.model->bind(frameInfo.commandBuffer);
+        return modelComp.model.get();
+    }
+
+    void RenderSystem::buildDrawList() {
+        drawList.clear();
+
+        for (auto entity : renderableSystem->mEntities) {
+            if (softwareOcclusion && !softwareOcclusion->isVisible(entity)) continue;
+
+            uint32_t permutation = 0;
+            if (gCoordinator.HasComponent<MaterialComponent>(entity)) {
+                auto &matComp = gCoordinator.GetComponent<MaterialComponent>(entity);
+                if (matComp.material) {
+                    permutation = matComp.material->getFeatureMask();
+                }
+            }
+
+            drawList.push_back({permutation, entity});
+        }
+
+        std::sort(drawList.begin(), drawList.end(), [](const DrawItem &a, const DrawItem &b) {
+            return a.permutation < b.permutation;
+        });
+    }
+
+    void RenderSystem::renderGameObjects(FrameInfo &frameInfo) {
+        bindGlobals(frameInfo);
+        buildDrawList();
+
+        KnoxicPipeline *boundPipeline = nullptr;
+        for (const auto &draw : drawList) {
+            KnoxicPipeline &pipeline = getPipeline(draw.permutation);
+            if (&pipeline != boundPipeline) {
+                pipeline.bind(frameInfo.commandBuffer);
+                boundPipeline = &pipeline;
+            }
+
+            if (KnoxicModel *model = bindEntity(frameInfo, draw.entity)) {
+                model->draw(frameInfo.commandBuffer);
+            }
+        }
+    }
+
+    void RenderSystem::renderGameObjectsIndirect(FrameInfo &frameInfo, VkBuffer drawCommandBuffer, uint32_t phase, bool compositePass) {
+        bindGlobals(frameInfo);
+        buildDrawList();
+
+        // Culled entities have an instance count of zero
+        KnoxicPipeline *boundPipeline = nullptr;
+        for (const auto &draw : drawList) {
+            KnoxicPipeline &pipeline = getPipeline(draw.permutation, compositePass);
+            if (&pipeline != boundPipeline) {
+                pipeline.bind(frameInfo.commandBuffer);
+                boundPipeline = &pipeline;
+            }
+
+            if (KnoxicModel *model = bindEntity(frameInfo, draw.entity)) {
+                model->drawIndirect(
+                    frameInfo.commandBuffer,
+                    drawCommandBuffer,
+                    OcclusionCullingSystem::getDrawCommandOffset(draw.entity, phase)
+                );
+            }
         }
     }
 }
\ No newline at end of file
@@ -1,19 +1,28 @@
 #pragma once
 
 #include "../../graphics/vulkan/knoxic_vk_pipeline.hpp"
+#include "../../graphics/vulkan/knoxic_vk_pipeline_manager.hpp"
 #include "../../core/vulkan/knoxic_vk_device.hpp"
 #include "../../graphics/knoxic_frame_info.hpp"
 #include "../../core/ecs/ecs_systems.hpp"
+#include "../../graphics/vulkan/knoxic_vk_model.hpp"
+#include "knoxic_vk_material_system.hpp"
 
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 namespace knoxic {
 
+    class SoftwareOcclusionSystem;
+
     class RenderSystem {
     public:
-        RenderSystem(KnoxicDevice &device, VkRenderPass renderPass, 
+        // The permutations of the loaded scene start compiling right away
+        RenderSystem(KnoxicDevice &device, KnoxicPipelineManager &pipelineManager, VkRenderPass renderPass,
             VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout materialSetLayout,
-            std::shared_ptr<RenderableSystem> ecsRenderableSystem);
+            const MaterialSystem &materialSystem, std::shared_ptr<RenderableSystem> ecsRenderableSystem,
+            RenderPath renderPath = RenderPath::Forward);
         ~RenderSystem();
 
         RenderSystem(const RenderSystem &) = delete;
@@ -21,15 +30,48 @@ namespace knoxic {
 
         void renderGameObjects(FrameInfo &frameInfo);
 
+        // Draws through the occlusion culling system's per-entity indirect commands.
+        // compositePass draws inside the HDR composite pass, with pipelines built for it
+        void renderGameObjectsIndirect(FrameInfo &frameInfo, VkBuffer drawCommandBuffer, uint32_t phase, bool compositePass = false);
+
+        // Forward late phase can run in the HDR composite pass (merged composite)
+        void setCompositeRenderPass(VkRenderPass renderPass);
+
+        // Entities hidden behind CPU occluders are skipped before any draw is recorded
+        void setSoftwareOcclusion(const SoftwareOcclusionSystem *system) { softwareOcclusion = system; }
+
     private:
+        // One draw, sorted by shader permutation so pipeline binds are minimal
+        struct DrawItem {
+            uint32_t permutation;
+            Entity entity;
+        };
+
         void createPipelineLayout(VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout materialSetLayout);
-        void createPipeline(VkRenderPass renderPass);
+        KnoxicPipeline &getPipeline(uint32_t permutation, bool compositePass = false);
+        void requestPipeline(uint32_t key);
+        void prewarmPipelines(bool compositePass);
+
+        void bindGlobals(FrameInfo &frameInfo);
+        KnoxicModel *bindEntity(FrameInfo &frameInfo, Entity entity);
+        void buildDrawList();
 
         KnoxicDevice &knoxicDevice;
-        std::unique_ptr<KnoxicPipeline> knoxicPipeline;
+        KnoxicPipelineManager &pipelineManager;
+        const MaterialSystem &materialSystem;
+        VkRenderPass renderPass;
+        VkRenderPass compositeRenderPass = VK_NULL_HANDLE;
+        RenderPath renderPath; // Deferred pipelines write the G-buffer instead of lighting
         VkPipelineLayout pipelineLayout;
 
+        // Pipelines keyed by MaterialFeatureBits, requested on first use. Composite pass pipelines set the top bit.
+        // Draws whose permutation is still compiling use the plain one (no maps) of the same pass meanwhile
+        static constexpr uint32_t COMPOSITE_PASS_KEY = 1u << 31;
+        std::unordered_map<uint32_t, KnoxicPipelineRequest<KnoxicPipeline>> pipelines;
+        std::vector<DrawItem> drawList;
+
         // ECS
         std::shared_ptr<RenderableSystem> renderableSystem;
+        const SoftwareOcclusionSystem *softwareOcclusion = nullptr;
     };
 }
\ No newline at end of file
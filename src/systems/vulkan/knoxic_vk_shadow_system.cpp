@@ -0,0 +1,715 @@
+#include "knoxic_vk_shadow_system.hpp"
+#include "../../core/vulkan/knoxic_vk_swap_chain.hpp"
+#include "../../core/ecs/coordinator_instance.hpp"
+#include "../../core/ecs/components.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace knoxic {
+
+    ShadowSystem::ShadowSystem(
+        KnoxicDevice &device,
+        std::shared_ptr<RenderableSystem> ecsRenderableSystem,
+        std::shared_ptr<PointLightECSSystem> ecsPointLightSystem,
+        std::shared_ptr<SpotLightECSSystem> ecsSpotLightSystem,
+        std::shared_ptr<DirectionalLightECSSystem> ecsDirectionalLightSystem
+    ) : knoxicDevice{device}, renderableSystem{std::move(ecsRenderableSystem)}, pointLightSystem{std::move(ecsPointLightSystem)},
+        spotLightSystem{std::move(ecsSpotLightSystem)}, directionalLightSystem{std::move(ecsDirectionalLightSystem)} {
+        tiles.resize(TILE_COUNT);
+
+        // Hand out tiles from the top left first
+        for (uint32_t i = 0; i < TILE_COUNT; i++) {
+            freeTiles.push_back(TILE_COUNT - 1 - i);
+        }
+
+        casters.resize(MAX_ENTITIES);
+
+        frames.resize(KnoxicSwapChain::framesInFlight());
+        for (auto &frame : frames) {
+            frame.shadowViews = createHostBuffer(sizeof(ShadowView), TILE_COUNT);
+            frame.lightShadows = createHostBuffer(sizeof(int32_t), INITIAL_LIGHT_CAPACITY);
+        }
+
+        createAtlas();
+        createRenderPass();
+        createPipeline();
+    }
+
+    ShadowSystem::~ShadowSystem() {
+        vkDeviceWaitIdle(knoxicDevice.device());
+
+        shadowPipeline.reset();
+        vkDestroyPipelineLayout(knoxicDevice.device(), pipelineLayout, nullptr);
+
+        vkDestroyFramebuffer(knoxicDevice.device(), framebuffer, nullptr);
+        vkDestroyRenderPass(knoxicDevice.device(), renderPass, nullptr);
+        vkDestroySampler(knoxicDevice.device(), atlasSampler, nullptr);
+        vkDestroyImageView(knoxicDevice.device(), atlasImageView, nullptr);
+        vkDestroyImage(knoxicDevice.device(), atlasImage, nullptr);
+        knoxicDevice.freeMemory(atlasImageAllocation);
+    }
+
+    std::unique_ptr<KnoxicBuffer> ShadowSystem::createHostBuffer(VkDeviceSize stride, uint32_t capacity) {
+        auto buffer = std::make_unique<KnoxicBuffer>(
+            knoxicDevice,
+            stride,
+            capacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+        );
+        buffer->map();
+        return buffer;
+    }
+
+    void ShadowSystem::createAtlas() {
+        atlasFormat = knoxicDevice.findSupportedFormat(
+            {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM},
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
+        );
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = ATLAS_SIZE;
+        imageInfo.extent.height = ATLAS_SIZE;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = atlasFormat;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        knoxicDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, atlasImage, atlasImageAllocation,
+            KnoxicAllocationStrategy::Dedicated);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = atlasImage;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = atlasFormat;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(knoxicDevice.device(), &viewInfo, nullptr, &atlasImageView) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow atlas image view!");
+        }
+
+        // Hardware depth compare with bilinear filtering, sampled as sampler2DShadow
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.anisotropyEnable = VK_FALSE;
+        samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+        samplerInfo.unnormalizedCoordinates = VK_FALSE;
+        samplerInfo.compareEnable = VK_TRUE;
+        samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = 0.0f;
+
+        if (vkCreateSampler(knoxicDevice.device(), &samplerInfo, nullptr, &atlasSampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow atlas sampler!");
+        }
+
+        // The atlas is always left shader readable, tiles that were never rendered are skipped by the shaders
+        VkCommandBuffer commandBuffer = knoxicDevice.beginSingleTimeCommands();
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = atlasImage;
+        barrier.subresourceRange = viewInfo.subresourceRange;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier
+        );
+
+        knoxicDevice.endSingleTimeCommands(commandBuffer);
+    }
+
+    void ShadowSystem::createRenderPass() {
+        // Loads the atlas so tiles that are not re-rendered keep their depth
+        VkAttachmentDescription depthAttachment{};
+        depthAttachment.format = atlasFormat;
+        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkAttachmentReference depthAttachmentRef{};
+        depthAttachmentRef.attachment = 0;
+        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 0;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+        // Previous frame's lighting reads before the tiles are overwritten, this frame's lighting after
+        std::array<VkSubpassDependency, 2> dependencies{};
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        dependencies[0].srcAccessMask = 0;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &depthAttachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+        renderPassInfo.pDependencies = dependencies.data();
+
+        if (vkCreateRenderPass(knoxicDevice.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow render pass!");
+        }
+
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &atlasImageView;
+        framebufferInfo.width = ATLAS_SIZE;
+        framebufferInfo.height = ATLAS_SIZE;
+        framebufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(knoxicDevice.device(), &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow framebuffer!");
+        }
+    }
+
+    void ShadowSystem::createPipeline() {
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(ShadowPushConstants);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 0;
+        pipelineLayoutInfo.pSetLayouts = nullptr;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(knoxicDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow pipeline layout!");
+        }
+
+        PipelineConfigInfo pipelineConfig{};
+        KnoxicPipeline::defaultPipelineConfigInfo(pipelineConfig);
+        pipelineConfig.renderPass = renderPass;
+        pipelineConfig.pipelineLayout = pipelineLayout;
+        pipelineConfig.colorBlendInfo.attachmentCount = 0; // Depth only
+        pipelineConfig.rasterizationInfo.depthBiasEnable = VK_TRUE;
+        pipelineConfig.rasterizationInfo.depthBiasConstantFactor = 1.25f;
+        pipelineConfig.rasterizationInfo.depthBiasSlopeFactor = 1.75f;
+
+        shadowPipeline = std::make_unique<KnoxicPipeline>(
+            knoxicDevice,
+            "shaders/vk_shadow.vert.spv",
+            "shaders/vk_shadow.frag.spv",
+            pipelineConfig
+        );
+    }
+
+    VkDescriptorImageInfo ShadowSystem::getAtlasImageInfo() const {
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = atlasImageView;
+        imageInfo.sampler = atlasSampler;
+        return imageInfo;
+    }
+
+    bool ShadowSystem::update(FrameInfo &frameInfo, const SceneLights &lights) {
+        frameCounter++;
+        lightsWithoutShadow = 0;
+
+        trackCasters();
+
+        glm::vec3 cameraPosition = frameInfo.camera.getPosition();
+
+        // Allocation order is the fallback order when the atlas runs out: directional, spot, then point.
+        // The ECS sets are walked in the same order the light systems filled SceneLights
+        uint32_t lightIndex = 0;
+        for (auto entity : directionalLightSystem->mEntities) {
+            const DirectionalLight &light = lights.directionalLights[lightIndex++];
+            LightShadow *shadow = acquireLight(Directional, entity, CASCADE_COUNT);
+            if (shadow) {
+                computeCascades(frameInfo.camera, glm::vec3(light.direction), *shadow);
+            }
+        }
+
+        lightIndex = 0;
+        for (auto entity : spotLightSystem->mEntities) {
+            const SpotLight &light = lights.spotLights[lightIndex++];
+            LightShadow *shadow = acquireLight(Spot, entity, 1);
+            if (!shadow) {
+                continue;
+            }
+
+            glm::vec3 position = glm::vec3(light.position);
+            glm::vec3 direction = glm::vec3(light.direction);
+            float fov = glm::min(2.0f * std::acos(glm::clamp(light.outerCutoff, -1.0f, 1.0f)) + 0.02f, glm::radians(170.0f));
+
+            KnoxicCamera lightCamera{};
+            lightCamera.setViewDirection(position, direction, upVectorFor(direction));
+            lightCamera.setPerspectiveProjection(fov, 1.0f, SHADOW_NEAR_PLANE, glm::max(light.position.w, 2.0f * SHADOW_NEAR_PLANE));
+
+            setTileView(shadow->tiles[0], lightCamera.getProjection() * lightCamera.getView(), 0.0f,
+                static_cast<float>(CASCADE_COUNT) + glm::length(position - cameraPosition));
+        }
+
+        lightIndex = 0;
+        for (auto entity : pointLightSystem->mEntities) {
+            const PointLight &light = lights.pointLights[lightIndex++];
+            LightShadow *shadow = acquireLight(Point, entity, CUBE_FACE_COUNT);
+            if (!shadow) {
+                continue;
+            }
+
+            // Face order +x, -x, +y, -y, +z, -z, the shaders pick the face by the major axis
+            static const glm::vec3 faceDirections[CUBE_FACE_COUNT] = {
+                {1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f},
+                {0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f},
+                {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}
+            };
+
+            glm::vec3 position = glm::vec3(light.position);
+            float distance = static_cast<float>(CASCADE_COUNT) + glm::length(position - cameraPosition);
+
+            KnoxicCamera lightCamera{};
+            lightCamera.setPerspectiveProjection(glm::radians(90.0f), 1.0f, SHADOW_NEAR_PLANE, glm::max(light.position.w, 2.0f * SHADOW_NEAR_PLANE));
+            for (uint32_t face = 0; face < CUBE_FACE_COUNT; face++) {
+                lightCamera.setViewDirection(position, faceDirections[face], upVectorFor(faceDirections[face]));
+                setTileView(shadow->tiles[face], lightCamera.getProjection() * lightCamera.getView(), 0.0f, distance);
+            }
+        }
+
+        // Give back the tiles of lights that were removed
+        for (auto it = lightShadows.begin(); it != lightShadows.end();) {
+            if (it->second.lastSeenFrame != frameCounter) {
+                for (uint32_t tile : it->second.tiles) {
+                    tiles[tile] = ShadowTile{};
+                    freeTiles.push_back(tile);
+                }
+                it = lightShadows.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        invalidateChangedCasters();
+        scheduleTiles();
+
+        return uploadViews(frameInfo.frameIndex, lights);
+    }
+
+    void ShadowSystem::trackCasters() {
+        changedSpheres.clear();
+
+        for (auto entity : renderableSystem->mEntities) {
+            auto &modelComp = gCoordinator.GetComponent<ModelComponent>(entity);
+            if (!modelComp.model) {
+                continue;
+            }
+
+            CasterState &caster = casters[entity];
+            caster.lastSeenFrame = frameCounter;
+
+            // Bounds are only recomputed for casters whose transform or model changed
+            uint32_t version = gCoordinator.GetComponentVersion<TransformComponent>(entity) +
+                gCoordinator.GetComponentVersion<ModelComponent>(entity);
+            if (caster.tracked && caster.version == version) {
+                continue;
+            }
+
+            if (caster.tracked) {
+                changedSpheres.push_back(caster.sphere);
+            } else {
+                trackedCasters.push_back(entity);
+            }
+
+            auto &transform = gCoordinator.GetComponent<TransformComponent>(entity);
+            glm::vec3 boundsMin = modelComp.model->getBoundsMin();
+            glm::vec3 boundsMax = modelComp.model->getBoundsMax();
+            glm::vec3 localCenter = (boundsMin + boundsMax) * 0.5f;
+            float localRadius = glm::length(boundsMax - boundsMin) * 0.5f;
+
+            glm::vec3 scale = glm::abs(transform.scale);
+            float maxScale = glm::max(scale.x, glm::max(scale.y, scale.z));
+
+            caster.model = transform.mat4();
+            caster.sphere = glm::vec4(glm::vec3(caster.model * glm::vec4(localCenter, 1.0f)), localRadius * maxScale);
+            caster.version = version;
+            caster.tracked = true;
+            changedSpheres.push_back(caster.sphere);
+        }
+
+        // Casters that left the scene uncover whatever they shadowed
+        for (size_t i = 0; i < trackedCasters.size();) {
+            CasterState &caster = casters[trackedCasters[i]];
+            if (caster.lastSeenFrame != frameCounter) {
+                changedSpheres.push_back(caster.sphere);
+                caster.tracked = false;
+                trackedCasters[i] = trackedCasters.back();
+                trackedCasters.pop_back();
+            } else {
+                i++;
+            }
+        }
+    }
+
+    ShadowSystem::LightShadow *ShadowSystem::acquireLight(LightType type, Entity entity, uint32_t tileCount) {
+        uint64_t key = (static_cast<uint64_t>(type) << 32) | entity;
+
+        auto it = lightShadows.find(key);
+        if (it == lightShadows.end()) {
+            if (freeTiles.size() < tileCount) {
+                lightsWithoutShadow++;
+                return nullptr;
+            }
+
+            it = lightShadows.emplace(key, LightShadow{}).first;
+            for (uint32_t i = 0; i < tileCount; i++) {
+                it->second.tiles.push_back(freeTiles.back());
+                freeTiles.pop_back();
+            }
+        }
+
+        it->second.lastSeenFrame = frameCounter;
+        return &it->second;
+    }
+
+    void ShadowSystem::setTileView(uint32_t tileIndex, const glm::mat4 &viewProjection, float cascadeFar, float priority) {
+        ShadowTile &tile = tiles[tileIndex];
+        tile.viewProjection = viewProjection;
+        tile.cascadeFar = cascadeFar;
+
+        // Tiles never rendered go first, then cascades nearest first, then other lights by camera distance
+        tile.priority = tile.rendered ? priority : -1.0f;
+
+        if (!tile.rendered || tile.renderedViewProjection != viewProjection || tile.renderedCascadeFar != cascadeFar) {
+            tile.stale = true;
+        }
+    }
+
+    void ShadowSystem::computeCascades(const KnoxicCamera &camera, const glm::vec3 &direction, LightShadow &light) {
+        const glm::mat4 &projection = camera.getProjection();
+        float zNear = -projection[3][2] / projection[2][2];
+        float zFar = glm::min(projection[3][2] / (1.0f - projection[2][2]), SHADOW_DISTANCE);
+
+        // Squared tangent of the frustum's corner direction
+        float tanX = 1.0f / projection[0][0];
+        float tanY = 1.0f / projection[1][1];
+        float cornerSquared = tanX * tanX + tanY * tanY;
+
+        glm::vec3 up = upVectorFor(direction);
+        KnoxicCamera lightCamera{};
+        lightCamera.setViewDirection(glm::vec3(0.0f), direction, up);
+
+        float splitNear = zNear;
+        for (uint32_t cascade = 0; cascade < CASCADE_COUNT; cascade++) {
+            // Practical split: mix of logarithmic and uniform
+            float t = static_cast<float>(cascade + 1) / static_cast<float>(CASCADE_COUNT);
+            float logSplit = zNear * std::pow(zFar / zNear, t);
+            float uniformSplit = zNear + (zFar - zNear) * t;
+            float splitFar = glm::mix(uniformSplit, logSplit, 0.75f);
+
+            // Smallest sphere around the slice, it only depends on the projection so the radius
+            // stays the same while the camera moves or turns
+            float center = (splitNear + splitFar) * 0.5f * (1.0f + cornerSquared);
+            float radius;
+            if (center >= splitFar) {
+                center = splitFar;
+                radius = splitFar * glm::sqrt(cornerSquared);
+            } else {
+                radius = glm::sqrt((splitFar - center) * (splitFar - center) + splitFar * splitFar * cornerSquared);
+            }
+            radius = std::ceil(radius * 16.0f) / 16.0f;
+
+            // Snap the center to whole texels in light space so moving the camera does not make edges crawl,
+            // and an unchanged snapped position keeps the cached tile
+            glm::vec3 worldCenter = glm::vec3(camera.getInverseView() * glm::vec4(0.0f, 0.0f, center, 1.0f));
+            glm::vec3 lightCenter = glm::vec3(lightCamera.getView() * glm::vec4(worldCenter, 1.0f));
+            float texelSize = 2.0f * radius / static_cast<float>(TILE_SIZE);
+            lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+            lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+            worldCenter = glm::vec3(lightCamera.getInverseView() * glm::vec4(lightCenter, 1.0f));
+
+            float backOff = radius + CASCADE_CASTER_DISTANCE;
+            KnoxicCamera cascadeCamera{};
+            cascadeCamera.setViewDirection(worldCenter - direction * backOff, direction, up);
+            cascadeCamera.setOrthographicProjection(-radius, radius, -radius, radius, 0.0f, backOff + radius);
+
+            setTileView(light.tiles[cascade], cascadeCamera.getProjection() * cascadeCamera.getView(), splitFar,
+                static_cast<float>(cascade));
+
+            splitNear = splitFar;
+        }
+    }
+
+    void ShadowSystem::invalidateChangedCasters() {
+        if (changedSpheres.empty()) {
+            return;
+        }
+
+        for (auto &pair : lightShadows) {
+            for (uint32_t tileIndex : pair.second.tiles) {
+                ShadowTile &tile = tiles[tileIndex];
+                if (!tile.rendered || tile.stale) {
+                    continue;
+                }
+
+                for (const glm::vec4 &sphere : changedSpheres) {
+                    if (sphereInFrustum(tile.renderedViewProjection, sphere)) {
+                        tile.stale = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    void ShadowSystem::scheduleTiles() {
+        renderQueue.clear();
+        for (auto &pair : lightShadows) {
+            for (uint32_t tileIndex : pair.second.tiles) {
+                if (tiles[tileIndex].stale) {
+                    renderQueue.push_back(tileIndex);
+                }
+            }
+        }
+
+        std::sort(renderQueue.begin(), renderQueue.end(), [this](uint32_t a, uint32_t b) {
+            return tiles[a].priority < tiles[b].priority;
+        });
+
+        // Tiles over the budget keep showing their old depth with the matrix it was rendered with
+        tilesPending = 0;
+        if (renderQueue.size() > updateBudget) {
+            tilesPending = static_cast<uint32_t>(renderQueue.size()) - updateBudget;
+            renderQueue.resize(updateBudget);
+        }
+
+        for (uint32_t tileIndex : renderQueue) {
+            ShadowTile &tile = tiles[tileIndex];
+            tile.renderedViewProjection = tile.viewProjection;
+            tile.renderedCascadeFar = tile.cascadeFar;
+            tile.rendered = true;
+            tile.stale = false;
+        }
+    }
+
+    bool ShadowSystem::uploadViews(int frameIndex, const SceneLights &lights) {
+        FrameBuffers &frame = frames[frameIndex];
+
+        shadowViews.clear();
+        firstViews.clear();
+
+        float tileScale = static_cast<float>(TILE_SIZE) / static_cast<float>(ATLAS_SIZE);
+        auto addLight = [&](LightType type, Entity entity) {
+            auto it = lightShadows.find((static_cast<uint64_t>(type) << 32) | entity);
+            if (it == lightShadows.end()) {
+                firstViews.push_back(-1);
+                return;
+            }
+
+            firstViews.push_back(static_cast<int32_t>(shadowViews.size()));
+            for (uint32_t tileIndex : it->second.tiles) {
+                const ShadowTile &tile = tiles[tileIndex];
+
+                ShadowView &view = shadowViews.emplace_back();
+                view.viewProjection = tile.renderedViewProjection;
+                view.params = glm::vec4(tile.renderedCascadeFar, 0.0f, 0.0f, 0.0f);
+                if (tile.rendered) {
+                    view.atlasRect = glm::vec4(
+                        static_cast<float>(tileIndex % TILES_PER_ROW) * tileScale,
+                        static_cast<float>(tileIndex / TILES_PER_ROW) * tileScale,
+                        tileScale,
+                        tileScale
+                    );
+                }
+            }
+        };
+
+        // Same order as the light buffers: point, spot, directional
+        for (auto entity : pointLightSystem->mEntities) {
+            addLight(Point, entity);
+        }
+        for (auto entity : spotLightSystem->mEntities) {
+            addLight(Spot, entity);
+        }
+        for (auto entity : directionalLightSystem->mEntities) {
+            addLight(Directional, entity);
+        }
+
+        // The frame's fence has been waited on, so its old buffer is no longer in use
+        bool reallocated = false;
+        uint32_t lightCount = static_cast<uint32_t>(firstViews.size());
+        if (lightCount > frame.lightShadows->getInstanceCount()) {
+            uint32_t capacity = frame.lightShadows->getInstanceCount();
+            while (capacity < lightCount) {
+                capacity *= 2;
+            }
+
+            frame.lightShadows = createHostBuffer(sizeof(int32_t), capacity);
+            reallocated = true;
+        }
+
+        if (!shadowViews.empty()) {
+            std::memcpy(frame.shadowViews->getMappedMemory(), shadowViews.data(), shadowViews.size() * sizeof(ShadowView));
+        }
+        if (lightCount > 0) {
+            std::memcpy(frame.lightShadows->getMappedMemory(), firstViews.data(), lightCount * sizeof(int32_t));
+        }
+        frame.shadowViews->flush();
+        frame.lightShadows->flush();
+
+        return reallocated;
+    }
+
+    void ShadowSystem::render(FrameInfo &frameInfo) {
+        if (renderQueue.empty()) {
+            return;
+        }
+
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = framebuffer;
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = {ATLAS_SIZE, ATLAS_SIZE};
+        renderPassInfo.clearValueCount = 0;
+        renderPassInfo.pClearValues = nullptr;
+
+        vkCmdBeginRenderPass(frameInfo.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        shadowPipeline->bind(frameInfo.commandBuffer);
+
+        for (uint32_t tileIndex : renderQueue) {
+            const ShadowTile &tile = tiles[tileIndex];
+
+            VkRect2D tileRect{};
+            tileRect.offset = {
+                static_cast<int32_t>((tileIndex % TILES_PER_ROW) * TILE_SIZE),
+                static_cast<int32_t>((tileIndex / TILES_PER_ROW) * TILE_SIZE)
+            };
+            tileRect.extent = {TILE_SIZE, TILE_SIZE};
+
+            VkViewport viewport{};
+            viewport.x = static_cast<float>(tileRect.offset.x);
+            viewport.y = static_cast<float>(tileRect.offset.y);
+            viewport.width = static_cast<float>(TILE_SIZE);
+            viewport.height = static_cast<float>(TILE_SIZE);
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+            vkCmdSetViewport(frameInfo.commandBuffer, 0, 1, &viewport);
+            vkCmdSetScissor(frameInfo.commandBuffer, 0, 1, &tileRect);
+
+            // Only this tile is cleared, the rest of the atlas stays cached
+            VkClearAttachment clearAttachment{};
+            clearAttachment.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+            clearAttachment.clearValue.depthStencil = {1.0f, 0};
+
+            VkClearRect clearRect{};
+            clearRect.rect = tileRect;
+            clearRect.baseArrayLayer = 0;
+            clearRect.layerCount = 1;
+            vkCmdClearAttachments(frameInfo.commandBuffer, 1, &clearAttachment, 1, &clearRect);
+
+            for (Entity entity : trackedCasters) {
+                const CasterState &caster = casters[entity];
+                if (!sphereInFrustum(tile.viewProjection, caster.sphere)) {
+                    continue;
+                }
+
+                ShadowPushConstants push{};
+                push.modelViewProjection = tile.viewProjection * caster.model;
+                vkCmdPushConstants(
+                    frameInfo.commandBuffer,
+                    pipelineLayout,
+                    VK_SHADER_STAGE_VERTEX_BIT,
+                    0,
+                    sizeof(ShadowPushConstants),
+                    &push
+                );
+
+                auto &model = gCoordinator.GetComponent<ModelComponent>(entity).model;
+                model->bind(frameInfo.commandBuffer);
+                model->draw(frameInfo.commandBuffer);
+            }
+        }
+
+        vkCmdEndRenderPass(frameInfo.commandBuffer);
+    }
+
+    bool ShadowSystem::sphereInFrustum(const glm::mat4 &viewProjection, const glm::vec4 &sphere) {
+        // Planes from the rows of the matrix, depth is 0 to 1
+        glm::vec4 row0{viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]};
+        glm::vec4 row1{viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]};
+        glm::vec4 row2{viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]};
+        glm::vec4 row3{viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]};
+
+        const glm::vec4 planes[6] = {
+            row3 + row0, row3 - row0,
+            row3 + row1, row3 - row1,
+            row2, row3 - row2
+        };
+
+        glm::vec4 center{glm::vec3(sphere), 1.0f};
+        for (const glm::vec4 &plane : planes) {
+            if (glm::dot(plane, center) < -sphere.w * glm::length(glm::vec3(plane))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    glm::vec3 ShadowSystem::upVectorFor(const glm::vec3 &direction) {
+        // Any up works as long as it is not parallel to the view direction
+        return glm::abs(direction.y) > 0.99f ? glm::vec3{0.0f, 0.0f, 1.0f} : glm::vec3{0.0f, -1.0f, 0.0f};
+    }
+}
\ No newline at end of file
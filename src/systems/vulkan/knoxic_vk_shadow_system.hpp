@@ -0,0 +1,161 @@
+#pragma once
+
+#include "../../core/vulkan/knoxic_vk_device.hpp"
+#include "../../core/vulkan/knoxic_vk_buffer.hpp"
+#include "../../graphics/vulkan/knoxic_vk_pipeline.hpp"
+#include "../../graphics/knoxic_frame_info.hpp"
+#include "../../core/ecs/ecs_systems.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace knoxic {
+
+    // Shadow maps for every light type packed into one depth atlas of fixed size tiles.
+    // Directional lights get cascades, spot lights one tile and point lights one tile per cube face.
+    // Tiles keep their depth between frames and are only re-rendered when the light moved or a caster
+    // inside them changed (transform and model versions), at most updateBudget tiles per frame.
+    class ShadowSystem {
+    public:
+        static constexpr uint32_t ATLAS_SIZE = 4096;
+        static constexpr uint32_t TILE_SIZE = 512;
+        static constexpr uint32_t TILES_PER_ROW = ATLAS_SIZE / TILE_SIZE;
+        static constexpr uint32_t TILE_COUNT = TILES_PER_ROW * TILES_PER_ROW;
+        static constexpr uint32_t CASCADE_COUNT = 3;
+        static constexpr uint32_t CUBE_FACE_COUNT = 6;
+        static constexpr uint32_t DEFAULT_UPDATE_BUDGET = 8;
+        static constexpr uint32_t INITIAL_LIGHT_CAPACITY = 64;
+        static constexpr float SHADOW_DISTANCE = 50.0f; // Cascades cover the view up to here
+        static constexpr float CASCADE_CASTER_DISTANCE = 50.0f; // Casters this far behind a cascade still count
+        static constexpr float SHADOW_NEAR_PLANE = 0.05f;
+
+        ShadowSystem(
+            KnoxicDevice &device,
+            std::shared_ptr<RenderableSystem> ecsRenderableSystem,
+            std::shared_ptr<PointLightECSSystem> ecsPointLightSystem,
+            std::shared_ptr<SpotLightECSSystem> ecsSpotLightSystem,
+            std::shared_ptr<DirectionalLightECSSystem> ecsDirectionalLightSystem
+        );
+        ~ShadowSystem();
+
+        ShadowSystem(const ShadowSystem &) = delete;
+        ShadowSystem &operator=(const ShadowSystem &) = delete;
+
+        uint32_t getUpdateBudget() const { return updateBudget; }
+        void setUpdateBudget(uint32_t tiles) { updateBudget = tiles; }
+
+        // Assign tiles, pick the stale ones to re-render and upload the shadow views.
+        // Lights must be gathered already, returns true if a buffer was reallocated and the descriptors need rewriting
+        bool update(FrameInfo &frameInfo, const SceneLights &lights);
+
+        // Re-render the tiles picked by update, recorded outside any render pass
+        void render(FrameInfo &frameInfo);
+
+        // Global set bindings 6, 7 and 8
+        VkDescriptorBufferInfo getShadowViewInfo(int frameIndex) { return frames[frameIndex].shadowViews->descriptorInfo(); }
+        VkDescriptorBufferInfo getLightShadowInfo(int frameIndex) { return frames[frameIndex].lightShadows->descriptorInfo(); }
+        VkDescriptorImageInfo getAtlasImageInfo() const;
+
+        // Tuning stats
+        uint32_t getTilesInUse() const { return TILE_COUNT - static_cast<uint32_t>(freeTiles.size()); }
+        uint32_t getTilesUpdated() const { return static_cast<uint32_t>(renderQueue.size()); }
+        uint32_t getTilesPending() const { return tilesPending; }
+        uint32_t getLightsWithoutShadow() const { return lightsWithoutShadow; }
+
+    private:
+        enum LightType : uint32_t { Directional = 0, Spot = 1, Point = 2 };
+
+        struct ShadowTile {
+            glm::mat4 viewProjection{1.0f}; // Wanted this frame
+            glm::mat4 renderedViewProjection{1.0f}; // What the atlas holds
+            float cascadeFar{0.0f};
+            float renderedCascadeFar{0.0f};
+            float priority{0.0f};
+            bool rendered{false};
+            bool stale{true};
+        };
+
+        struct LightShadow {
+            std::vector<uint32_t> tiles;
+            uint64_t lastSeenFrame{0};
+        };
+
+        struct CasterState {
+            uint32_t version{0};
+            glm::mat4 model{1.0f};
+            glm::vec4 sphere{0.0f}; // World center, radius
+            uint64_t lastSeenFrame{0};
+            bool tracked{false};
+        };
+
+        struct FrameBuffers {
+            std::unique_ptr<KnoxicBuffer> shadowViews;
+            std::unique_ptr<KnoxicBuffer> lightShadows;
+        };
+
+        struct ShadowPushConstants {
+            glm::mat4 modelViewProjection{1.0f};
+        };
+
+        void createAtlas();
+        void createRenderPass();
+        void createPipeline();
+        std::unique_ptr<KnoxicBuffer> createHostBuffer(VkDeviceSize stride, uint32_t capacity);
+
+        void trackCasters();
+        LightShadow *acquireLight(LightType type, Entity entity, uint32_t tileCount);
+        void setTileView(uint32_t tileIndex, const glm::mat4 &viewProjection, float cascadeFar, float priority);
+        void computeCascades(const KnoxicCamera &camera, const glm::vec3 &direction, LightShadow &light);
+        void invalidateChangedCasters();
+        void scheduleTiles();
+        bool uploadViews(int frameIndex, const SceneLights &lights);
+
+        static bool sphereInFrustum(const glm::mat4 &viewProjection, const glm::vec4 &sphere);
+        static glm::vec3 upVectorFor(const glm::vec3 &direction);
+
+        KnoxicDevice &knoxicDevice;
+        std::shared_ptr<RenderableSystem> renderableSystem;
+        std::shared_ptr<PointLightECSSystem> pointLightSystem;
+        std::shared_ptr<SpotLightECSSystem> spotLightSystem;
+        std::shared_ptr<DirectionalLightECSSystem> directionalLightSystem;
+
+        uint32_t updateBudget = DEFAULT_UPDATE_BUDGET;
+        uint32_t tilesPending = 0;
+        uint32_t lightsWithoutShadow = 0;
+        uint64_t frameCounter = 0;
+
+        // Atlas tiles and their owners
+        std::vector<ShadowTile> tiles;
+        std::vector<uint32_t> freeTiles;
+        std::unordered_map<uint64_t, LightShadow> lightShadows;
+        std::vector<uint32_t> renderQueue;
+
+        // Caster change tracking, indexed by entity
+        std::vector<CasterState> casters;
+        std::vector<Entity> trackedCasters;
+        std::vector<glm::vec4> changedSpheres; // Old and new bounds of every caster that changed
+
+        // Per-frame shader data: views in light order, then the first view of each light (-1 for none)
+        std::vector<ShadowView> shadowViews;
+        std::vector<int32_t> firstViews;
+        std::vector<FrameBuffers> frames;
+
+        // Atlas
+        VkFormat atlasFormat;
+        VkImage atlasImage = VK_NULL_HANDLE;
+        KnoxicAllocation atlasImageAllocation{};
+        VkImageView atlasImageView = VK_NULL_HANDLE;
+        VkSampler atlasSampler = VK_NULL_HANDLE;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+        std::unique_ptr<KnoxicPipeline> shadowPipeline;
+        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    };
+}
\ No newline at end of file
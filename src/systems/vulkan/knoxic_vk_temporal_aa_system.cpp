@@ -0,0 +1,354 @@
+#include "knoxic_vk_temporal_aa_system.hpp"
+#include "../../core/vulkan/knoxic_vk_swap_chain.hpp"
+#include "../../core/ecs/components.hpp"
+#include "../../core/ecs/coordinator_instance.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace knoxic {
+
+    namespace {
+        float halton(uint32_t index, uint32_t base) {
+            float result = 0.0f;
+            float fraction = 1.0f / static_cast<float>(base);
+            while (index > 0) {
+                result += static_cast<float>(index % base) * fraction;
+                index /= base;
+                fraction /= static_cast<float>(base);
+            }
+            return result;
+        }
+    }
+
+    TemporalAASystem::TemporalAASystem(
+        KnoxicDevice &device,
+        PostProcessSystem &postProcessSystem,
+        std::shared_ptr<RenderableSystem> ecsRenderableSystem
+    ) : knoxicDevice{device}, postProcessSystem{postProcessSystem}, renderableSystem{std::move(ecsRenderableSystem)} {
+        previousModels.resize(MAX_ENTITIES, glm::mat4{1.0f});
+        lastModels.resize(MAX_ENTITIES, glm::mat4{1.0f});
+        lastSeenFrame.resize(MAX_ENTITIES, 0);
+        createBuffers();
+        createSamplers();
+        createDescriptorSetLayout();
+        createPipeline();
+        // History and descriptor sets follow the render graph targets, see recreate()
+    }
+
+    TemporalAASystem::~TemporalAASystem() {
+        vkDeviceWaitIdle(knoxicDevice.device());
+
+        resolvePipeline.reset();
+        vkDestroyPipelineLayout(knoxicDevice.device(), resolvePipelineLayout, nullptr);
+
+        descriptorPool.reset();
+        resolveSetLayout.reset();
+
+        destroyHistory();
+        vkDestroySampler(knoxicDevice.device(), pointSampler, nullptr);
+        vkDestroySampler(knoxicDevice.device(), linearSampler, nullptr);
+    }
+
+    VkExtent2D TemporalAASystem::getRenderExtent(VkExtent2D extent) const {
+        if (!enabled || renderScale >= 1.0f) {
+            return extent;
+        }
+
+        auto scaled = [&](uint32_t size) {
+            uint32_t scaledSize = static_cast<uint32_t>(static_cast<float>(size) * renderScale);
+            return std::clamp(scaledSize, std::min(size, 8u), size);
+        };
+        return {scaled(extent.width), scaled(extent.height)};
+    }
+
+    void TemporalAASystem::recreate() {
+        vkDeviceWaitIdle(knoxicDevice.device());
+
+        descriptorPool.reset();
+        resolveDescriptorSets.clear();
+        destroyHistory();
+        if (!enabled) {
+            return;
+        }
+
+        createHistory();
+        createDescriptorSets();
+    }
+
+    void TemporalAASystem::createBuffers() {
+        previousModelBuffers.resize(KnoxicSwapChain::framesInFlight());
+        for (int i = 0; i < KnoxicSwapChain::framesInFlight(); i++) {
+            previousModelBuffers[i] = std::make_unique<KnoxicBuffer>(
+                knoxicDevice,
+                sizeof(glm::mat4),
+                static_cast<uint32_t>(MAX_ENTITIES),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+            );
+            previousModelBuffers[i]->map();
+        }
+    }
+
+    void TemporalAASystem::createSamplers() {
+        // Point for the current frame, the resolve places its samples itself. Linear for the history
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.anisotropyEnable = VK_FALSE;
+        samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+        samplerInfo.unnormalizedCoordinates = VK_FALSE;
+        samplerInfo.compareEnable = VK_FALSE;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = 0.0f;
+
+        if (vkCreateSampler(knoxicDevice.device(), &samplerInfo, nullptr, &pointSampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create temporal resolve sampler!");
+        }
+
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        if (vkCreateSampler(knoxicDevice.device(), &samplerInfo, nullptr, &linearSampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create temporal history sampler!");
+        }
+    }
+
+    void TemporalAASystem::createHistory() {
+        historyExtent = postProcessSystem.getTargetExtent();
+
+        historyImages.resize(KnoxicSwapChain::framesInFlight());
+        historyImageAllocations.resize(KnoxicSwapChain::framesInFlight());
+        historyViews.resize(KnoxicSwapChain::framesInFlight());
+        historyWritten.assign(KnoxicSwapChain::framesInFlight(), false);
+        resolvesSinceRecreate = 0;
+
+        for (size_t i = 0; i < KnoxicSwapChain::framesInFlight(); i++) {
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent.width = historyExtent.width;
+            imageInfo.extent.height = historyExtent.height;
+            imageInfo.extent.depth = 1;
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            knoxicDevice.shareWithComputeQueue(imageInfo); // Bloom may read it on the compute queue
+
+            knoxicDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                historyImages[i], historyImageAllocations[i], KnoxicAllocationStrategy::Dedicated);
+
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = historyImages[i];
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+            viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            viewInfo.subresourceRange.baseMipLevel = 0;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+
+            if (vkCreateImageView(knoxicDevice.device(), &viewInfo, nullptr, &historyViews[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create temporal history image view!");
+            }
+        }
+    }
+
+    void TemporalAASystem::destroyHistory() {
+        for (size_t i = 0; i < historyImages.size(); i++) {
+            vkDestroyImageView(knoxicDevice.device(), historyViews[i], nullptr);
+            vkDestroyImage(knoxicDevice.device(), historyImages[i], nullptr);
+            knoxicDevice.freeMemory(historyImageAllocations[i]);
+        }
+
+        historyViews.clear();
+        historyImages.clear();
+        historyImageAllocations.clear();
+        historyWritten.clear();
+    }
+
+    void TemporalAASystem::createDescriptorSetLayout() {
+        // Scene color, velocity, history, resolved output
+        resolveSetLayout = KnoxicDescriptorSetLayout::Builder(knoxicDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+            .build();
+    }
+
+    void TemporalAASystem::createDescriptorSets() {
+        uint32_t frames = KnoxicSwapChain::framesInFlight();
+        descriptorPool = KnoxicDescriptorPool::Builder(knoxicDevice)
+            .setMaxSets(frames)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frames * 3)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, frames)
+            .build();
+
+        resolveDescriptorSets.resize(frames);
+        for (uint32_t i = 0; i < frames; i++) {
+            VkDescriptorImageInfo colorInfo{};
+            colorInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            colorInfo.imageView = postProcessSystem.getHDRColorImageView(static_cast<int>(i));
+            colorInfo.sampler = pointSampler;
+
+            VkDescriptorImageInfo velocityInfo{};
+            velocityInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            velocityInfo.imageView = postProcessSystem.getVelocityImageView(static_cast<int>(i));
+            velocityInfo.sampler = pointSampler;
+
+            // The previous frame's output
+            VkDescriptorImageInfo historyInfo{};
+            historyInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            historyInfo.imageView = historyViews[(i + frames - 1) % frames];
+            historyInfo.sampler = linearSampler;
+
+            VkDescriptorImageInfo outputInfo{};
+            outputInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            outputInfo.imageView = historyViews[i];
+            outputInfo.sampler = VK_NULL_HANDLE;
+
+            KnoxicDescriptorWriter(*resolveSetLayout, *descriptorPool)
+                .writeImage(0, &colorInfo)
+                .writeImage(1, &velocityInfo)
+                .writeImage(2, &historyInfo)
+                .writeImage(3, &outputInfo)
+                .build(resolveDescriptorSets[i]);
+        }
+    }
+
+    void TemporalAASystem::createPipeline() {
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(ResolvePushConstants);
+
+        VkDescriptorSetLayout setLayout = resolveSetLayout->getDescriptorSetLayout();
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(knoxicDevice.device(), &pipelineLayoutInfo, nullptr, &resolvePipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create temporal resolve pipeline layout!");
+        }
+
+        resolvePipeline = std::make_unique<KnoxicComputePipeline>(
+            knoxicDevice,
+            "shaders/vk_taa_resolve.comp.spv",
+            resolvePipelineLayout
+        );
+    }
+
+    glm::vec2 TemporalAASystem::nextJitter(VkExtent2D renderExtent) {
+        if (!enabled) {
+            jitterPixels = glm::vec2(0.0f);
+            return jitterPixels;
+        }
+
+        // Halton (2, 3) from index 1, centered on the pixel
+        jitterIndex = jitterIndex % JITTER_PHASES + 1;
+        jitterPixels = glm::vec2(halton(jitterIndex, 2), halton(jitterIndex, 3)) - 0.5f;
+        return 2.0f * jitterPixels / glm::vec2(renderExtent.width, renderExtent.height);
+    }
+
+    void TemporalAASystem::update(FrameInfo &frameInfo, GlobalUbo &ubo) {
+        const KnoxicCamera &camera = frameInfo.camera;
+        previousViewProjection = hasPreviousView ? currentViewProjection : camera.getUnjitteredProjection() * camera.getView();
+        hasPreviousView = true;
+        updateView(camera, ubo);
+
+        frameCounter++;
+        uint32_t entityCount = 0;
+        for (auto entity : renderableSystem->mEntities) {
+            glm::mat4 model = gCoordinator.GetComponent<TransformComponent>(entity).mat4();
+            previousModels[entity] = lastSeenFrame[entity] + 1 == frameCounter ? lastModels[entity] : model;
+            lastModels[entity] = model;
+            lastSeenFrame[entity] = frameCounter;
+            entityCount = std::max(entityCount, static_cast<uint32_t>(entity) + 1);
+        }
+
+        if (entityCount > 0) {
+            auto &buffer = previousModelBuffers[frameInfo.frameIndex];
+            buffer->writeToBuffer(previousModels.data(), entityCount * sizeof(glm::mat4));
+            buffer->flush();
+        }
+    }
+
+    void TemporalAASystem::updateView(const KnoxicCamera &camera, GlobalUbo &ubo) {
+        currentViewProjection = camera.getUnjitteredProjection() * camera.getView();
+        ubo.viewProjection = currentViewProjection;
+        ubo.previousViewProjection = previousViewProjection;
+        reprojection = previousViewProjection * glm::inverse(currentViewProjection);
+    }
+
+    void TemporalAASystem::resolve(FrameInfo &frameInfo) {
+        assert(!historyImages.empty() && "Temporal resolve needs recreate() while enabled");
+
+        VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+        int frameIndex = frameInfo.frameIndex;
+
+        // The output was last read by bloom and the composite two frames ago
+        VkImageMemoryBarrier writeBarrier{};
+        writeBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        writeBarrier.srcAccessMask = 0;
+        writeBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        writeBarrier.oldLayout = historyWritten[frameIndex] ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
+        writeBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        writeBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        writeBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        writeBarrier.image = historyImages[frameIndex];
+        writeBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &writeBarrier);
+
+        // A resize keeps the history images but the previous output no longer lines up with this one
+        VkExtent2D renderExtent = postProcessSystem.getRenderExtent();
+        VkExtent2D outputExtent = postProcessSystem.getExtent();
+        bool sameOutput = outputExtent.width == lastOutputExtent.width && outputExtent.height == lastOutputExtent.height;
+        lastOutputExtent = outputExtent;
+
+        ResolvePushConstants push{};
+        push.reprojection = reprojection;
+        push.renderSize = glm::ivec2(renderExtent.width, renderExtent.height);
+        push.outputSize = glm::ivec2(outputExtent.width, outputExtent.height);
+        push.jitter = jitterPixels;
+        push.historySize = glm::ivec2(historyExtent.width, historyExtent.height);
+        push.historyValid = resolvesSinceRecreate > 0 && sameOutput ? 1 : 0;
+
+        resolvePipeline->bind(commandBuffer);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+            resolvePipelineLayout, 0, 1, &resolveDescriptorSets[frameIndex], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, resolvePipelineLayout,
+            VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ResolvePushConstants), &push);
+        vkCmdDispatch(commandBuffer, (outputExtent.width + 7) / 8, (outputExtent.height + 7) / 8, 1);
+
+        // Bloom samples it in compute, the composite in the fragment shader and the next frame as history
+        VkImageMemoryBarrier readBarrier = writeBarrier;
+        readBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        readBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        readBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &readBarrier);
+
+        historyWritten[frameIndex] = true;
+        resolvesSinceRecreate++;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "../../core/vulkan/knoxic_vk_device.hpp"
+#include "../../core/vulkan/knoxic_vk_buffer.hpp"
+#include "../../core/vulkan/knoxic_vk_descriptors.hpp"
+#include "../../graphics/vulkan/knoxic_vk_pipeline.hpp"
+#include "../../graphics/knoxic_frame_info.hpp"
+#include "../../core/ecs/ecs_systems.hpp"
+#include "knoxic_vk_post_process_system.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <vector>
+
+namespace knoxic {
+
+    // Temporal anti-aliasing with upsampling.
+    // The projection is jittered by a sub-pixel Halton offset every frame and the scene passes write motion vectors.
+    // A compute resolve reprojects the previous output, clamps it to the current neighbourhood and blends in the
+    // new samples at output resolution, so the scene can render at a fixed fraction of it. Bloom and the composite
+    // then read the resolved color. The previous model matrices for the motion vectors are kept here as well.
+    class TemporalAASystem {
+    public:
+        static constexpr float DEFAULT_RENDER_SCALE = 0.67f;
+        static constexpr uint32_t JITTER_PHASES = 16;
+
+        TemporalAASystem(KnoxicDevice &device, PostProcessSystem &postProcessSystem,
+            std::shared_ptr<RenderableSystem> ecsRenderableSystem);
+        ~TemporalAASystem();
+
+        TemporalAASystem(const TemporalAASystem &) = delete;
+        TemporalAASystem &operator=(const TemporalAASystem &) = delete;
+
+        // Takes effect on the next recreate(), the render graph has to be rebuilt
+        bool isEnabled() const { return enabled; }
+        void setEnabled(bool value) { enabled = value; }
+
+        // Fraction of the output the scene renders at while enabled
+        float getRenderScale() const { return renderScale; }
+        void setRenderScale(float scale) { renderScale = scale; }
+        VkExtent2D getRenderExtent(VkExtent2D extent) const;
+
+        // History images and descriptor sets, after every render graph compile. Frees them while disabled
+        void recreate();
+
+        // Resolved color per frame in flight, empty while disabled
+        const std::vector<VkImageView> &getResolvedViews() const { return historyViews; }
+
+        // Advances the sequence, returns this frame's projection offset in NDC. Zero while disabled
+        glm::vec2 nextJitter(VkExtent2D renderExtent);
+
+        // Unjittered view projections for the motion vectors and this frame's previous model matrices
+        void update(FrameInfo &frameInfo, GlobalUbo &ubo);
+
+        // Recomputes the view projection after a late camera latch, the history stays the last frame's final view
+        void updateView(const KnoxicCamera &camera, GlobalUbo &ubo);
+
+        // Global set binding 9
+        VkDescriptorBufferInfo getPreviousModelInfo(int frameIndex) { return previousModelBuffers[frameIndex]->descriptorInfo(); }
+
+        // Reads the HDR color and velocity in sampled layouts, writes the resolved color for bloom and the composite
+        void resolve(FrameInfo &frameInfo);
+
+    private:
+        struct ResolvePushConstants {
+            glm::mat4 reprojection{1.0f}; // Current unjittered clip to previous clip
+            glm::ivec2 renderSize{0};
+            glm::ivec2 outputSize{0};
+            glm::vec2 jitter{0.0f}; // Render pixels
+            glm::ivec2 historySize{0};
+            int historyValid{0};
+            float padding{0.0f};
+        };
+
+        void createBuffers();
+        void createSamplers();
+        void createHistory();
+        void destroyHistory();
+        void createDescriptorSetLayout();
+        void createDescriptorSets();
+        void createPipeline();
+
+        KnoxicDevice &knoxicDevice;
+        PostProcessSystem &postProcessSystem;
+        std::shared_ptr<RenderableSystem> renderableSystem;
+
+        bool enabled = false;
+        float renderScale = DEFAULT_RENDER_SCALE;
+
+        // Jitter and camera
+        uint32_t jitterIndex = 0;
+        glm::vec2 jitterPixels{0.0f};
+        glm::mat4 previousViewProjection{1.0f};
+        glm::mat4 currentViewProjection{1.0f};
+        glm::mat4 reprojection{1.0f};
+        bool hasPreviousView = false;
+
+        // Model matrices by entity, an entity not drawn last frame has no motion of its own
+        std::vector<std::unique_ptr<KnoxicBuffer>> previousModelBuffers;
+        std::vector<glm::mat4> previousModels;
+        std::vector<glm::mat4> lastModels;
+        std::vector<uint32_t> lastSeenFrame;
+        uint32_t frameCounter = 0;
+
+        // One history image per frame in flight, each frame writes its own and reads the previous one.
+        // Sized like the post-process targets, the output only covers the top-left part of it
+        std::vector<VkImage> historyImages;
+        std::vector<KnoxicAllocation> historyImageAllocations;
+        std::vector<VkImageView> historyViews;
+        std::vector<bool> historyWritten;
+        uint32_t resolvesSinceRecreate = 0;
+        VkExtent2D historyExtent{0, 0};
+        VkExtent2D lastOutputExtent{0, 0};
+
+        VkSampler pointSampler = VK_NULL_HANDLE;
+        VkSampler linearSampler = VK_NULL_HANDLE;
+
+        std::unique_ptr<KnoxicDescriptorPool> descriptorPool;
+        std::unique_ptr<KnoxicDescriptorSetLayout> resolveSetLayout;
+        std::vector<VkDescriptorSet> resolveDescriptorSets;
+
+        std::unique_ptr<KnoxicComputePipeline> resolvePipeline;
+        VkPipelineLayout resolvePipelineLayout = VK_NULL_HANDLE;
+    };
+}
\ No newline at end of file